@@ -0,0 +1,487 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "arena.h"
+#include "intern.h"
+#include "output.h"
+#include "lexer.h"
+#include "parser.h"
+#include "semantic.h"
+#include "translator.h"
+#include "render.h"
+#include "formatter.h"
+#include "stats.h"
+#include "corpus.h"
+
+/*
+ * c2en_bench - times each pipeline stage in-process on generated corpora and
+ * prints the results as JSON. Every stage is run on the same input for a
+ * number of iterations; the best and median times are reported, with
+ * throughput worked out from the best. Giving several function counts runs
+ * one corpus per count, so throughput that falls as the input grows points
+ * at super-linear work.
+ */
+
+#define BENCH_MAX_SIZES 16
+
+typedef enum {
+    BENCH_LEX,          /* Tokenizing the whole input into a list */
+    BENCH_PARSE,        /* Parsing, pulling tokens from the lexer */
+    BENCH_SEMANTIC,
+    BENCH_TRANSLATE,
+    BENCH_FORMAT,
+    BENCH_PIPELINE,     /* Parse to format, as one compilation runs them */
+    BENCH_PHASE_COUNT
+} BenchPhase;
+
+static const char* const bench_phase_names[BENCH_PHASE_COUNT] = {
+    "lex",
+    "parse",
+    "semantic",
+    "translate",
+    "format",
+    "pipeline",
+};
+
+typedef struct {
+    CorpusParams corpus;
+    int sizes[BENCH_MAX_SIZES];     /* Function counts, one corpus each */
+    int size_count;
+    int iterations;
+    int emit;                       /* Print the corpus instead of timing it */
+    int keyword_words;              /* Time keyword lookup over this many words instead (0 = off) */
+    int keyword_percent;            /* Share of those words that are keywords */
+    int show_help;
+} BenchOptions;
+
+/* Sizes and per-iteration times for one corpus */
+typedef struct {
+    size_t input_bytes;
+    size_t tokens;
+    size_t nodes;
+    size_t output_bytes;
+    uint64_t* times[BENCH_PHASE_COUNT];
+} BenchResult;
+
+static void print_usage(const char* program_name) {
+    CorpusParams defaults;
+    corpus_params_default(&defaults);
+
+    printf("c2en benchmark - Version %s\n\n", C2EN_VERSION_STRING);
+    printf("Usage: %s [options]\n\n", program_name);
+    printf("Options:\n");
+    printf("  --functions <n[,n...]>\n");
+    printf("                  Functions per corpus; a list runs one corpus each (default: %d)\n",
+           defaults.functions);
+    printf("  --block <n>     Statements per function body (default: %d)\n", defaults.block_length);
+    printf("  --depth <n>     Operator nesting of expressions (default: %d)\n", defaults.depth);
+    printf("  --switch <n>    Cases per switch statement (default: %d)\n", defaults.switch_size);
+    printf("  --identifiers <n>\n");
+    printf("                  Distinct variable names in the corpus (default: %d)\n", defaults.identifiers);
+    printf("  --iterations <n>\n");
+    printf("                  Timed runs of each stage (default: 5)\n");
+    printf("  --seed <n>      Corpus random seed (default: %u)\n", defaults.seed);
+    printf("  --emit          Write the first corpus to standard output and stop\n");
+    printf("  --keywords <n>  Time keyword lookup over n identifiers and keywords instead\n");
+    printf("  --keyword-share <pct>\n");
+    printf("                  Percentage of those words that are keywords (default: 30)\n");
+    printf("  --help          Display this help message\n\n");
+    printf("Results are written to standard output as JSON.\n");
+}
+
+/* Read a non-negative integer option value; logs and returns 0 on failure */
+static int parse_count(int argc, char** argv, int* i, long minimum, long* value) {
+    char* end = NULL;
+    long parsed = *i + 1 < argc ? strtol(argv[*i + 1], &end, 10) : -1;
+    if (parsed < minimum || !end || *end != '\0') {
+        log_message(LOG_ERROR, "Option %s requires a number of at least %ld", argv[*i], minimum);
+        return 0;
+    }
+    *value = parsed;
+    (*i)++;
+    return 1;
+}
+
+static int parse_sizes(const char* text, BenchOptions* opts) {
+    opts->size_count = 0;
+    const char* cursor = text;
+    while (*cursor) {
+        char* end = NULL;
+        long size = strtol(cursor, &end, 10);
+        if (end == cursor || size < 1 || (*end != ',' && *end != '\0') ||
+            opts->size_count >= BENCH_MAX_SIZES) {
+            log_message(LOG_ERROR, "Option --functions requires up to %d positive numbers",
+                        BENCH_MAX_SIZES);
+            return 0;
+        }
+        opts->sizes[opts->size_count++] = (int)size;
+        cursor = *end == ',' ? end + 1 : end;
+    }
+    return opts->size_count > 0;
+}
+
+static BenchOptions parse_arguments(int argc, char** argv) {
+    BenchOptions opts;
+    memset(&opts, 0, sizeof(opts));
+    corpus_params_default(&opts.corpus);
+    opts.sizes[0] = opts.corpus.functions;
+    opts.size_count = 1;
+    opts.iterations = 5;
+    opts.keyword_percent = 30;
+
+    for (int i = 1; i < argc; i++) {
+        long value = 0;
+        if (string_equals(argv[i], "--help")) {
+            opts.show_help = 1;
+        } else if (string_equals(argv[i], "--emit")) {
+            opts.emit = 1;
+        } else if (string_equals(argv[i], "--functions")) {
+            if (i + 1 >= argc || !parse_sizes(argv[++i], &opts)) {
+                opts.show_help = 1;
+            }
+        } else if (string_equals(argv[i], "--block")) {
+            if (parse_count(argc, argv, &i, 1, &value)) opts.corpus.block_length = (int)value;
+            else opts.show_help = 1;
+        } else if (string_equals(argv[i], "--depth")) {
+            if (parse_count(argc, argv, &i, 0, &value)) opts.corpus.depth = (int)value;
+            else opts.show_help = 1;
+        } else if (string_equals(argv[i], "--switch")) {
+            if (parse_count(argc, argv, &i, 0, &value)) opts.corpus.switch_size = (int)value;
+            else opts.show_help = 1;
+        } else if (string_equals(argv[i], "--identifiers")) {
+            if (parse_count(argc, argv, &i, 1, &value)) opts.corpus.identifiers = (int)value;
+            else opts.show_help = 1;
+        } else if (string_equals(argv[i], "--iterations")) {
+            if (parse_count(argc, argv, &i, 1, &value)) opts.iterations = (int)value;
+            else opts.show_help = 1;
+        } else if (string_equals(argv[i], "--keywords")) {
+            if (parse_count(argc, argv, &i, 1, &value)) opts.keyword_words = (int)value;
+            else opts.show_help = 1;
+        } else if (string_equals(argv[i], "--keyword-share")) {
+            if (parse_count(argc, argv, &i, 0, &value) && value <= 100) opts.keyword_percent = (int)value;
+            else opts.show_help = 1;
+        } else if (string_equals(argv[i], "--seed")) {
+            if (parse_count(argc, argv, &i, 0, &value)) opts.corpus.seed = (unsigned int)value;
+            else opts.show_help = 1;
+        } else {
+            log_message(LOG_ERROR, "Unknown option: %s", argv[i]);
+            opts.show_help = 1;
+        }
+    }
+
+    return opts;
+}
+
+/* Timing */
+
+static int compare_times(const void* a, const void* b) {
+    uint64_t left = *(const uint64_t*)a;
+    uint64_t right = *(const uint64_t*)b;
+    return left < right ? -1 : left > right;
+}
+
+/* Run every stage once on source, recording the times for iteration */
+static int run_iteration(const char* source, size_t length, Arena* arena, Interner* interner,
+                         AST* ast, Description* description, OutputBuilder* english,
+                         OutputBuilder* formatted, BenchResult* result, int iteration) {
+    const char* filename = "<corpus>";
+
+    arena_reset(arena);
+    interner_clear(interner);
+    uint64_t start = stats_now();
+    TokenList* tokens = tokenize(source, length, filename, arena);
+    result->times[BENCH_LEX][iteration] = stats_now() - start;
+    if (!tokens) return 0;
+    result->tokens = (size_t)tokens->count;
+    token_list_destroy(tokens);
+
+    arena_reset(arena);
+    interner_clear(interner);
+    ast_clear(ast);
+    start = stats_now();
+    Lexer* lexer = lexer_create(source, length, filename, arena);
+    TokenStream stream;
+    token_stream_init(&stream, lexer);
+    ASTRef program = parse(&stream, filename, arena, interner, ast);
+    lexer_destroy(lexer);
+    result->times[BENCH_PARSE][iteration] = stats_now() - start;
+    if (program == AST_NONE || stream.had_error) return 0;
+    result->nodes = ast_count_nodes(ast, program);
+
+    uint64_t phase_start = stats_now();
+    int symbol_count = 0;
+    if (!analyze_semantics(ast, program, filename, arena, NULL, NULL, 1, &symbol_count)) return 0;
+    uint64_t phase_end = stats_now();
+    result->times[BENCH_SEMANTIC][iteration] = phase_end - phase_start;
+
+    TranslateOptions translate_options = { 1, 0, NULL };
+    description_clear(description);
+    phase_start = stats_now();
+    translate_to_english(ast, program, description, &translate_options);
+    phase_end = stats_now();
+    result->times[BENCH_TRANSLATE][iteration] = phase_end - phase_start;
+
+    output_builder_clear(english);
+    output_builder_clear(formatted);
+    phase_start = stats_now();
+    render_description(description, RENDER_TEXT, english);
+    format_english_output(english, formatted, NULL);
+    phase_end = stats_now();
+    result->times[BENCH_FORMAT][iteration] = phase_end - phase_start;
+    result->output_bytes = formatted->length;
+
+    /* Node counting falls between parsing and analysis, so sum the stages */
+    result->times[BENCH_PIPELINE][iteration] = result->times[BENCH_PARSE][iteration] +
+                                               result->times[BENCH_SEMANTIC][iteration] +
+                                               result->times[BENCH_TRANSLATE][iteration] +
+                                               result->times[BENCH_FORMAT][iteration];
+    return 1;
+}
+
+/* Reporting */
+
+static double per_second(double amount, uint64_t nanoseconds) {
+    return nanoseconds > 0 ? amount * 1e9 / (double)nanoseconds : 0.0;
+}
+
+static void print_result(const CorpusParams* corpus, const BenchResult* result, int iterations,
+                         int first) {
+    printf("%s    {\n", first ? "" : ",\n");
+    printf("      \"params\": {\"functions\": %d, \"block_length\": %d, \"depth\": %d, "
+           "\"switch_size\": %d, \"identifiers\": %d, \"seed\": %u},\n",
+           corpus->functions, corpus->block_length, corpus->depth,
+           corpus->switch_size, corpus->identifiers, corpus->seed);
+    printf("      \"input_bytes\": %zu,\n", result->input_bytes);
+    printf("      \"tokens\": %zu,\n", result->tokens);
+    printf("      \"nodes\": %zu,\n", result->nodes);
+    printf("      \"output_bytes\": %zu,\n", result->output_bytes);
+    printf("      \"phases\": {\n");
+
+    for (int phase = 0; phase < BENCH_PHASE_COUNT; phase++) {
+        uint64_t* times = result->times[phase];
+        qsort(times, (size_t)iterations, sizeof(uint64_t), compare_times);
+        uint64_t best = times[0];
+        uint64_t median = times[iterations / 2];
+
+        printf("        \"%s\": {\"best_ms\": %.3f, \"median_ms\": %.3f, "
+               "\"mb_per_s\": %.2f, \"tokens_per_s\": %.0f, \"nodes_per_s\": %.0f}%s\n",
+               bench_phase_names[phase], (double)best / 1e6, (double)median / 1e6,
+               per_second((double)result->input_bytes / (1024.0 * 1024.0), best),
+               per_second((double)result->tokens, best),
+               per_second((double)result->nodes, best),
+               phase + 1 < BENCH_PHASE_COUNT ? "," : "");
+    }
+
+    printf("      }\n");
+    printf("    }");
+}
+
+/* Generate, time and report one corpus; returns 0 if a stage failed */
+static int bench_corpus(const CorpusParams* corpus, int iterations, int first) {
+    OutputBuilder* generated = output_builder_create();
+    corpus_generate(corpus, generated);
+    char* source = output_builder_to_string(generated);
+    size_t length = generated->length;
+    output_builder_destroy(generated);
+
+    BenchResult result;
+    memset(&result, 0, sizeof(result));
+    result.input_bytes = length;
+    for (int phase = 0; phase < BENCH_PHASE_COUNT; phase++) {
+        result.times[phase] = (uint64_t*)safe_malloc(sizeof(uint64_t) * (size_t)iterations);
+    }
+
+    /* State is reset between iterations, as a batch worker does between files */
+    Arena* arena = arena_create(0);
+    Interner* interner = interner_create(arena);
+    AST* ast = ast_create();
+    Description* description = description_create();
+    OutputBuilder* english = output_builder_create();
+    OutputBuilder* formatted = output_builder_create();
+
+    int ok = 1;
+    for (int i = 0; i < iterations && ok; i++) {
+        ok = run_iteration(source, length, arena, interner, ast, description, english, formatted, &result, i);
+    }
+
+    if (ok) {
+        print_result(corpus, &result, iterations, first);
+    } else {
+        log_message(LOG_ERROR, "Generated corpus failed to compile (%d functions)", corpus->functions);
+    }
+
+    output_builder_destroy(formatted);
+    output_builder_destroy(english);
+    description_destroy(description);
+    ast_destroy(ast);
+    interner_destroy(interner);
+    arena_destroy(arena);
+    for (int phase = 0; phase < BENCH_PHASE_COUNT; phase++) {
+        free(result.times[phase]);
+    }
+    free(source);
+    return ok;
+}
+
+/* Keyword lookup */
+
+typedef enum {
+    KEYWORD_LEXER,      /* lexer_next_token over the words, as the parser pulls them */
+    KEYWORD_INDEX,      /* The lexer's keyword index alone, on each word */
+    KEYWORD_LINEAR,     /* The scan of every keyword the index replaced, on each word */
+    KEYWORD_PHASE_COUNT
+} KeywordPhase;
+
+static const char* const keyword_phase_names[KEYWORD_PHASE_COUNT] = {
+    "lexer",
+    "keyword_index",
+    "linear_scan",
+};
+
+/* The lookup lexer_keyword_type replaced: strncmp against each keyword in turn */
+static int linear_keyword(const char* start, int length) {
+    for (int i = 0; corpus_keywords[i] != NULL; i++) {
+        if (strncmp(start, corpus_keywords[i], (size_t)length) == 0 && corpus_keywords[i][length] == '\0') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Time each way of telling keywords from identifiers over the same words; returns 0 if they disagree */
+static int bench_keywords(const BenchOptions* opts) {
+    OutputBuilder* generated = output_builder_create();
+    corpus_generate_words(opts->keyword_words, opts->keyword_percent, opts->corpus.seed, generated);
+    char* source = output_builder_to_string(generated);
+    size_t length = generated->length;
+    output_builder_destroy(generated);
+
+    /* Each word's text, found by lexing once, for the lookups timed alone */
+    Arena* arena = arena_create(0);
+    Token* words = (Token*)safe_malloc(sizeof(Token) * (size_t)opts->keyword_words);
+    int word_count = 0;
+    int keyword_count = 0;
+    Lexer* lexer = lexer_create(source, length, "<words>", arena);
+    for (Token token = lexer_next_token(lexer); token.type != TOKEN_EOF; token = lexer_next_token(lexer)) {
+        if (word_count < opts->keyword_words) {
+            words[word_count++] = token;
+            keyword_count += token.type != TOKEN_IDENTIFIER;
+        }
+    }
+    lexer_destroy(lexer);
+
+    int ok = 1;
+    for (int i = 0; i < word_count && ok; i++) {
+        ok = linear_keyword(words[i].start, words[i].length) == (words[i].type != TOKEN_IDENTIFIER);
+    }
+
+    uint64_t* times[KEYWORD_PHASE_COUNT];
+    for (int phase = 0; phase < KEYWORD_PHASE_COUNT; phase++) {
+        times[phase] = (uint64_t*)safe_malloc(sizeof(uint64_t) * (size_t)opts->iterations);
+    }
+
+    /* Keywords found on each run, checked against the first lexing so no lookup can be skipped */
+    for (int i = 0; i < opts->iterations && ok; i++) {
+        int found = 0;
+        arena_reset(arena);
+        uint64_t start = stats_now();
+        lexer = lexer_create(source, length, "<words>", arena);
+        for (Token token = lexer_next_token(lexer); token.type != TOKEN_EOF; token = lexer_next_token(lexer)) {
+            found += token.type != TOKEN_IDENTIFIER;
+        }
+        lexer_destroy(lexer);
+        times[KEYWORD_LEXER][i] = stats_now() - start;
+        ok = found == keyword_count;
+
+        found = 0;
+        start = stats_now();
+        for (int j = 0; j < word_count; j++) {
+            found += lexer_keyword_type(words[j].start, words[j].length) != TOKEN_IDENTIFIER;
+        }
+        times[KEYWORD_INDEX][i] = stats_now() - start;
+        ok = ok && found == keyword_count;
+
+        found = 0;
+        start = stats_now();
+        for (int j = 0; j < word_count; j++) {
+            found += linear_keyword(words[j].start, words[j].length);
+        }
+        times[KEYWORD_LINEAR][i] = stats_now() - start;
+        ok = ok && found == keyword_count;
+    }
+
+    if (ok) {
+        printf("{\n");
+        printf("  \"benchmark\": \"c2en-keywords\",\n");
+        printf("  \"version\": \"%s\",\n", C2EN_VERSION_STRING);
+        printf("  \"iterations\": %d,\n", opts->iterations);
+        printf("  \"params\": {\"words\": %d, \"keyword_percent\": %d, \"seed\": %u},\n",
+               word_count, opts->keyword_percent, opts->corpus.seed);
+        printf("  \"input_bytes\": %zu,\n", length);
+        printf("  \"keywords\": %d,\n", keyword_count);
+        printf("  \"phases\": {\n");
+        for (int phase = 0; phase < KEYWORD_PHASE_COUNT; phase++) {
+            qsort(times[phase], (size_t)opts->iterations, sizeof(uint64_t), compare_times);
+            uint64_t best = times[phase][0];
+            uint64_t median = times[phase][opts->iterations / 2];
+            printf("    \"%s\": {\"best_ms\": %.3f, \"median_ms\": %.3f, \"words_per_s\": %.0f}%s\n",
+                   keyword_phase_names[phase], (double)best / 1e6, (double)median / 1e6,
+                   per_second((double)word_count, best), phase + 1 < KEYWORD_PHASE_COUNT ? "," : "");
+        }
+        printf("  }\n");
+        printf("}\n");
+    } else {
+        log_message(LOG_ERROR, "Keyword lookups disagree on the generated words");
+    }
+
+    for (int phase = 0; phase < KEYWORD_PHASE_COUNT; phase++) {
+        free(times[phase]);
+    }
+    free(words);
+    arena_destroy(arena);
+    free(source);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions opts = parse_arguments(argc, argv);
+    if (opts.show_help) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (opts.emit) {
+        CorpusParams corpus = opts.corpus;
+        corpus.functions = opts.sizes[0];
+        OutputBuilder* generated = output_builder_create();
+        corpus_generate(&corpus, generated);
+        int written = output_builder_write(generated, stdout);
+        output_builder_destroy(generated);
+        return written ? 0 : 1;
+    }
+
+    if (opts.keyword_words > 0) {
+        return bench_keywords(&opts) ? 0 : 1;
+    }
+
+    printf("{\n");
+    printf("  \"benchmark\": \"c2en\",\n");
+    printf("  \"version\": \"%s\",\n", C2EN_VERSION_STRING);
+    printf("  \"iterations\": %d,\n", opts.iterations);
+    printf("  \"runs\": [\n");
+
+    int failures = 0;
+    for (int i = 0; i < opts.size_count; i++) {
+        CorpusParams corpus = opts.corpus;
+        corpus.functions = opts.sizes[i];
+        if (!bench_corpus(&corpus, opts.iterations, i == failures)) {
+            failures++;
+        }
+    }
+
+    printf("\n  ]\n");
+    printf("}\n");
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,318 @@
+#include "corpus.h"
+
+/* Deepest statement nesting inside a function body */
+#define CORPUS_MAX_NESTING 2
+
+/* Locals declared by each function, at most */
+#define CORPUS_MAX_LOCALS 6
+
+static const char* const name_words[] = {
+    "count", "total", "index", "value", "offset", "limit", "width", "height",
+    "sum", "flags", "mask", "step", "level", "score", "delta", "carry",
+};
+#define NAME_WORD_COUNT ((int)(sizeof(name_words) / sizeof(name_words[0])))
+
+const char* const corpus_keywords[] = {
+    "int", "char", "float", "double", "void", "if", "else", "while", "for", "do",
+    "return", "break", "continue", "struct", "union", "typedef", "sizeof",
+    "const", "static", "extern", "switch", "case", "default", "enum", "goto",
+    "signed", "unsigned", "long", "short", NULL,
+};
+#define KEYWORD_COUNT ((int)(sizeof(corpus_keywords) / sizeof(corpus_keywords[0])) - 1)
+
+static const char* const binary_operators[] = {
+    "+", "-", "*", "/", "%", "<", ">", "<=", ">=", "==", "!=",
+    "&&", "||", "&", "|", "^", "<<", ">>",
+};
+#define BINARY_OPERATOR_COUNT ((int)(sizeof(binary_operators) / sizeof(binary_operators[0])))
+
+static const char* const compound_operators[] = { "+=", "-=", "*=", "|=", "&=", "^=" };
+#define COMPOUND_OPERATOR_COUNT ((int)(sizeof(compound_operators) / sizeof(compound_operators[0])))
+
+typedef struct {
+    const CorpusParams* params;
+    OutputBuilder* out;
+    unsigned int state;
+    char** names;               /* The identifier pool */
+    int* order;                 /* Scratch for drawing distinct names */
+    const char* locals[CORPUS_MAX_LOCALS];
+    int local_count;
+    int function_index;         /* Functions below this one may be called */
+} Generator;
+
+void corpus_params_default(CorpusParams* params) {
+    params->functions = 200;
+    params->block_length = 12;
+    params->depth = 4;
+    params->switch_size = 8;
+    params->identifiers = 64;
+    params->seed = 1;
+}
+
+/* xorshift32; a fixed seed gives the same corpus on every platform */
+static unsigned int next_random(Generator* gen) {
+    unsigned int x = gen->state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    gen->state = x;
+    return x;
+}
+
+static int random_below(Generator* gen, int limit) {
+    return limit > 0 ? (int)(next_random(gen) % (unsigned int)limit) : 0;
+}
+
+static void indent(Generator* gen, int level) {
+    for (int i = 0; i < level; i++) {
+        output_append(gen->out, "    ");
+    }
+}
+
+static const char* random_local(Generator* gen) {
+    return gen->locals[random_below(gen, gen->local_count)];
+}
+
+/* Expressions */
+
+static void generate_expression(Generator* gen, int depth);
+
+static void generate_operand(Generator* gen) {
+    if (random_below(gen, 10) < 7) {
+        output_append(gen->out, random_local(gen));
+    } else {
+        output_appendf(gen->out, "%d", random_below(gen, 100));
+    }
+}
+
+/* A call to a function defined earlier in the corpus */
+static void generate_call(Generator* gen, int depth) {
+    output_appendf(gen->out, "compute_%d(", random_below(gen, gen->function_index));
+    generate_expression(gen, depth - 1);
+    output_append(gen->out, ", ");
+    generate_expression(gen, depth - 1);
+    output_append(gen->out, ")");
+}
+
+/* The left operand carries the full depth; the right is shallower */
+static void generate_expression(Generator* gen, int depth) {
+    if (depth <= 0) {
+        generate_operand(gen);
+        return;
+    }
+
+    int choice = random_below(gen, 16);
+    if (choice == 0) {
+        output_append(gen->out, random_below(gen, 2) ? "-" : "!");
+        generate_operand(gen);
+    } else if (choice == 1) {
+        output_append(gen->out, "(");
+        generate_expression(gen, depth - 1);
+        output_append(gen->out, ") ? ");
+        generate_operand(gen);
+        output_append(gen->out, " : ");
+        generate_operand(gen);
+    } else if (choice == 2 && gen->function_index > 0) {
+        generate_call(gen, depth);
+    } else {
+        int right_depth = random_below(gen, depth);
+        generate_expression(gen, depth - 1);
+        output_appendf(gen->out, " %s ", binary_operators[random_below(gen, BINARY_OPERATOR_COUNT)]);
+        if (right_depth > 0) {
+            output_append(gen->out, "(");
+            generate_expression(gen, right_depth);
+            output_append(gen->out, ")");
+        } else {
+            generate_operand(gen);
+        }
+    }
+}
+
+/* Statements */
+
+static void generate_statement(Generator* gen, int level);
+
+static void generate_block(Generator* gen, int level, int length) {
+    for (int i = 0; i < length; i++) {
+        generate_statement(gen, level);
+    }
+}
+
+static int nested_length(const Generator* gen) {
+    int length = gen->params->block_length / 4;
+    return length > 0 ? length : 1;
+}
+
+static void generate_switch(Generator* gen, int level) {
+    output_appendf(gen->out, "switch (%s) {\n", random_local(gen));
+    for (int i = 0; i < gen->params->switch_size; i++) {
+        indent(gen, level + 1);
+        output_appendf(gen->out, "case %d:\n", i);
+        indent(gen, level + 2);
+        output_appendf(gen->out, "%s = ", random_local(gen));
+        generate_expression(gen, gen->params->depth);
+        output_append(gen->out, ";\n");
+        indent(gen, level + 2);
+        output_append(gen->out, "break;\n");
+    }
+    indent(gen, level + 1);
+    output_append(gen->out, "default:\n");
+    indent(gen, level + 2);
+    output_appendf(gen->out, "%s = 0;\n", random_local(gen));
+    indent(gen, level + 2);
+    output_append(gen->out, "break;\n");
+    indent(gen, level);
+    output_append(gen->out, "}\n");
+}
+
+static void generate_statement(Generator* gen, int level) {
+    int choice = random_below(gen, 10);
+    int nested = level <= CORPUS_MAX_NESTING;
+
+    indent(gen, level);
+    if (choice == 5 && nested) {
+        output_append(gen->out, "if (");
+        generate_expression(gen, gen->params->depth);
+        output_append(gen->out, ") {\n");
+        generate_block(gen, level + 1, nested_length(gen));
+        indent(gen, level);
+        output_append(gen->out, "} else {\n");
+        generate_block(gen, level + 1, nested_length(gen));
+        indent(gen, level);
+        output_append(gen->out, "}\n");
+    } else if (choice == 6 && nested) {
+        const char* counter = random_local(gen);
+        output_appendf(gen->out, "while (%s < %d) {\n", counter, 10 + random_below(gen, 90));
+        generate_block(gen, level + 1, nested_length(gen));
+        indent(gen, level + 1);
+        output_appendf(gen->out, "%s++;\n", counter);
+        indent(gen, level);
+        output_append(gen->out, "}\n");
+    } else if (choice == 7 && nested) {
+        const char* counter = random_local(gen);
+        output_appendf(gen->out, "for (%s = 0; %s < %d; %s++) {\n",
+                       counter, counter, 1 + random_below(gen, 64), counter);
+        generate_block(gen, level + 1, nested_length(gen));
+        indent(gen, level);
+        output_append(gen->out, "}\n");
+    } else if (choice == 8 && nested && gen->params->switch_size > 0) {
+        generate_switch(gen, level);
+    } else if (choice == 9) {
+        output_appendf(gen->out, "printf(\"%%d\\n\", %s);\n", random_local(gen));
+    } else if (choice == 4) {
+        output_appendf(gen->out, "%s %s ", random_local(gen),
+                       compound_operators[random_below(gen, COMPOUND_OPERATOR_COUNT)]);
+        generate_expression(gen, gen->params->depth);
+        output_append(gen->out, ";\n");
+    } else {
+        output_appendf(gen->out, "%s = ", random_local(gen));
+        generate_expression(gen, gen->params->depth);
+        output_append(gen->out, ";\n");
+    }
+}
+
+/* Functions */
+
+/* Draw this function's locals without repeats (partial Fisher-Yates) */
+static void choose_locals(Generator* gen) {
+    int pool = gen->params->identifiers;
+    gen->local_count = pool < CORPUS_MAX_LOCALS ? pool : CORPUS_MAX_LOCALS;
+    for (int i = 0; i < gen->local_count; i++) {
+        int pick = i + random_below(gen, pool - i);
+        int swap = gen->order[i];
+        gen->order[i] = gen->order[pick];
+        gen->order[pick] = swap;
+        gen->locals[i] = gen->names[gen->order[i]];
+    }
+}
+
+static void generate_locals(Generator* gen) {
+    for (int i = 0; i < gen->local_count; i++) {
+        output_appendf(gen->out, "    int %s = %d;\n", gen->locals[i], random_below(gen, 10));
+    }
+    output_append(gen->out, "\n");
+}
+
+static void generate_function(Generator* gen) {
+    choose_locals(gen);
+
+    output_appendf(gen->out, "int compute_%d(int first, int second) {\n", gen->function_index);
+    generate_locals(gen);
+    indent(gen, 1);
+    output_appendf(gen->out, "%s = first + second;\n", gen->locals[0]);
+    generate_block(gen, 1, gen->params->block_length);
+    indent(gen, 1);
+    output_append(gen->out, "return ");
+    generate_expression(gen, gen->params->depth);
+    output_append(gen->out, ";\n}\n\n");
+}
+
+static void generate_main(Generator* gen) {
+    choose_locals(gen);
+
+    output_append(gen->out, "int main() {\n");
+    generate_locals(gen);
+    generate_block(gen, 1, gen->params->block_length);
+    indent(gen, 1);
+    output_appendf(gen->out, "printf(\"%%d\\n\", %s);\n", gen->locals[0]);
+    indent(gen, 1);
+    output_append(gen->out, "return 0;\n}\n");
+}
+
+void corpus_generate(const CorpusParams* params, OutputBuilder* out) {
+    Generator gen;
+    gen.params = params;
+    gen.out = out;
+    gen.state = params->seed ? params->seed : 1;
+    gen.local_count = 0;
+
+    int pool = params->identifiers > 0 ? params->identifiers : 1;
+    gen.names = (char**)safe_malloc(sizeof(char*) * (size_t)pool);
+    gen.order = (int*)safe_malloc(sizeof(int) * (size_t)pool);
+    for (int i = 0; i < pool; i++) {
+        char name[64];
+        if (i < NAME_WORD_COUNT) {
+            snprintf(name, sizeof(name), "%s", name_words[i]);
+        } else {
+            snprintf(name, sizeof(name), "%s_%d", name_words[i % NAME_WORD_COUNT], i / NAME_WORD_COUNT);
+        }
+        gen.names[i] = string_duplicate(name);
+        gen.order[i] = i;
+    }
+
+    CorpusParams clamped = *params;
+    clamped.identifiers = pool;
+    gen.params = &clamped;
+
+    output_appendf(out, "/* Generated benchmark corpus: %d functions, seed %u */\n\n",
+                   params->functions, params->seed);
+    for (gen.function_index = 0; gen.function_index < params->functions - 1; gen.function_index++) {
+        generate_function(&gen);
+    }
+    generate_main(&gen);
+
+    for (int i = 0; i < pool; i++) {
+        free(gen.names[i]);
+    }
+    free(gen.names);
+    free(gen.order);
+}
+
+void corpus_generate_words(int count, int keyword_percent, unsigned int seed, OutputBuilder* out) {
+    Generator gen;
+    gen.params = NULL;
+    gen.out = out;
+    gen.state = seed ? seed : 1;
+
+    for (int i = 0; i < count; i++) {
+        if (random_below(&gen, 100) < keyword_percent) {
+            output_append(out, corpus_keywords[random_below(&gen, KEYWORD_COUNT)]);
+        } else if (random_below(&gen, 4) == 0) {
+            output_appendf(out, "%s_%s", corpus_keywords[random_below(&gen, KEYWORD_COUNT)],
+                           name_words[random_below(&gen, NAME_WORD_COUNT)]);
+        } else {
+            output_appendf(out, "%s%d", name_words[random_below(&gen, NAME_WORD_COUNT)], random_below(&gen, 10));
+        }
+        output_append_char(out, i % 8 == 7 ? '\n' : ' ');
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include "utils.h"
+#include "output.h"
+
+/*
+ * Synthetic C corpus for benchmarking. The generated program is valid for
+ * every pipeline stage, semantic analysis included: each function declares
+ * its locals before use and only calls functions defined above it.
+ */
+typedef struct {
+    int functions;      /* Functions in the program, main included */
+    int block_length;   /* Statements in each function body */
+    int depth;          /* Operator nesting of generated expressions */
+    int switch_size;    /* Cases in each switch statement */
+    int identifiers;    /* Distinct local variable names in the corpus */
+    unsigned int seed;
+} CorpusParams;
+
+/* Defaults give a corpus of roughly 1.4 MB */
+void corpus_params_default(CorpusParams* params);
+
+/* Append the program described by params to out */
+void corpus_generate(const CorpusParams* params, OutputBuilder* out);
+
+/* The C keywords the words below are drawn from, NULL-terminated */
+extern const char* const corpus_keywords[];
+
+/*
+ * Append count words, eight to a line, for timing keyword lookup:
+ * keyword_percent of them keywords and the rest identifiers, some of which
+ * start with a keyword (int_count) so lookups cannot stop at the first
+ * letter.
+ */
+void corpus_generate_words(int count, int keyword_percent, unsigned int seed, OutputBuilder* out);
+
+#endif /* CORPUS_H */
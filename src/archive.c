@@ -0,0 +1,335 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <sys/stat.h>
+
+#include "archive.h"
+#include "compress.h"
+
+/* Bump when the layout changes */
+#define ARCHIVE_VERSION 1
+
+#define ARCHIVE_MAGIC "C2ENARCH"
+#define ARCHIVE_INDEX_MAGIC "C2ENINDX"
+#define ARCHIVE_HEADER_SIZE 16
+#define ARCHIVE_RECORD_SIZE 64
+#define ARCHIVE_TRAILER_SIZE 32
+
+/* Record flags */
+#define ARCHIVE_COMPRESSED 1
+
+static uint64_t text_hash(const char* text, size_t length) {
+    return fnv1a_64(FNV1A_64_BASIS, text, length);
+}
+
+/* Reading */
+
+/* Check the header and trailer, and that the index and names fill the space between */
+static int locate_index(OutputArchive* archive) {
+    const unsigned char* data = (const unsigned char*)archive->file->data;
+    uint64_t length = (uint64_t)archive->file->length;
+    if (length < ARCHIVE_HEADER_SIZE + ARCHIVE_TRAILER_SIZE) return 0;
+    if (memcmp(data, ARCHIVE_MAGIC, 8) != 0 || get_le32(data + 8) != ARCHIVE_VERSION) return 0;
+
+    const unsigned char* trailer = data + length - ARCHIVE_TRAILER_SIZE;
+    if (memcmp(trailer + 24, ARCHIVE_INDEX_MAGIC, 8) != 0) return 0;
+    uint64_t index_offset = get_le64(trailer);
+    uint64_t count = get_le64(trailer + 8);
+    uint64_t names_length = get_le64(trailer + 16);
+
+    uint64_t space = length - ARCHIVE_TRAILER_SIZE;
+    if (index_offset < ARCHIVE_HEADER_SIZE || index_offset > space) return 0;
+    if (count > (space - index_offset) / ARCHIVE_RECORD_SIZE) return 0;
+    if (index_offset + count * ARCHIVE_RECORD_SIZE + names_length != space) return 0;
+
+    archive->index = data + index_offset;
+    archive->names = (const char*)(archive->index + count * ARCHIVE_RECORD_SIZE);
+    archive->entry_count = count;
+    archive->data_end = index_offset;
+    archive->names_length = names_length;
+    return 1;
+}
+
+OutputArchive* output_archive_open(const char* path) {
+    SourceFile* file = source_file_open_binary(path);
+    if (!file) return NULL;
+
+    OutputArchive* archive = (OutputArchive*)safe_malloc(sizeof(OutputArchive));
+    archive->file = file;
+    if (!locate_index(archive)) {
+        log_message(LOG_ERROR, "Not an output archive: %s", path);
+        output_archive_close(archive);
+        return NULL;
+    }
+    return archive;
+}
+
+void output_archive_close(OutputArchive* archive) {
+    if (!archive) return;
+
+    source_file_close(archive->file);
+    free(archive);
+}
+
+uint64_t output_archive_count(const OutputArchive* archive) {
+    return archive->entry_count;
+}
+
+int output_archive_entry(const OutputArchive* archive, uint64_t index, ArchiveEntry* entry) {
+    if (index >= archive->entry_count) return 0;
+
+    const unsigned char* record = archive->index + index * ARCHIVE_RECORD_SIZE;
+    uint64_t name_offset = get_le64(record);
+    uint32_t name_length = get_le32(record + 8);
+    entry->compressed = (get_le32(record + 12) & ARCHIVE_COMPRESSED) != 0;
+    entry->data_offset = get_le64(record + 16);
+    entry->stored_length = get_le64(record + 24);
+    entry->text_length = get_le64(record + 32);
+    entry->text_hash = get_le64(record + 40);
+    entry->key.hash = get_le64(record + 48);
+    entry->key.input_length = get_le64(record + 56);
+
+    if (name_offset > archive->names_length || name_length > archive->names_length - name_offset) return 0;
+    if (entry->data_offset < ARCHIVE_HEADER_SIZE || entry->data_offset > archive->data_end ||
+        entry->stored_length > archive->data_end - entry->data_offset) {
+        return 0;
+    }
+    if (!entry->compressed && entry->stored_length != entry->text_length) return 0;
+
+    entry->name = archive->names + name_offset;
+    entry->name_length = name_length;
+    return 1;
+}
+
+/* Byte order of names, shorter first where one is a prefix of the other */
+static int compare_name(const char* a, size_t a_length, const char* b, size_t b_length) {
+    int order = memcmp(a, b, a_length < b_length ? a_length : b_length);
+    if (order != 0) return order;
+    return a_length < b_length ? -1 : a_length > b_length;
+}
+
+int output_archive_find(const OutputArchive* archive, const char* name, ArchiveEntry* entry) {
+    size_t length = strlen(name);
+    uint64_t low = 0;
+    uint64_t high = archive->entry_count;
+
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (!output_archive_entry(archive, middle, entry)) return 0;
+
+        int order = compare_name(name, length, entry->name, entry->name_length);
+        if (order == 0) return 1;
+        if (order < 0) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return 0;
+}
+
+int output_archive_read(const OutputArchive* archive, const ArchiveEntry* entry, OutputBuilder* out) {
+    const char* stored = archive->file->data + entry->data_offset;
+    size_t stored_length = (size_t)entry->stored_length;
+    size_t length = (size_t)entry->text_length;
+
+    if (!entry->compressed) {
+        if (text_hash(stored, length) != entry->text_hash) return 0;
+        output_append_length(out, stored, length);
+        return 1;
+    }
+
+    /* No sequence expands to more than 255 times its size, so anything claiming more is damaged */
+    if (entry->text_length / 256 > entry->stored_length) return 0;
+
+    char* text = (char*)safe_malloc(length + 1);
+    int ok = decompress_block(stored, stored_length, text, length) && text_hash(text, length) == entry->text_hash;
+    if (ok) {
+        output_append_length(out, text, length);
+    }
+    free(text);
+    return ok;
+}
+
+/* Writing */
+
+ArchiveWriter* archive_writer_create(const char* path) {
+    /* Never replace a file that is not an archive */
+    OutputArchive* previous = NULL;
+    struct stat info;
+    if (stat(path, &info) == 0) {
+        previous = output_archive_open(path);
+        if (!previous) return NULL;
+    }
+
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".tmp.%ld", current_process_id());
+    char* temp_path = string_concat(path, suffix);
+
+    FILE* file = fopen(temp_path, "wb");
+    if (!file) {
+        log_message(LOG_ERROR, "Cannot create archive: %s", temp_path);
+        free(temp_path);
+        output_archive_close(previous);
+        return NULL;
+    }
+
+    unsigned char header[ARCHIVE_HEADER_SIZE];
+    memcpy(header, ARCHIVE_MAGIC, 8);
+    put_le32(header + 8, ARCHIVE_VERSION);
+    put_le32(header + 12, 0);
+
+    ArchiveWriter* writer = (ArchiveWriter*)safe_malloc(sizeof(ArchiveWriter));
+    writer->path = string_duplicate(path);
+    writer->temp_path = temp_path;
+    writer->file = file;
+    writer->offset = ARCHIVE_HEADER_SIZE;
+    writer->records = NULL;
+    writer->record_count = 0;
+    writer->record_capacity = 0;
+    writer->previous = previous;
+    writer->failed = fwrite(header, 1, sizeof(header), file) != sizeof(header);
+    mutex_init(&writer->lock);
+    return writer;
+}
+
+/* Append stored bytes to the data section and record them; call with the lock held */
+static int append_entry(ArchiveWriter* writer, const char* name, const char* stored, size_t stored_length,
+                        int compressed, uint64_t length, uint64_t hash, CacheKey key) {
+    if (writer->failed) return 0;
+    if (fwrite(stored, 1, stored_length, writer->file) != stored_length) {
+        writer->failed = 1;
+        return 0;
+    }
+
+    if (writer->record_count >= writer->record_capacity) {
+        writer->record_capacity = writer->record_capacity ? writer->record_capacity * 2 : 256;
+        writer->records = (ArchiveRecord*)safe_realloc(writer->records,
+                                                       sizeof(ArchiveRecord) * writer->record_capacity);
+    }
+    ArchiveRecord* record = &writer->records[writer->record_count];
+    record->name = string_duplicate(name);
+    record->compressed = compressed;
+    record->data_offset = writer->offset;
+    record->stored_length = stored_length;
+    record->text_length = length;
+    record->text_hash = hash;
+    record->key = key;
+    record->sequence = writer->record_count++;
+    writer->offset += stored_length;
+    return 1;
+}
+
+int archive_writer_add(ArchiveWriter* writer, const char* name, CacheKey key, const OutputBuilder* text) {
+    /* Compressing is the costly part, and happens before the lock */
+    char* raw = output_builder_to_string(text);
+    size_t length = text->length;
+    char* packed = (char*)safe_malloc(compress_bound(length));
+    size_t packed_length = compress_block(raw, length, packed);
+    int compressed = packed_length < length;
+    uint64_t hash = text_hash(raw, length);
+
+    mutex_lock(&writer->lock);
+    int ok = compressed ? append_entry(writer, name, packed, packed_length, 1, length, hash, key)
+                        : append_entry(writer, name, raw, length, 0, length, hash, key);
+    mutex_unlock(&writer->lock);
+
+    free(packed);
+    free(raw);
+    return ok;
+}
+
+int archive_writer_carry(ArchiveWriter* writer, const char* name, CacheKey key) {
+    const OutputArchive* previous = writer->previous;
+    ArchiveEntry entry;
+    if (!previous || !output_archive_find(previous, name, &entry)) return 0;
+    if (entry.key.hash != key.hash || entry.key.input_length != key.input_length) return 0;
+
+    mutex_lock(&writer->lock);
+    int ok = append_entry(writer, name, previous->file->data + entry.data_offset, (size_t)entry.stored_length,
+                          entry.compressed, entry.text_length, entry.text_hash, entry.key);
+    mutex_unlock(&writer->lock);
+    return ok;
+}
+
+static int compare_records(const void* a, const void* b) {
+    const ArchiveRecord* left = (const ArchiveRecord*)a;
+    const ArchiveRecord* right = (const ArchiveRecord*)b;
+    int order = strcmp(left->name, right->name);
+    if (order != 0) return order;
+    return left->sequence < right->sequence ? -1 : left->sequence > right->sequence;
+}
+
+/* Write the sorted index, the names and the trailer; returns 0 on failure */
+static int write_index(ArchiveWriter* writer) {
+    ArchiveRecord* records = writer->records;
+    int count = 0;
+
+    /* strcmp orders by unsigned bytes, as compare_name does; of equal names the last added stays */
+    qsort(records, (size_t)writer->record_count, sizeof(ArchiveRecord), compare_records);
+    for (int i = 0; i < writer->record_count; i++) {
+        if (i + 1 < writer->record_count && strcmp(records[i].name, records[i + 1].name) == 0) {
+            free(records[i].name);
+            continue;
+        }
+        records[count++] = records[i];
+    }
+    writer->record_count = count;
+
+    uint64_t name_offset = 0;
+    for (int i = 0; i < count; i++) {
+        const ArchiveRecord* record = &records[i];
+        size_t name_length = strlen(record->name);
+        unsigned char bytes[ARCHIVE_RECORD_SIZE];
+        put_le64(bytes, name_offset);
+        put_le32(bytes + 8, (uint32_t)name_length);
+        put_le32(bytes + 12, record->compressed ? ARCHIVE_COMPRESSED : 0);
+        put_le64(bytes + 16, record->data_offset);
+        put_le64(bytes + 24, record->stored_length);
+        put_le64(bytes + 32, record->text_length);
+        put_le64(bytes + 40, record->text_hash);
+        put_le64(bytes + 48, record->key.hash);
+        put_le64(bytes + 56, record->key.input_length);
+        if (fwrite(bytes, 1, sizeof(bytes), writer->file) != sizeof(bytes)) return 0;
+        name_offset += name_length;
+    }
+    for (int i = 0; i < count; i++) {
+        size_t name_length = strlen(records[i].name);
+        if (fwrite(records[i].name, 1, name_length, writer->file) != name_length) return 0;
+    }
+
+    unsigned char trailer[ARCHIVE_TRAILER_SIZE];
+    put_le64(trailer, writer->offset);
+    put_le64(trailer + 8, (uint64_t)count);
+    put_le64(trailer + 16, name_offset);
+    memcpy(trailer + 24, ARCHIVE_INDEX_MAGIC, 8);
+    return fwrite(trailer, 1, sizeof(trailer), writer->file) == sizeof(trailer);
+}
+
+int archive_writer_finish(ArchiveWriter* writer) {
+    int ok = !writer->failed && write_index(writer);
+    ok = fclose(writer->file) == 0 && ok;
+
+    /* The old archive's mapping goes before the new one takes its name */
+    output_archive_close(writer->previous);
+    if (ok) {
+#ifdef _WIN32
+        remove(writer->path);
+#endif
+        ok = rename(writer->temp_path, writer->path) == 0;
+    }
+    if (!ok) {
+        log_message(LOG_ERROR, "Failed to write archive: %s", writer->path);
+        remove(writer->temp_path);
+    }
+
+    for (int i = 0; i < writer->record_count; i++) {
+        free(writer->records[i].name);
+    }
+    free(writer->records);
+    mutex_destroy(&writer->lock);
+    free(writer->temp_path);
+    free(writer->path);
+    free(writer);
+    return ok;
+}
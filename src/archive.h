@@ -0,0 +1,117 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdint.h>
+
+#include "utils.h"
+#include "output.h"
+#include "cache.h"
+#include "source.h"
+#include "thread.h"
+
+/*
+ * Output archive: every output of a batch run in one file, so a run over a
+ * large tree writes one file instead of tens of thousands and a reader maps
+ * one file instead of opening each. After a 16-byte header comes the data
+ * section, each entry's translation compressed (compress.h) and appended
+ * as it is finished; then the index, one fixed-size record per entry sorted
+ * by name; then the names; then a 32-byte trailer locating the index. All
+ * numbers are little-endian. A record gives the entry's data offset and
+ * stored size, the size and FNV-1a hash of its text, and the cache key of
+ * the source and options it was translated from, so a later run can carry
+ * an entry over without translating its source again.
+ */
+
+/* An entry, as found in an archive's index */
+typedef struct {
+    const char* name;           /* Not NUL-terminated: use name_length */
+    size_t name_length;
+    int compressed;             /* Stored compressed, rather than as the text itself */
+    uint64_t data_offset;
+    uint64_t stored_length;
+    uint64_t text_length;
+    uint64_t text_hash;
+    CacheKey key;
+} ArchiveEntry;
+
+/* An archive opened for reading; its file is memory-mapped where the platform allows */
+typedef struct {
+    SourceFile* file;
+    const unsigned char* index;
+    const char* names;
+    uint64_t entry_count;
+    uint64_t data_end;          /* Where the data section ends and the index starts */
+    uint64_t names_length;
+} OutputArchive;
+
+/* Open an archive; NULL, with an error logged, if it cannot be read or is not an archive */
+OutputArchive* output_archive_open(const char* path);
+void output_archive_close(OutputArchive* archive);
+
+/* Entries in name order: the number of them, and the index'th; 0 if the record is damaged */
+uint64_t output_archive_count(const OutputArchive* archive);
+int output_archive_entry(const OutputArchive* archive, uint64_t index, ArchiveEntry* entry);
+
+/* The entry called name, by binary search of the mapped index; returns 0 if there is none */
+int output_archive_find(const OutputArchive* archive, const char* name, ArchiveEntry* entry);
+
+/* Append an entry's text to out; returns 0 if its data is damaged */
+int output_archive_read(const OutputArchive* archive, const ArchiveEntry* entry, OutputBuilder* out);
+
+/* An entry written so far, waiting for the index */
+typedef struct {
+    char* name;
+    int compressed;
+    uint64_t data_offset;
+    uint64_t stored_length;
+    uint64_t text_length;
+    uint64_t text_hash;
+    CacheKey key;
+    int sequence;               /* Order of adding, so a name added twice keeps its last entry */
+} ArchiveRecord;
+
+/*
+ * Writer for a new archive at path, built under a temporary name and
+ * renamed over path when finished, so readers of the old archive are never
+ * disturbed. If path already holds an archive, its entries can be carried
+ * over. Entries may be added from several threads at once: each is
+ * compressed on the adding thread and only the append is serialised.
+ */
+typedef struct {
+    char* path;
+    char* temp_path;
+    FILE* file;
+    uint64_t offset;            /* Where the next entry's data goes */
+    ArchiveRecord* records;
+    int record_count;
+    int record_capacity;
+    OutputArchive* previous;    /* The archive at path when the writer was created, or NULL */
+    int failed;                 /* A write failed; finishing will fail */
+    Mutex lock;
+} ArchiveWriter;
+
+/*
+ * Start writing the archive at path; returns NULL, with an error logged, if
+ * the temporary file cannot be created or path holds something other than
+ * an archive.
+ */
+ArchiveWriter* archive_writer_create(const char* path);
+
+/* Add text as the entry called name, translated from the source and options key stands for; 0 on failure */
+int archive_writer_add(ArchiveWriter* writer, const char* name, CacheKey key, const OutputBuilder* text);
+
+/*
+ * Copy the previous archive's entry called name into the new one, as it is
+ * stored, if it was translated from the same source and options; returns 0
+ * if there is no such entry, and the text has to be added afresh.
+ */
+int archive_writer_carry(ArchiveWriter* writer, const char* name, CacheKey key);
+
+/*
+ * Write the index and trailer, put the archive in place and free the
+ * writer; returns 0, leaving any earlier archive at path as it was, if
+ * anything failed.
+ */
+int archive_writer_finish(ArchiveWriter* writer);
+
+#endif /* ARCHIVE_H */
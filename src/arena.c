@@ -0,0 +1,122 @@
+#include "arena.h"
+
+/* Every allocation is aligned for pointers and doubles */
+#define ARENA_ALIGNMENT 8
+#define ARENA_ALIGN(n) (((n) + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+/* Block header size, rounded so block data starts aligned */
+#define ARENA_HEADER_SIZE ARENA_ALIGN(sizeof(ArenaBlock))
+
+static char* block_data(ArenaBlock* block) {
+    return (char*)block + ARENA_HEADER_SIZE;
+}
+
+static ArenaBlock* arena_block_create(size_t capacity) {
+    ArenaBlock* block = (ArenaBlock*)safe_malloc(ARENA_HEADER_SIZE + capacity);
+    block->next = NULL;
+    block->used = 0;
+    block->capacity = capacity;
+    return block;
+}
+
+/* Arena creation and destruction */
+
+Arena* arena_create(size_t block_size) {
+    Arena* arena = (Arena*)safe_malloc(sizeof(Arena));
+    arena->block_size = block_size ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+    arena->head = arena_block_create(arena->block_size);
+    arena->current = arena->head;
+    arena->bytes_used = 0;
+    return arena;
+}
+
+void arena_destroy(Arena* arena) {
+    if (!arena) return;
+
+    ArenaBlock* current = arena->head;
+    while (current) {
+        ArenaBlock* next = current->next;
+        free(current);
+        current = next;
+    }
+
+    free(arena);
+}
+
+/* Rewind to the first block, keeping every block for reuse */
+void arena_reset(Arena* arena) {
+    if (!arena) return;
+
+    arena->current = arena->head;
+    arena->head->used = 0;
+    arena->bytes_used = 0;
+}
+
+/* Allocation */
+
+/* Move to a block with room for size bytes, reusing kept blocks when possible */
+static ArenaBlock* arena_next_block(Arena* arena, size_t size) {
+    ArenaBlock* current = arena->current;
+    ArenaBlock* next = current->next;
+
+    if (next && next->capacity >= size) {
+        next->used = 0;
+        arena->current = next;
+        return next;
+    }
+
+    size_t capacity = size > arena->block_size ? size : arena->block_size;
+    ArenaBlock* block = arena_block_create(capacity);
+    block->next = next;
+    current->next = block;
+    arena->current = block;
+    return block;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = ARENA_ALIGN(size ? size : 1);
+
+    ArenaBlock* block = arena->current;
+    if (block->capacity - block->used < size) {
+        block = arena_next_block(arena, size);
+    }
+
+    void* ptr = block_data(block) + block->used;
+    block->used += size;
+    arena->bytes_used += size;
+    return ptr;
+}
+
+void* arena_realloc(Arena* arena, void* ptr, size_t old_size, size_t new_size) {
+    if (!ptr) return arena_alloc(arena, new_size);
+    if (new_size <= old_size) return ptr;
+
+    /* Extend in place when ptr is the most recent allocation */
+    ArenaBlock* block = arena->current;
+    size_t old_aligned = ARENA_ALIGN(old_size ? old_size : 1);
+    size_t new_aligned = ARENA_ALIGN(new_size);
+    if ((char*)ptr + old_aligned == block_data(block) + block->used &&
+        block->used - old_aligned + new_aligned <= block->capacity) {
+        block->used += new_aligned - old_aligned;
+        arena->bytes_used += new_aligned - old_aligned;
+        return ptr;
+    }
+
+    void* new_ptr = arena_alloc(arena, new_size);
+    memcpy(new_ptr, ptr, old_size);
+    return new_ptr;
+}
+
+char* arena_strndup(Arena* arena, const char* str, size_t length) {
+    if (!str) return NULL;
+
+    char* dup = (char*)arena_alloc(arena, length + 1);
+    memcpy(dup, str, length);
+    dup[length] = '\0';
+    return dup;
+}
+
+char* arena_strdup(Arena* arena, const char* str) {
+    if (!str) return NULL;
+    return arena_strndup(arena, str, strlen(str));
+}
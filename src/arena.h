@@ -0,0 +1,36 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "utils.h"
+
+/* Default size of each arena block */
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+/* Arena block - allocations are bumped out of data */
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t used;
+    size_t capacity;
+    /* Block memory follows the header */
+} ArenaBlock;
+
+/* Bump allocator with chunked growth; everything is released at once */
+typedef struct {
+    ArenaBlock* head;
+    ArenaBlock* current;
+    size_t block_size;
+    size_t bytes_used;
+} Arena;
+
+/* Arena creation and destruction */
+Arena* arena_create(size_t block_size);
+void arena_destroy(Arena* arena);
+void arena_reset(Arena* arena);
+
+/* Allocation */
+void* arena_alloc(Arena* arena, size_t size);
+void* arena_realloc(Arena* arena, void* ptr, size_t old_size, size_t new_size);
+char* arena_strdup(Arena* arena, const char* str);
+char* arena_strndup(Arena* arena, const char* str, size_t length);
+
+#endif /* ARENA_H */
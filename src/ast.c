@@ -1,529 +1,919 @@
 #include "ast.h"
+#include "intern.h"
+
+/* Initial capacities; every table doubles when full */
+#define AST_INITIAL_NODES 256
+#define AST_INITIAL_LISTS 256
+#define AST_INITIAL_STRINGS 64
+#define AST_INITIAL_PARAMETERS 16
+
+/* Make room for needed items in a growable table */
+static void* grow_table(void* items, int* capacity, int needed, size_t item_size) {
+    if (needed <= *capacity) return items;
+
+    int grown = *capacity;
+    while (grown < needed) grown *= 2;
+    *capacity = grown;
+    return safe_realloc(items, item_size * (size_t)grown);
+}
+
+/* Tree creation and destruction */
+
+AST* ast_create(void) {
+    AST* ast = (AST*)safe_malloc(sizeof(AST));
+    ast->node_capacity = AST_INITIAL_NODES;
+    ast->nodes = (ASTNode*)safe_malloc(sizeof(ASTNode) * ast->node_capacity);
+    ast->list_capacity = AST_INITIAL_LISTS;
+    ast->lists = (uint32_t*)safe_malloc(sizeof(uint32_t) * ast->list_capacity);
+    ast->string_capacity = AST_INITIAL_STRINGS;
+    ast->strings = (const char**)safe_malloc(sizeof(const char*) * ast->string_capacity);
+    ast->slot_capacity = AST_INITIAL_STRINGS * 2;
+    ast->string_slots = (ASTString*)safe_malloc(sizeof(ASTString) * ast->slot_capacity);
+    ast->parameter_capacity = AST_INITIAL_PARAMETERS;
+    ast->parameters = (Parameter*)safe_malloc(sizeof(Parameter) * ast->parameter_capacity);
+    ast_clear(ast);
+    return ast;
+}
+
+void ast_destroy(AST* ast) {
+    if (!ast) return;
+
+    free(ast->nodes);
+    free(ast->lists);
+    free(ast->strings);
+    free(ast->string_slots);
+    free(ast->parameters);
+    free(ast);
+}
+
+/* Empty the tree, keeping entry 0 of each table reserved for AST_NONE */
+void ast_clear(AST* ast) {
+    memset(&ast->nodes[0], 0, sizeof(ASTNode));
+    ast->nodes[0].offset = -1;
+    ast->node_count = 1;
+    ast->lists[0] = 0;
+    ast->list_length = 1;
+    ast->strings[0] = NULL;
+    ast->string_count = 1;
+    memset(ast->string_slots, 0, sizeof(ASTString) * ast->slot_capacity);
+    ast->parameter_count = 0;
+}
+
+ASTMark ast_mark(const AST* ast) {
+    ASTMark mark;
+    mark.node_count = ast->node_count;
+    mark.list_length = ast->list_length;
+    mark.string_count = ast->string_count;
+    mark.parameter_count = ast->parameter_count;
+    return mark;
+}
+
+/*
+ * Drop everything added since mark. Strings leave the index newest first;
+ * an older string never probes past a newer one's slot, so emptying those
+ * slots leaves every remaining probe sequence intact.
+ */
+void ast_rewind(AST* ast, ASTMark mark) {
+    unsigned int mask = (unsigned int)ast->slot_capacity - 1;
+    for (int i = ast->string_count - 1; i >= mark.string_count; i--) {
+        unsigned int slot = intern_pointer_hash(ast->strings[i]) & mask;
+        while (ast->string_slots[slot] != (ASTString)i) {
+            slot = (slot + 1) & mask;
+        }
+        ast->string_slots[slot] = AST_NONE;
+    }
+
+    ast->node_count = mark.node_count;
+    ast->list_length = mark.list_length;
+    ast->string_count = mark.string_count;
+    ast->parameter_count = mark.parameter_count;
+}
+
+/* Side tables */
+
+static void rehash_strings(AST* ast, int capacity) {
+    free(ast->string_slots);
+    ast->slot_capacity = capacity;
+    ast->string_slots = (ASTString*)calloc((size_t)capacity, sizeof(ASTString));
+    if (!ast->string_slots) {
+        log_message(LOG_ERROR, "Memory allocation failed");
+        memory_failure();
+    }
+
+    unsigned int mask = (unsigned int)capacity - 1;
+    for (int i = 1; i < ast->string_count; i++) {
+        unsigned int slot = intern_pointer_hash(ast->strings[i]) & mask;
+        while (ast->string_slots[slot] != AST_NONE) {
+            slot = (slot + 1) & mask;
+        }
+        ast->string_slots[slot] = (ASTString)i;
+    }
+}
+
+ASTString ast_add_string(AST* ast, const char* text) {
+    if (!text) return AST_NONE;
+
+    unsigned int mask = (unsigned int)ast->slot_capacity - 1;
+    unsigned int slot = intern_pointer_hash(text) & mask;
+    while (ast->string_slots[slot] != AST_NONE) {
+        ASTString existing = ast->string_slots[slot];
+        if (ast->strings[existing] == text) return existing;
+        slot = (slot + 1) & mask;
+    }
+
+    ast->strings = (const char**)grow_table((void*)ast->strings, &ast->string_capacity,
+                                            ast->string_count + 1, sizeof(const char*));
+    ASTString id = (ASTString)ast->string_count++;
+    ast->strings[id] = text;
 
-/* Helper to create base node */
-static ASTNode* ast_create_node(NodeType type) {
-    ASTNode* node = (ASTNode*)safe_malloc(sizeof(ASTNode));
-    node->type = type;
-    node->line = 0;
-    node->column = 0;
-    return node;
+    /* Keep the index at most half full */
+    if (ast->string_count * 2 > ast->slot_capacity) {
+        rehash_strings(ast, ast->slot_capacity * 2);
+    } else {
+        ast->string_slots[slot] = id;
+    }
+    return id;
+}
+
+ASTList ast_add_list(AST* ast, const uint32_t* items, int count) {
+    if (count == 0) return AST_NONE;
+
+    ast->lists = (uint32_t*)grow_table(ast->lists, &ast->list_capacity,
+                                       ast->list_length + 1 + count, sizeof(uint32_t));
+    ASTList list = (ASTList)ast->list_length;
+    ast->lists[list] = (uint32_t)count;
+    memcpy(&ast->lists[list + 1], items, sizeof(uint32_t) * (size_t)count);
+    ast->list_length += 1 + count;
+    return list;
+}
+
+uint32_t ast_add_parameter(AST* ast, const char* type, const char* name, int is_array) {
+    ast->parameters = (Parameter*)grow_table(ast->parameters, &ast->parameter_capacity,
+                                             ast->parameter_count + 1, sizeof(Parameter));
+    Parameter* param = &ast->parameters[ast->parameter_count];
+    param->type = type;
+    param->name = name;
+    param->is_array = is_array;
+    return (uint32_t)ast->parameter_count++;
+}
+
+/* Helper to create base node; every field starts as AST_NONE */
+static ASTRef ast_create_node(AST* ast, NodeType type) {
+    ast->nodes = (ASTNode*)grow_table(ast->nodes, &ast->node_capacity,
+                                      ast->node_count + 1, sizeof(ASTNode));
+    ASTRef ref = (ASTRef)ast->node_count++;
+    ASTNode* node = &ast->nodes[ref];
+    memset(node, 0, sizeof(ASTNode));
+    node->type = (uint8_t)type;
+    node->offset = -1;
+    return ref;
 }
 
 /* Node creation functions */
 
-ASTNode* ast_create_program(void) {
-    ASTNode* node = ast_create_node(NODE_PROGRAM);
-    node->data.program.functions = NULL;
-    node->data.program.function_count = 0;
-    return node;
+ASTRef ast_create_program(AST* ast) {
+    return ast_create_node(ast, NODE_PROGRAM);
 }
 
-ASTNode* ast_create_function(const char* return_type, const char* name, Parameter** params, int param_count, ASTNode* body) {
-    ASTNode* node = ast_create_node(NODE_FUNCTION);
-    node->data.function.return_type = string_duplicate(return_type);
-    node->data.function.name = string_duplicate(name);
+ASTRef ast_create_function(AST* ast, const char* return_type, const char* name, ASTList params, ASTRef body) {
+    ASTRef ref = ast_create_node(ast, NODE_FUNCTION);
+    ASTNode* node = AST_NODE(ast, ref);
+    node->data.function.return_type = ast_add_string(ast, return_type);
+    node->data.function.name = ast_add_string(ast, name);
     node->data.function.parameters = params;
-    node->data.function.param_count = param_count;
     node->data.function.body = body;
-    return node;
+    return ref;
 }
 
-ASTNode* ast_create_declaration(const char* type, const char* name, ASTNode* initializer) {
-    ASTNode* node = ast_create_node(NODE_DECLARATION);
-    node->data.declaration.data_type = string_duplicate(type);
-    node->data.declaration.name = string_duplicate(name);
-    node->data.declaration.is_array = 0;
-    node->data.declaration.array_size = NULL;
+ASTRef ast_create_declaration(AST* ast, const char* type, const char* name, ASTRef initializer) {
+    ASTRef ref = ast_create_node(ast, NODE_DECLARATION);
+    ASTNode* node = AST_NODE(ast, ref);
+    node->data.declaration.data_type = ast_add_string(ast, type);
+    node->data.declaration.name = ast_add_string(ast, name);
     node->data.declaration.initializer = initializer;
-    return node;
+    return ref;
 }
 
-ASTNode* ast_create_array_declaration(const char* type, const char* name, ASTNode* size) {
-    ASTNode* node = ast_create_node(NODE_DECLARATION);
-    node->data.declaration.data_type = string_duplicate(type);
-    node->data.declaration.name = string_duplicate(name);
-    node->data.declaration.is_array = 1;
+ASTRef ast_create_array_declaration(AST* ast, const char* type, const char* name, ASTRef size) {
+    ASTRef ref = ast_create_node(ast, NODE_DECLARATION);
+    ASTNode* node = AST_NODE(ast, ref);
+    node->flag = 1;
+    node->data.declaration.data_type = ast_add_string(ast, type);
+    node->data.declaration.name = ast_add_string(ast, name);
     node->data.declaration.array_size = size;
-    node->data.declaration.initializer = NULL;
-    return node;
+    return ref;
 }
 
-ASTNode* ast_create_if(ASTNode* condition, ASTNode* then_branch, ASTNode* else_branch) {
-    ASTNode* node = ast_create_node(NODE_IF);
+ASTRef ast_create_if(AST* ast, ASTRef condition, ASTRef then_branch, ASTRef else_branch) {
+    ASTRef ref = ast_create_node(ast, NODE_IF);
+    ASTNode* node = AST_NODE(ast, ref);
     node->data.if_stmt.condition = condition;
     node->data.if_stmt.then_branch = then_branch;
     node->data.if_stmt.else_branch = else_branch;
-    return node;
+    return ref;
 }
 
-ASTNode* ast_create_while(ASTNode* condition, ASTNode* body) {
-    ASTNode* node = ast_create_node(NODE_WHILE);
+ASTRef ast_create_while(AST* ast, ASTRef condition, ASTRef body) {
+    ASTRef ref = ast_create_node(ast, NODE_WHILE);
+    ASTNode* node = AST_NODE(ast, ref);
     node->data.while_stmt.condition = condition;
     node->data.while_stmt.body = body;
-    return node;
+    return ref;
 }
 
-ASTNode* ast_create_for(ASTNode* init, ASTNode* condition, ASTNode* increment, ASTNode* body) {
-    ASTNode* node = ast_create_node(NODE_FOR);
+ASTRef ast_create_for(AST* ast, ASTRef init, ASTRef condition, ASTRef increment, ASTRef body) {
+    ASTRef ref = ast_create_node(ast, NODE_FOR);
+    ASTNode* node = AST_NODE(ast, ref);
     node->data.for_stmt.init = init;
     node->data.for_stmt.condition = condition;
     node->data.for_stmt.increment = increment;
     node->data.for_stmt.body = body;
-    return node;
+    return ref;
 }
 
-ASTNode* ast_create_return(ASTNode* value) {
-    ASTNode* node = ast_create_node(NODE_RETURN);
-    node->data.return_stmt.value = value;
-    return node;
+ASTRef ast_create_return(AST* ast, ASTRef value) {
+    ASTRef ref = ast_create_node(ast, NODE_RETURN);
+    AST_NODE(ast, ref)->data.return_stmt.value = value;
+    return ref;
 }
 
-ASTNode* ast_create_block(void) {
-    ASTNode* node = ast_create_node(NODE_BLOCK);
-    node->data.block.statements = NULL;
-    node->data.block.statement_count = 0;
-    return node;
+ASTRef ast_create_block(AST* ast) {
+    return ast_create_node(ast, NODE_BLOCK);
 }
 
-ASTNode* ast_create_binary_op(const char* operator, ASTNode* left, ASTNode* right) {
-    ASTNode* node = ast_create_node(NODE_BINARY_OP);
-    node->data.binary_op.operator = string_duplicate(operator);
+ASTRef ast_create_binary_op(AST* ast, OperatorKind operator, ASTRef left, ASTRef right) {
+    ASTRef ref = ast_create_node(ast, NODE_BINARY_OP);
+    ASTNode* node = AST_NODE(ast, ref);
+    node->op = (uint8_t)operator;
     node->data.binary_op.left = left;
     node->data.binary_op.right = right;
-    return node;
+    return ref;
 }
 
-ASTNode* ast_create_unary_op(const char* operator, ASTNode* operand) {
-    ASTNode* node = ast_create_node(NODE_UNARY_OP);
-    node->data.unary_op.operator = string_duplicate(operator);
+ASTRef ast_create_unary_op(AST* ast, OperatorKind operator, ASTRef operand) {
+    ASTRef ref = ast_create_node(ast, NODE_UNARY_OP);
+    ASTNode* node = AST_NODE(ast, ref);
+    node->op = (uint8_t)operator;
     node->data.unary_op.operand = operand;
-    return node;
+    return ref;
 }
 
-ASTNode* ast_create_function_call(const char* name, ASTNode** args, int arg_count) {
-    ASTNode* node = ast_create_node(NODE_FUNCTION_CALL);
-    node->data.function_call.name = string_duplicate(name);
+ASTRef ast_create_function_call(AST* ast, const char* name, ASTList args) {
+    ASTRef ref = ast_create_node(ast, NODE_FUNCTION_CALL);
+    ASTNode* node = AST_NODE(ast, ref);
+    node->data.function_call.name = ast_add_string(ast, name);
     node->data.function_call.arguments = args;
-    node->data.function_call.arg_count = arg_count;
-    return node;
+    return ref;
 }
 
-ASTNode* ast_create_array_access(const char* name, ASTNode* index) {
-    ASTNode* node = ast_create_node(NODE_ARRAY_ACCESS);
-    node->data.array_access.name = string_duplicate(name);
+ASTRef ast_create_array_access(AST* ast, const char* name, ASTRef index) {
+    ASTRef ref = ast_create_node(ast, NODE_ARRAY_ACCESS);
+    ASTNode* node = AST_NODE(ast, ref);
+    node->data.array_access.name = ast_add_string(ast, name);
     node->data.array_access.index = index;
-    return node;
+    return ref;
 }
 
-ASTNode* ast_create_assignment(ASTNode* target, ASTNode* value) {
-    ASTNode* node = ast_create_node(NODE_ASSIGNMENT);
+ASTRef ast_create_assignment(AST* ast, ASTRef target, ASTRef value) {
+    ASTRef ref = ast_create_node(ast, NODE_ASSIGNMENT);
+    ASTNode* node = AST_NODE(ast, ref);
     node->data.assignment.target = target;
     node->data.assignment.value = value;
-    return node;
+    return ref;
 }
 
-ASTNode* ast_create_literal(const char* value, const char* type) {
-    ASTNode* node = ast_create_node(NODE_LITERAL);
-    node->data.literal.value = string_duplicate(value);
-    node->data.literal.data_type = string_duplicate(type);
-    return node;
+ASTRef ast_create_literal(AST* ast, const char* value, const char* type) {
+    ASTRef ref = ast_create_node(ast, NODE_LITERAL);
+    ASTNode* node = AST_NODE(ast, ref);
+    node->data.literal.value = ast_add_string(ast, value);
+    node->data.literal.data_type = ast_add_string(ast, type);
+    return ref;
 }
 
-ASTNode* ast_create_identifier(const char* name) {
-    ASTNode* node = ast_create_node(NODE_IDENTIFIER);
-    node->data.identifier.name = string_duplicate(name);
-    return node;
+ASTRef ast_create_identifier(AST* ast, const char* name) {
+    ASTRef ref = ast_create_node(ast, NODE_IDENTIFIER);
+    AST_NODE(ast, ref)->data.identifier.name = ast_add_string(ast, name);
+    return ref;
 }
 
-ASTNode* ast_create_break(void) {
-    return ast_create_node(NODE_BREAK);
+ASTRef ast_create_break(AST* ast) {
+    return ast_create_node(ast, NODE_BREAK);
 }
 
-ASTNode* ast_create_continue(void) {
-    return ast_create_node(NODE_CONTINUE);
+ASTRef ast_create_continue(AST* ast) {
+    return ast_create_node(ast, NODE_CONTINUE);
 }
 
-ASTNode* ast_create_do_while(ASTNode* body, ASTNode* condition) {
-    ASTNode* node = ast_create_node(NODE_DO_WHILE);
+ASTRef ast_create_do_while(AST* ast, ASTRef body, ASTRef condition) {
+    ASTRef ref = ast_create_node(ast, NODE_DO_WHILE);
+    ASTNode* node = AST_NODE(ast, ref);
     node->data.while_stmt.body = body;
     node->data.while_stmt.condition = condition;
-    return node;
+    return ref;
 }
 
-ASTNode* ast_create_struct_def(const char* name, int is_union) {
-    ASTNode* node = ast_create_node(NODE_STRUCT_DEF);
-    node->data.struct_def.name = name ? string_duplicate(name) : NULL;
-    node->data.struct_def.is_union = is_union;
-    node->data.struct_def.members = NULL;
-    node->data.struct_def.member_count = 0;
-    return node;
+ASTRef ast_create_struct_def(AST* ast, const char* name, int is_union) {
+    ASTRef ref = ast_create_node(ast, NODE_STRUCT_DEF);
+    ASTNode* node = AST_NODE(ast, ref);
+    node->flag = (uint8_t)(is_union != 0);
+    node->data.struct_def.name = ast_add_string(ast, name);
+    return ref;
 }
 
-ASTNode* ast_create_member_access(ASTNode* object, const char* member, int is_arrow) {
-    ASTNode* node = ast_create_node(NODE_MEMBER_ACCESS);
+ASTRef ast_create_member_access(AST* ast, ASTRef object, const char* member, int is_arrow) {
+    ASTRef ref = ast_create_node(ast, NODE_MEMBER_ACCESS);
+    ASTNode* node = AST_NODE(ast, ref);
+    node->flag = (uint8_t)(is_arrow != 0);
     node->data.member_access.object = object;
-    node->data.member_access.member = string_duplicate(member);
-    node->data.member_access.is_arrow = is_arrow;
-    return node;
+    node->data.member_access.member = ast_add_string(ast, member);
+    return ref;
 }
 
-ASTNode* ast_create_switch(ASTNode* expression) {
-    ASTNode* node = ast_create_node(NODE_SWITCH);
-    node->data.switch_stmt.expression = expression;
-    node->data.switch_stmt.cases = NULL;
-    node->data.switch_stmt.case_count = 0;
-    return node;
+ASTRef ast_create_switch(AST* ast, ASTRef expression) {
+    ASTRef ref = ast_create_node(ast, NODE_SWITCH);
+    AST_NODE(ast, ref)->data.switch_stmt.expression = expression;
+    return ref;
 }
 
-ASTNode* ast_create_case(ASTNode* value) {
-    ASTNode* node = ast_create_node(NODE_CASE);
-    node->data.case_stmt.value = value;
-    node->data.case_stmt.statements = NULL;
-    node->data.case_stmt.statement_count = 0;
-    return node;
+ASTRef ast_create_case(AST* ast, ASTRef value) {
+    ASTRef ref = ast_create_node(ast, NODE_CASE);
+    AST_NODE(ast, ref)->data.case_stmt.value = value;
+    return ref;
 }
 
-ASTNode* ast_create_default(void) {
-    ASTNode* node = ast_create_node(NODE_DEFAULT);
-    node->data.case_stmt.value = NULL;
-    node->data.case_stmt.statements = NULL;
-    node->data.case_stmt.statement_count = 0;
-    return node;
+ASTRef ast_create_default(AST* ast) {
+    return ast_create_node(ast, NODE_DEFAULT);
 }
 
-ASTNode* ast_create_ternary(ASTNode* condition, ASTNode* then_expr, ASTNode* else_expr) {
-    ASTNode* node = ast_create_node(NODE_TERNARY);
+ASTRef ast_create_ternary(AST* ast, ASTRef condition, ASTRef then_expr, ASTRef else_expr) {
+    ASTRef ref = ast_create_node(ast, NODE_TERNARY);
+    ASTNode* node = AST_NODE(ast, ref);
     node->data.ternary.condition = condition;
     node->data.ternary.then_expr = then_expr;
     node->data.ternary.else_expr = else_expr;
-    return node;
+    return ref;
 }
 
-ASTNode* ast_create_enum_def(const char* name) {
-    ASTNode* node = ast_create_node(NODE_ENUM_DEF);
-    node->data.enum_def.name = name ? string_duplicate(name) : NULL;
-    node->data.enum_def.values = NULL;
-    node->data.enum_def.value_count = 0;
-    return node;
+ASTRef ast_create_enum_def(AST* ast, const char* name) {
+    ASTRef ref = ast_create_node(ast, NODE_ENUM_DEF);
+    AST_NODE(ast, ref)->data.enum_def.name = ast_add_string(ast, name);
+    return ref;
 }
 
-ASTNode* ast_create_sizeof_type(const char* type_name) {
-    ASTNode* node = ast_create_node(NODE_SIZEOF);
-    node->data.sizeof_expr.type_name = string_duplicate(type_name);
-    node->data.sizeof_expr.expression = NULL;
-    return node;
+ASTRef ast_create_sizeof_type(AST* ast, const char* type_name) {
+    ASTRef ref = ast_create_node(ast, NODE_SIZEOF);
+    AST_NODE(ast, ref)->data.sizeof_expr.type_name = ast_add_string(ast, type_name);
+    return ref;
 }
 
-ASTNode* ast_create_sizeof_expr(ASTNode* expression) {
-    ASTNode* node = ast_create_node(NODE_SIZEOF);
-    node->data.sizeof_expr.type_name = NULL;
-    node->data.sizeof_expr.expression = expression;
-    return node;
+ASTRef ast_create_sizeof_expr(AST* ast, ASTRef expression) {
+    ASTRef ref = ast_create_node(ast, NODE_SIZEOF);
+    AST_NODE(ast, ref)->data.sizeof_expr.expression = expression;
+    return ref;
 }
 
-ASTNode* ast_create_cast(const char* target_type, ASTNode* expression) {
-    ASTNode* node = ast_create_node(NODE_CAST);
-    node->data.cast.target_type = string_duplicate(target_type);
+ASTRef ast_create_cast(AST* ast, const char* target_type, ASTRef expression) {
+    ASTRef ref = ast_create_node(ast, NODE_CAST);
+    ASTNode* node = AST_NODE(ast, ref);
+    node->data.cast.target_type = ast_add_string(ast, target_type);
     node->data.cast.expression = expression;
-    return node;
+    return ref;
 }
 
-ASTNode* ast_create_compound_assign(const char* op, ASTNode* target, ASTNode* value) {
-    ASTNode* node = ast_create_node(NODE_COMPOUND_ASSIGN);
-    node->data.compound_assign.operator = string_duplicate(op);
+ASTRef ast_create_compound_assign(AST* ast, OperatorKind op, ASTRef target, ASTRef value) {
+    ASTRef ref = ast_create_node(ast, NODE_COMPOUND_ASSIGN);
+    ASTNode* node = AST_NODE(ast, ref);
+    node->op = (uint8_t)op;
     node->data.compound_assign.target = target;
     node->data.compound_assign.value = value;
-    return node;
+    return ref;
 }
 
-ASTNode* ast_create_goto(const char* label) {
-    ASTNode* node = ast_create_node(NODE_GOTO);
-    node->data.goto_stmt.label = string_duplicate(label);
-    return node;
+ASTRef ast_create_goto(AST* ast, const char* label) {
+    ASTRef ref = ast_create_node(ast, NODE_GOTO);
+    AST_NODE(ast, ref)->data.goto_stmt.label = ast_add_string(ast, label);
+    return ref;
 }
 
-ASTNode* ast_create_label(const char* name, ASTNode* statement) {
-    ASTNode* node = ast_create_node(NODE_LABEL);
-    node->data.label_stmt.name = string_duplicate(name);
+ASTRef ast_create_label(AST* ast, const char* name, ASTRef statement) {
+    ASTRef ref = ast_create_node(ast, NODE_LABEL);
+    ASTNode* node = AST_NODE(ast, ref);
+    node->data.label_stmt.name = ast_add_string(ast, name);
     node->data.label_stmt.statement = statement;
-    return node;
-}
-
-ASTNode* ast_create_typedef(const char* original_type, const char* new_name) {
-    ASTNode* node = ast_create_node(NODE_TYPEDEF);
-    node->data.typedef_stmt.original_type = string_duplicate(original_type);
-    node->data.typedef_stmt.new_name = string_duplicate(new_name);
-    return node;
-}
-
-/* Helper functions */
-
-void ast_add_struct_member(ASTNode* struct_def, ASTNode* member) {
-    if (struct_def->type != NODE_STRUCT_DEF) return;
-    int new_count = struct_def->data.struct_def.member_count + 1;
-    struct_def->data.struct_def.members = (ASTNode**)safe_realloc(
-        struct_def->data.struct_def.members,
-        sizeof(ASTNode*) * new_count
-    );
-    struct_def->data.struct_def.members[new_count - 1] = member;
-    struct_def->data.struct_def.member_count = new_count;
-}
-
-void ast_add_case(ASTNode* switch_stmt, ASTNode* case_node) {
-    if (switch_stmt->type != NODE_SWITCH) return;
-    int new_count = switch_stmt->data.switch_stmt.case_count + 1;
-    switch_stmt->data.switch_stmt.cases = (ASTNode**)safe_realloc(
-        switch_stmt->data.switch_stmt.cases,
-        sizeof(ASTNode*) * new_count
-    );
-    switch_stmt->data.switch_stmt.cases[new_count - 1] = case_node;
-    switch_stmt->data.switch_stmt.case_count = new_count;
-}
-
-void ast_add_case_statement(ASTNode* case_node, ASTNode* statement) {
-    if (case_node->type != NODE_CASE && case_node->type != NODE_DEFAULT) return;
-    int new_count = case_node->data.case_stmt.statement_count + 1;
-    case_node->data.case_stmt.statements = (ASTNode**)safe_realloc(
-        case_node->data.case_stmt.statements,
-        sizeof(ASTNode*) * new_count
-    );
-    case_node->data.case_stmt.statements[new_count - 1] = statement;
-    case_node->data.case_stmt.statement_count = new_count;
-}
-
-void ast_add_enum_value(ASTNode* enum_def, const char* value) {
-    if (enum_def->type != NODE_ENUM_DEF) return;
-    int new_count = enum_def->data.enum_def.value_count + 1;
-    enum_def->data.enum_def.values = (char**)safe_realloc(
-        enum_def->data.enum_def.values,
-        sizeof(char*) * new_count
-    );
-    enum_def->data.enum_def.values[new_count - 1] = string_duplicate(value);
-    enum_def->data.enum_def.value_count = new_count;
-}
-
-void ast_add_function(ASTNode* program, ASTNode* function) {
-    if (program->type != NODE_PROGRAM) return;
-
-    int new_count = program->data.program.function_count + 1;
-    program->data.program.functions = (ASTNode**)safe_realloc(
-        program->data.program.functions,
-        sizeof(ASTNode*) * new_count
-    );
-    program->data.program.functions[new_count - 1] = function;
-    program->data.program.function_count = new_count;
-}
-
-void ast_add_statement(ASTNode* block, ASTNode* statement) {
-    if (block->type != NODE_BLOCK) return;
-
-    int new_count = block->data.block.statement_count + 1;
-    block->data.block.statements = (ASTNode**)safe_realloc(
-        block->data.block.statements,
-        sizeof(ASTNode*) * new_count
-    );
-    block->data.block.statements[new_count - 1] = statement;
-    block->data.block.statement_count = new_count;
-}
-
-Parameter* parameter_create(const char* type, const char* name, int is_array) {
-    Parameter* param = (Parameter*)safe_malloc(sizeof(Parameter));
-    param->type = string_duplicate(type);
-    param->name = string_duplicate(name);
-    param->is_array = is_array;
-    return param;
+    return ref;
 }
 
-void parameter_destroy(Parameter* param) {
-    if (param) {
-        free(param->type);
-        free(param->name);
-        free(param);
+ASTRef ast_create_typedef(AST* ast, const char* original_type, const char* new_name) {
+    ASTRef ref = ast_create_node(ast, NODE_TYPEDEF);
+    ASTNode* node = AST_NODE(ast, ref);
+    node->data.typedef_stmt.original_type = ast_add_string(ast, original_type);
+    node->data.typedef_stmt.new_name = ast_add_string(ast, new_name);
+    return ref;
+}
+
+/* Child traversal */
+
+static void visit_list(const AST* ast, ASTList list, ASTVisitor visitor, void* context) {
+    const uint32_t* children = AST_LIST_ITEMS(ast, list);
+    int count = AST_LIST_COUNT(ast, list);
+    for (int i = 0; i < count; i++) {
+        if (children[i] != AST_NONE) visitor(context, ast, children[i]);
     }
 }
 
-/* AST destruction */
+/* Visit each present child once, in source order */
+void ast_visit_children(const AST* ast, ASTRef ref, ASTVisitor visitor, void* context) {
+    if (ref == AST_NONE) return;
 
-void ast_destroy(ASTNode* node) {
-    if (!node) return;
+    const ASTNode* node = AST_NODE(ast, ref);
+    ASTRef children[4] = { AST_NONE, AST_NONE, AST_NONE, AST_NONE };
 
     switch (node->type) {
         case NODE_PROGRAM:
-            for (int i = 0; i < node->data.program.function_count; i++) {
-                ast_destroy(node->data.program.functions[i]);
-            }
-            free(node->data.program.functions);
-            break;
+            visit_list(ast, node->data.program.functions, visitor, context);
+            return;
+        case NODE_BLOCK:
+            visit_list(ast, node->data.block.statements, visitor, context);
+            return;
+        case NODE_FUNCTION_CALL:
+            visit_list(ast, node->data.function_call.arguments, visitor, context);
+            return;
+        case NODE_STRUCT_DEF:
+            visit_list(ast, node->data.struct_def.members, visitor, context);
+            return;
+        case NODE_SWITCH:
+            if (node->data.switch_stmt.expression) visitor(context, ast, node->data.switch_stmt.expression);
+            visit_list(ast, node->data.switch_stmt.cases, visitor, context);
+            return;
+        case NODE_CASE:
+        case NODE_DEFAULT:
+            if (node->data.case_stmt.value) visitor(context, ast, node->data.case_stmt.value);
+            visit_list(ast, node->data.case_stmt.statements, visitor, context);
+            return;
 
         case NODE_FUNCTION:
-            free(node->data.function.return_type);
-            free(node->data.function.name);
-            for (int i = 0; i < node->data.function.param_count; i++) {
-                parameter_destroy(node->data.function.parameters[i]);
-            }
-            free(node->data.function.parameters);
-            ast_destroy(node->data.function.body);
+            children[0] = node->data.function.body;
             break;
-
         case NODE_DECLARATION:
-            free(node->data.declaration.data_type);
-            free(node->data.declaration.name);
-            ast_destroy(node->data.declaration.array_size);
-            ast_destroy(node->data.declaration.initializer);
+            children[0] = node->data.declaration.array_size;
+            children[1] = node->data.declaration.initializer;
             break;
-
         case NODE_IF:
-            ast_destroy(node->data.if_stmt.condition);
-            ast_destroy(node->data.if_stmt.then_branch);
-            ast_destroy(node->data.if_stmt.else_branch);
+            children[0] = node->data.if_stmt.condition;
+            children[1] = node->data.if_stmt.then_branch;
+            children[2] = node->data.if_stmt.else_branch;
             break;
-
         case NODE_WHILE:
+            children[0] = node->data.while_stmt.condition;
+            children[1] = node->data.while_stmt.body;
+            break;
         case NODE_DO_WHILE:
-            ast_destroy(node->data.while_stmt.condition);
-            ast_destroy(node->data.while_stmt.body);
+            children[0] = node->data.while_stmt.body;
+            children[1] = node->data.while_stmt.condition;
             break;
-
         case NODE_FOR:
-            ast_destroy(node->data.for_stmt.init);
-            ast_destroy(node->data.for_stmt.condition);
-            ast_destroy(node->data.for_stmt.increment);
-            ast_destroy(node->data.for_stmt.body);
+            children[0] = node->data.for_stmt.init;
+            children[1] = node->data.for_stmt.condition;
+            children[2] = node->data.for_stmt.increment;
+            children[3] = node->data.for_stmt.body;
             break;
-
         case NODE_RETURN:
-            ast_destroy(node->data.return_stmt.value);
+            children[0] = node->data.return_stmt.value;
+            break;
+        case NODE_BINARY_OP:
+            children[0] = node->data.binary_op.left;
+            children[1] = node->data.binary_op.right;
+            break;
+        case NODE_UNARY_OP:
+            children[0] = node->data.unary_op.operand;
+            break;
+        case NODE_ARRAY_ACCESS:
+            children[0] = node->data.array_access.index;
+            break;
+        case NODE_ASSIGNMENT:
+            children[0] = node->data.assignment.target;
+            children[1] = node->data.assignment.value;
+            break;
+        case NODE_MEMBER_ACCESS:
+            children[0] = node->data.member_access.object;
             break;
+        case NODE_TERNARY:
+            children[0] = node->data.ternary.condition;
+            children[1] = node->data.ternary.then_expr;
+            children[2] = node->data.ternary.else_expr;
+            break;
+        case NODE_SIZEOF:
+            children[0] = node->data.sizeof_expr.expression;
+            break;
+        case NODE_CAST:
+            children[0] = node->data.cast.expression;
+            break;
+        case NODE_COMPOUND_ASSIGN:
+            children[0] = node->data.compound_assign.target;
+            children[1] = node->data.compound_assign.value;
+            break;
+        case NODE_LABEL:
+            children[0] = node->data.label_stmt.statement;
+            break;
+        default:
+            return;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        if (children[i] != AST_NONE) visitor(context, ast, children[i]);
+    }
+}
+
+static void count_node(void* context, const AST* ast, ASTRef node) {
+    size_t* count = (size_t*)context;
+    (*count)++;
+    ast_visit_children(ast, node, count_node, context);
+}
+
+size_t ast_count_nodes(const AST* ast, ASTRef node) {
+    if (node == AST_NONE) return 0;
+
+    size_t count = 1;
+    ast_visit_children(ast, node, count_node, &count);
+    return count;
+}
+
+/*
+ * Structural hashing and comparison. Two trees are equal when they have the
+ * same shape, operators and text; source positions are ignored.
+ */
+
+static unsigned int hash_mix(unsigned int hash, unsigned int value) {
+    return (hash ^ value) * 16777619u;
+}
+
+static unsigned int hash_text(unsigned int hash, const AST* ast, ASTString string) {
+    const char* text = AST_TEXT(ast, string);
+    return hash_mix(hash, text ? string_hash(text, strlen(text)) : 0u);
+}
+
+static int text_equal(const AST* ast, ASTString a, ASTString b) {
+    if (a == b) return 1;
+    const char* a_text = AST_TEXT(ast, a);
+    const char* b_text = AST_TEXT(ast, b);
+    return a_text && b_text && strcmp(a_text, b_text) == 0;
+}
+
+static unsigned int hash_children(unsigned int hash, const AST* ast, ASTList list) {
+    const uint32_t* children = AST_LIST_ITEMS(ast, list);
+    int count = AST_LIST_COUNT(ast, list);
+    hash = hash_mix(hash, (unsigned int)count);
+    for (int i = 0; i < count; i++) {
+        hash = hash_mix(hash, ast_hash(ast, children[i]));
+    }
+    return hash;
+}
+
+static int children_equal(const AST* ast, ASTList a, ASTList b) {
+    int count = AST_LIST_COUNT(ast, a);
+    if (count != AST_LIST_COUNT(ast, b)) return 0;
+
+    const uint32_t* a_items = AST_LIST_ITEMS(ast, a);
+    const uint32_t* b_items = AST_LIST_ITEMS(ast, b);
+    for (int i = 0; i < count; i++) {
+        if (!ast_equal(ast, a_items[i], b_items[i])) return 0;
+    }
+    return 1;
+}
+
+static unsigned int hash_parameter_text(unsigned int hash, const char* text) {
+    return hash_mix(hash, text ? string_hash(text, strlen(text)) : 0u);
+}
+
+static int parameter_text_equal(const char* a, const char* b) {
+    if (a == b) return 1;
+    return a && b && strcmp(a, b) == 0;
+}
+
+unsigned int ast_hash_parameters(const AST* ast, ASTList params) {
+    const uint32_t* items = AST_LIST_ITEMS(ast, params);
+    int count = AST_LIST_COUNT(ast, params);
+    unsigned int hash = hash_mix(2166136261u, (unsigned int)count);
+    for (int i = 0; i < count; i++) {
+        const Parameter* param = AST_PARAMETER(ast, items[i]);
+        hash = hash_parameter_text(hash, param->type);
+        hash = hash_parameter_text(hash, param->name);
+        hash = hash_mix(hash, (unsigned int)param->is_array);
+    }
+    return hash;
+}
+
+int ast_parameters_equal(const AST* ast, ASTList a, ASTList b) {
+    int count = AST_LIST_COUNT(ast, a);
+    if (count != AST_LIST_COUNT(ast, b)) return 0;
+
+    const uint32_t* a_items = AST_LIST_ITEMS(ast, a);
+    const uint32_t* b_items = AST_LIST_ITEMS(ast, b);
+    for (int i = 0; i < count; i++) {
+        const Parameter* a_param = AST_PARAMETER(ast, a_items[i]);
+        const Parameter* b_param = AST_PARAMETER(ast, b_items[i]);
+        if (!parameter_text_equal(a_param->type, b_param->type) ||
+            !parameter_text_equal(a_param->name, b_param->name) ||
+            a_param->is_array != b_param->is_array) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+unsigned int ast_hash(const AST* ast, ASTRef ref) {
+    if (ref == AST_NONE) return 0;
+
+    const ASTNode* node = AST_NODE(ast, ref);
+    unsigned int hash = hash_mix(2166136261u, (unsigned int)node->type + 1);
+
+    switch (node->type) {
+        case NODE_PROGRAM:
+            return hash_children(hash, ast, node->data.program.functions);
+
+        case NODE_FUNCTION:
+            hash = hash_text(hash, ast, node->data.function.return_type);
+            hash = hash_text(hash, ast, node->data.function.name);
+            hash = hash_mix(hash, ast_hash_parameters(ast, node->data.function.parameters));
+            return hash_mix(hash, ast_hash(ast, node->data.function.body));
+
+        case NODE_DECLARATION:
+            hash = hash_text(hash, ast, node->data.declaration.data_type);
+            hash = hash_text(hash, ast, node->data.declaration.name);
+            hash = hash_mix(hash, (unsigned int)node->flag);
+            hash = hash_mix(hash, ast_hash(ast, node->data.declaration.array_size));
+            return hash_mix(hash, ast_hash(ast, node->data.declaration.initializer));
+
+        case NODE_IF:
+            hash = hash_mix(hash, ast_hash(ast, node->data.if_stmt.condition));
+            hash = hash_mix(hash, ast_hash(ast, node->data.if_stmt.then_branch));
+            return hash_mix(hash, ast_hash(ast, node->data.if_stmt.else_branch));
+
+        case NODE_WHILE:
+        case NODE_DO_WHILE:
+            hash = hash_mix(hash, ast_hash(ast, node->data.while_stmt.condition));
+            return hash_mix(hash, ast_hash(ast, node->data.while_stmt.body));
+
+        case NODE_FOR:
+            hash = hash_mix(hash, ast_hash(ast, node->data.for_stmt.init));
+            hash = hash_mix(hash, ast_hash(ast, node->data.for_stmt.condition));
+            hash = hash_mix(hash, ast_hash(ast, node->data.for_stmt.increment));
+            return hash_mix(hash, ast_hash(ast, node->data.for_stmt.body));
+
+        case NODE_RETURN:
+            return hash_mix(hash, ast_hash(ast, node->data.return_stmt.value));
 
         case NODE_BLOCK:
-            for (int i = 0; i < node->data.block.statement_count; i++) {
-                ast_destroy(node->data.block.statements[i]);
-            }
-            free(node->data.block.statements);
-            break;
+            return hash_children(hash, ast, node->data.block.statements);
 
         case NODE_BINARY_OP:
-            free(node->data.binary_op.operator);
-            ast_destroy(node->data.binary_op.left);
-            ast_destroy(node->data.binary_op.right);
-            break;
+            hash = hash_mix(hash, (unsigned int)node->op);
+            hash = hash_mix(hash, ast_hash(ast, node->data.binary_op.left));
+            return hash_mix(hash, ast_hash(ast, node->data.binary_op.right));
 
         case NODE_UNARY_OP:
-            free(node->data.unary_op.operator);
-            ast_destroy(node->data.unary_op.operand);
-            break;
+            hash = hash_mix(hash, (unsigned int)node->op);
+            return hash_mix(hash, ast_hash(ast, node->data.unary_op.operand));
 
         case NODE_FUNCTION_CALL:
-            free(node->data.function_call.name);
-            for (int i = 0; i < node->data.function_call.arg_count; i++) {
-                ast_destroy(node->data.function_call.arguments[i]);
-            }
-            free(node->data.function_call.arguments);
-            break;
+            hash = hash_text(hash, ast, node->data.function_call.name);
+            return hash_children(hash, ast, node->data.function_call.arguments);
 
         case NODE_ARRAY_ACCESS:
-            free(node->data.array_access.name);
-            ast_destroy(node->data.array_access.index);
-            break;
+            hash = hash_text(hash, ast, node->data.array_access.name);
+            return hash_mix(hash, ast_hash(ast, node->data.array_access.index));
 
         case NODE_ASSIGNMENT:
-            ast_destroy(node->data.assignment.target);
-            ast_destroy(node->data.assignment.value);
-            break;
+            hash = hash_mix(hash, ast_hash(ast, node->data.assignment.target));
+            return hash_mix(hash, ast_hash(ast, node->data.assignment.value));
 
         case NODE_LITERAL:
-            free(node->data.literal.value);
-            free(node->data.literal.data_type);
-            break;
+            hash = hash_text(hash, ast, node->data.literal.value);
+            return hash_text(hash, ast, node->data.literal.data_type);
 
         case NODE_IDENTIFIER:
-            free(node->data.identifier.name);
-            break;
-
-        case NODE_BREAK:
-        case NODE_CONTINUE:
-            /* No data to free */
-            break;
+            return hash_text(hash, ast, node->data.identifier.name);
 
         case NODE_STRUCT_DEF:
-            free(node->data.struct_def.name);
-            for (int i = 0; i < node->data.struct_def.member_count; i++) {
-                ast_destroy(node->data.struct_def.members[i]);
-            }
-            free(node->data.struct_def.members);
-            break;
+            hash = hash_text(hash, ast, node->data.struct_def.name);
+            hash = hash_mix(hash, (unsigned int)node->flag);
+            return hash_children(hash, ast, node->data.struct_def.members);
 
         case NODE_MEMBER_ACCESS:
-            ast_destroy(node->data.member_access.object);
-            free(node->data.member_access.member);
-            break;
+            hash = hash_mix(hash, ast_hash(ast, node->data.member_access.object));
+            hash = hash_text(hash, ast, node->data.member_access.member);
+            return hash_mix(hash, (unsigned int)node->flag);
 
         case NODE_SWITCH:
-            ast_destroy(node->data.switch_stmt.expression);
-            for (int i = 0; i < node->data.switch_stmt.case_count; i++) {
-                ast_destroy(node->data.switch_stmt.cases[i]);
-            }
-            free(node->data.switch_stmt.cases);
-            break;
+            hash = hash_mix(hash, ast_hash(ast, node->data.switch_stmt.expression));
+            return hash_children(hash, ast, node->data.switch_stmt.cases);
 
         case NODE_CASE:
         case NODE_DEFAULT:
-            ast_destroy(node->data.case_stmt.value);
-            for (int i = 0; i < node->data.case_stmt.statement_count; i++) {
-                ast_destroy(node->data.case_stmt.statements[i]);
-            }
-            free(node->data.case_stmt.statements);
-            break;
+            hash = hash_mix(hash, ast_hash(ast, node->data.case_stmt.value));
+            return hash_children(hash, ast, node->data.case_stmt.statements);
 
         case NODE_TERNARY:
-            ast_destroy(node->data.ternary.condition);
-            ast_destroy(node->data.ternary.then_expr);
-            ast_destroy(node->data.ternary.else_expr);
-            break;
+            hash = hash_mix(hash, ast_hash(ast, node->data.ternary.condition));
+            hash = hash_mix(hash, ast_hash(ast, node->data.ternary.then_expr));
+            return hash_mix(hash, ast_hash(ast, node->data.ternary.else_expr));
+
+        case NODE_ENUM_DEF: {
+            const uint32_t* values = AST_LIST_ITEMS(ast, node->data.enum_def.values);
+            int count = AST_LIST_COUNT(ast, node->data.enum_def.values);
+            hash = hash_text(hash, ast, node->data.enum_def.name);
+            hash = hash_mix(hash, (unsigned int)count);
+            for (int i = 0; i < count; i++) {
+                hash = hash_text(hash, ast, values[i]);
+            }
+            return hash;
+        }
 
-        case NODE_ENUM_DEF:
-            free(node->data.enum_def.name);
-            for (int i = 0; i < node->data.enum_def.value_count; i++) {
-                free(node->data.enum_def.values[i]);
+        case NODE_SIZEOF:
+            hash = hash_text(hash, ast, node->data.sizeof_expr.type_name);
+            return hash_mix(hash, ast_hash(ast, node->data.sizeof_expr.expression));
+
+        case NODE_CAST:
+            hash = hash_text(hash, ast, node->data.cast.target_type);
+            return hash_mix(hash, ast_hash(ast, node->data.cast.expression));
+
+        case NODE_COMPOUND_ASSIGN:
+            hash = hash_mix(hash, (unsigned int)node->op);
+            hash = hash_mix(hash, ast_hash(ast, node->data.compound_assign.target));
+            return hash_mix(hash, ast_hash(ast, node->data.compound_assign.value));
+
+        case NODE_GOTO:
+            return hash_text(hash, ast, node->data.goto_stmt.label);
+
+        case NODE_LABEL:
+            hash = hash_text(hash, ast, node->data.label_stmt.name);
+            return hash_mix(hash, ast_hash(ast, node->data.label_stmt.statement));
+
+        case NODE_TYPEDEF:
+            hash = hash_text(hash, ast, node->data.typedef_stmt.original_type);
+            return hash_text(hash, ast, node->data.typedef_stmt.new_name);
+
+        default:
+            /* Nodes without data: break, continue */
+            return hash;
+    }
+}
+
+int ast_equal(const AST* ast, ASTRef a_ref, ASTRef b_ref) {
+    if (a_ref == b_ref) return 1;
+    if (a_ref == AST_NONE || b_ref == AST_NONE) return 0;
+
+    const ASTNode* a = AST_NODE(ast, a_ref);
+    const ASTNode* b = AST_NODE(ast, b_ref);
+    if (a->type != b->type) return 0;
+
+    switch (a->type) {
+        case NODE_PROGRAM:
+            return children_equal(ast, a->data.program.functions, b->data.program.functions);
+
+        case NODE_FUNCTION:
+            return text_equal(ast, a->data.function.return_type, b->data.function.return_type) &&
+                   text_equal(ast, a->data.function.name, b->data.function.name) &&
+                   ast_parameters_equal(ast, a->data.function.parameters, b->data.function.parameters) &&
+                   ast_equal(ast, a->data.function.body, b->data.function.body);
+
+        case NODE_DECLARATION:
+            return text_equal(ast, a->data.declaration.data_type, b->data.declaration.data_type) &&
+                   text_equal(ast, a->data.declaration.name, b->data.declaration.name) &&
+                   a->flag == b->flag &&
+                   ast_equal(ast, a->data.declaration.array_size, b->data.declaration.array_size) &&
+                   ast_equal(ast, a->data.declaration.initializer, b->data.declaration.initializer);
+
+        case NODE_IF:
+            return ast_equal(ast, a->data.if_stmt.condition, b->data.if_stmt.condition) &&
+                   ast_equal(ast, a->data.if_stmt.then_branch, b->data.if_stmt.then_branch) &&
+                   ast_equal(ast, a->data.if_stmt.else_branch, b->data.if_stmt.else_branch);
+
+        case NODE_WHILE:
+        case NODE_DO_WHILE:
+            return ast_equal(ast, a->data.while_stmt.condition, b->data.while_stmt.condition) &&
+                   ast_equal(ast, a->data.while_stmt.body, b->data.while_stmt.body);
+
+        case NODE_FOR:
+            return ast_equal(ast, a->data.for_stmt.init, b->data.for_stmt.init) &&
+                   ast_equal(ast, a->data.for_stmt.condition, b->data.for_stmt.condition) &&
+                   ast_equal(ast, a->data.for_stmt.increment, b->data.for_stmt.increment) &&
+                   ast_equal(ast, a->data.for_stmt.body, b->data.for_stmt.body);
+
+        case NODE_RETURN:
+            return ast_equal(ast, a->data.return_stmt.value, b->data.return_stmt.value);
+
+        case NODE_BLOCK:
+            return children_equal(ast, a->data.block.statements, b->data.block.statements);
+
+        case NODE_BINARY_OP:
+            return a->op == b->op &&
+                   ast_equal(ast, a->data.binary_op.left, b->data.binary_op.left) &&
+                   ast_equal(ast, a->data.binary_op.right, b->data.binary_op.right);
+
+        case NODE_UNARY_OP:
+            return a->op == b->op &&
+                   ast_equal(ast, a->data.unary_op.operand, b->data.unary_op.operand);
+
+        case NODE_FUNCTION_CALL:
+            return text_equal(ast, a->data.function_call.name, b->data.function_call.name) &&
+                   children_equal(ast, a->data.function_call.arguments, b->data.function_call.arguments);
+
+        case NODE_ARRAY_ACCESS:
+            return text_equal(ast, a->data.array_access.name, b->data.array_access.name) &&
+                   ast_equal(ast, a->data.array_access.index, b->data.array_access.index);
+
+        case NODE_ASSIGNMENT:
+            return ast_equal(ast, a->data.assignment.target, b->data.assignment.target) &&
+                   ast_equal(ast, a->data.assignment.value, b->data.assignment.value);
+
+        case NODE_LITERAL:
+            return text_equal(ast, a->data.literal.value, b->data.literal.value) &&
+                   text_equal(ast, a->data.literal.data_type, b->data.literal.data_type);
+
+        case NODE_IDENTIFIER:
+            return text_equal(ast, a->data.identifier.name, b->data.identifier.name);
+
+        case NODE_STRUCT_DEF:
+            return text_equal(ast, a->data.struct_def.name, b->data.struct_def.name) &&
+                   a->flag == b->flag &&
+                   children_equal(ast, a->data.struct_def.members, b->data.struct_def.members);
+
+        case NODE_MEMBER_ACCESS:
+            return ast_equal(ast, a->data.member_access.object, b->data.member_access.object) &&
+                   text_equal(ast, a->data.member_access.member, b->data.member_access.member) &&
+                   a->flag == b->flag;
+
+        case NODE_SWITCH:
+            return ast_equal(ast, a->data.switch_stmt.expression, b->data.switch_stmt.expression) &&
+                   children_equal(ast, a->data.switch_stmt.cases, b->data.switch_stmt.cases);
+
+        case NODE_CASE:
+        case NODE_DEFAULT:
+            return ast_equal(ast, a->data.case_stmt.value, b->data.case_stmt.value) &&
+                   children_equal(ast, a->data.case_stmt.statements, b->data.case_stmt.statements);
+
+        case NODE_TERNARY:
+            return ast_equal(ast, a->data.ternary.condition, b->data.ternary.condition) &&
+                   ast_equal(ast, a->data.ternary.then_expr, b->data.ternary.then_expr) &&
+                   ast_equal(ast, a->data.ternary.else_expr, b->data.ternary.else_expr);
+
+        case NODE_ENUM_DEF: {
+            int count = AST_LIST_COUNT(ast, a->data.enum_def.values);
+            if (!text_equal(ast, a->data.enum_def.name, b->data.enum_def.name) ||
+                count != AST_LIST_COUNT(ast, b->data.enum_def.values)) {
+                return 0;
             }
-            free(node->data.enum_def.values);
-            break;
+            const uint32_t* a_values = AST_LIST_ITEMS(ast, a->data.enum_def.values);
+            const uint32_t* b_values = AST_LIST_ITEMS(ast, b->data.enum_def.values);
+            for (int i = 0; i < count; i++) {
+                if (!text_equal(ast, a_values[i], b_values[i])) return 0;
+            }
+            return 1;
+        }
 
         case NODE_SIZEOF:
-            free(node->data.sizeof_expr.type_name);
-            ast_destroy(node->data.sizeof_expr.expression);
-            break;
+            return text_equal(ast, a->data.sizeof_expr.type_name, b->data.sizeof_expr.type_name) &&
+                   ast_equal(ast, a->data.sizeof_expr.expression, b->data.sizeof_expr.expression);
 
         case NODE_CAST:
-            free(node->data.cast.target_type);
-            ast_destroy(node->data.cast.expression);
-            break;
+            return text_equal(ast, a->data.cast.target_type, b->data.cast.target_type) &&
+                   ast_equal(ast, a->data.cast.expression, b->data.cast.expression);
 
         case NODE_COMPOUND_ASSIGN:
-            free(node->data.compound_assign.operator);
-            ast_destroy(node->data.compound_assign.target);
-            ast_destroy(node->data.compound_assign.value);
-            break;
+            return a->op == b->op &&
+                   ast_equal(ast, a->data.compound_assign.target, b->data.compound_assign.target) &&
+                   ast_equal(ast, a->data.compound_assign.value, b->data.compound_assign.value);
 
         case NODE_GOTO:
-            free(node->data.goto_stmt.label);
-            break;
+            return text_equal(ast, a->data.goto_stmt.label, b->data.goto_stmt.label);
 
         case NODE_LABEL:
-            free(node->data.label_stmt.name);
-            ast_destroy(node->data.label_stmt.statement);
-            break;
+            return text_equal(ast, a->data.label_stmt.name, b->data.label_stmt.name) &&
+                   ast_equal(ast, a->data.label_stmt.statement, b->data.label_stmt.statement);
 
         case NODE_TYPEDEF:
-            free(node->data.typedef_stmt.original_type);
-            free(node->data.typedef_stmt.new_name);
-            break;
+            return text_equal(ast, a->data.typedef_stmt.original_type, b->data.typedef_stmt.original_type) &&
+                   text_equal(ast, a->data.typedef_stmt.new_name, b->data.typedef_stmt.new_name);
 
         default:
-            break;
+            return 1;
     }
+}
+
+/* Operator spelling, indexed by OperatorKind */
+static const char* const operator_symbols[OP_COUNT] = {
+    "+", "-", "*", "/", "%",
+    "==", "!=", "<", "<=", ">", ">=",
+    "&&", "||", "&", "|", "^", "<<", ">>",
+    "[]",
+    "!", "-", "+", "++", "--", "++post", "--post", "~", "&", "*",
+    "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "<<=", ">>="
+};
 
-    free(node);
+const char* operator_symbol(OperatorKind op) {
+    if (op < 0 || op >= OP_COUNT) return "?";
+    return operator_symbols[op];
 }
 
 /* Debug printing */
@@ -534,43 +924,50 @@ static void print_indent(int indent) {
     }
 }
 
-void ast_print(ASTNode* node, int indent) {
-    if (!node) return;
+void ast_print(const AST* ast, ASTRef ref, int indent) {
+    if (ref == AST_NONE) return;
 
+    const ASTNode* node = AST_NODE(ast, ref);
     print_indent(indent);
 
     switch (node->type) {
-        case NODE_PROGRAM:
-            printf("PROGRAM (%d functions)\n", node->data.program.function_count);
-            for (int i = 0; i < node->data.program.function_count; i++) {
-                ast_print(node->data.program.functions[i], indent + 1);
+        case NODE_PROGRAM: {
+            const uint32_t* functions = AST_LIST_ITEMS(ast, node->data.program.functions);
+            int count = AST_LIST_COUNT(ast, node->data.program.functions);
+            printf("PROGRAM (%d functions)\n", count);
+            for (int i = 0; i < count; i++) {
+                ast_print(ast, functions[i], indent + 1);
             }
             break;
+        }
 
         case NODE_FUNCTION:
-            printf("FUNCTION %s: %s\n", node->data.function.name, node->data.function.return_type);
-            ast_print(node->data.function.body, indent + 1);
+            printf("FUNCTION %s: %s\n", AST_TEXT(ast, node->data.function.name),
+                   AST_TEXT(ast, node->data.function.return_type));
+            ast_print(ast, node->data.function.body, indent + 1);
             break;
 
         case NODE_DECLARATION:
-            printf("DECLARATION %s: %s\n", node->data.declaration.name, node->data.declaration.data_type);
+            printf("DECLARATION %s: %s\n", AST_TEXT(ast, node->data.declaration.name),
+                   AST_TEXT(ast, node->data.declaration.data_type));
             if (node->data.declaration.initializer) {
-                ast_print(node->data.declaration.initializer, indent + 1);
+                ast_print(ast, node->data.declaration.initializer, indent + 1);
             }
             break;
 
         case NODE_LITERAL:
-            printf("LITERAL %s (%s)\n", node->data.literal.value, node->data.literal.data_type);
+            printf("LITERAL %s (%s)\n", AST_TEXT(ast, node->data.literal.value),
+                   AST_TEXT(ast, node->data.literal.data_type));
             break;
 
         case NODE_IDENTIFIER:
-            printf("IDENTIFIER %s\n", node->data.identifier.name);
+            printf("IDENTIFIER %s\n", AST_TEXT(ast, node->data.identifier.name));
             break;
 
         case NODE_BINARY_OP:
-            printf("BINARY_OP %s\n", node->data.binary_op.operator);
-            ast_print(node->data.binary_op.left, indent + 1);
-            ast_print(node->data.binary_op.right, indent + 1);
+            printf("BINARY_OP %s\n", operator_symbol((OperatorKind)node->op));
+            ast_print(ast, node->data.binary_op.left, indent + 1);
+            ast_print(ast, node->data.binary_op.right, indent + 1);
             break;
 
         default:
@@ -1,6 +1,8 @@
 #ifndef AST_H
 #define AST_H
 
+#include <stdint.h>
+
 #include "utils.h"
 #include "lexer.h"
 
@@ -42,253 +44,350 @@ typedef enum {
     NODE_TYPEDEF
 } NodeType;
 
-/* Forward declaration */
-struct ASTNode;
+/* Operators carried by binary, unary and compound-assignment nodes */
+typedef enum {
+    /* Binary */
+    OP_ADD,
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE,
+    OP_MODULO,
+    OP_EQUAL,
+    OP_NOT_EQUAL,
+    OP_LESS,
+    OP_LESS_EQUAL,
+    OP_GREATER,
+    OP_GREATER_EQUAL,
+    OP_LOGICAL_AND,
+    OP_LOGICAL_OR,
+    OP_BIT_AND,
+    OP_BIT_OR,
+    OP_BIT_XOR,
+    OP_SHIFT_LEFT,
+    OP_SHIFT_RIGHT,
+    OP_INDEX,           /* a[i][j] on a non-identifier base */
+    /* Unary */
+    OP_NOT,
+    OP_NEGATE,
+    OP_UNARY_PLUS,
+    OP_PRE_INCREMENT,
+    OP_PRE_DECREMENT,
+    OP_POST_INCREMENT,
+    OP_POST_DECREMENT,
+    OP_BIT_NOT,
+    OP_ADDRESS_OF,
+    OP_DEREFERENCE,
+    /* Compound assignment */
+    OP_ADD_ASSIGN,
+    OP_SUBTRACT_ASSIGN,
+    OP_MULTIPLY_ASSIGN,
+    OP_DIVIDE_ASSIGN,
+    OP_MODULO_ASSIGN,
+    OP_AND_ASSIGN,
+    OP_OR_ASSIGN,
+    OP_XOR_ASSIGN,
+    OP_SHIFT_LEFT_ASSIGN,
+    OP_SHIFT_RIGHT_ASSIGN,
+    OP_COUNT
+} OperatorKind;
+
+/*
+ * The tree is flat: nodes live in one array and name each other by 32-bit
+ * index, and strings and variable-length child lists sit in side tables.
+ * Index 0 is reserved in every table, so AST_NONE reads as no node, a NULL
+ * string and the empty list alike.
+ */
+typedef uint32_t ASTRef;    /* Index into AST.nodes */
+typedef uint32_t ASTString; /* Index into AST.strings */
+typedef uint32_t ASTList;   /* Index into AST.lists of a count followed by the items */
+
+#define AST_NONE 0u
 
 /* Parameter structure */
 typedef struct Parameter {
-    char* type;
-    char* name;
+    const char* type;
+    const char* name;
     int is_array;
 } Parameter;
 
-/* AST Node structure */
-typedef struct ASTNode {
-    NodeType type;
-    int line;
-    int column;
+/*
+ * AST node: a small fixed header and at most four 32-bit fields. Operators
+ * and the one flag some nodes need live in the header, not the union.
+ */
+typedef struct {
+    uint8_t type;       /* NodeType */
+    uint8_t op;         /* OperatorKind of binary, unary and compound-assignment nodes */
+    uint8_t flag;       /* is_array (declaration), is_union (struct_def), is_arrow (member_access) */
+    int32_t offset;     /* Byte offset in the source, or -1 when unknown */
 
     union {
         /* Program node */
         struct {
-            struct ASTNode** functions;
-            int function_count;
+            ASTList functions;
         } program;
 
         /* Function node */
         struct {
-            char* return_type;
-            char* name;
-            Parameter** parameters;
-            int param_count;
-            struct ASTNode* body;
+            ASTString return_type;
+            ASTString name;
+            ASTList parameters;     /* Items index AST.parameters */
+            ASTRef body;
         } function;
 
         /* Declaration node */
         struct {
-            char* data_type;
-            char* name;
-            int is_array;
-            struct ASTNode* array_size;
-            struct ASTNode* initializer;
+            ASTString data_type;
+            ASTString name;
+            ASTRef array_size;
+            ASTRef initializer;
         } declaration;
 
         /* If statement node */
         struct {
-            struct ASTNode* condition;
-            struct ASTNode* then_branch;
-            struct ASTNode* else_branch;
+            ASTRef condition;
+            ASTRef then_branch;
+            ASTRef else_branch;
         } if_stmt;
 
-        /* While statement node */
+        /* While and do-while statement node */
         struct {
-            struct ASTNode* condition;
-            struct ASTNode* body;
+            ASTRef condition;
+            ASTRef body;
         } while_stmt;
 
         /* For statement node */
         struct {
-            struct ASTNode* init;
-            struct ASTNode* condition;
-            struct ASTNode* increment;
-            struct ASTNode* body;
+            ASTRef init;
+            ASTRef condition;
+            ASTRef increment;
+            ASTRef body;
         } for_stmt;
 
         /* Return statement node */
         struct {
-            struct ASTNode* value;
+            ASTRef value;
         } return_stmt;
 
         /* Block node */
         struct {
-            struct ASTNode** statements;
-            int statement_count;
+            ASTList statements;
         } block;
 
         /* Binary operation node */
         struct {
-            char* operator;
-            struct ASTNode* left;
-            struct ASTNode* right;
+            ASTRef left;
+            ASTRef right;
         } binary_op;
 
         /* Unary operation node */
         struct {
-            char* operator;
-            struct ASTNode* operand;
+            ASTRef operand;
         } unary_op;
 
         /* Function call node */
         struct {
-            char* name;
-            struct ASTNode** arguments;
-            int arg_count;
+            ASTString name;
+            ASTList arguments;
         } function_call;
 
         /* Array access node */
         struct {
-            char* name;
-            struct ASTNode* index;
+            ASTString name;
+            ASTRef index;
         } array_access;
 
         /* Assignment node */
         struct {
-            struct ASTNode* target;
-            struct ASTNode* value;
+            ASTRef target;
+            ASTRef value;
         } assignment;
 
         /* Literal node */
         struct {
-            char* value;
-            char* data_type;  /* "int", "float", "string", "char" */
+            ASTString value;
+            ASTString data_type;    /* "number", "string", "char" */
         } literal;
 
         /* Identifier node */
         struct {
-            char* name;
+            ASTString name;
         } identifier;
 
         /* Struct/Union definition node */
         struct {
-            char* name;
-            int is_union;
-            struct ASTNode** members;
-            int member_count;
+            ASTString name;
+            ASTList members;
         } struct_def;
 
         /* Member access node (. and ->) */
         struct {
-            struct ASTNode* object;
-            char* member;
-            int is_arrow;  /* 1 for ->, 0 for . */
+            ASTRef object;
+            ASTString member;
         } member_access;
 
         /* Switch statement node */
         struct {
-            struct ASTNode* expression;
-            struct ASTNode** cases;
-            int case_count;
+            ASTRef expression;
+            ASTList cases;
         } switch_stmt;
 
-        /* Case node */
+        /* Case and default node */
         struct {
-            struct ASTNode* value;  /* NULL for default */
-            struct ASTNode** statements;
-            int statement_count;
+            ASTRef value;           /* AST_NONE for default */
+            ASTList statements;
         } case_stmt;
 
         /* Ternary operator node */
         struct {
-            struct ASTNode* condition;
-            struct ASTNode* then_expr;
-            struct ASTNode* else_expr;
+            ASTRef condition;
+            ASTRef then_expr;
+            ASTRef else_expr;
         } ternary;
 
         /* Enum definition node */
         struct {
-            char* name;
-            char** values;
-            int value_count;
+            ASTString name;
+            ASTList values;         /* Items are ASTStrings */
         } enum_def;
 
         /* Sizeof expression node */
         struct {
-            char* type_name;
-            struct ASTNode* expression;  /* Either type_name or expression */
+            ASTString type_name;
+            ASTRef expression;      /* Either type_name or expression */
         } sizeof_expr;
 
         /* Cast expression node */
         struct {
-            char* target_type;
-            struct ASTNode* expression;
+            ASTString target_type;
+            ASTRef expression;
         } cast;
 
         /* Compound assignment node */
         struct {
-            char* operator;  /* +=, -=, *=, etc. */
-            struct ASTNode* target;
-            struct ASTNode* value;
+            ASTRef target;
+            ASTRef value;
         } compound_assign;
 
         /* Goto node */
         struct {
-            char* label;
+            ASTString label;
         } goto_stmt;
 
         /* Label node */
         struct {
-            char* name;
-            struct ASTNode* statement;
+            ASTString name;
+            ASTRef statement;
         } label_stmt;
 
         /* Typedef node */
         struct {
-            char* original_type;
-            char* new_name;
+            ASTString original_type;
+            ASTString new_name;
         } typedef_stmt;
 
     } data;
 } ASTNode;
 
-/* AST node creation functions */
-ASTNode* ast_create_program(void);
-ASTNode* ast_create_function(const char* return_type, const char* name, Parameter** params, int param_count, ASTNode* body);
-ASTNode* ast_create_declaration(const char* type, const char* name, ASTNode* initializer);
-ASTNode* ast_create_array_declaration(const char* type, const char* name, ASTNode* size);
-ASTNode* ast_create_if(ASTNode* condition, ASTNode* then_branch, ASTNode* else_branch);
-ASTNode* ast_create_while(ASTNode* condition, ASTNode* body);
-ASTNode* ast_create_for(ASTNode* init, ASTNode* condition, ASTNode* increment, ASTNode* body);
-ASTNode* ast_create_return(ASTNode* value);
-ASTNode* ast_create_block(void);
-ASTNode* ast_create_binary_op(const char* operator, ASTNode* left, ASTNode* right);
-ASTNode* ast_create_unary_op(const char* operator, ASTNode* operand);
-ASTNode* ast_create_function_call(const char* name, ASTNode** args, int arg_count);
-ASTNode* ast_create_array_access(const char* name, ASTNode* index);
-ASTNode* ast_create_assignment(ASTNode* target, ASTNode* value);
-ASTNode* ast_create_literal(const char* value, const char* type);
-ASTNode* ast_create_identifier(const char* name);
-ASTNode* ast_create_break(void);
-ASTNode* ast_create_continue(void);
-ASTNode* ast_create_do_while(ASTNode* body, ASTNode* condition);
-ASTNode* ast_create_struct_def(const char* name, int is_union);
-ASTNode* ast_create_member_access(ASTNode* object, const char* member, int is_arrow);
-ASTNode* ast_create_switch(ASTNode* expression);
-ASTNode* ast_create_case(ASTNode* value);
-ASTNode* ast_create_default(void);
-ASTNode* ast_create_ternary(ASTNode* condition, ASTNode* then_expr, ASTNode* else_expr);
-ASTNode* ast_create_enum_def(const char* name);
-ASTNode* ast_create_sizeof_type(const char* type_name);
-ASTNode* ast_create_sizeof_expr(ASTNode* expression);
-ASTNode* ast_create_cast(const char* target_type, ASTNode* expression);
-ASTNode* ast_create_compound_assign(const char* op, ASTNode* target, ASTNode* value);
-ASTNode* ast_create_goto(const char* label);
-ASTNode* ast_create_label(const char* name, ASTNode* statement);
-ASTNode* ast_create_typedef(const char* original_type, const char* new_name);
-
-/* Helper functions */
-void ast_add_struct_member(ASTNode* struct_def, ASTNode* member);
-void ast_add_case(ASTNode* switch_stmt, ASTNode* case_node);
-void ast_add_case_statement(ASTNode* case_node, ASTNode* statement);
-void ast_add_enum_value(ASTNode* enum_def, const char* value);
-void ast_add_function(ASTNode* program, ASTNode* function);
-void ast_add_statement(ASTNode* block, ASTNode* statement);
-Parameter* parameter_create(const char* type, const char* name, int is_array);
-void parameter_destroy(Parameter* param);
-
-/* AST destruction */
-void ast_destroy(ASTNode* node);
+/*
+ * A tree and its side tables. Everything is reset, not freed, by ast_clear,
+ * so a compiler reuses the same storage from file to file. Strings are
+ * stored, not copied: callers pass text that lives as long as the tree
+ * (interned or static), and each distinct pointer gets one index.
+ */
+typedef struct {
+    ASTNode* nodes;
+    int node_count;
+    int node_capacity;
+    uint32_t* lists;
+    int list_length;
+    int list_capacity;
+    const char** strings;
+    int string_count;
+    int string_capacity;
+    ASTString* string_slots;    /* Open-addressing index of strings by pointer */
+    int slot_capacity;
+    Parameter* parameters;
+    int parameter_count;
+    int parameter_capacity;
+} AST;
+
+/* Table sizes at some point, for discarding everything added after it */
+typedef struct {
+    int node_count;
+    int list_length;
+    int string_count;
+    int parameter_count;
+} ASTMark;
+
+/* Lookups; the pointers stay valid until the tree grows */
+#define AST_NODE(ast, ref)          (&(ast)->nodes[ref])
+#define AST_TEXT(ast, string)       ((ast)->strings[string])
+#define AST_LIST_COUNT(ast, list)   ((int)(ast)->lists[list])
+#define AST_LIST_ITEMS(ast, list)   ((const uint32_t*)&(ast)->lists[(list) + 1])
+#define AST_PARAMETER(ast, index)   (&(ast)->parameters[index])
+
+/* Tree creation and destruction */
+AST* ast_create(void);
+void ast_destroy(AST* ast);
+void ast_clear(AST* ast);
+ASTMark ast_mark(const AST* ast);
+void ast_rewind(AST* ast, ASTMark mark);
+
+/* Side tables */
+ASTString ast_add_string(AST* ast, const char* text);
+ASTList ast_add_list(AST* ast, const uint32_t* items, int count);
+uint32_t ast_add_parameter(AST* ast, const char* type, const char* name, int is_array);
+
+/* AST node creation functions; lists start empty and are filled in with ast_add_list */
+ASTRef ast_create_program(AST* ast);
+ASTRef ast_create_function(AST* ast, const char* return_type, const char* name, ASTList params, ASTRef body);
+ASTRef ast_create_declaration(AST* ast, const char* type, const char* name, ASTRef initializer);
+ASTRef ast_create_array_declaration(AST* ast, const char* type, const char* name, ASTRef size);
+ASTRef ast_create_if(AST* ast, ASTRef condition, ASTRef then_branch, ASTRef else_branch);
+ASTRef ast_create_while(AST* ast, ASTRef condition, ASTRef body);
+ASTRef ast_create_for(AST* ast, ASTRef init, ASTRef condition, ASTRef increment, ASTRef body);
+ASTRef ast_create_return(AST* ast, ASTRef value);
+ASTRef ast_create_block(AST* ast);
+ASTRef ast_create_binary_op(AST* ast, OperatorKind operator, ASTRef left, ASTRef right);
+ASTRef ast_create_unary_op(AST* ast, OperatorKind operator, ASTRef operand);
+ASTRef ast_create_function_call(AST* ast, const char* name, ASTList args);
+ASTRef ast_create_array_access(AST* ast, const char* name, ASTRef index);
+ASTRef ast_create_assignment(AST* ast, ASTRef target, ASTRef value);
+ASTRef ast_create_literal(AST* ast, const char* value, const char* type);
+ASTRef ast_create_identifier(AST* ast, const char* name);
+ASTRef ast_create_break(AST* ast);
+ASTRef ast_create_continue(AST* ast);
+ASTRef ast_create_do_while(AST* ast, ASTRef body, ASTRef condition);
+ASTRef ast_create_struct_def(AST* ast, const char* name, int is_union);
+ASTRef ast_create_member_access(AST* ast, ASTRef object, const char* member, int is_arrow);
+ASTRef ast_create_switch(AST* ast, ASTRef expression);
+ASTRef ast_create_case(AST* ast, ASTRef value);
+ASTRef ast_create_default(AST* ast);
+ASTRef ast_create_ternary(AST* ast, ASTRef condition, ASTRef then_expr, ASTRef else_expr);
+ASTRef ast_create_enum_def(AST* ast, const char* name);
+ASTRef ast_create_sizeof_type(AST* ast, const char* type_name);
+ASTRef ast_create_sizeof_expr(AST* ast, ASTRef expression);
+ASTRef ast_create_cast(AST* ast, const char* target_type, ASTRef expression);
+ASTRef ast_create_compound_assign(AST* ast, OperatorKind op, ASTRef target, ASTRef value);
+ASTRef ast_create_goto(AST* ast, const char* label);
+ASTRef ast_create_label(AST* ast, const char* name, ASTRef statement);
+ASTRef ast_create_typedef(AST* ast, const char* original_type, const char* new_name);
+
+/* Child traversal */
+typedef void (*ASTVisitor)(void* context, const AST* ast, ASTRef child);
+void ast_visit_children(const AST* ast, ASTRef node, ASTVisitor visitor, void* context);
+size_t ast_count_nodes(const AST* ast, ASTRef node);
+
+/* Structural hashing and equality, ignoring source positions */
+unsigned int ast_hash(const AST* ast, ASTRef node);
+int ast_equal(const AST* ast, ASTRef a, ASTRef b);
+unsigned int ast_hash_parameters(const AST* ast, ASTList params);
+int ast_parameters_equal(const AST* ast, ASTList a, ASTList b);
+
+/* Source spelling of an operator ("+", "<<=", "++post", ...) */
+const char* operator_symbol(OperatorKind op);
 
 /* Debug printing */
-void ast_print(ASTNode* node, int indent);
+void ast_print(const AST* ast, ASTRef node, int indent);
 
 #endif /* AST_H */
@@ -0,0 +1,734 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#include "batch.h"
+#include "thread.h"
+#include "source.h"
+
+#define INPUT_LIST_INITIAL_CAPACITY 16
+#define RESPONSE_FILE_MAX_DEPTH 16
+
+/* Input list creation and destruction */
+
+InputList* input_list_create(void) {
+    InputList* inputs = (InputList*)safe_malloc(sizeof(InputList));
+    inputs->capacity = INPUT_LIST_INITIAL_CAPACITY;
+    inputs->count = 0;
+    inputs->paths = (char**)safe_malloc(sizeof(char*) * inputs->capacity);
+    inputs->expanded = 0;
+    return inputs;
+}
+
+void input_list_destroy(InputList* inputs) {
+    if (!inputs) return;
+
+    for (int i = 0; i < inputs->count; i++) {
+        free(inputs->paths[i]);
+    }
+    free(inputs->paths);
+    free(inputs);
+}
+
+static void input_list_append(InputList* inputs, const char* path) {
+    if (inputs->count >= inputs->capacity) {
+        inputs->capacity *= 2;
+        inputs->paths = (char**)safe_realloc(inputs->paths, sizeof(char*) * inputs->capacity);
+    }
+    inputs->paths[inputs->count++] = string_duplicate(path);
+}
+
+/* Directory expansion */
+
+static int has_c_extension(const char* name) {
+    size_t len = strlen(name);
+    return len > 2 && name[len-2] == '.' && name[len-1] == 'c';
+}
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static char* join_path(const char* directory, const char* name) {
+    size_t dir_len = strlen(directory);
+    size_t name_len = strlen(name);
+    char* path = (char*)safe_malloc(dir_len + name_len + 2);
+
+    memcpy(path, directory, dir_len);
+    if (dir_len > 0 && directory[dir_len-1] != '/' && directory[dir_len-1] != '\\') {
+        path[dir_len++] = '/';
+    }
+    memcpy(path + dir_len, name, name_len + 1);
+    return path;
+}
+
+#ifdef _WIN32
+
+static int is_directory(const char* path) {
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+/* Collect the names in a directory, skipping hidden entries */
+static char** list_directory(const char* directory, int* count) {
+    char* pattern = join_path(directory, "*");
+    WIN32_FIND_DATAA entry;
+    HANDLE search = FindFirstFileA(pattern, &entry);
+    free(pattern);
+    if (search == INVALID_HANDLE_VALUE) return NULL;
+
+    int capacity = 16;
+    char** names = (char**)safe_malloc(sizeof(char*) * capacity);
+    *count = 0;
+    do {
+        if (entry.cFileName[0] == '.') continue;
+        if (*count >= capacity) {
+            capacity *= 2;
+            names = (char**)safe_realloc(names, sizeof(char*) * capacity);
+        }
+        names[(*count)++] = string_duplicate(entry.cFileName);
+    } while (FindNextFileA(search, &entry));
+
+    FindClose(search);
+    return names;
+}
+
+#else
+
+static int is_directory(const char* path) {
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+/* Collect the names in a directory, skipping hidden entries */
+static char** list_directory(const char* directory, int* count) {
+    DIR* dir = opendir(directory);
+    if (!dir) return NULL;
+
+    int capacity = 16;
+    char** names = (char**)safe_malloc(sizeof(char*) * capacity);
+    *count = 0;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        if (*count >= capacity) {
+            capacity *= 2;
+            names = (char**)safe_realloc(names, sizeof(char*) * capacity);
+        }
+        names[(*count)++] = string_duplicate(entry->d_name);
+    }
+
+    closedir(dir);
+    return names;
+}
+
+#endif
+
+/* Add every .c file under directory, in sorted order */
+static int add_directory(InputList* inputs, const char* directory) {
+    int count = 0;
+    char** names = list_directory(directory, &count);
+    if (!names) {
+        log_message(LOG_ERROR, "Cannot read directory: %s", directory);
+        return 0;
+    }
+
+    qsort(names, (size_t)count, sizeof(char*), compare_names);
+
+    int ok = 1;
+    for (int i = 0; i < count; i++) {
+        char* path = join_path(directory, names[i]);
+        if (is_directory(path)) {
+            ok = add_directory(inputs, path) && ok;
+        } else if (has_c_extension(names[i])) {
+            input_list_append(inputs, path);
+        }
+        free(path);
+        free(names[i]);
+    }
+
+    free(names);
+    return ok;
+}
+
+/* Input collection */
+
+static int add_input(InputList* inputs, const char* arg, int depth);
+
+/* Add each non-blank line of a response file as an input */
+static int add_response_file(InputList* inputs, const char* filename, int depth) {
+    if (depth > RESPONSE_FILE_MAX_DEPTH) {
+        log_message(LOG_ERROR, "Response files nested too deeply: %s", filename);
+        return 0;
+    }
+
+    char* content = read_file(filename);
+    if (!content) return 0;
+
+    int ok = 1;
+    char* line = content;
+    while (*line) {
+        char* end = line;
+        while (*end && *end != '\n') end++;
+        char* next = *end ? end + 1 : end;
+
+        /* Trim surrounding whitespace, including a Windows '\r' */
+        while (line < end && isspace((unsigned char)*line)) line++;
+        while (end > line && isspace((unsigned char)end[-1])) end--;
+        *end = '\0';
+
+        if (*line) {
+            ok = add_input(inputs, line, depth + 1) && ok;
+        }
+        line = next;
+    }
+
+    free(content);
+    return ok;
+}
+
+static int add_input(InputList* inputs, const char* arg, int depth) {
+    if (arg[0] == '@') {
+        inputs->expanded = 1;
+        return add_response_file(inputs, arg + 1, depth);
+    }
+
+    if (is_directory(arg)) {
+        inputs->expanded = 1;
+        return add_directory(inputs, arg);
+    }
+
+    input_list_append(inputs, arg);
+    return 1;
+}
+
+int input_list_add(InputList* inputs, const char* arg) {
+    return add_input(inputs, arg, 0);
+}
+
+/* Worker pool */
+
+/*
+ * Work-stealing queue. Each worker owns a contiguous range of input indices
+ * and takes from its front; an idle worker steals the back half of another
+ * worker's remaining range. Nothing is added once the run starts, so a worker
+ * that finds every range empty can stop.
+ */
+typedef struct {
+    int top;            /* Next index the owner takes */
+    int bottom;         /* One past the last index in the range */
+    Mutex lock;
+} WorkRange;
+
+typedef struct {
+    const InputList* inputs;
+    const CompileOptions* options;
+    ArchiveWriter* archive;
+    WorkRange* ranges;
+    int worker_count;
+    Mutex stderr_lock;
+} BatchRun;
+
+typedef struct {
+    BatchRun* run;
+    int id;
+    int failures;
+} BatchWorker;
+
+static int take_own(WorkRange* range) {
+    int index = -1;
+
+    mutex_lock(&range->lock);
+    if (range->top < range->bottom) {
+        index = range->top++;
+    }
+    mutex_unlock(&range->lock);
+
+    return index;
+}
+
+static int steal(BatchRun* run, int thief) {
+    for (int offset = 1; offset < run->worker_count; offset++) {
+        WorkRange* victim = &run->ranges[(thief + offset) % run->worker_count];
+
+        mutex_lock(&victim->lock);
+        int remaining = victim->bottom - victim->top;
+        int half = (remaining + 1) / 2;
+        int start = victim->bottom - half;
+        victim->bottom = start;
+        mutex_unlock(&victim->lock);
+
+        if (half > 0) {
+            /* Keep all but the first stolen index in our own range */
+            WorkRange* own = &run->ranges[thief];
+            mutex_lock(&own->lock);
+            own->top = start + 1;
+            own->bottom = start + half;
+            mutex_unlock(&own->lock);
+            return start;
+        }
+    }
+
+    return -1;
+}
+
+static void capture_diagnostic(void* context, const char* text, size_t length) {
+    output_append_length((OutputBuilder*)context, text, length);
+}
+
+/*
+ * Archive runs. Every output goes into the archive under the name its file
+ * would have. Outputs the archive's last run stored for the same source and
+ * options are carried over as they are stored, and a source is translated
+ * only when one of its outputs is missing.
+ */
+
+/* Put data's outputs into the archive, translating into texts if need be; returns 1 on success */
+static int translate_to_archive(Compiler* compiler, ArchiveWriter* archive, const char* data, size_t length,
+                                const char* input_file, const CompileOptions* options, OutputBuilder** texts,
+                                CompileStats* stats) {
+    int formats = compile_formats(options);
+    char* output_file = default_output_filename(input_file, render_first_format(formats));
+    char* names[RENDER_FORMAT_COUNT];
+    CacheKey keys[RENDER_FORMAT_COUNT];
+    int missing = 0;
+
+    stats->input_bytes = length;
+    for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+        names[i] = NULL;
+        if (!(formats & RENDER_FORMAT_BIT(i))) continue;
+
+        names[i] = compile_output_filename(output_file, (RenderFormat)i, options);
+        keys[i] = compiler_cache_key(compiler, data, length, input_file, (RenderFormat)i, options);
+        if (!archive_writer_carry(archive, names[i], keys[i])) {
+            missing |= RENDER_FORMAT_BIT(i);
+        }
+    }
+
+    int ok = 1;
+    if (!missing) {
+        if (options->verbose) {
+            log_message(LOG_INFO, "Using archived translation");
+        }
+        compiler_discard_includes(compiler);
+        stats->cached = 1;
+    } else {
+        ok = compile_to_text(compiler, data, length, input_file, options, texts, stats) == 0;
+        compile_stats_phase_begin(stats, PHASE_FORMAT);
+        for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+            if (ok && (missing & RENDER_FORMAT_BIT(i))) {
+                ok = archive_writer_add(archive, names[i], keys[i], texts[i]);
+                if (!ok) log_message(LOG_ERROR, "Failed to write to archive");
+            }
+            output_builder_clear(texts[i]);
+        }
+        compile_stats_phase_end(stats, PHASE_FORMAT);
+    }
+
+    for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+        free(names[i]);
+    }
+    free(output_file);
+    return ok;
+}
+
+/* compile_file for archive runs; returns 0 on success, 1 on failure */
+static int compile_to_archive(Compiler* compiler, ArchiveWriter* archive, const char* input_file,
+                              const CompileOptions* options, OutputBuilder** texts) {
+    CompileStats stats;
+    compile_stats_begin(&stats);
+    if (options->verbose) {
+        log_message(LOG_INFO, "Starting compilation of %s", input_file);
+    }
+
+    compile_stats_phase_begin(&stats, PHASE_READ);
+    SourceFile* source = source_file_open(input_file);
+    compile_stats_phase_end(&stats, PHASE_READ);
+
+    int ok = 0;
+    if (!source) {
+        log_message(LOG_ERROR, "Failed to read input file: %s", input_file);
+    } else {
+        ok = translate_to_archive(compiler, archive, source->data, source->length, input_file, options,
+                                  texts, &stats);
+        source_file_close(source);
+    }
+
+    compile_stats_end(&stats);
+    if (options->stats) {
+        compile_stats_report(&stats, input_file);
+    }
+    if (options->trace) {
+        trace_log_add_compile(options->trace, &stats, input_file);
+    }
+    return ok ? 0 : 1;
+}
+
+static void batch_worker_run(void* arg) {
+    BatchWorker* worker = (BatchWorker*)arg;
+    BatchRun* run = worker->run;
+    Compiler* compiler = compiler_create();
+    OutputBuilder* log = output_builder_create();
+    RenderFormat first_format = render_first_format(compile_formats(run->options));
+    OutputBuilder* texts[RENDER_FORMAT_COUNT];
+    for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+        texts[i] = run->archive ? output_builder_create() : NULL;
+    }
+
+    /* Hold this thread's diagnostics until its current file is done */
+    diagnostics_capture(capture_diagnostic, log);
+
+    for (;;) {
+        int index = take_own(&run->ranges[worker->id]);
+        if (index < 0) index = steal(run, worker->id);
+        if (index < 0) break;
+
+        const char* input_file = run->inputs->paths[index];
+        char* output_file = default_output_filename(input_file, first_format);
+
+        int result = run->archive
+            ? compile_to_archive(compiler, run->archive, input_file, run->options, texts)
+            : compile_file(compiler, input_file, output_file, run->options);
+        if (result == 0) {
+            log_message(LOG_INFO, "Compiled %s %s %s", input_file, run->archive ? "into" : "to",
+                        run->archive ? run->archive->path : output_file);
+        } else {
+            log_message(LOG_ERROR, "Failed to compile %s", input_file);
+            worker->failures++;
+        }
+        free(output_file);
+
+        mutex_lock(&run->stderr_lock);
+        output_builder_write(log, stderr);
+        fflush(stderr);
+        mutex_unlock(&run->stderr_lock);
+        output_builder_clear(log);
+    }
+
+    diagnostics_capture(NULL, NULL);
+    for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+        output_builder_destroy(texts[i]);
+    }
+    output_builder_destroy(log);
+    compiler_destroy(compiler);
+}
+
+/*
+ * Pipelined runs. Each input becomes a FileJob that passes from the reader,
+ * through a translating worker, to the writer, carrying its diagnostics
+ * with it so they still come out as one block.
+ */
+
+typedef struct {
+    const char* input_file;
+    SourceFile* source;         /* NULL if it could not be read */
+    OutputBuilder* texts[RENDER_FORMAT_COUNT];  /* Translation in each format, once translated */
+    OutputBuilder* log;         /* Diagnostics so far */
+    CompileStats stats;
+    int translated;
+} FileJob;
+
+/* Bounded queue of jobs; a full queue blocks the stage that fills it */
+typedef struct {
+    FileJob** items;
+    int capacity;
+    int head;
+    int count;
+    int closed;                 /* Nothing more will be pushed */
+    Mutex lock;
+    Condition not_empty;
+    Condition not_full;
+} JobQueue;
+
+static void job_queue_init(JobQueue* queue, int capacity) {
+    queue->items = (FileJob**)safe_malloc(sizeof(FileJob*) * capacity);
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
+    queue->closed = 0;
+    mutex_init(&queue->lock);
+    condition_init(&queue->not_empty);
+    condition_init(&queue->not_full);
+}
+
+static void job_queue_destroy(JobQueue* queue) {
+    condition_destroy(&queue->not_full);
+    condition_destroy(&queue->not_empty);
+    mutex_destroy(&queue->lock);
+    free(queue->items);
+}
+
+static void job_queue_push(JobQueue* queue, FileJob* job) {
+    mutex_lock(&queue->lock);
+    while (queue->count == queue->capacity) {
+        condition_wait(&queue->not_full, &queue->lock);
+    }
+    queue->items[(queue->head + queue->count++) % queue->capacity] = job;
+    condition_signal(&queue->not_empty);
+    mutex_unlock(&queue->lock);
+}
+
+/* The next job, or NULL once the queue is closed and empty */
+static FileJob* job_queue_pop(JobQueue* queue) {
+    mutex_lock(&queue->lock);
+    while (queue->count == 0 && !queue->closed) {
+        condition_wait(&queue->not_empty, &queue->lock);
+    }
+    FileJob* job = NULL;
+    if (queue->count > 0) {
+        job = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+        condition_signal(&queue->not_full);
+    }
+    mutex_unlock(&queue->lock);
+    return job;
+}
+
+static void job_queue_close(JobQueue* queue) {
+    mutex_lock(&queue->lock);
+    queue->closed = 1;
+    condition_broadcast(&queue->not_empty);
+    mutex_unlock(&queue->lock);
+}
+
+typedef struct {
+    const InputList* inputs;
+    const CompileOptions* options;
+    ArchiveWriter* archive;
+    JobQueue read;              /* Read, waiting to be translated */
+    JobQueue written;           /* Translated (or failed), waiting to be written */
+} Pipeline;
+
+/* Reader stage: fetch every source into memory, in input order */
+static void pipeline_reader_run(void* arg) {
+    Pipeline* pipeline = (Pipeline*)arg;
+
+    for (int i = 0; i < pipeline->inputs->count; i++) {
+        FileJob* job = (FileJob*)safe_malloc(sizeof(FileJob));
+        job->input_file = pipeline->inputs->paths[i];
+        for (int j = 0; j < RENDER_FORMAT_COUNT; j++) {
+            job->texts[j] = output_builder_create();
+        }
+        job->log = output_builder_create();
+        job->translated = 0;
+        compile_stats_begin(&job->stats);
+
+        diagnostics_capture(capture_diagnostic, job->log);
+        if (pipeline->options->verbose) {
+            log_message(LOG_INFO, "Starting compilation of %s", job->input_file);
+        }
+        compile_stats_phase_begin(&job->stats, PHASE_READ);
+        job->source = source_file_read(job->input_file);
+        compile_stats_phase_end(&job->stats, PHASE_READ);
+        if (!job->source) {
+            log_message(LOG_ERROR, "Failed to read input file: %s", job->input_file);
+        }
+        diagnostics_capture(NULL, NULL);
+
+        /* Unreadable files go straight to the writer to be reported */
+        job_queue_push(job->source ? &pipeline->read : &pipeline->written, job);
+    }
+
+    job_queue_close(&pipeline->read);
+}
+
+/* Translating stage */
+static void pipeline_worker_run(void* arg) {
+    Pipeline* pipeline = (Pipeline*)arg;
+    Compiler* compiler = compiler_create();
+
+    FileJob* job;
+    while ((job = job_queue_pop(&pipeline->read)) != NULL) {
+        diagnostics_capture(capture_diagnostic, job->log);
+        if (pipeline->archive) {
+            job->translated = translate_to_archive(compiler, pipeline->archive, job->source->data,
+                                                   job->source->length, job->input_file, pipeline->options,
+                                                   job->texts, &job->stats);
+        } else {
+            job->translated = compile_to_text(compiler, job->source->data, job->source->length,
+                                              job->input_file, pipeline->options, job->texts,
+                                              &job->stats) == 0;
+        }
+        diagnostics_capture(NULL, NULL);
+
+        source_file_close(job->source);
+        job->source = NULL;
+        job_queue_push(&pipeline->written, job);
+    }
+
+    compiler_destroy(compiler);
+}
+
+/* Writer stage, on the calling thread: write each result and report it; returns the failures */
+static int pipeline_write_all(Pipeline* pipeline) {
+    const CompileOptions* options = pipeline->options;
+    int failures = 0;
+
+    for (int done = 0; done < pipeline->inputs->count; done++) {
+        FileJob* job = job_queue_pop(&pipeline->written);
+        int formats = compile_formats(options);
+        char* output_file = default_output_filename(job->input_file, render_first_format(formats));
+
+        diagnostics_capture(capture_diagnostic, job->log);
+        int ok = job->translated;
+        if (ok && !pipeline->archive) {
+            compile_stats_phase_begin(&job->stats, PHASE_FORMAT);
+            for (int i = 0; i < RENDER_FORMAT_COUNT && ok; i++) {
+                if (!(formats & RENDER_FORMAT_BIT(i))) continue;
+                char* format_file = compile_output_filename(output_file, (RenderFormat)i, options);
+                ok = output_builder_write_file(job->texts[i], format_file);
+                free(format_file);
+            }
+            compile_stats_phase_end(&job->stats, PHASE_FORMAT);
+            if (!ok) {
+                log_message(LOG_ERROR, "Failed to write output file");
+            } else if (options->verbose) {
+                log_message(LOG_INFO, "Compilation completed successfully!");
+            }
+        }
+        compile_stats_end(&job->stats);
+        if (options->stats) {
+            compile_stats_report(&job->stats, job->input_file);
+        }
+        if (options->trace) {
+            trace_log_add_compile(options->trace, &job->stats, job->input_file);
+        }
+
+        if (ok) {
+            log_message(LOG_INFO, "Compiled %s %s %s", job->input_file, pipeline->archive ? "into" : "to",
+                        pipeline->archive ? pipeline->archive->path : output_file);
+        } else {
+            log_message(LOG_ERROR, "Failed to compile %s", job->input_file);
+            failures++;
+        }
+        diagnostics_capture(NULL, NULL);
+
+        output_builder_write(job->log, stderr);
+        fflush(stderr);
+
+        free(output_file);
+        output_builder_destroy(job->log);
+        for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+            output_builder_destroy(job->texts[i]);
+        }
+        free(job);
+    }
+
+    return failures;
+}
+
+/* Returns the failure count, or -1 if the stage threads could not be started and nothing ran */
+static int run_pipeline(const InputList* inputs, int jobs, int read_ahead, int write_behind,
+                        ArchiveWriter* archive, const CompileOptions* options) {
+    Pipeline pipeline;
+    pipeline.inputs = inputs;
+    pipeline.options = options;
+    pipeline.archive = archive;
+    job_queue_init(&pipeline.read, read_ahead);
+    job_queue_init(&pipeline.written, write_behind);
+
+    Thread* threads = (Thread*)safe_malloc(sizeof(Thread) * jobs);
+    int* started = (int*)safe_malloc(sizeof(int) * jobs);
+    int running = 0;
+    for (int i = 0; i < jobs; i++) {
+        started[i] = thread_create(&threads[i], pipeline_worker_run, &pipeline);
+        if (started[i]) {
+            running++;
+        } else {
+            log_message(LOG_WARNING, "Could not start worker thread %d", i);
+        }
+    }
+
+    Thread reader;
+    int reader_started = running > 0 && thread_create(&reader, pipeline_reader_run, &pipeline);
+
+    int failures = -1;
+    if (reader_started) {
+        failures = pipeline_write_all(&pipeline);
+        thread_join(reader);
+    } else {
+        /* Nothing was read, so any workers that did start just stop */
+        job_queue_close(&pipeline.read);
+    }
+
+    for (int i = 0; i < jobs; i++) {
+        if (started[i]) {
+            thread_join(threads[i]);
+        }
+    }
+    free(started);
+    free(threads);
+    job_queue_destroy(&pipeline.written);
+    job_queue_destroy(&pipeline.read);
+    return failures;
+}
+
+int run_batch(const InputList* inputs, const BatchOptions* batch, const CompileOptions* options) {
+    if (inputs->count == 0) return 0;
+
+    int jobs = batch->jobs;
+    if (jobs <= 0) jobs = thread_cpu_count();
+    if (jobs > inputs->count) jobs = inputs->count;
+
+    /* Streaming writes as it translates, so it has nothing to hand a writer */
+    if ((batch->read_ahead > 0 || batch->write_behind > 0) && !options->stream) {
+        int read_ahead = batch->read_ahead > 0 ? batch->read_ahead : batch->write_behind;
+        int write_behind = batch->write_behind > 0 ? batch->write_behind : batch->read_ahead;
+        int failures = run_pipeline(inputs, jobs, read_ahead, write_behind, batch->archive, options);
+        if (failures >= 0) return failures;
+        log_message(LOG_WARNING, "Could not start the batch pipeline; translating in place");
+    }
+
+    BatchRun run;
+    run.inputs = inputs;
+    run.options = options;
+    run.archive = batch->archive;
+    run.worker_count = jobs;
+    run.ranges = (WorkRange*)safe_malloc(sizeof(WorkRange) * jobs);
+    mutex_init(&run.stderr_lock);
+
+    BatchWorker* workers = (BatchWorker*)safe_malloc(sizeof(BatchWorker) * jobs);
+    for (int i = 0; i < jobs; i++) {
+        run.ranges[i].top = (int)((long long)inputs->count * i / jobs);
+        run.ranges[i].bottom = (int)((long long)inputs->count * (i + 1) / jobs);
+        mutex_init(&run.ranges[i].lock);
+        workers[i].run = &run;
+        workers[i].id = i;
+        workers[i].failures = 0;
+    }
+
+    /* Worker 0 runs on the calling thread */
+    Thread* threads = (Thread*)safe_malloc(sizeof(Thread) * jobs);
+    int* started = (int*)safe_malloc(sizeof(int) * jobs);
+    for (int i = 1; i < jobs; i++) {
+        started[i] = thread_create(&threads[i], batch_worker_run, &workers[i]);
+        if (!started[i]) {
+            log_message(LOG_WARNING, "Could not start worker thread %d", i);
+        }
+    }
+
+    batch_worker_run(&workers[0]);
+
+    int failures = workers[0].failures;
+    for (int i = 1; i < jobs; i++) {
+        if (started[i]) {
+            thread_join(threads[i]);
+        }
+        failures += workers[i].failures;
+    }
+
+    for (int i = 0; i < jobs; i++) {
+        mutex_destroy(&run.ranges[i].lock);
+    }
+    mutex_destroy(&run.stderr_lock);
+    free(started);
+    free(threads);
+    free(workers);
+    free(run.ranges);
+
+    return failures;
+}
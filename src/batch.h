@@ -0,0 +1,52 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "utils.h"
+#include "compiler.h"
+#include "archive.h"
+
+/* Input files for a batch run */
+typedef struct {
+    char** paths;
+    int count;
+    int capacity;
+    int expanded;       /* Set once a directory or response file was added */
+} InputList;
+
+/* Input list creation and destruction */
+InputList* input_list_create(void);
+void input_list_destroy(InputList* inputs);
+
+/*
+ * Add a command line input: a source file, a directory (searched recursively
+ * for .c files) or "@file", a response file listing one input per line.
+ * Returns 0 and logs an error if a directory or response file is unreadable.
+ */
+int input_list_add(InputList* inputs, const char* arg);
+
+/* How a batch run is spread over threads */
+typedef struct {
+    int jobs;           /* Translating threads (0 = one per CPU) */
+    int read_ahead;     /* Sources read ahead of translation */
+    int write_behind;   /* Translations waiting to be written */
+    /* With both 0 there is no pipeline; with one 0 it takes the other's value */
+    ArchiveWriter* archive;     /* Put every output in this archive instead of a file, or NULL */
+} BatchOptions;
+
+/*
+ * Translate every input, each writing next to its input using
+ * default_output_filename(). Per-file diagnostics and status are written to
+ * stderr as one block per file. Without queue bounds each of the jobs threads
+ * reads, translates and writes its files in turn. With it the run is a
+ * pipeline: a reader thread fills a queue of at most read_ahead sources,
+ * the jobs threads translate from it into a queue of at most write_behind
+ * results, and the calling thread writes them out, so slow storage and
+ * translation overlap and a full queue holds back the stage feeding it.
+ * With an archive, each output goes into it under the name its file would
+ * have, added by the translating threads as they finish, and outputs the
+ * archive's last run stored for the same source and options are carried
+ * over without translating again. Returns the failure count.
+ */
+int run_batch(const InputList* inputs, const BatchOptions* batch, const CompileOptions* options);
+
+#endif /* BATCH_H */
@@ -0,0 +1,309 @@
+#include <setjmp.h>
+
+#include "c2en.h"
+#include "compiler.h"
+#include "cache.h"
+#include "revision.h"
+#include "archive.h"
+
+/* Stores between trims of the context's cache directory */
+#define C2EN_TRIM_INTERVAL 64
+
+struct c2en_context {
+    Compiler* compiler;
+    TranslationCache* cache;
+    Revision* revision;         /* The last translation, with options.incremental */
+    int stores_since_trim;
+    char* filename;
+    int memoise;
+    char* diagnostics;          /* Messages from the last translation (NUL-terminated) */
+    size_t diagnostic_length;
+    size_t diagnostic_capacity;
+    jmp_buf unwind;             /* Where an allocation failure returns to */
+};
+
+/* Allocation failures jump back to the entry point that set up the buffer */
+static void unwind_to_entry(void* context) {
+    longjmp(*(jmp_buf*)context, 1);
+}
+
+static void discard_diagnostic(void* context, const char* text, size_t length) {
+    (void)context;
+    (void)text;
+    (void)length;
+}
+
+/*
+ * Keep a diagnostic for c2en_context_diagnostics. Plain realloc, so running
+ * out of memory here loses the message instead of unwinding again.
+ */
+static void collect_diagnostic(void* context, const char* text, size_t length) {
+    c2en_context* ctx = (c2en_context*)context;
+    size_t needed = ctx->diagnostic_length + length + 1;
+
+    if (needed > ctx->diagnostic_capacity) {
+        size_t capacity = ctx->diagnostic_capacity * 2;
+        if (capacity < needed) capacity = needed;
+        char* grown = (char*)realloc(ctx->diagnostics, capacity);
+        if (!grown) return;
+        ctx->diagnostics = grown;
+        ctx->diagnostic_capacity = capacity;
+    }
+
+    memcpy(ctx->diagnostics + ctx->diagnostic_length, text, length);
+    ctx->diagnostic_length += length;
+    ctx->diagnostics[ctx->diagnostic_length] = '\0';
+}
+
+/* Options */
+
+void c2en_options_init(c2en_options* options) {
+    options->filename = "<input>";
+    options->memoise = 0;
+    options->cache_dir = NULL;
+    options->cache_max_bytes = 0;
+    options->incremental = 0;
+}
+
+/* Context creation and destruction */
+
+static c2en_context* context_create(const c2en_options* options) {
+    c2en_context* context = (c2en_context*)safe_malloc(sizeof(c2en_context));
+    context->compiler = compiler_create();
+    context->cache = NULL;
+    context->revision = options->incremental ? revision_create() : NULL;
+    context->stores_since_trim = 0;
+    context->filename = string_duplicate(options->filename ? options->filename : "<input>");
+    context->memoise = options->memoise;
+    context->diagnostics = NULL;
+    context->diagnostic_length = 0;
+    context->diagnostic_capacity = 0;
+
+    if (options->cache_dir) {
+        size_t max_bytes = options->cache_max_bytes;
+        if (max_bytes == 0) max_bytes = (size_t)CACHE_DEFAULT_SIZE_MB * 1024 * 1024;
+        context->cache = translation_cache_create(options->cache_dir, max_bytes);
+        if (!context->cache) {
+            c2en_context_destroy(context);
+            return NULL;
+        }
+    }
+    return context;
+}
+
+c2en_context* c2en_context_create(const c2en_options* options) {
+    c2en_options defaults;
+    c2en_options_init(&defaults);
+    const c2en_options* volatile chosen = options ? options : &defaults;
+
+    /* Whatever was allocated before a failure is lost; nothing is printed */
+    jmp_buf unwind;
+    c2en_context* volatile context = NULL;
+    diagnostics_capture(discard_diagnostic, NULL);
+    memory_failure_capture(unwind_to_entry, &unwind);
+    if (setjmp(unwind) == 0) {
+        context = context_create(chosen);
+    } else {
+        context = NULL;
+    }
+    memory_failure_capture(NULL, NULL);
+    diagnostics_capture(NULL, NULL);
+    return context;
+}
+
+void c2en_context_destroy(c2en_context* context) {
+    if (!context) return;
+
+    if (context->cache) {
+        translation_cache_trim(context->cache);
+        translation_cache_destroy(context->cache);
+    }
+    revision_destroy(context->revision);
+    compiler_destroy(context->compiler);
+    free(context->filename);
+    free(context->diagnostics);
+    free(context);
+}
+
+/* Translation */
+
+static c2en_status translate(c2en_context* context, const char* source, size_t length,
+                             const c2en_writer* out) {
+    CompileOptions options;
+    memset(&options, 0, sizeof(options));
+    options.function_jobs = 1;
+    options.memoise = context->memoise;
+
+    CompileStats stats;
+    compile_stats_begin(&stats);
+
+    CacheKey key = { 0, 0 };
+    if (context->cache) {
+        key = translation_cache_key(source, length, compile_cache_variant(&options, RENDER_TEXT));
+        size_t cached_length = 0;
+        FILE* entry = translation_cache_lookup(context->cache, key, &cached_length);
+        if (entry) {
+            return translation_cache_copy(entry, out->write, out->user_data) ? C2EN_OK : C2EN_ERROR_WRITE;
+        }
+    }
+
+    /* A revision that cannot be translated incrementally is translated afresh, which reports its errors */
+    if (context->revision && revision_translate(context->revision, context->compiler, source, length,
+                                                context->filename, &options, &stats)) {
+        if (!output_builder_emit(context->compiler->formatted[RENDER_TEXT], out->write, out->user_data)) {
+            return C2EN_ERROR_WRITE;
+        }
+    } else {
+        switch (compiler_translate(context->compiler, source, length, context->filename, &options, &stats)) {
+            case COMPILE_OK:
+                break;
+            case COMPILE_LEXICAL_ERROR:
+                return C2EN_ERROR_LEXICAL;
+            case COMPILE_SYNTAX_ERROR:
+                return C2EN_ERROR_SYNTAX;
+            case COMPILE_SEMANTIC_ERROR:
+                return C2EN_ERROR_SEMANTIC;
+        }
+
+        if (!compiler_emit(context->compiler, RENDER_TEXT, out->write, out->user_data, context->cache != NULL,
+                           &options, &stats)) {
+            return C2EN_ERROR_WRITE;
+        }
+    }
+
+    if (context->cache) {
+        translation_cache_store(context->cache, key, context->compiler->formatted[RENDER_TEXT]);
+        if (++context->stores_since_trim >= C2EN_TRIM_INTERVAL) {
+            translation_cache_trim(context->cache);
+            context->stores_since_trim = 0;
+        }
+    }
+    return C2EN_OK;
+}
+
+c2en_status c2en_translate_buffer(c2en_context* context, const char* source, size_t length,
+                                  const c2en_writer* out) {
+    if (!context || (!source && length > 0) || !out || !out->write) {
+        return C2EN_ERROR_INVALID_ARGUMENT;
+    }
+
+    /*
+     * Text ends at the first NUL, as it does for source files. The arguments
+     * are settled in locals before setjmp, which could clobber a parameter
+     * assigned here.
+     */
+    const char* volatile text = source ? source : "";
+    const char* nul = (const char*)memchr(text, '\0', length);
+    volatile size_t text_length = nul ? (size_t)(nul - text) : length;
+
+    context->diagnostic_length = 0;
+    if (context->diagnostics) context->diagnostics[0] = '\0';
+
+    volatile c2en_status status = C2EN_ERROR_OUT_OF_MEMORY;
+    diagnostics_capture(collect_diagnostic, context);
+    memory_failure_capture(unwind_to_entry, &context->unwind);
+    if (setjmp(context->unwind) == 0) {
+        status = translate(context, text, text_length, out);
+    } else {
+        /* The next translation resets everything else */
+        output_builder_set_writer(context->compiler->formatted[RENDER_TEXT], NULL, NULL);
+        status = C2EN_ERROR_OUT_OF_MEMORY;
+    }
+    memory_failure_capture(NULL, NULL);
+    diagnostics_capture(NULL, NULL);
+    return status;
+}
+
+const char* c2en_context_diagnostics(const c2en_context* context) {
+    return context && context->diagnostics ? context->diagnostics : "";
+}
+
+/* Archives */
+
+struct c2en_archive {
+    OutputArchive* archive;
+};
+
+c2en_archive* c2en_archive_open(const char* path) {
+    if (!path) return NULL;
+
+    jmp_buf unwind;
+    c2en_archive* volatile archive = NULL;
+    diagnostics_capture(discard_diagnostic, NULL);
+    memory_failure_capture(unwind_to_entry, &unwind);
+    if (setjmp(unwind) == 0) {
+        OutputArchive* opened = output_archive_open(path);
+        if (opened) {
+            archive = (c2en_archive*)safe_malloc(sizeof(c2en_archive));
+            archive->archive = opened;
+        }
+    } else {
+        archive = NULL;
+    }
+    memory_failure_capture(NULL, NULL);
+    diagnostics_capture(NULL, NULL);
+    return archive;
+}
+
+void c2en_archive_close(c2en_archive* archive) {
+    if (!archive) return;
+
+    output_archive_close(archive->archive);
+    free(archive);
+}
+
+/* Look up and decompress an entry into text, which belongs to this call alone */
+static c2en_status fetch(const c2en_archive* archive, const char* name, OutputBuilder* text,
+                         const c2en_writer* out) {
+    ArchiveEntry entry;
+    if (!output_archive_find(archive->archive, name, &entry)) {
+        return C2EN_ERROR_NOT_FOUND;
+    }
+    if (!output_archive_read(archive->archive, &entry, text)) {
+        return C2EN_ERROR_DAMAGED;
+    }
+    return output_builder_emit(text, out->write, out->user_data) ? C2EN_OK : C2EN_ERROR_WRITE;
+}
+
+c2en_status c2en_archive_fetch(const c2en_archive* archive, const char* name, const c2en_writer* out) {
+    if (!archive || !name || !out || !out->write) {
+        return C2EN_ERROR_INVALID_ARGUMENT;
+    }
+
+    jmp_buf unwind;
+    OutputBuilder* volatile text = NULL;
+    volatile c2en_status status = C2EN_ERROR_OUT_OF_MEMORY;
+    diagnostics_capture(discard_diagnostic, NULL);
+    memory_failure_capture(unwind_to_entry, &unwind);
+    if (setjmp(unwind) == 0) {
+        text = output_builder_create();
+        status = fetch(archive, name, text, out);
+    } else {
+        status = C2EN_ERROR_OUT_OF_MEMORY;
+    }
+    memory_failure_capture(NULL, NULL);
+    diagnostics_capture(NULL, NULL);
+    output_builder_destroy(text);
+    return status;
+}
+
+/* Descriptions and version */
+
+const char* c2en_status_string(c2en_status status) {
+    switch (status) {
+        case C2EN_OK:                       return "Success";
+        case C2EN_ERROR_INVALID_ARGUMENT:   return "Invalid argument";
+        case C2EN_ERROR_LEXICAL:            return "Lexical analysis failed";
+        case C2EN_ERROR_SYNTAX:             return "Syntax analysis failed";
+        case C2EN_ERROR_SEMANTIC:           return "Semantic analysis failed";
+        case C2EN_ERROR_WRITE:              return "Output could not be written";
+        case C2EN_ERROR_OUT_OF_MEMORY:      return "Out of memory";
+        case C2EN_ERROR_NOT_FOUND:          return "No such archive entry";
+        case C2EN_ERROR_DAMAGED:            return "Archive entry is damaged";
+    }
+    return "Unknown status";
+}
+
+const char* c2en_version(void) {
+    return C2EN_VERSION_STRING;
+}
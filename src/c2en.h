@@ -0,0 +1,104 @@
+#ifndef C2EN_H
+#define C2EN_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * libc2en - the C to British English translator as a library.
+ *
+ * A context owns everything one translation needs (arena, interner, output
+ * buffers and an optional translation cache) and keeps it between calls, so
+ * a long-running service reuses warm memory instead of starting afresh for
+ * each request. A context must only be used by one thread at a time;
+ * separate contexts may be used concurrently. Failures, running out of
+ * memory included, are returned as a status and never end the process.
+ * The translation cache is best effort: when memory runs out in its file
+ * operations it misses, or skips a store or trim, so no file is left
+ * open, and a temporary file left by a store cut short (say, by the
+ * process being killed) is deleted by a later trim once stale.
+ */
+typedef struct c2en_context c2en_context;
+
+typedef enum {
+    C2EN_OK = 0,
+    C2EN_ERROR_INVALID_ARGUMENT,
+    C2EN_ERROR_LEXICAL,
+    C2EN_ERROR_SYNTAX,
+    C2EN_ERROR_SEMANTIC,
+    C2EN_ERROR_WRITE,           /* The writer refused some output */
+    C2EN_ERROR_OUT_OF_MEMORY,
+    C2EN_ERROR_NOT_FOUND,       /* The archive has no entry of that name */
+    C2EN_ERROR_DAMAGED          /* The archive entry fails its checks */
+} c2en_status;
+
+/*
+ * Receives the translation in pieces, in order. Return nonzero to accept the
+ * bytes, or 0 to fail the translation with C2EN_ERROR_WRITE.
+ */
+typedef int (*c2en_write_fn)(void* user_data, const char* text, size_t length);
+
+typedef struct {
+    c2en_write_fn write;
+    void* user_data;
+} c2en_writer;
+
+typedef struct {
+    const char* filename;       /* Name used in diagnostics (default "<input>") */
+    int memoise;                /* Describe functions that differ only in name once */
+    const char* cache_dir;      /* Translation cache directory, or NULL for none */
+    size_t cache_max_bytes;     /* Cache size cap; 0 for the default */
+    int incremental;            /* Keep each translation to redo only the functions the next one changes */
+} c2en_options;
+
+/* Fill options with the defaults */
+void c2en_options_init(c2en_options* options);
+
+/*
+ * Context creation (NULL options for the defaults) and destruction. Returns
+ * NULL if memory runs out or the cache directory cannot be created.
+ */
+c2en_context* c2en_context_create(const c2en_options* options);
+void c2en_context_destroy(c2en_context* context);
+
+/*
+ * Translate length bytes of C source, passing the formatted text to out.
+ * Text after an embedded NUL is ignored. Nothing is written unless the
+ * source translates without errors. With options.incremental, each source
+ * is taken as the next revision of the last one translated: only the
+ * functions whose bytes changed are parsed, checked and described again,
+ * and the output is the same as translating the source afresh.
+ */
+c2en_status c2en_translate_buffer(c2en_context* context, const char* source, size_t length,
+                                  const c2en_writer* out);
+
+/* Diagnostics from the context's last translation, "" if there were none */
+const char* c2en_context_diagnostics(const c2en_context* context);
+
+/*
+ * An output archive written by a batch run (c2en --archive), opened for
+ * reading. Entries are named by the output file each would otherwise have
+ * been written to, such as "src/main.txt". An archive may be read from
+ * several threads at once. Returns NULL if path cannot be read, is not an
+ * archive or memory runs out.
+ */
+typedef struct c2en_archive c2en_archive;
+
+c2en_archive* c2en_archive_open(const char* path);
+void c2en_archive_close(c2en_archive* archive);
+
+/* Pass the text of the entry called name to out */
+c2en_status c2en_archive_fetch(const c2en_archive* archive, const char* name, const c2en_writer* out);
+
+/* Descriptions and version */
+const char* c2en_status_string(c2en_status status);
+const char* c2en_version(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* C2EN_H */
@@ -0,0 +1,297 @@
+#ifdef _WIN32
+#include <sys/utime.h>
+#else
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <utime.h>
+#endif
+#include <sys/stat.h>
+#include <time.h>
+
+#include "cache.h"
+
+/* Bump when the entry layout or the translation itself changes */
+#define CACHE_FORMAT_VERSION "1"
+
+#define CACHE_MAGIC "C2ENCACH"
+#define CACHE_HEADER_SIZE 32
+#define CACHE_EXTENSION ".c2en"
+#define CACHE_COPY_CHUNK (64 * 1024)
+#define CACHE_TEMP_MARK ".tmp."
+
+/* Age after which a temporary file no store is still writing is removed */
+#define CACHE_STALE_SECONDS (60 * 60)
+
+/* Cache creation and destruction */
+
+TranslationCache* translation_cache_create(const char* directory, size_t max_bytes) {
+    if (!make_directory(directory)) {
+        log_message(LOG_ERROR, "Cannot create cache directory: %s", directory);
+        return NULL;
+    }
+
+    TranslationCache* cache = (TranslationCache*)safe_malloc(sizeof(TranslationCache));
+    cache->directory = string_duplicate(directory);
+    cache->max_bytes = max_bytes;
+    cache->temp_sequence = 0;
+    mutex_init(&cache->lock);
+    return cache;
+}
+
+void translation_cache_destroy(TranslationCache* cache) {
+    if (!cache) return;
+
+    mutex_destroy(&cache->lock);
+    free(cache->directory);
+    free(cache);
+}
+
+/* Keys and entry names */
+
+CacheKey translation_cache_key(const char* data, size_t length, const char* variant) {
+    static const char prefix[] = "c2en " C2EN_VERSION_STRING " cache " CACHE_FORMAT_VERSION;
+
+    uint64_t hash = FNV1A_64_BASIS;
+    hash = fnv1a_64(hash, prefix, sizeof(prefix));
+    hash = fnv1a_64(hash, variant, strlen(variant) + 1);
+    hash = fnv1a_64(hash, data, length);
+
+    CacheKey key;
+    key.hash = hash;
+    key.input_length = (uint64_t)length;
+    return key;
+}
+
+/*
+ * The cache allocates with plain malloc, so running out of memory makes
+ * it miss or skip work instead of unwinding past an open file or a store
+ * half done; entry_path returns NULL then.
+ */
+static char* entry_path(const TranslationCache* cache, CacheKey key, const char* suffix) {
+    size_t length = strlen(cache->directory) + strlen(suffix) + 40;
+    char* path = (char*)malloc(length);
+    if (!path) return NULL;
+    snprintf(path, length, "%s/%016llx%s", cache->directory,
+             (unsigned long long)key.hash, suffix);
+    return path;
+}
+
+/* Lookup */
+
+FILE* translation_cache_lookup(TranslationCache* cache, CacheKey key, size_t* length) {
+    char* path = entry_path(cache, key, CACHE_EXTENSION);
+    if (!path) return NULL;
+    FILE* entry = fopen(path, "rb");
+    if (!entry) {
+        free(path);
+        return NULL;
+    }
+
+    /* The entry must be for this key and complete */
+    unsigned char header[CACHE_HEADER_SIZE];
+    struct stat info;
+    int valid = fread(header, 1, sizeof(header), entry) == sizeof(header) &&
+                memcmp(header, CACHE_MAGIC, 8) == 0 &&
+                get_le64(header + 8) == key.hash &&
+                get_le64(header + 16) == key.input_length &&
+                stat(path, &info) == 0 &&
+                (uint64_t)info.st_size == CACHE_HEADER_SIZE + get_le64(header + 24);
+
+    if (!valid) {
+        fclose(entry);
+        free(path);
+        return NULL;
+    }
+
+    /* Mark the entry recently used */
+    utime(path, NULL);
+    free(path);
+    *length = (size_t)get_le64(header + 24);
+    return entry;
+}
+
+int translation_cache_copy(FILE* entry, OutputWriter writer, void* context) {
+    char buffer[CACHE_COPY_CHUNK];
+    int ok = 1;
+
+    size_t read_size;
+    while ((read_size = fread(buffer, 1, sizeof(buffer), entry)) > 0) {
+        if (!writer(context, buffer, read_size)) {
+            ok = 0;
+            break;
+        }
+    }
+
+    if (ferror(entry)) ok = 0;
+    fclose(entry);
+    return ok;
+}
+
+/* Storing */
+
+void translation_cache_store(TranslationCache* cache, CacheKey key, const OutputBuilder* text) {
+    /* Write under a unique temporary name, then rename into place */
+    mutex_lock(&cache->lock);
+    unsigned int sequence = cache->temp_sequence++;
+    mutex_unlock(&cache->lock);
+
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), CACHE_TEMP_MARK "%ld.%u", current_process_id(), sequence);
+    char* temp_path = entry_path(cache, key, suffix);
+    char* path = entry_path(cache, key, CACHE_EXTENSION);
+
+    FILE* entry = temp_path && path ? fopen(temp_path, "wb") : NULL;
+    if (!entry) {
+        free(temp_path);
+        free(path);
+        return;
+    }
+
+    unsigned char header[CACHE_HEADER_SIZE];
+    memcpy(header, CACHE_MAGIC, 8);
+    put_le64(header + 8, key.hash);
+    put_le64(header + 16, key.input_length);
+    put_le64(header + 24, (uint64_t)text->length);
+
+    int ok = fwrite(header, 1, sizeof(header), entry) == sizeof(header) &&
+             output_builder_write(text, entry);
+    ok = fclose(entry) == 0 && ok;
+
+    if (ok) {
+#ifdef _WIN32
+        remove(path);
+#endif
+        ok = rename(temp_path, path) == 0;
+    }
+    if (!ok) {
+        remove(temp_path);
+    }
+
+    free(temp_path);
+    free(path);
+}
+
+/* Eviction */
+
+typedef struct {
+    char* path;
+    size_t size;
+    time_t used;
+    int temporary;      /* A store's temporary file, not an entry */
+} CacheFile;
+
+static int compare_by_use(const void* a, const void* b) {
+    const CacheFile* left = (const CacheFile*)a;
+    const CacheFile* right = (const CacheFile*)b;
+    if (left->used != right->used) return left->used < right->used ? -1 : 1;
+    return strcmp(left->path, right->path);
+}
+
+static int is_entry_name(const char* name) {
+    size_t length = strlen(name);
+    size_t extension = strlen(CACHE_EXTENSION);
+    return length > extension && strcmp(name + length - extension, CACHE_EXTENSION) == 0;
+}
+
+/*
+ * Append an entry or temporary file with its size and last use; returns 0
+ * when memory runs out, which ends the listing early.
+ */
+static int add_cache_file(CacheFile** files, int* count, int* capacity,
+                          const char* directory, const char* name) {
+    int temporary = strstr(name, CACHE_TEMP_MARK) != NULL;
+    if (!temporary && !is_entry_name(name)) return 1;
+
+    size_t length = strlen(directory) + strlen(name) + 2;
+    char* path = (char*)malloc(length);
+    if (!path) return 0;
+    snprintf(path, length, "%s/%s", directory, name);
+
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        free(path);
+        return 1;
+    }
+
+    if (*count >= *capacity) {
+        int grown_capacity = *capacity ? *capacity * 2 : 64;
+        CacheFile* grown = (CacheFile*)realloc(*files, sizeof(CacheFile) * (size_t)grown_capacity);
+        if (!grown) {
+            free(path);
+            return 0;
+        }
+        *files = grown;
+        *capacity = grown_capacity;
+    }
+    CacheFile* file = &(*files)[(*count)++];
+    file->path = path;
+    file->size = (size_t)info.st_size;
+    file->used = info.st_mtime;
+    file->temporary = temporary;
+    return 1;
+}
+
+static CacheFile* list_cache_files(const char* directory, int* count) {
+    CacheFile* files = NULL;
+    int capacity = 0;
+    *count = 0;
+
+#ifdef _WIN32
+    size_t length = strlen(directory) + 8;
+    char* pattern = (char*)malloc(length);
+    if (!pattern) return NULL;
+    snprintf(pattern, length, "%s/*", directory);
+    WIN32_FIND_DATAA entry;
+    HANDLE search = FindFirstFileA(pattern, &entry);
+    free(pattern);
+    if (search == INVALID_HANDLE_VALUE) return NULL;
+
+    do {
+        if (!add_cache_file(&files, count, &capacity, directory, entry.cFileName)) break;
+    } while (FindNextFileA(search, &entry));
+    FindClose(search);
+#else
+    DIR* dir = opendir(directory);
+    if (!dir) return NULL;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!add_cache_file(&files, count, &capacity, directory, entry->d_name)) break;
+    }
+    closedir(dir);
+#endif
+
+    return files;
+}
+
+void translation_cache_trim(TranslationCache* cache) {
+    int count = 0;
+    CacheFile* files = list_cache_files(cache->directory, &count);
+    if (!files) return;
+
+    /* Temporary files left by stores that never finished, as when a process was killed */
+    time_t stale = time(NULL) - CACHE_STALE_SECONDS;
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        if (!files[i].temporary) {
+            total += files[i].size;
+        } else if (files[i].used < stale) {
+            remove(files[i].path);
+        }
+    }
+
+    /* Oldest use first */
+    if (total > cache->max_bytes) {
+        qsort(files, (size_t)count, sizeof(CacheFile), compare_by_use);
+        for (int i = 0; i < count && total > cache->max_bytes; i++) {
+            if (!files[i].temporary && remove(files[i].path) == 0) {
+                total -= files[i].size;
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(files[i].path);
+    }
+    free(files);
+}
@@ -0,0 +1,54 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+
+#include "utils.h"
+#include "output.h"
+#include "thread.h"
+
+/*
+ * On-disk translation cache. Each entry holds the formatted output for one
+ * input, keyed by a hash of the input bytes, the compiler version and the
+ * options that shape the output. Entries are files in one directory; a hit
+ * refreshes the entry's modification time, and trimming deletes the least
+ * recently used entries until the directory fits the size cap. Running out
+ * of memory makes the cache miss or skip a store or trim, never unwind
+ * through it; temporary files a store left behind are deleted by a later
+ * trim once they are an hour old.
+ */
+typedef struct {
+    char* directory;
+    size_t max_bytes;
+    unsigned int temp_sequence;     /* Names temporary files during stores */
+    Mutex lock;
+} TranslationCache;
+
+typedef struct {
+    uint64_t hash;
+    uint64_t input_length;
+} CacheKey;
+
+/* Default size cap, in megabytes */
+#define CACHE_DEFAULT_SIZE_MB 256
+
+/* Cache creation and destruction; the directory is created if missing */
+TranslationCache* translation_cache_create(const char* directory, size_t max_bytes);
+void translation_cache_destroy(TranslationCache* cache);
+
+/* Key for input text translated with the given output variant */
+CacheKey translation_cache_key(const char* data, size_t length, const char* variant);
+
+/* Open a valid entry positioned at its text (length bytes), or NULL on a miss */
+FILE* translation_cache_lookup(TranslationCache* cache, CacheKey key, size_t* length);
+
+/* Pass an entry's text to writer and close the entry; returns 0 on failure */
+int translation_cache_copy(FILE* entry, OutputWriter writer, void* context);
+
+/* Record the text for key, replacing any existing entry */
+void translation_cache_store(TranslationCache* cache, CacheKey key, const OutputBuilder* text);
+
+/* Delete least recently used entries until the cache fits its size cap */
+void translation_cache_trim(TranslationCache* cache);
+
+#endif /* CACHE_H */
@@ -0,0 +1,789 @@
+#include "compiler.h"
+#include "lexer.h"
+#include "parser.h"
+#include "semantic.h"
+#include "translator.h"
+#include "formatter.h"
+#include "source.h"
+
+/* Compiler creation and destruction */
+
+Compiler* compiler_create(void) {
+    Compiler* compiler = (Compiler*)safe_malloc(sizeof(Compiler));
+    compiler->arena = arena_create(0);
+    compiler->interner = interner_create(compiler->arena);
+    compiler->ast = ast_create();
+    compiler->function_arena = arena_create(0);
+    compiler->description = description_create();
+    compiler->english = output_builder_create();
+    for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+        compiler->formatted[i] = output_builder_create();
+    }
+    include_set_init(&compiler->includes);
+    compiler->includes_resolved = 0;
+    return compiler;
+}
+
+void compiler_destroy(Compiler* compiler) {
+    if (!compiler) return;
+
+    include_set_destroy(&compiler->includes);
+    for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+        output_builder_destroy(compiler->formatted[i]);
+    }
+    output_builder_destroy(compiler->english);
+    description_destroy(compiler->description);
+    arena_destroy(compiler->function_arena);
+    ast_destroy(compiler->ast);
+    interner_destroy(compiler->interner);
+    arena_destroy(compiler->arena);
+    free(compiler);
+}
+
+/* Output files */
+
+/* Open the output for writing ("-" is stdout); logs and returns NULL on failure */
+static FILE* open_output(const char* output_file) {
+    if (string_equals(output_file, "-")) return stdout;
+
+    FILE* output = fopen(output_file, "w");
+    if (!output) {
+        log_message(LOG_ERROR, "Cannot write to file: %s", output_file);
+    }
+    return output;
+}
+
+/* Finish writing; returns 0 if anything failed to reach the file */
+static int close_output(FILE* output, int written) {
+    if (output == stdout) {
+        return fflush(output) == 0 && written;
+    }
+    return fclose(output) == 0 && written;
+}
+
+/* Write a cached translation; returns 0 on success, 1 on failure */
+static int write_cached(FILE* entry, const char* output_file, const CompileOptions* options,
+                        CompileStats* stats) {
+    if (options->verbose) {
+        log_message(LOG_INFO, "Using cached translation");
+    }
+
+    FILE* output = open_output(output_file);
+    if (!output) {
+        fclose(entry);
+        log_message(LOG_ERROR, "Failed to write output file");
+        return 1;
+    }
+
+    compile_stats_phase_begin(stats, PHASE_FORMAT);
+    int written = close_output(output, translation_cache_copy(entry, output_file_writer, output));
+    compile_stats_phase_end(stats, PHASE_FORMAT);
+    if (!written) {
+        log_message(LOG_ERROR, "Failed to write output file");
+        return 1;
+    }
+    return 0;
+}
+
+/* Compilation */
+
+const char* compile_cache_variant(const CompileOptions* options, RenderFormat format) {
+    static const char* const variants[RENDER_FORMAT_COUNT][2] = {
+        { "text", "text memoised" },
+        { "md", "md memoised" },
+        { "html", "html memoised" },
+        { "json", "json memoised" }
+    };
+    return variants[format][options->memoise != 0];
+}
+
+int compile_formats(const CompileOptions* options) {
+    return options->formats ? options->formats : RENDER_FORMAT_BIT(RENDER_TEXT);
+}
+
+char* compile_output_filename(const char* output_file, RenderFormat format, const CompileOptions* options) {
+    int formats = compile_formats(options);
+    if ((formats & (formats - 1)) == 0) {
+        return string_duplicate(output_file);
+    }
+
+    /* Replace the extension of the last path component, or add one */
+    const char* base = output_file;
+    for (const char* c = output_file; *c; c++) {
+        if (*c == '/' || *c == '\\') base = c + 1;
+    }
+    const char* dot = strrchr(base, '.');
+    size_t stem = dot && dot != base ? (size_t)(dot - output_file) : strlen(output_file);
+    const char* extension = render_format_extension(format);
+
+    char* name = (char*)safe_malloc(stem + strlen(extension) + 1);
+    memcpy(name, output_file, stem);
+    strcpy(name + stem, extension);
+    return name;
+}
+
+/* How the raw English is formatted for options */
+static FormatOptions format_options(const CompileOptions* options) {
+    FormatOptions format = { options->spelling, options->wrap_width };
+    return format;
+}
+
+/* Includes */
+
+static void resolve_includes(Compiler* compiler, const char* data, size_t length, const char* name,
+                             const CompileOptions* options) {
+    if (options->verbose) {
+        log_message(LOG_INFO, "Resolving included headers...");
+    }
+    header_cache_resolve(options->headers, data, length, name, &compiler->includes);
+    compiler->includes_resolved = 1;
+}
+
+/*
+ * Cache key for data in format. With include resolution the headers shape
+ * the text too, so data's includes are resolved first (once for all the
+ * formats) and their digest folded in; the next translation uses them
+ * unless a hit means there is none. Spelling and wrapping change only text.
+ */
+CacheKey compiler_cache_key(Compiler* compiler, const char* data, size_t length, const char* name,
+                            RenderFormat format, const CompileOptions* options) {
+    CacheKey key = translation_cache_key(data, length, compile_cache_variant(options, format));
+    if (options->headers) {
+        if (!compiler->includes_resolved) {
+            resolve_includes(compiler, data, length, name, options);
+        }
+        key.hash = (key.hash ^ compiler->includes.digest) * 1099511628211ULL;
+    }
+    if (format == RENDER_TEXT && (options->spelling || options->wrap_width)) {
+        uint64_t format = (options->spelling ? options->spelling->digest : 0) ^ (uint64_t)options->wrap_width;
+        key.hash = (key.hash ^ format) * 1099511628211ULL;
+    }
+    return key;
+}
+
+void compiler_discard_includes(Compiler* compiler) {
+    compiler->includes_resolved = 0;
+}
+
+/*
+ * What the headers of the file being translated declare, or NULL without
+ * include resolution; call after the arena and interner are reset
+ */
+static SymbolTable* header_symbols(Compiler* compiler, const char* data, size_t length, const char* name,
+                                   const CompileOptions* options) {
+    int resolved = compiler->includes_resolved;
+    compiler->includes_resolved = 0;
+    if (!options->headers) return NULL;
+
+    if (!resolved) {
+        resolve_includes(compiler, data, length, name, options);
+        compiler->includes_resolved = 0;
+    }
+    return include_set_symbols(&compiler->includes, compiler->interner, compiler->arena);
+}
+
+CompileStatus compiler_translate(Compiler* compiler, const char* data, size_t length, const char* name,
+                                 const CompileOptions* options, CompileStats* stats) {
+    /* Counting nodes walks the tree, so sizes are only gathered when wanted */
+    int collect = options->stats || options->trace != NULL;
+
+    /* Tokens and symbols live in the arena for this compilation, the tree in its own tables */
+    Arena* arena = compiler->arena;
+    AST* ast = compiler->ast;
+    arena_reset(arena);
+    interner_clear(compiler->interner);
+    ast_clear(ast);
+    description_clear(compiler->description);
+    for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+        output_builder_clear(compiler->formatted[i]);
+    }
+    SymbolTable* headers = header_symbols(compiler, data, length, name, options);
+
+    /* Token and node positions are offsets, resolved through this on demand */
+    LineIndex lines;
+    line_index_init(&lines, data, length, arena);
+
+    /* Lexical analysis */
+    if (options->verbose) {
+        log_message(LOG_INFO, "Performing lexical analysis...");
+    }
+
+    /* --show-tokens needs the whole list; the parser streams its own tokens */
+    if (options->show_tokens) {
+        TokenList* tokens = tokenize(data, length, name, arena);
+        printf("\n=== TOKENS ===\n");
+        for (int i = 0; i < tokens->count; i++) {
+            Token* token = &tokens->tokens[i];
+            int line;
+            int column;
+            line_index_position(&lines, token->offset, &line, &column);
+            printf("%d:%d  %-15s  '%.*s'\n",
+                   line, column,
+                   token_type_to_string(token->type),
+                   token->length, token->start);
+        }
+        printf("\n");
+        token_list_destroy(tokens);
+    }
+
+    /* Syntax analysis, pulling tokens from the lexer as it goes */
+    if (options->verbose) {
+        log_message(LOG_INFO, "Performing syntax analysis...");
+    }
+    compile_stats_phase_begin(stats, PHASE_PARSE);
+    Lexer* lexer = lexer_create(data, length, name, arena);
+    TokenStream stream;
+    token_stream_init(&stream, lexer);
+    ASTRef program = parse(&stream, name, arena, compiler->interner, ast);
+    lexer_destroy(lexer);
+    compile_stats_phase_end(stats, PHASE_PARSE);
+    stats->tokens = (size_t)stream.produced;
+    if (collect) {
+        stats->nodes = ast_count_nodes(ast, program);
+    }
+
+    if (stream.had_error) {
+        log_message(LOG_ERROR, "Lexical analysis failed");
+        symbol_table_destroy(headers);
+        return COMPILE_LEXICAL_ERROR;
+    }
+
+    if (program == AST_NONE) {
+        log_message(LOG_ERROR, "Syntax analysis failed");
+        symbol_table_destroy(headers);
+        return COMPILE_SYNTAX_ERROR;
+    }
+
+    if (options->show_ast) {
+        printf("\n=== ABSTRACT SYNTAX TREE ===\n");
+        ast_print(ast, program, 0);
+        printf("\n");
+    }
+
+    /* Semantic analysis */
+    if (options->verbose) {
+        log_message(LOG_INFO, "Performing semantic analysis...");
+    }
+    compile_stats_phase_begin(stats, PHASE_SEMANTIC);
+    int symbol_count = 0;
+    int analyzed = analyze_semantics(ast, program, name, arena, &lines, headers, options->function_jobs,
+                                     &symbol_count);
+    compile_stats_phase_end(stats, PHASE_SEMANTIC);
+    stats->symbols = (size_t)symbol_count;
+    if (!analyzed) {
+        log_message(LOG_ERROR, "Semantic analysis failed");
+        symbol_table_destroy(headers);
+        return COMPILE_SEMANTIC_ERROR;
+    }
+
+    /* Translation to English */
+    if (options->verbose) {
+        log_message(LOG_INFO, "Translating to British English...");
+    }
+    compile_stats_phase_begin(stats, PHASE_TRANSLATE);
+    TranslateOptions translate_options = { options->function_jobs, options->memoise, headers };
+    translate_to_english(ast, program, compiler->description, &translate_options);
+    compile_stats_phase_end(stats, PHASE_TRANSLATE);
+    stats->arena_bytes = arena->bytes_used;
+    symbol_table_destroy(headers);
+
+    return COMPILE_OK;
+}
+
+/* Render the description in format into out, formatting text as options say */
+static void render_output(Compiler* compiler, RenderFormat format, OutputBuilder* out,
+                          const CompileOptions* options) {
+    if (format != RENDER_TEXT) {
+        render_description(compiler->description, format, out);
+        return;
+    }
+
+    output_builder_clear(compiler->english);
+    render_description(compiler->description, RENDER_TEXT, compiler->english);
+    FormatOptions text_format = format_options(options);
+    format_english_output(compiler->english, out, &text_format);
+}
+
+int compiler_emit(Compiler* compiler, RenderFormat format, OutputWriter writer, void* context, int keep_text,
+                  const CompileOptions* options, CompileStats* stats) {
+    compile_stats_phase_begin(stats, PHASE_FORMAT);
+    OutputBuilder* formatted = compiler->formatted[format];
+    int written;
+    if (keep_text) {
+        render_output(compiler, format, formatted, options);
+        written = output_builder_emit(formatted, writer, context);
+        stats->output_bytes += formatted->length;
+    } else {
+        output_builder_set_writer(formatted, writer, context);
+        render_output(compiler, format, formatted, options);
+        written = output_builder_flush(formatted);
+        stats->output_bytes += formatted->written;
+        output_builder_set_writer(formatted, NULL, NULL);
+    }
+    compile_stats_phase_end(stats, PHASE_FORMAT);
+    return written;
+}
+
+/* Writer that keeps the text in an OutputBuilder */
+static int builder_writer(void* builder, const char* data, size_t length) {
+    output_append_length((OutputBuilder*)builder, data, length);
+    return 1;
+}
+
+int compile_to_text(Compiler* compiler, const char* data, size_t length, const char* input_file,
+                    const CompileOptions* options, OutputBuilder** texts, CompileStats* stats) {
+    stats->input_bytes = length;
+    int formats = compile_formats(options);
+
+    /* Formats found in the cache are copied from it; the rest share one translation */
+    TranslationCache* cache = options->show_tokens || options->show_ast ? NULL : options->cache;
+    CacheKey keys[RENDER_FORMAT_COUNT];
+    int missing = formats;
+    if (cache) {
+        for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+            if (!(formats & RENDER_FORMAT_BIT(i))) continue;
+
+            keys[i] = compiler_cache_key(compiler, data, length, input_file, (RenderFormat)i, options);
+            size_t cached_length = 0;
+            FILE* entry = translation_cache_lookup(cache, keys[i], &cached_length);
+            if (!entry) continue;
+
+            if (options->verbose) {
+                log_message(LOG_INFO, "Using cached translation");
+            }
+            compile_stats_phase_begin(stats, PHASE_FORMAT);
+            int copied = translation_cache_copy(entry, builder_writer, texts[i]);
+            compile_stats_phase_end(stats, PHASE_FORMAT);
+            if (!copied) {
+                compiler->includes_resolved = 0;
+                return 1;
+            }
+            stats->output_bytes += cached_length;
+            missing &= ~RENDER_FORMAT_BIT(i);
+        }
+        if (!missing) {
+            compiler->includes_resolved = 0;
+            stats->cached = 1;
+            return 0;
+        }
+    }
+
+    if (compiler_translate(compiler, data, length, input_file, options, stats) != COMPILE_OK) {
+        return 1;
+    }
+
+    if (options->verbose) {
+        log_message(LOG_INFO, "Formatting output...");
+    }
+    for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+        if (!(missing & RENDER_FORMAT_BIT(i))) continue;
+
+        OutputBuilder* formatted = compiler->formatted[i];
+        compile_stats_phase_begin(stats, PHASE_FORMAT);
+        render_output(compiler, (RenderFormat)i, formatted, options);
+        compile_stats_phase_end(stats, PHASE_FORMAT);
+        stats->output_bytes += formatted->length;
+
+        if (cache) {
+            translation_cache_store(cache, keys[i], formatted);
+        }
+        output_builder_splice(texts[i], formatted);
+    }
+    return 0;
+}
+
+/*
+ * Streaming. Only the global scope and the interned text outlive a
+ * function: its nodes are discarded by the parser, its local symbols by
+ * resetting function_arena, and its text leaves through the output writer.
+ */
+
+typedef struct {
+    Compiler* compiler;
+    SemanticAnalyzer* analyzer;
+    TranslateOptions translate_options;
+    int formats;
+    Renderer renderers[RENDER_FORMAT_COUNT];    /* Carry the open blocks from one function to the next */
+    Formatter formatter;    /* Carries a part-formatted text line from one function to the next */
+    CompileStats* stats;
+    int collect;
+    int failed;         /* A semantic error: later functions are checked but not translated */
+} StreamState;
+
+/* Format the raw text rendered so far into the streaming text output */
+static void stream_english(StreamState* state) {
+    Compiler* compiler = state->compiler;
+    for (OutputChunk* chunk = compiler->english->head; chunk; chunk = chunk->next) {
+        formatter_feed(&state->formatter, chunk->data, chunk->length, compiler->formatted[RENDER_TEXT]);
+    }
+    output_builder_clear(compiler->english);
+}
+
+/* Render the description built so far into each streaming output */
+static void stream_description(StreamState* state) {
+    Compiler* compiler = state->compiler;
+    compile_stats_phase_begin(state->stats, PHASE_FORMAT);
+    for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+        if (!(state->formats & RENDER_FORMAT_BIT(i))) continue;
+
+        if (i == RENDER_TEXT) {
+            renderer_feed(&state->renderers[i], compiler->description, compiler->english);
+            stream_english(state);
+        } else {
+            renderer_feed(&state->renderers[i], compiler->description, compiler->formatted[i]);
+        }
+    }
+    description_clear(compiler->description);
+    compile_stats_phase_end(state->stats, PHASE_FORMAT);
+}
+
+static void stream_function(void* context, const AST* ast, ASTRef function) {
+    StreamState* state = (StreamState*)context;
+    Compiler* compiler = state->compiler;
+    CompileStats* stats = state->stats;
+
+    compile_stats_phase_end(stats, PHASE_PARSE);
+    if (state->collect) {
+        stats->nodes += ast_count_nodes(ast, function);
+    }
+
+    compile_stats_phase_begin(stats, PHASE_SEMANTIC);
+    if (!semantic_analyze_function(state->analyzer, function)) {
+        state->failed = 1;
+    }
+    arena_reset(compiler->function_arena);
+    compile_stats_phase_end(stats, PHASE_SEMANTIC);
+
+    if (!state->failed) {
+        compile_stats_phase_begin(stats, PHASE_TRANSLATE);
+        translate_stream_function(ast, function, compiler->description, &state->translate_options);
+        compile_stats_phase_end(stats, PHASE_TRANSLATE);
+        stream_description(state);
+    }
+    compile_stats_phase_begin(stats, PHASE_PARSE);
+}
+
+/*
+ * Lex, parse, check, translate and write data one function at a time, each
+ * format to writer with its own context; *written is 0 if a write failed
+ */
+static CompileStatus compiler_stream(Compiler* compiler, const char* data, size_t length, const char* name,
+                                     OutputWriter writer, void* const* contexts, const CompileOptions* options,
+                                     CompileStats* stats, int* written) {
+    Arena* arena = compiler->arena;
+    AST* ast = compiler->ast;
+    arena_reset(arena);
+    arena_reset(compiler->function_arena);
+    interner_clear(compiler->interner);
+    ast_clear(ast);
+    description_clear(compiler->description);
+    output_builder_clear(compiler->english);
+    SymbolTable* headers = header_symbols(compiler, data, length, name, options);
+
+    LineIndex lines;
+    line_index_init(&lines, data, length, arena);
+
+    if (options->verbose) {
+        log_message(LOG_INFO, "Translating one function at a time...");
+    }
+
+    StreamState state;
+    state.compiler = compiler;
+    state.analyzer = semantic_analyzer_create(ast, name, arena, &lines);
+    state.analyzer->local_arena = compiler->function_arena;
+    state.analyzer->headers = headers;
+    state.analyzer->defer_calls = 1;
+    state.translate_options.jobs = 1;
+    state.translate_options.memoise = 0;
+    state.translate_options.headers = headers;
+    state.stats = stats;
+    state.collect = options->stats || options->trace != NULL;
+    state.failed = 0;
+    state.formats = compile_formats(options);
+    for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+        if (!(state.formats & RENDER_FORMAT_BIT(i))) continue;
+        output_builder_clear(compiler->formatted[i]);
+        output_builder_set_writer(compiler->formatted[i], writer, contexts[i]);
+        renderer_begin(&state.renderers[i], (RenderFormat)i);
+    }
+    if (state.formats & RENDER_FORMAT_BIT(RENDER_TEXT)) {
+        FormatOptions format = format_options(options);
+        formatter_begin(&state.formatter, &format);
+    }
+
+    translate_stream_begin(compiler->description);
+    stream_description(&state);
+
+    compile_stats_phase_begin(stats, PHASE_PARSE);
+    Lexer* lexer = lexer_create(data, length, name, arena);
+    TokenStream stream;
+    token_stream_init(&stream, lexer);
+    int function_count = parse_stream(&stream, name, arena, compiler->interner, ast,
+                                      stream_function, &state);
+    lexer_destroy(lexer);
+    compile_stats_phase_end(stats, PHASE_PARSE);
+
+    /* A call to a function defined further down was kept until every function had been declared */
+    if (!stream.had_error && function_count >= 0) {
+        compile_stats_phase_begin(stats, PHASE_SEMANTIC);
+        if (!semantic_report_deferred(state.analyzer)) {
+            state.failed = 1;
+        }
+        compile_stats_phase_end(stats, PHASE_SEMANTIC);
+    }
+    stats->tokens = (size_t)stream.produced;
+    stats->symbols = (size_t)semantic_analyzer_symbol_count(state.analyzer);
+    stats->arena_bytes = arena->bytes_used;
+    semantic_analyzer_destroy(state.analyzer);
+    symbol_table_destroy(headers);
+
+    CompileStatus status = COMPILE_OK;
+    if (stream.had_error) {
+        log_message(LOG_ERROR, "Lexical analysis failed");
+        status = COMPILE_LEXICAL_ERROR;
+    } else if (function_count < 0) {
+        log_message(LOG_ERROR, "Syntax analysis failed");
+        status = COMPILE_SYNTAX_ERROR;
+    } else if (state.failed) {
+        log_message(LOG_ERROR, "Semantic analysis failed");
+        status = COMPILE_SEMANTIC_ERROR;
+    } else {
+        translate_stream_end(compiler->description, function_count);
+        stream_description(&state);
+    }
+
+    compile_stats_phase_begin(stats, PHASE_FORMAT);
+    *written = 1;
+    for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+        if (!(state.formats & RENDER_FORMAT_BIT(i))) continue;
+
+        OutputBuilder* formatted = compiler->formatted[i];
+        if (i == RENDER_TEXT) {
+            renderer_end(&state.renderers[i], compiler->english);
+            stream_english(&state);
+            formatter_end(&state.formatter, formatted);
+        } else {
+            renderer_end(&state.renderers[i], formatted);
+        }
+        if (!output_builder_flush(formatted)) {
+            *written = 0;
+        }
+        stats->output_bytes += formatted->written;
+        output_builder_set_writer(formatted, NULL, NULL);
+    }
+    compile_stats_phase_end(stats, PHASE_FORMAT);
+    return status;
+}
+
+/* Stream source straight to each format's output file; returns 0 on success, 1 on failure */
+static int stream_pipeline(Compiler* compiler, const SourceFile* source, const char* input_file,
+                           const char* output_file, const CompileOptions* options, CompileStats* stats) {
+    int formats = compile_formats(options);
+    char* names[RENDER_FORMAT_COUNT] = { NULL };
+    void* outputs[RENDER_FORMAT_COUNT] = { NULL };
+    int opened = 1;
+    for (int i = 0; i < RENDER_FORMAT_COUNT && opened; i++) {
+        if (!(formats & RENDER_FORMAT_BIT(i))) continue;
+
+        names[i] = compile_output_filename(output_file, (RenderFormat)i, options);
+        outputs[i] = open_output(names[i]);
+        if (!outputs[i]) {
+            opened = 0;
+        } else if (options->verbose) {
+            log_message(LOG_INFO, "Writing output to %s",
+                        outputs[i] == stdout ? "standard output" : names[i]);
+        }
+    }
+
+    int written = 0;
+    CompileStatus status = COMPILE_OK;
+    if (opened) {
+        status = compiler_stream(compiler, source->data, source->length, input_file,
+                                 output_file_writer, outputs, options, stats, &written);
+    }
+
+    for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+        if (outputs[i] && !close_output((FILE*)outputs[i], written)) {
+            written = 0;
+        }
+    }
+
+    /* Text already written for earlier functions must not pass for a translation */
+    int failed = !opened || status != COMPILE_OK || !written;
+    for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+        if (failed && outputs[i] && outputs[i] != stdout) {
+            remove(names[i]);
+        }
+        free(names[i]);
+    }
+
+    if (!opened || (status == COMPILE_OK && !written)) {
+        log_message(LOG_ERROR, "Failed to write output file");
+    }
+    if (failed) {
+        return 1;
+    }
+
+    if (options->verbose) {
+        log_message(LOG_INFO, "Compilation completed successfully!");
+    }
+    return 0;
+}
+
+/* Render format into its output file and store it in the cache when key is set; returns 0 on success */
+static int write_format(Compiler* compiler, RenderFormat format, const char* output_file,
+                        const CacheKey* key, const CompileOptions* options, CompileStats* stats) {
+    FILE* output = open_output(output_file);
+    if (!output) {
+        log_message(LOG_ERROR, "Failed to write output file");
+        return 1;
+    }
+
+    if (options->verbose) {
+        log_message(LOG_INFO, "Formatting output...");
+        log_message(LOG_INFO, "Writing output to %s",
+                    output == stdout ? "standard output" : output_file);
+    }
+    int written = compiler_emit(compiler, format, output_file_writer, output, key != NULL, options, stats);
+    written = close_output(output, written);
+
+    if (!written) {
+        log_message(LOG_ERROR, "Failed to write output file");
+        return 1;
+    }
+
+    if (key) {
+        translation_cache_store(options->cache, *key, compiler->formatted[format]);
+    }
+    return 0;
+}
+
+static int run_pipeline(Compiler* compiler, const char* input_file, const char* output_file,
+                        const CompileOptions* options, CompileStats* stats) {
+    if (options->verbose) {
+        log_message(LOG_INFO, "Starting compilation of %s", input_file);
+    }
+
+    /* Read source file */
+    if (options->verbose) {
+        log_message(LOG_INFO, "Reading source file...");
+    }
+    compile_stats_phase_begin(stats, PHASE_READ);
+    SourceFile* source = source_file_open(input_file);
+    compile_stats_phase_end(stats, PHASE_READ);
+    if (!source) {
+        log_message(LOG_ERROR, "Failed to read input file: %s", input_file);
+        return 1;
+    }
+    stats->input_bytes = source->length;
+
+    /*
+     * An unchanged input costs a hash and a copy for each format; debug
+     * dumps need the whole tree, and streaming never holds the whole text
+     * to store
+     */
+    int dumping = options->show_tokens || options->show_ast;
+    TranslationCache* cache = dumping || options->stream ? NULL : options->cache;
+    int formats = compile_formats(options);
+    CacheKey keys[RENDER_FORMAT_COUNT];
+    int missing = formats;      /* Formats not written from the cache */
+    if (cache) {
+        for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+            if (!(formats & RENDER_FORMAT_BIT(i))) continue;
+
+            keys[i] = compiler_cache_key(compiler, source->data, source->length, input_file,
+                                        (RenderFormat)i, options);
+            size_t cached_length = 0;
+            FILE* entry = translation_cache_lookup(cache, keys[i], &cached_length);
+            if (!entry) continue;
+
+            char* format_file = compile_output_filename(output_file, (RenderFormat)i, options);
+            int failed = write_cached(entry, format_file, options, stats);
+            free(format_file);
+            if (failed) {
+                compiler->includes_resolved = 0;
+                source_file_close(source);
+                return 1;
+            }
+            stats->output_bytes += cached_length;
+            missing &= ~RENDER_FORMAT_BIT(i);
+        }
+        if (!missing) {
+            compiler->includes_resolved = 0;
+            stats->cached = 1;
+            source_file_close(source);
+            if (options->verbose) {
+                log_message(LOG_INFO, "Compilation completed successfully!");
+            }
+            return 0;
+        }
+    }
+
+    if (options->stream && !dumping) {
+        int result = stream_pipeline(compiler, source, input_file, output_file, options, stats);
+        source_file_close(source);
+        return result;
+    }
+
+    CompileStatus status = compiler_translate(compiler, source->data, source->length, input_file,
+                                              options, stats);
+    source_file_close(source);
+    if (status != COMPILE_OK) {
+        return 1;
+    }
+
+    /*
+     * Render each format still missing, streaming it to its output file
+     * ("-" is stdout). When caching, the output is kept whole so it can be
+     * stored afterwards.
+     */
+    for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+        if (!(missing & RENDER_FORMAT_BIT(i))) continue;
+
+        char* format_file = compile_output_filename(output_file, (RenderFormat)i, options);
+        int failed = write_format(compiler, (RenderFormat)i, format_file, cache ? &keys[i] : NULL,
+                                  options, stats);
+        free(format_file);
+        if (failed) {
+            return 1;
+        }
+    }
+
+    if (options->verbose) {
+        log_message(LOG_INFO, "Compilation completed successfully!");
+    }
+
+    return 0;
+}
+
+int compile_file(Compiler* compiler, const char* input_file, const char* output_file,
+                 const CompileOptions* options) {
+    CompileStats stats;
+    compile_stats_begin(&stats);
+    int result = run_pipeline(compiler, input_file, output_file, options, &stats);
+    compile_stats_end(&stats);
+
+    if (options->stats) {
+        compile_stats_report(&stats, input_file);
+    }
+    if (options->trace) {
+        trace_log_add_compile(options->trace, &stats, input_file);
+    }
+    return result;
+}
+
+char* default_output_filename(const char* input_file, RenderFormat format) {
+    const char* extension = render_format_extension(format);
+    size_t len = strlen(input_file);
+    char* output = (char*)safe_malloc(len + strlen(extension) + 1);
+    strcpy(output, input_file);
+
+    /* Replace .c extension with the format's */
+    if (len > 2 && output[len-2] == '.' && output[len-1] == 'c') {
+        output[len-2] = '\0';
+    } else if (len > 2 && output[len-1] == 'c') {
+        output[len-1] = '\0';
+    }
+    strcat(output, extension);
+    return output;
+}
@@ -0,0 +1,124 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "utils.h"
+#include "arena.h"
+#include "intern.h"
+#include "ast.h"
+#include "output.h"
+#include "description.h"
+#include "render.h"
+#include "cache.h"
+#include "header.h"
+#include "spelling.h"
+#include "stats.h"
+
+/* Per-file pipeline switches */
+typedef struct {
+    int show_tokens;
+    int show_ast;
+    int verbose;
+    int function_jobs;  /* Threads checking and translating one file's functions (1 = serial) */
+    int memoise;        /* Describe structurally identical functions once */
+    TranslationCache* cache;    /* Shared translation cache, or NULL */
+    int stats;                  /* Report phase timings and sizes */
+    TraceLog* trace;            /* Shared trace-event log, or NULL */
+    int stream;                 /* Translate and discard each function as soon as it is parsed */
+    HeaderCache* headers;       /* Resolve #include lines through these shared summaries, or NULL */
+    const SpellingDictionary* spelling;     /* British spellings, or NULL for the built-in ones */
+    int wrap_width;             /* Wrap text lines at this many columns (0 = no wrapping) */
+    int formats;                /* Formats to write, a mask of RENDER_FORMAT_BIT()s (0 = text only) */
+} CompileOptions;
+
+/*
+ * Compilation state for one thread. Everything is reset, not freed, between
+ * files, so a worker translating many files reuses the same memory.
+ */
+typedef struct {
+    Arena* arena;               /* Tokens, symbols and interned text */
+    Interner* interner;
+    AST* ast;                   /* Tree of the file being translated */
+    Arena* function_arena;      /* Symbols of the function being streamed */
+    Description* description;   /* Translator output, rendered once per format */
+    OutputBuilder* english;     /* The description as raw text, before formatting */
+    OutputBuilder* formatted[RENDER_FORMAT_COUNT];  /* Final output of each format */
+    IncludeSet includes;        /* Headers of the file being translated, with options->headers */
+    int includes_resolved;      /* includes already resolved for the next translation, to key the cache */
+} Compiler;
+
+/* Outcome of translating one input */
+typedef enum {
+    COMPILE_OK,
+    COMPILE_LEXICAL_ERROR,
+    COMPILE_SYNTAX_ERROR,
+    COMPILE_SEMANTIC_ERROR
+} CompileStatus;
+
+/* Compiler creation and destruction */
+Compiler* compiler_create(void);
+void compiler_destroy(Compiler* compiler);
+
+/*
+ * The pipeline in two steps, for callers that supply their own text and
+ * output. compiler_translate runs lexing to translation, leaving the
+ * description in compiler->description, after resolving the includes when
+ * options->headers is set; compiler_emit renders it in format, and formats
+ * text as options say, to writer, streaming unless keep_text asks for the
+ * whole output to stay in compiler->formatted[format] (to store in a
+ * cache). compiler_emit can be called once for each format and returns 0 if
+ * a write failed.
+ */
+CompileStatus compiler_translate(Compiler* compiler, const char* data, size_t length, const char* name,
+                                 const CompileOptions* options, CompileStats* stats);
+int compiler_emit(Compiler* compiler, RenderFormat format, OutputWriter writer, void* context, int keep_text,
+                  const CompileOptions* options, CompileStats* stats);
+
+/*
+ * compile_file without the file I/O, for callers that read and write on
+ * stages of their own: translate data, already in memory, and append each
+ * format's final output to texts[format]. The cache is used and filled as
+ * compile_file would; stats gets everything but the read and the write.
+ * options->stream does not apply. Returns 0 on success, 1 on failure.
+ */
+int compile_to_text(Compiler* compiler, const char* data, size_t length, const char* input_file,
+                    const CompileOptions* options, OutputBuilder** texts, CompileStats* stats);
+
+/* Cache key variant for the options that change the output in format */
+const char* compile_cache_variant(const CompileOptions* options, RenderFormat format);
+
+/*
+ * The key compile_to_text caches format's output of data under, for
+ * callers keeping outputs elsewhere. With include resolution, data's
+ * includes are resolved to compute it and kept for translating data next;
+ * compiler_discard_includes drops them when data needs no translating.
+ */
+CacheKey compiler_cache_key(Compiler* compiler, const char* data, size_t length, const char* name,
+                            RenderFormat format, const CompileOptions* options);
+void compiler_discard_includes(Compiler* compiler);
+
+/* The formats options ask for, as a mask; never empty */
+int compile_formats(const CompileOptions* options);
+
+/*
+ * Where format's output goes: output_file itself when it is the only
+ * format asked for, otherwise output_file with its extension replaced by
+ * the format's. The caller frees the name.
+ */
+char* compile_output_filename(const char* output_file, RenderFormat format, const CompileOptions* options);
+
+/*
+ * Translate input_file into output_file; returns 0 on success, 1 on failure.
+ * With options->stream, memory is bounded by the largest function rather
+ * than the file: each function is checked, translated and written out as
+ * soon as it is parsed, and the function count follows the last function
+ * instead of heading the text. A partially written output file is removed
+ * on failure. Every format asked for is written from the one translation,
+ * each to compile_output_filename(output_file, ...).
+ */
+int compile_file(Compiler* compiler, const char* input_file, const char* output_file,
+                 const CompileOptions* options);
+
+/* Output name for an input: a trailing ".c" (or "c") becomes format's extension, such as ".txt" */
+char* default_output_filename(const char* input_file, RenderFormat format);
+
+#endif /* COMPILER_H */
@@ -0,0 +1,147 @@
+#include <stdint.h>
+
+#include "compress.h"
+
+#define COMPRESS_HASH_BITS 14
+#define COMPRESS_MIN_MATCH 4
+#define COMPRESS_MAX_DISTANCE 65535
+
+size_t compress_bound(size_t length) {
+    return length + length / 255 + 16;
+}
+
+/* Compression */
+
+static uint32_t read_u32(const unsigned char* in) {
+    uint32_t value;
+    memcpy(&value, in, sizeof(value));
+    return value;
+}
+
+/* Slot for the four bytes at a position (Knuth's multiplicative hash) */
+static unsigned int hash_u32(uint32_t value) {
+    return (value * 2654435761u) >> (32 - COMPRESS_HASH_BITS);
+}
+
+/* A count past a nibble's 15, as bytes of 255 and a final byte below it */
+static unsigned char* write_length(unsigned char* out, size_t length) {
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = (unsigned char)length;
+    return out;
+}
+
+/* One sequence: literals, then a match unless match_length is 0 (the last sequence) */
+static unsigned char* write_sequence(unsigned char* out, const unsigned char* literals, size_t literal_count,
+                                     size_t distance, size_t match_length) {
+    unsigned char* token = out++;
+    size_t match_extra = match_length ? match_length - COMPRESS_MIN_MATCH : 0;
+    *token = (unsigned char)(((literal_count < 15 ? literal_count : 15) << 4) |
+                             (match_extra < 15 ? match_extra : 15));
+
+    if (literal_count >= 15) {
+        out = write_length(out, literal_count - 15);
+    }
+    memcpy(out, literals, literal_count);
+    out += literal_count;
+
+    if (match_length) {
+        *out++ = (unsigned char)distance;
+        *out++ = (unsigned char)(distance >> 8);
+        if (match_extra >= 15) {
+            out = write_length(out, match_extra - 15);
+        }
+    }
+    return out;
+}
+
+size_t compress_block(const char* src, size_t length, char* dst) {
+    const unsigned char* in = (const unsigned char*)src;
+    unsigned char* out = (unsigned char*)dst;
+
+    /* Positions plus one of the last occurrence of each hashed four bytes; 0 is empty */
+    uint32_t* table = (uint32_t*)safe_malloc(sizeof(uint32_t) << COMPRESS_HASH_BITS);
+    memset(table, 0, sizeof(uint32_t) << COMPRESS_HASH_BITS);
+
+    size_t anchor = 0;
+    size_t position = 0;
+    while (length >= COMPRESS_MIN_MATCH && position <= length - COMPRESS_MIN_MATCH && position < UINT32_MAX) {
+        uint32_t bytes = read_u32(in + position);
+        unsigned int slot = hash_u32(bytes);
+        size_t candidate = table[slot];
+        table[slot] = (uint32_t)(position + 1);
+
+        if (candidate == 0 || position - (candidate - 1) > COMPRESS_MAX_DISTANCE ||
+            read_u32(in + candidate - 1) != bytes) {
+            position++;
+            continue;
+        }
+
+        size_t match = candidate - 1;
+        size_t match_length = COMPRESS_MIN_MATCH;
+        while (position + match_length < length && in[match + match_length] == in[position + match_length]) {
+            match_length++;
+        }
+
+        out = write_sequence(out, in + anchor, position - anchor, position - match, match_length);
+        position += match_length;
+        anchor = position;
+    }
+
+    out = write_sequence(out, in + anchor, length - anchor, 0, 0);
+    free(table);
+    return (size_t)(out - (unsigned char*)dst);
+}
+
+/* Decompression */
+
+/* Add the bytes of 255 and the final byte of a long count; returns 0 if the block ends first */
+static int read_length(const unsigned char** in, const unsigned char* end, size_t* length) {
+    unsigned char byte;
+    do {
+        if (*in >= end) return 0;
+        byte = *(*in)++;
+        *length += byte;
+    } while (byte == 255);
+    return 1;
+}
+
+int decompress_block(const char* src, size_t src_length, char* dst, size_t length) {
+    const unsigned char* in = (const unsigned char*)src;
+    const unsigned char* end = in + src_length;
+    unsigned char* out = (unsigned char*)dst;
+    size_t produced = 0;
+
+    while (in < end) {
+        unsigned char token = *in++;
+
+        size_t literal_count = token >> 4;
+        if (literal_count == 15 && !read_length(&in, end, &literal_count)) return 0;
+        if (literal_count > (size_t)(end - in) || literal_count > length - produced) return 0;
+        memcpy(out + produced, in, literal_count);
+        in += literal_count;
+        produced += literal_count;
+
+        /* The last sequence ends the block after its literals */
+        if (in == end) break;
+
+        if (end - in < 2) return 0;
+        size_t distance = (size_t)in[0] | ((size_t)in[1] << 8);
+        in += 2;
+        size_t match_length = (size_t)(token & 15);
+        if (match_length == 15 && !read_length(&in, end, &match_length)) return 0;
+        match_length += COMPRESS_MIN_MATCH;
+        if (distance == 0 || distance > produced || match_length > length - produced) return 0;
+
+        /* Byte by byte, since a match may overlap the bytes it produces */
+        const unsigned char* from = out + produced - distance;
+        for (size_t i = 0; i < match_length; i++) {
+            out[produced + i] = from[i];
+        }
+        produced += match_length;
+    }
+
+    return produced == length;
+}
@@ -0,0 +1,26 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include "utils.h"
+
+/*
+ * Byte-oriented LZ77 compression for stored translations, laid out like
+ * LZ4's block format: each sequence is a token byte (literal count in the
+ * high nibble, match length less four in the low one, 15 meaning more
+ * bytes follow), the literals, then a two-byte little-endian distance back
+ * into the last 64 KiB and the rest of the match length. The last sequence
+ * has literals only. Translations repeat whole phrases, so this shrinks
+ * them severalfold without a compression library, and decompressing costs
+ * little more than a copy.
+ */
+
+/* Largest compressed size of length bytes */
+size_t compress_bound(size_t length);
+
+/* Compress length bytes of src into dst, which holds compress_bound(length); returns the compressed size */
+size_t compress_block(const char* src, size_t length, char* dst);
+
+/* Decompress into dst, exactly length bytes; returns 0 if src is not a valid block of that size */
+int decompress_block(const char* src, size_t src_length, char* dst, size_t length);
+
+#endif /* COMPRESS_H */
@@ -0,0 +1,91 @@
+#include "description.h"
+
+#define DESCRIPTION_INITIAL_CAPACITY 256
+
+/* Description creation and destruction */
+
+Description* description_create(void) {
+    Description* description = (Description*)safe_malloc(sizeof(Description));
+    description->records = NULL;
+    description->count = 0;
+    description->capacity = 0;
+    return description;
+}
+
+void description_destroy(Description* description) {
+    if (!description) return;
+
+    free(description->records);
+    free(description);
+}
+
+void description_clear(Description* description) {
+    description->count = 0;
+}
+
+/* Records */
+
+static void reserve(Description* description, int count) {
+    if (description->count + count <= description->capacity) return;
+
+    int capacity = description->capacity ? description->capacity : DESCRIPTION_INITIAL_CAPACITY;
+    while (description->count + count > capacity) {
+        capacity *= 2;
+    }
+    description->records = (DescriptionRecord*)safe_realloc(description->records,
+                                                             sizeof(DescriptionRecord) * capacity);
+    description->capacity = capacity;
+}
+
+static void add_record(Description* description, DescriptionKind kind, int flags, int value, const char* text) {
+    reserve(description, 1);
+    DescriptionRecord* record = &description->records[description->count++];
+    record->kind = (unsigned char)kind;
+    record->flags = (unsigned char)flags;
+    record->value = value;
+    record->text = text;
+}
+
+static void add_fragment(Description* description, DescriptionKind kind, int flags, const char* text) {
+    add_record(description, kind, flags, (int)strlen(text), text);
+}
+
+/* Blocks */
+
+void description_begin(Description* description, DescriptionKind kind, int value, int flags) {
+    add_record(description, kind, flags, value, NULL);
+}
+
+void description_end(Description* description) {
+    add_record(description, DESC_END, 0, 0, NULL);
+}
+
+/* Fragments */
+
+void description_text(Description* description, const char* text) {
+    if (*text) add_fragment(description, DESC_TEXT, 0, text);
+}
+
+void description_name(Description* description, const char* name) {
+    add_fragment(description, DESC_NAME, 0, name);
+}
+
+void description_code(Description* description, const char* code) {
+    add_fragment(description, DESC_CODE, 0, code);
+}
+
+void description_quoted_code(Description* description, const char* code) {
+    add_fragment(description, DESC_CODE, DESC_QUOTED, code);
+}
+
+void description_number(Description* description, int value) {
+    add_record(description, DESC_NUMBER, 0, value, NULL);
+}
+
+void description_append(Description* description, const Description* src) {
+    if (src->count == 0) return;
+
+    reserve(description, src->count);
+    memcpy(description->records + description->count, src->records, sizeof(DescriptionRecord) * src->count);
+    description->count += src->count;
+}
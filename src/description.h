@@ -0,0 +1,81 @@
+#ifndef DESCRIPTION_H
+#define DESCRIPTION_H
+
+#include "utils.h"
+
+/*
+ * What a record is. Blocks are opened by a record of their kind and closed
+ * by DESC_END; in between come the fragments of the block's sentence, then
+ * the blocks nested in it. Fragments never follow a nested block.
+ */
+typedef enum {
+    /* Blocks */
+    DESC_PROGRAMME,     /* The whole description; its sentence is the title */
+    DESC_FUNCTION,      /* One function; its sentence is the heading */
+    DESC_PARAGRAPH,     /* A sentence standing on its own */
+    DESC_SENTENCE,      /* A closing sentence, with nothing after it */
+    DESC_PARAMETERS,    /* The parameter list, holding DESC_PARAMETER items */
+    DESC_PARAMETER,
+    DESC_STEPS,         /* The function's steps, holding DESC_STEP and the like */
+    DESC_STEP,          /* One step, numbered when value is positive, holding its sub-steps */
+    DESC_CASE,          /* An arm of a choice, holding its steps */
+    DESC_OTHERWISE,     /* The steps taken when a condition is false */
+    DESC_LABEL,         /* A label, holding the labelled step */
+    DESC_CLOSING,       /* The line ending a step after its sub-steps */
+    DESC_END,
+
+    /* Fragments */
+    DESC_TEXT,          /* Prose */
+    DESC_NAME,          /* A name from the source: a variable, function, member or label */
+    DESC_CODE,          /* Other source text: a type, a literal or a header */
+    DESC_NUMBER         /* A count, held in value */
+} DescriptionKind;
+
+/* Record flags */
+#define DESC_CAPITALISE 1   /* On a block: the sentence's first letter is made a capital */
+#define DESC_QUOTED 2       /* On code: the text form puts it in quotes, as it does names */
+
+/*
+ * One record. Text is not copied: it points at a string literal, the
+ * interned text of the tree or the included headers' declarations, so a
+ * description is only valid while those are.
+ */
+typedef struct {
+    unsigned char kind;     /* DescriptionKind */
+    unsigned char flags;
+    int value;              /* A fragment's length, a step's number or a number's value */
+    const char* text;
+} DescriptionRecord;
+
+/*
+ * A structured description of a programme, as the translator produces it:
+ * a flat sequence of records in the order they are read, so descriptions
+ * built separately join by appending records and the renderers walk one
+ * front to back, in one pass, whatever the output format.
+ */
+typedef struct {
+    DescriptionRecord* records;
+    int count;
+    int capacity;
+} Description;
+
+/* Description creation and destruction */
+Description* description_create(void);
+void description_destroy(Description* description);
+void description_clear(Description* description);
+
+/* Blocks */
+void description_begin(Description* description, DescriptionKind kind, int value, int flags);
+void description_end(Description* description);
+
+/* Fragments; empty prose adds nothing */
+void description_text(Description* description, const char* text);
+void description_name(Description* description, const char* name);
+void description_code(Description* description, const char* code);
+void description_quoted_code(Description* description, const char* code);
+void description_number(Description* description, int value);
+
+/* Append a copy of every record of src */
+void description_append(Description* description, const Description* src);
+
+#endif /* DESCRIPTION_H */
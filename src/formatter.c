@@ -1,27 +1,505 @@
 #include "formatter.h"
+#include "render.h"
+#include "scan.h"
+#include "thread.h"
 
-/* Apply British English spelling conventions */
-char* apply_british_spelling(const char* text) {
-    if (!text) return NULL;
+#define FORMATTER_INITIAL_LINE 256
+#define FORMATTER_INITIAL_BREAKS 32
 
-    /* For now, just return a copy since we're already using British terms */
-    /* In future, could add automatic conversion of American spellings */
-    return string_duplicate(text);
+/* Buffers */
+
+static void append_text(char** buffer, size_t* length, size_t* capacity, const char* text, size_t count) {
+    if (count == 0) return;
+    if (*length + count > *capacity) {
+        size_t grown = *capacity ? *capacity : FORMATTER_INITIAL_LINE;
+        while (*length + count > grown) {
+            grown *= 2;
+        }
+        *buffer = (char*)safe_realloc(*buffer, grown);
+        *capacity = grown;
+    }
+    memcpy(*buffer + *length, text, count);
+    *length += count;
 }
 
-/* Format English output */
-char* format_english_output(const char* raw_output) {
-    if (!raw_output) return NULL;
+static void add_break(Formatter* formatter, size_t offset) {
+    if (formatter->break_count == formatter->break_capacity) {
+        formatter->break_capacity = formatter->break_capacity ? formatter->break_capacity * 2
+                                                              : FORMATTER_INITIAL_BREAKS;
+        formatter->breaks = (size_t*)safe_realloc(formatter->breaks,
+                                                  sizeof(size_t) * formatter->break_capacity);
+    }
+    formatter->breaks[formatter->break_count++] = offset;
+}
+
+static void add_code(Formatter* formatter, size_t start, size_t end) {
+    if (formatter->code_count == formatter->code_capacity) {
+        formatter->code_capacity = formatter->code_capacity ? formatter->code_capacity * 2
+                                                            : FORMATTER_INITIAL_BREAKS;
+        formatter->code = (size_t*)safe_realloc(formatter->code, sizeof(size_t) * 2 * formatter->code_capacity);
+    }
+    formatter->code[2 * formatter->code_count] = start;
+    formatter->code[2 * formatter->code_count + 1] = end;
+    formatter->code_count++;
+}
+
+/* Characters */
+
+/*
+ * Each byte's class: a letter's place in the alphabet or SPELLING_DIGIT,
+ * which are the spelling automaton's columns and make up words, or
+ * CLASS_OTHER.
+ */
+#define CLASS_OTHER SPELLING_COLUMNS
+
+static unsigned char byte_class[256];
+static ThreadOnce byte_class_once = THREAD_ONCE_INIT;
+
+static void build_byte_class(void) {
+    for (int c = 0; c < 256; c++) {
+        int class_of = CLASS_OTHER;
+        if (c >= 'a' && c <= 'z') {
+            class_of = c - 'a';
+        } else if (c >= 'A' && c <= 'Z') {
+            class_of = c - 'A';
+        } else if ((c >= '0' && c <= '9') || c == '_' || c >= 0x80) {
+            class_of = SPELLING_DIGIT;
+        }
+        byte_class[c] = (unsigned char)class_of;
+    }
+}
+
+#define CLASS_OF(c) byte_class[(unsigned char)(c)]
+
+static int is_upper(unsigned char c) {
+    return c >= 'A' && c <= 'Z';
+}
+
+/* Display columns: UTF-8 continuation bytes take none */
+static size_t columns(const char* text, size_t length) {
+    size_t count = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (((unsigned char)text[i] & 0xC0) != 0x80) count++;
+    }
+    return count;
+}
+
+/* A heading's underline */
+static int is_underline(const char* text, size_t length) {
+    if (length == 0 || (text[0] != '-' && text[0] != '=')) return 0;
+    for (size_t i = 1; i < length; i++) {
+        if (text[i] != text[0]) return 0;
+    }
+    return 1;
+}
+
+/* Spelling */
+
+/* Append british in place of original, capitalised as original is */
+static void append_spelling(Formatter* formatter, const char* british, size_t length, const char* original,
+                            size_t original_length) {
+    size_t start = formatter->spelt_length;
+    append_text(&formatter->spelt, &formatter->spelt_length, &formatter->spelt_capacity, british, length);
+    if (!is_upper((unsigned char)original[0])) return;
+
+    int all_upper = original_length > 1;
+    for (size_t i = 1; i < original_length && all_upper; i++) {
+        all_upper = is_upper((unsigned char)original[i]);
+    }
+    size_t end = all_upper ? formatter->spelt_length : start + (length > 0);
+    for (size_t i = start; i < end; i++) {
+        char c = formatter->spelt[i];
+        if (c >= 'a' && c <= 'z') formatter->spelt[i] = (char)(c - 'a' + 'A');
+    }
+}
+
+/* The class of text[i] if it is a letter, else SPELLING_DIGIT, for prefixes */
+static int prefix_letter(const char* text, size_t i, size_t length) {
+    int class_of = i < length ? CLASS_OF(text[i]) : SPELLING_DIGIT;
+    return class_of < SPELLING_ALPHABET ? class_of : SPELLING_DIGIT;
+}
+
+/*
+ * Run the automaton over the word starting at text[start] (a letter whose
+ * prefix passed the filter); returns the end of the part it read, which is
+ * the end of the word unless no dictionary word continues that way, and
+ * sets *row to the state reached.
+ */
+static size_t follow_word(const SpellingDictionary* spelling, const char* text, size_t start, size_t length,
+                          int* row) {
+    const int* next = spelling->next;
+    int state = next[CLASS_OF(text[start])];
+    size_t i = start + 1;
+    int class_of;
+    while (state != SPELLING_DEAD && i < length && (class_of = CLASS_OF(text[i])) <= SPELLING_DIGIT) {
+        state = next[state + class_of];
+        i++;
+    }
+    *row = state;
+    return i;
+}
+
+/*
+ * Copy text[before, start) - up to a code mark - and the code from
+ * text[start] to its closing mark into spelt, without the marks, noting
+ * where the code lies in spelt; returns the end of the code and its mark.
+ * Code with no closing mark runs on into the next line.
+ */
+static size_t copy_code(Formatter* formatter, const char* text, size_t before, size_t start, size_t length,
+                        size_t* copied) {
+    size_t end = scan_find_byte(text, start, length, RENDER_CODE_CLOSE);
+    formatter->in_code = end == length;
+    append_text(&formatter->spelt, &formatter->spelt_length, &formatter->spelt_capacity, text + *copied,
+                before - *copied);
+    size_t code_start = formatter->spelt_length;
+    append_text(&formatter->spelt, &formatter->spelt_length, &formatter->spelt_capacity, text + start,
+                end - start);
+    add_code(formatter, code_start, formatter->spelt_length);
+    *copied = end < length ? end + 1 : length;
+    return *copied;
+}
+
+/*
+ * Respell the word starting at text[i], or take the code marked there,
+ * appending what comes before a changed word or a mark to spelt; returns
+ * where the next word or mark may start. Without respell only marks are
+ * taken.
+ */
+static size_t spell_word(Formatter* formatter, const char* text, size_t i, size_t length, int respell,
+                         size_t* copied) {
+    const SpellingDictionary* spelling = formatter->spelling;
+    if (text[i] == RENDER_CODE_OPEN) return copy_code(formatter, text, i, i + 1, length, copied);
+    if (text[i] == RENDER_CODE_CLOSE) {
+        append_text(&formatter->spelt, &formatter->spelt_length, &formatter->spelt_capacity, text + *copied,
+                    i - *copied);
+        *copied = i + 1;
+        return i + 1;
+    }
+    if (!respell) return i + 1;
+
+    int class_of = CLASS_OF(text[i]);
+
+    int second = prefix_letter(text, i + 1, length);
+    int third = second < SPELLING_ALPHABET ? prefix_letter(text, i + 2, length) : SPELLING_DIGIT;
+    int prefix = SPELLING_PREFIX(class_of, second, third);
+    if (!(spelling->prefixes[prefix / 8] & (1u << (prefix % 8)))) return i + 1;
+
+    int row;
+    size_t end = follow_word(spelling, text, i, length, &row);
+    size_t british_length;
+    const char* british = NULL;
+    if (end == length || CLASS_OF(text[end]) > SPELLING_DIGIT) {
+        british = spelling_replacement(spelling, row, &british_length);
+    }
+    if (british) {
+        append_text(&formatter->spelt, &formatter->spelt_length, &formatter->spelt_capacity,
+                    text + *copied, i - *copied);
+        append_spelling(formatter, british, british_length, text + i, end - i);
+        *copied = end;
+    }
+    return end;
+}
+
+/*
+ * A line with British spellings, or with none when respell is 0, and
+ * without code marks: text itself when no word changes and nothing is
+ * marked, else spelt, with the code in it noted for wrapping.
+ */
+static const char* spell_line(Formatter* formatter, const char* text, size_t length, int respell,
+                              size_t* result_length) {
+    formatter->spelt_length = 0;
+    formatter->code_count = 0;
+
+    size_t copied = 0;      /* text before this is already in spelt */
+    size_t from = formatter->in_code ? copy_code(formatter, text, 0, 0, length, &copied) : 0;
+    while (from < length) {
+        uint64_t starts = scan_word_starts(text, from, length);
+        size_t resume = from + SCAN_WORD_SPAN;
+        while (starts) {
+            size_t i = from + (size_t)scan_lowest_bit(starts);
+            size_t end = spell_word(formatter, text, i, length, respell, &copied);
+            if (end - from >= SCAN_WORD_SPAN) {
+                resume = end;
+                break;
+            }
+            starts &= ~(uint64_t)0 << (end - from);
+        }
+        from = resume;
+    }
+
+    if (copied == 0) {
+        *result_length = length;
+        return text;
+    }
+    append_text(&formatter->spelt, &formatter->spelt_length, &formatter->spelt_capacity, text + copied,
+                length - copied);
+    *result_length = formatter->spelt_length;
+    return formatter->spelt;
+}
 
-    /* Apply British spelling conventions */
-    char* formatted = apply_british_spelling(raw_output);
+/* Wrapping */
 
-    /* Additional formatting could be added here:
-     * - Paragraph wrapping
-     * - Line length limits
-     * - Enhanced indentation
-     * - Table of contents generation
-     */
+/*
+ * Note the spaces a spelt line may be broken at: those outside code and
+ * outside the double quotes the translator puts round a condition, which
+ * is kept whole.
+ */
+static void find_breaks(Formatter* formatter, const char* text, size_t length) {
+    formatter->break_count = 0;
+    int quoted = 0;
+    size_t i = 0;
+    for (int k = 0; k <= formatter->code_count; k++) {
+        size_t end = k < formatter->code_count ? formatter->code[2 * k] : length;
+        for (; i < end; i++) {
+            if (text[i] == '"') {
+                quoted = !quoted;
+            } else if (text[i] == ' ' && !quoted) {
+                add_break(formatter, i);
+            }
+        }
+        if (k < formatter->code_count) i = formatter->code[2 * k + 1];
+    }
+}
+
+/* Columns a wrapped line's continuations are indented by: past a list item's marker, else its indentation */
+static size_t hanging_indent(const char* text, size_t length, size_t* text_start) {
+    size_t indent = 0;
+    while (indent < length && text[indent] == ' ') {
+        indent++;
+    }
+    *text_start = indent;
+
+    /* "• " */
+    if (length - indent >= 4 && memcmp(text + indent, "\xE2\x80\xA2 ", 4) == 0) {
+        *text_start = indent + 4;
+        return indent + 2;
+    }
+
+    /* "1. " */
+    size_t digits = indent;
+    while (digits < length && text[digits] >= '0' && text[digits] <= '9') {
+        digits++;
+    }
+    if (digits > indent && length - digits >= 2 && text[digits] == '.' && text[digits + 1] == ' ') {
+        *text_start = digits + 2;
+        return digits + 2;
+    }
+    return indent;
+}
+
+/*
+ * Write a spelt line broken into lines of at most wrap_width columns where its
+ * breaks allow: each piece ends at the last break that keeps it within the
+ * width, or at the first break when even that does not.
+ */
+static void wrap_line(Formatter* formatter, const char* text, size_t length, OutputBuilder* out) {
+    size_t width = (size_t)formatter->wrap_width;
+    find_breaks(formatter, text, length);
+    size_t text_start;
+    size_t hang = hanging_indent(text, length, &text_start);
+
+    int next = 0;
+    while (next < formatter->break_count && formatter->breaks[next] < text_start) {
+        next++;
+    }
+
+    size_t start = 0;
+    size_t column = 0;      /* Columns the piece's indentation takes */
+    for (;;) {
+        int chosen = -1;
+        size_t used = column;
+        size_t position = start;
+        int k = next;
+        for (; k < formatter->break_count; k++) {
+            size_t offset = formatter->breaks[k];
+            size_t reach = used + columns(text + position, offset - position);
+            if (reach > width && chosen >= 0) break;
+            used = reach;
+            position = offset;
+            chosen = k;
+            if (used > width) break;
+        }
+        if (chosen < 0 || (k == formatter->break_count &&
+                           used + columns(text + position, length - position) <= width)) {
+            output_append_length(out, text + start, length - start);
+            return;
+        }
+
+        size_t end = formatter->breaks[chosen];
+        while (end > start && text[end - 1] == ' ') {
+            end--;
+        }
+        output_append_length(out, text + start, end - start);
+        output_append_char(out, '\n');
+        for (size_t i = 0; i < hang; i++) {
+            output_append_char(out, ' ');
+        }
+        column = hang;
+
+        start = formatter->breaks[chosen] + 1;
+        while (start < length && text[start] == ' ') {
+            start++;
+        }
+        next = chosen + 1;
+        while (next < formatter->break_count && formatter->breaks[next] < start) {
+            next++;
+        }
+    }
+}
+
+/* Lines */
+
+/* Write the run of unchanged lines waiting in the text being fed */
+static void flush_run(Formatter* formatter, OutputBuilder* out) {
+    output_append_length(out, formatter->run, formatter->run_length);
+    formatter->run_length = 0;
+}
+
+/*
+ * Write a line, and its newline when it has one. A line of the text being
+ * fed that goes out unchanged joins the run of such lines before it, newline
+ * and all, so a run is written in one piece.
+ */
+static void write_line(Formatter* formatter, const char* text, size_t length, int verbatim, int newline,
+                       OutputBuilder* out) {
+    size_t spelt_length = length;
+    const char* spelt = spell_line(formatter, text, length, !verbatim, &spelt_length);
+    int wrap = formatter->wrap_width > 0 && columns(spelt, spelt_length) > (size_t)formatter->wrap_width;
+
+    if (spelt == text && !wrap && newline && text != formatter->held && text != formatter->line) {
+        if (formatter->run_length > 0 && formatter->run + formatter->run_length != text) {
+            flush_run(formatter, out);
+        }
+        if (formatter->run_length == 0) formatter->run = text;
+        formatter->run_length += length + 1;
+        return;
+    }
+
+    flush_run(formatter, out);
+    if (wrap) {
+        wrap_line(formatter, spelt, spelt_length, out);
+    } else {
+        output_append_length(out, spelt, spelt_length);
+    }
+    if (newline) output_append_char(out, '\n');
+}
+
+/* Write the held line, now that the line after it (or none) is known */
+static void release_held(Formatter* formatter, const char* next_line, size_t next_length, OutputBuilder* out) {
+    write_line(formatter, formatter->held_text, formatter->held_length, is_underline(next_line, next_length), 1,
+               out);
+}
+
+/* A whole line has arrived: write the one before it and hold this one */
+static void end_line(Formatter* formatter, const char* text, size_t length, OutputBuilder* out) {
+    if (formatter->holding) {
+        release_held(formatter, text, length, out);
+    }
+    formatter->held_text = text;
+    formatter->held_length = length;
+    formatter->holding = 1;
+
+    /* A line gathered across pieces becomes the held copy */
+    if (text == formatter->line) {
+        char* line = formatter->held;
+        size_t capacity = formatter->held_capacity;
+        formatter->held = formatter->line;
+        formatter->held_capacity = formatter->line_capacity;
+        formatter->line = line;
+        formatter->line_length = 0;
+        formatter->line_capacity = capacity;
+    }
+}
+
+/* Formatting */
+
+void formatter_begin(Formatter* formatter, const FormatOptions* options) {
+    thread_once(&byte_class_once, build_byte_class);
+    formatter->spelling = options && options->spelling ? options->spelling : spelling_dictionary_default();
+    formatter->wrap_width = options ? options->wrap_width : 0;
+    formatter->line = NULL;
+    formatter->line_length = 0;
+    formatter->line_capacity = 0;
+    formatter->held = NULL;
+    formatter->held_capacity = 0;
+    formatter->held_text = NULL;
+    formatter->held_length = 0;
+    formatter->holding = 0;
+    formatter->run = NULL;
+    formatter->run_length = 0;
+    formatter->spelt = NULL;
+    formatter->spelt_length = 0;
+    formatter->spelt_capacity = 0;
+    formatter->breaks = NULL;
+    formatter->break_count = 0;
+    formatter->break_capacity = 0;
+    formatter->code = NULL;
+    formatter->code_count = 0;
+    formatter->code_capacity = 0;
+    formatter->in_code = 0;
+}
+
+void formatter_feed(Formatter* formatter, const char* text, size_t length, OutputBuilder* out) {
+    while (length > 0) {
+        const char* newline = (const char*)memchr(text, '\n', length);
+        if (!newline) {
+            append_text(&formatter->line, &formatter->line_length, &formatter->line_capacity, text, length);
+            break;
+        }
+
+        /* Lines wholly inside text are used where they are */
+        size_t count = (size_t)(newline - text);
+        if (formatter->line_length > 0) {
+            append_text(&formatter->line, &formatter->line_length, &formatter->line_capacity, text, count);
+            end_line(formatter, formatter->line, formatter->line_length, out);
+        } else {
+            end_line(formatter, text, count, out);
+        }
+        text += count + 1;
+        length -= count + 1;
+    }
+
+    /* text is the caller's, so nothing may point into it once this returns */
+    flush_run(formatter, out);
+    if (formatter->holding && formatter->held_text != formatter->held) {
+        size_t held_length = 0;
+        append_text(&formatter->held, &held_length, &formatter->held_capacity, formatter->held_text,
+                    formatter->held_length);
+        formatter->held_text = formatter->held;
+    }
+}
+
+void formatter_end(Formatter* formatter, OutputBuilder* out) {
+    if (formatter->holding) {
+        release_held(formatter, formatter->line, formatter->line_length, out);
+    }
+    if (formatter->line_length > 0) {
+        write_line(formatter, formatter->line, formatter->line_length, 0, 0, out);
+    }
+
+    free(formatter->line);
+    free(formatter->held);
+    free(formatter->spelt);
+    free(formatter->breaks);
+    free(formatter->code);
+    formatter->line = NULL;
+    formatter->held = NULL;
+    formatter->spelt = NULL;
+    formatter->breaks = NULL;
+    formatter->code = NULL;
+    formatter->holding = 0;
+    formatter->in_code = 0;
+}
+
+/* Format English output */
+void format_english_output(const OutputBuilder* raw_output, OutputBuilder* formatted,
+                           const FormatOptions* options) {
+    if (!raw_output) return;
 
-    return formatted;
+    Formatter formatter;
+    formatter_begin(&formatter, options);
+    for (OutputChunk* chunk = raw_output->head; chunk; chunk = chunk->next) {
+        formatter_feed(&formatter, chunk->data, chunk->length, formatted);
+    }
+    formatter_end(&formatter, formatted);
 }
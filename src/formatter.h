@@ -1,12 +1,57 @@
 #ifndef FORMATTER_H
 #define FORMATTER_H
 
+#include "output.h"
+#include "spelling.h"
 #include "utils.h"
 
-/* Formatter functions */
-char* format_english_output(const char* raw_output);
+/* How raw English is turned into the final text */
+typedef struct {
+    const SpellingDictionary* spelling;     /* NULL for the built-in dictionary */
+    int wrap_width;                         /* Columns per line, or 0 to leave lines as they are */
+} FormatOptions;
 
-/* British English spelling conversions */
-char* apply_british_spelling(const char* text);
+/*
+ * Formatter state for text that arrives in pieces, as the text renderer
+ * writes it. Text is formatted a line at a time, in one pass: words outside
+ * code get their British spelling, keeping their capitalisation, and with a
+ * wrap width long lines are broken at spaces outside code and quoted
+ * conditions, continuing under the text of a list item. Code - the names, types, literals and headers
+ * the renderer marks - and headings, a line over a line of '-' or '=', are
+ * copied as they are, less the marks.
+ */
+typedef struct {
+    const SpellingDictionary* spelling;
+    int wrap_width;
+    char* line;             /* The start of a line, gathered until its end arrives */
+    size_t line_length;
+    size_t line_capacity;
+    const char* held_text;  /* The last whole line, until the next shows whether it is a heading */
+    size_t held_length;
+    int holding;
+    const char* run;        /* Lines written unchanged, in the text being fed, not yet copied out */
+    size_t run_length;
+    char* held;             /* held_text's copy, when it is not in the text being fed */
+    size_t held_capacity;
+    char* spelt;            /* A line with British spellings, when a word changed */
+    size_t spelt_length;
+    size_t spelt_capacity;
+    size_t* breaks;         /* Offsets of the spaces the spelt line may be broken at */
+    int break_count;
+    int break_capacity;
+    size_t* code;           /* Start and end offsets of the code in the spelt line */
+    int code_count;
+    int code_capacity;
+    int in_code;            /* The last line ended inside code */
+} Formatter;
+
+/* Formatting text a piece at a time; formatter_end writes what is left and frees the state */
+void formatter_begin(Formatter* formatter, const FormatOptions* options);
+void formatter_feed(Formatter* formatter, const char* text, size_t length, OutputBuilder* out);
+void formatter_end(Formatter* formatter, OutputBuilder* out);
+
+/* Format the whole of raw_output into formatted; options may be NULL for the defaults */
+void format_english_output(const OutputBuilder* raw_output, OutputBuilder* formatted,
+                           const FormatOptions* options);
 
 #endif /* FORMATTER_H */
@@ -0,0 +1,1118 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <sys/stat.h>
+#include <time.h>
+
+#include "header.h"
+#include "lexer.h"
+#include "scan.h"
+#include "source.h"
+
+/* Bump when the summary layout or what a summary records changes */
+#define HEADER_FORMAT_VERSION "1"
+
+#define HEADER_MAGIC "c2en header summary " HEADER_FORMAT_VERSION
+#define HEADER_EXTENSION ".hdr"
+#define HEADER_ARENA_BLOCK_SIZE 4096
+#define HEADER_INITIAL_CAPACITY 64
+
+/* Summaries */
+
+static HeaderSummary* summary_create(const char* path) {
+    HeaderSummary* summary = (HeaderSummary*)safe_malloc(sizeof(HeaderSummary));
+    summary->path = string_duplicate(path);
+    summary->mtime = 0;
+    summary->size = 0;
+    summary->hash = 0;
+    summary->verified = 0;
+    summary->entries = NULL;
+    summary->entry_count = 0;
+    summary->entry_capacity = 0;
+    summary->includes = NULL;
+    summary->include_count = 0;
+    summary->include_capacity = 0;
+    summary->arena = arena_create(HEADER_ARENA_BLOCK_SIZE);
+    summary->next = NULL;
+    return summary;
+}
+
+static void summary_destroy(HeaderSummary* summary) {
+    if (!summary) return;
+
+    arena_destroy(summary->arena);
+    free(summary->includes);
+    free(summary->entries);
+    free(summary->path);
+    free(summary);
+}
+
+/* Copy text into the summary on one line: tabs and line breaks become spaces */
+static const char* summary_text(HeaderSummary* summary, const char* text, size_t length) {
+    char* copy = arena_strndup(summary->arena, text, length);
+    for (char* c = copy; *c; c++) {
+        if (*c == '\t' || *c == '\n' || *c == '\r') *c = ' ';
+    }
+    return copy;
+}
+
+static void add_entry(HeaderSummary* summary, HeaderEntryKind kind, const char* name, const char* type,
+                      const char* detail) {
+    if (summary->entry_count >= summary->entry_capacity) {
+        summary->entry_capacity = summary->entry_capacity ? summary->entry_capacity * 2 : 16;
+        summary->entries = (HeaderEntry*)safe_realloc(summary->entries,
+                                                      sizeof(HeaderEntry) * summary->entry_capacity);
+    }
+
+    HeaderEntry* entry = &summary->entries[summary->entry_count++];
+    entry->kind = kind;
+    entry->name = name;
+    entry->type = type ? type : "";
+    entry->detail = detail ? detail : "";
+}
+
+static void add_include(HeaderSummary* summary, const char* name, int system) {
+    if (summary->include_count >= summary->include_capacity) {
+        summary->include_capacity = summary->include_capacity ? summary->include_capacity * 2 : 8;
+        summary->includes = (HeaderInclude*)safe_realloc(summary->includes,
+                                                         sizeof(HeaderInclude) * summary->include_capacity);
+    }
+
+    HeaderInclude* include = &summary->includes[summary->include_count++];
+    include->name = name;
+    include->system = system;
+}
+
+/*
+ * Directives. The lexer skips every '#' line, so includes and macros are
+ * read from the text directly: a directive is a '#' that starts a line,
+ * outside comments, and runs to the first newline not escaped by a
+ * backslash.
+ */
+
+static size_t skip_spaces(const char* text, size_t from, size_t end) {
+    while (from < end && (text[from] == ' ' || text[from] == '\t')) from++;
+    return from;
+}
+
+static size_t directive_end(const char* text, size_t from, size_t end) {
+    size_t newline = from;
+    for (;;) {
+        newline = scan_find_byte(text, newline, end, '\n');
+        if (newline >= end) return end;
+
+        size_t last = newline;
+        if (last > from && text[last - 1] == '\r') last--;
+        if (last > from && text[last - 1] == '\\') {
+            newline++;
+            continue;
+        }
+        return newline;
+    }
+}
+
+/* Text from..to with runs of blanks and escaped newlines reduced to one space, up to any comment */
+static const char* directive_text(HeaderSummary* summary, const char* text, size_t from, size_t to) {
+    char* copy = (char*)arena_alloc(summary->arena, to - from + 1);
+    size_t length = 0;
+    int blank = 0;
+    char quote = 0;
+
+    for (size_t i = from; i < to; i++) {
+        char c = text[i];
+        int escaped_newline = c == '\\' && i + 1 < to && (text[i + 1] == '\n' || text[i + 1] == '\r');
+        if (!quote && c == '/' && i + 1 < to && (text[i + 1] == '*' || text[i + 1] == '/')) break;
+        if (!quote && (c == ' ' || c == '\t' || c == '\r' || c == '\n' || escaped_newline)) {
+            blank = length > 0;
+            continue;
+        }
+
+        if (quote && c == '\\' && i + 1 < to) {
+            copy[length++] = c;
+            c = text[++i];
+        } else if (c == '"' || c == '\'') {
+            quote = quote == c ? 0 : quote ? quote : c;
+        }
+        if (blank) copy[length++] = ' ';
+        blank = 0;
+        copy[length++] = c == '\t' || c == '\r' || c == '\n' ? ' ' : c;
+    }
+
+    copy[length] = '\0';
+    return copy;
+}
+
+/* Record an #include, and with macros set a #define, from the directive at from..to */
+static void read_directive(HeaderSummary* summary, const char* text, size_t from, size_t to, int macros) {
+    size_t word = skip_spaces(text, from + 1, to);
+    size_t word_end = scan_identifier_end(text, word, to);
+    size_t rest = skip_spaces(text, word_end, to);
+
+    if (word_end - word == 7 && memcmp(text + word, "include", 7) == 0) {
+        if (rest >= to || (text[rest] != '"' && text[rest] != '<')) return;
+
+        char close = text[rest] == '"' ? '"' : '>';
+        size_t name_end = rest + 1;
+        while (name_end < to && text[name_end] != close && text[name_end] != '\n') name_end++;
+        if (name_end >= to || text[name_end] != close || name_end == rest + 1) return;
+
+        add_include(summary, summary_text(summary, text + rest + 1, name_end - rest - 1), close == '>');
+    } else if (macros && word_end - word == 6 && memcmp(text + word, "define", 6) == 0) {
+        size_t name_end = scan_identifier_end(text, rest, to);
+        if (name_end == rest || !is_identifier_start(text[rest])) return;
+        const char* name = summary_text(summary, text + rest, name_end - rest);
+
+        /* A parenthesis straight after the name opens a parameter list */
+        if (name_end < to && text[name_end] == '(') {
+            size_t close = scan_find_byte(text, name_end, to, ')');
+            if (close >= to) return;
+            add_entry(summary, HEADER_MACRO, name, "", directive_text(summary, text, rest, close + 1));
+            return;
+        }
+
+        /* Empty definitions (include guards, feature flags) are not values */
+        const char* value = directive_text(summary, text, name_end, to);
+        if (*value) {
+            add_entry(summary, HEADER_CONSTANT, name, "", value);
+        }
+    }
+}
+
+/* One past the literal starting with the quote at from */
+static size_t literal_end(const char* text, size_t from, size_t end) {
+    char quote = text[from];
+    size_t at = from + 1;
+    while (at < end) {
+        at = scan_find_quote(text, at, end, quote);
+        if (at >= end) return end;
+        if (text[at] == '\\') {
+            at += 2;
+            continue;
+        }
+        return at + 1;
+    }
+    return end;
+}
+
+/*
+ * Read every directive in text. With blanked (a copy of text) given, macros
+ * are recorded too and each directive is overwritten with spaces in it, so
+ * the continuation lines of a multi-line macro never reach the lexer.
+ */
+static void read_directives(HeaderSummary* summary, const char* text, size_t length, char* blanked) {
+    size_t at = 0;
+    int line_start = 1;
+
+    while (at < length) {
+        char c = text[at];
+        if (c == '\n') {
+            line_start = 1;
+            at++;
+        } else if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
+            at++;
+        } else if (c == '/' && at + 1 < length && text[at + 1] == '*') {
+            size_t close = scan_find_comment_end(text, at + 2, length);
+            at = close < length ? close + 2 : length;
+        } else if (c == '/' && at + 1 < length && text[at + 1] == '/') {
+            at = scan_find_byte(text, at, length, '\n');
+        } else if (c == '#' && line_start) {
+            size_t end = directive_end(text, at, length);
+            read_directive(summary, text, at, end, blanked != NULL);
+            if (blanked) {
+                for (size_t i = at; i < end; i++) {
+                    if (blanked[i] != '\n') blanked[i] = ' ';
+                }
+            }
+            at = end;
+        } else if (c == '"' || c == '\'') {
+            line_start = 0;
+            at = literal_end(text, at, length);
+        } else {
+            line_start = 0;
+            at++;
+        }
+    }
+}
+
+/*
+ * Declarations. The header is lexed with the directives blanked out and
+ * split into top-level declarations: runs of tokens ending in a ';' outside
+ * any brackets, or in the closing brace of a function body.
+ */
+
+typedef struct {
+    Token* tokens;
+    int count;
+    int capacity;
+} TokenRun;
+
+static void run_push(TokenRun* run, Token token) {
+    if (run->count >= run->capacity) {
+        run->capacity = run->capacity ? run->capacity * 2 : 64;
+        run->tokens = (Token*)safe_realloc(run->tokens, sizeof(Token) * run->capacity);
+    }
+    run->tokens[run->count++] = token;
+}
+
+static int is_open(TokenType type) {
+    return type == TOKEN_LPAREN || type == TOKEN_LBRACKET || type == TOKEN_LBRACE;
+}
+
+static int is_close(TokenType type) {
+    return type == TOKEN_RPAREN || type == TOKEN_RBRACKET || type == TOKEN_RBRACE;
+}
+
+static int is_tag_keyword(TokenType type) {
+    return type == TOKEN_STRUCT || type == TOKEN_UNION || type == TOKEN_ENUM;
+}
+
+static int is_word(const Token* token, const char* word) {
+    size_t length = strlen(word);
+    return token->type == TOKEN_IDENTIFIER && (size_t)token->length == length &&
+           memcmp(token->start, word, length) == 0;
+}
+
+/* Index of the bracket closing the one at open, or to if it is not closed before to */
+static int matching_close(const Token* tokens, int open, int to) {
+    int depth = 0;
+    for (int i = open; i < to; i++) {
+        if (is_open(tokens[i].type)) depth++;
+        if (is_close(tokens[i].type) && --depth == 0) return i;
+    }
+    return to;
+}
+
+/* Next index from from with a token of type outside brackets, or to */
+static int find_outside(const Token* tokens, int from, int to, TokenType type) {
+    int depth = 0;
+    for (int i = from; i < to; i++) {
+        if (depth == 0 && tokens[i].type == type) return i;
+        if (is_open(tokens[i].type)) depth++;
+        if (is_close(tokens[i].type) && depth > 0) depth--;
+    }
+    return to;
+}
+
+/* Whether the token at index is written with a space before it */
+static int space_before(const Token* tokens, int from, int index) {
+    TokenType left = tokens[index - 1].type;
+    TokenType right = tokens[index].type;
+
+    if (right == TOKEN_RPAREN || right == TOKEN_RBRACKET || right == TOKEN_LBRACKET ||
+        right == TOKEN_COMMA || right == TOKEN_SEMICOLON || right == TOKEN_STAR || right == TOKEN_DOT) {
+        return 0;
+    }
+    if (left == TOKEN_LPAREN || left == TOKEN_LBRACKET || left == TOKEN_DOT) return 0;
+    if (right == TOKEN_LPAREN) return left != TOKEN_IDENTIFIER && left != TOKEN_RPAREN;
+
+    /* "(*name)" and unary signs stay attached to what follows */
+    if (left == TOKEN_STAR || left == TOKEN_MINUS || left == TOKEN_PLUS || left == TOKEN_TILDE ||
+        left == TOKEN_NOT) {
+        if (index - 1 == from) return 0;
+        TokenType before = tokens[index - 2].type;
+        if (left == TOKEN_STAR) return before != TOKEN_LPAREN;
+        return before == TOKEN_IDENTIFIER || before == TOKEN_NUMBER || before == TOKEN_RPAREN ||
+               before == TOKEN_RBRACKET;
+    }
+    return 1;
+}
+
+/* The tokens from..to as one line of normalised C */
+static const char* join_tokens(HeaderSummary* summary, const Token* tokens, int from, int to) {
+    size_t length = 0;
+    for (int i = from; i < to; i++) {
+        length += (size_t)tokens[i].length + 1;
+    }
+
+    char* text = (char*)arena_alloc(summary->arena, length + 1);
+    length = 0;
+    for (int i = from; i < to; i++) {
+        if (i > from && space_before(tokens, from, i)) text[length++] = ' ';
+        memcpy(text + length, tokens[i].start, (size_t)tokens[i].length);
+        length += (size_t)tokens[i].length;
+    }
+    text[length] = '\0';
+
+    for (char* c = text; *c; c++) {
+        if (*c == '\t' || *c == '\n' || *c == '\r') *c = ' ';
+    }
+    return text;
+}
+
+static const char* token_name(HeaderSummary* summary, const Token* token) {
+    return summary_text(summary, token->start, (size_t)token->length);
+}
+
+/*
+ * Index of the name a declarator declares, or -1: the identifier of a
+ * "(*name)" if there is one, otherwise the last identifier outside brackets
+ * before any initialiser, array bounds or bit-field width, unless that is a
+ * structure tag.
+ */
+static int declarator_name(const Token* tokens, int from, int to) {
+    int depth = 0;
+    int name = -1;
+
+    for (int i = from; i < to; i++) {
+        TokenType type = tokens[i].type;
+        if (type == TOKEN_LPAREN && i + 2 < to && tokens[i + 1].type == TOKEN_STAR &&
+            tokens[i + 2].type == TOKEN_IDENTIFIER) {
+            return i + 2;
+        }
+        if (depth == 0 && (type == TOKEN_ASSIGN || type == TOKEN_COLON || type == TOKEN_LBRACKET)) break;
+        if (is_open(type)) depth++;
+        if (is_close(type) && depth > 0) depth--;
+        if (depth == 0 && type == TOKEN_IDENTIFIER && !(i > from && is_tag_keyword(tokens[i - 1].type))) {
+            name = i;
+        }
+    }
+    return name;
+}
+
+/* Comma-separated names declared by the member declarations between braces */
+static const char* member_list(HeaderSummary* summary, const Token* tokens, int from, int to) {
+    size_t length = 0;
+    for (int i = from; i < to; i++) {
+        length += (size_t)tokens[i].length + 2;
+    }
+
+    char* list = (char*)arena_alloc(summary->arena, length + 1);
+    length = 0;
+
+    for (int start = from; start < to;) {
+        int end = find_outside(tokens, start, to, TOKEN_SEMICOLON);
+
+        /* A nested structure's declarators follow its closing brace */
+        int declarators = start;
+        int body = find_outside(tokens, start, end, TOKEN_LBRACE);
+        if (body < end) declarators = matching_close(tokens, body, end) + 1;
+
+        for (int item = declarators; item < end;) {
+            int item_end = find_outside(tokens, item, end, TOKEN_COMMA);
+            int name = declarator_name(tokens, item, item_end);
+            if (name >= 0) {
+                if (length > 0) {
+                    memcpy(list + length, ", ", 2);
+                    length += 2;
+                }
+                memcpy(list + length, tokens[name].start, (size_t)tokens[name].length);
+                length += (size_t)tokens[name].length;
+            }
+            item = item_end + 1;
+        }
+        start = end + 1;
+    }
+
+    list[length] = '\0';
+    return list;
+}
+
+/* Record the constants of an enumeration body; returns their names, comma-separated */
+static const char* enumerators(HeaderSummary* summary, const Token* tokens, int from, int to,
+                               const char* type) {
+    for (int item = from; item < to;) {
+        int end = find_outside(tokens, item, to, TOKEN_COMMA);
+        if (item < end && tokens[item].type == TOKEN_IDENTIFIER) {
+            const char* value = "";
+            if (item + 1 < end && tokens[item + 1].type == TOKEN_ASSIGN) {
+                value = join_tokens(summary, tokens, item + 2, end);
+            }
+            add_entry(summary, HEADER_CONSTANT, token_name(summary, &tokens[item]), type, value);
+        }
+        item = end + 1;
+    }
+    return member_list(summary, tokens, from, to);
+}
+
+/* Record each declarator from..to declares as a variable, or as a type name under typedef */
+static void add_declarators(HeaderSummary* summary, const Token* tokens, int from, int to,
+                            const char* base_type, const char* members, int is_typedef) {
+    for (int item = from; item < to;) {
+        int end = find_outside(tokens, item, to, TOKEN_COMMA);
+        int name = declarator_name(tokens, item, end);
+
+        if (name >= 0) {
+            const char* type = base_type;
+            int stars = 0;
+            int function_pointer = 0;
+            int array = name + 1 < end && tokens[name + 1].type == TOKEN_LBRACKET;
+            for (int i = item; i < name; i++) {
+                if (tokens[i].type == TOKEN_STAR) stars++;
+                if (tokens[i].type == TOKEN_LPAREN) function_pointer = 1;
+            }
+
+            if (function_pointer) {
+                /* The whole declarator is the type: "int (*compare)(const void*, const void*)" */
+                size_t length = strlen(base_type) + strlen(join_tokens(summary, tokens, item, end)) + 2;
+                char* text = (char*)arena_alloc(summary->arena, length);
+                snprintf(text, length, "%s %s", base_type, join_tokens(summary, tokens, item, end));
+                type = text;
+            } else if (stars > 0 || array) {
+                /* "const char* names[]" has type "const char*[]" */
+                size_t base_length = strlen(base_type);
+                char* text = (char*)arena_alloc(summary->arena, base_length + (size_t)stars + 3);
+                memcpy(text, base_type, base_length);
+                memset(text + base_length, '*', (size_t)stars);
+                strcpy(text + base_length + stars, array ? "[]" : "");
+                type = text;
+            }
+
+            add_entry(summary, is_typedef ? HEADER_TYPEDEF : HEADER_VARIABLE,
+                      token_name(summary, &tokens[name]), type, is_typedef ? members : "");
+        }
+        item = end + 1;
+    }
+}
+
+static void read_declaration(HeaderSummary* summary, const Token* tokens, int count) {
+    int from = 0;
+    int is_typedef = 0;
+
+    /* Storage classes say nothing a description uses */
+    while (from < count && (tokens[from].type == TOKEN_EXTERN || tokens[from].type == TOKEN_STATIC ||
+                            tokens[from].type == TOKEN_TYPEDEF || is_word(&tokens[from], "inline"))) {
+        if (tokens[from].type == TOKEN_TYPEDEF) is_typedef = 1;
+        from++;
+    }
+    if (from >= count) return;
+
+    /* A structure, union or enumeration defined in place */
+    int body = find_outside(tokens, from, count, TOKEN_LBRACE);
+    int tag = body - 1;
+    if (body < count && tag >= from && tokens[tag].type == TOKEN_IDENTIFIER && tag > from) tag--;
+    if (body < count && tag >= from && is_tag_keyword(tokens[tag].type)) {
+        int close = matching_close(tokens, body, count);
+        TokenType keyword = tokens[tag].type;
+        const char* name = body - tag == 2 ? token_name(summary, &tokens[tag + 1]) : NULL;
+        const char* type = join_tokens(summary, tokens, from, body);
+
+        const char* members;
+        if (keyword == TOKEN_ENUM) {
+            members = enumerators(summary, tokens, body + 1, close, type);
+        } else {
+            members = member_list(summary, tokens, body + 1, close);
+        }
+
+        if (name) {
+            HeaderEntryKind kind = keyword == TOKEN_STRUCT ? HEADER_STRUCT :
+                                   keyword == TOKEN_UNION ? HEADER_UNION : HEADER_ENUM;
+            add_entry(summary, kind, name, type, members);
+        }
+        add_declarators(summary, tokens, close + 1, count, type, members, is_typedef);
+        return;
+    }
+
+    /* A function: a name and a parameter list before any initialiser */
+    int first_end = find_outside(tokens, from, count, TOKEN_COMMA);
+    int value = find_outside(tokens, from, first_end, TOKEN_ASSIGN);
+    int parameters = find_outside(tokens, from, value, TOKEN_LPAREN);
+    if (!is_typedef && parameters < value && parameters - 1 > from &&
+        tokens[parameters - 1].type == TOKEN_IDENTIFIER) {
+        int close = matching_close(tokens, parameters, count);
+        if (close >= count) return;
+        add_entry(summary, HEADER_FUNCTION, token_name(summary, &tokens[parameters - 1]),
+                  join_tokens(summary, tokens, from, parameters - 1),
+                  join_tokens(summary, tokens, from, close + 1));
+        return;
+    }
+
+    /* Variables or type names: a shared base type, then declarators */
+    int name = declarator_name(tokens, from, first_end);
+    if (name <= from) return;
+    int base_end = from;
+    while (base_end < name && tokens[base_end].type != TOKEN_STAR && tokens[base_end].type != TOKEN_LPAREN) {
+        base_end++;
+    }
+    if (base_end == from) return;
+
+    add_declarators(summary, tokens, base_end, count, join_tokens(summary, tokens, from, base_end),
+                    "", is_typedef);
+}
+
+/* Split text (directives already blanked) into declarations and record each */
+static void read_declarations(HeaderSummary* summary, const char* text, size_t length) {
+    Arena* scratch = arena_create(HEADER_ARENA_BLOCK_SIZE);
+    Lexer* lexer = lexer_create(text, length, summary->path, scratch);
+    TokenRun run = { NULL, 0, 0 };
+    int depth = 0;
+    int body = -1;              /* Index of the '{' opened outside any bracket */
+    int linkage_blocks = 0;     /* Open extern "C" blocks, whose braces are transparent */
+
+    for (;;) {
+        Token token = lexer_next_token(lexer);
+        if (token.type == TOKEN_EOF || token.type == TOKEN_ERROR) break;
+
+        if (depth == 0) {
+            if (token.type == TOKEN_SEMICOLON) {
+                read_declaration(summary, run.tokens, run.count);
+                run.count = 0;
+                continue;
+            }
+            if (token.type == TOKEN_LBRACE && run.count == 2 && run.tokens[0].type == TOKEN_EXTERN &&
+                run.tokens[1].type == TOKEN_STRING) {
+                linkage_blocks++;
+                run.count = 0;
+                continue;
+            }
+            if (token.type == TOKEN_RBRACE && linkage_blocks > 0) {
+                linkage_blocks--;
+                run.count = 0;
+                continue;
+            }
+            if (token.type == TOKEN_LBRACE) body = run.count;
+        }
+
+        if (is_open(token.type)) depth++;
+        if (is_close(token.type) && depth > 0) depth--;
+        run_push(&run, token);
+
+        /* A function body ends its definition without a ';' */
+        if (depth == 0 && token.type == TOKEN_RBRACE && body > 0 &&
+            run.tokens[body - 1].type == TOKEN_RPAREN) {
+            read_declaration(summary, run.tokens, run.count);
+            run.count = 0;
+        }
+    }
+
+    free(run.tokens);
+    lexer_destroy(lexer);
+    arena_destroy(scratch);
+}
+
+/* Summarise the header text at path */
+static HeaderSummary* summarise(const char* path, const char* text, size_t length) {
+    HeaderSummary* summary = summary_create(path);
+    char* blanked = (char*)safe_malloc(length + 1);
+    memcpy(blanked, text, length);
+    blanked[length] = '\0';
+
+    read_directives(summary, text, length, blanked);
+    read_declarations(summary, blanked, length);
+
+    free(blanked);
+    return summary;
+}
+
+/*
+ * Persisted summaries: one text file per header, named by a hash of its
+ * path, one record per line with tab-separated fields.
+ */
+
+static char* entry_path(const HeaderCache* cache, const char* path, const char* suffix) {
+    uint64_t hash = fnv1a_64(FNV1A_64_BASIS, path, strlen(path));
+    size_t length = strlen(cache->directory) + strlen(suffix) + 40;
+    char* file = (char*)safe_malloc(length);
+    snprintf(file, length, "%s/%016llx%s", cache->directory, (unsigned long long)hash, suffix);
+    return file;
+}
+
+/* Next tab-separated field of a line, cut off in place */
+static char* next_field(char** cursor) {
+    char* field = *cursor;
+    if (!field) return NULL;
+
+    char* tab = strchr(field, '\t');
+    if (tab) {
+        *tab = '\0';
+        *cursor = tab + 1;
+    } else {
+        *cursor = NULL;
+    }
+    return field;
+}
+
+static HeaderSummary* load_summary(const HeaderCache* cache, const char* path) {
+    char* file = entry_path(cache, path, HEADER_EXTENSION);
+    FILE* entry = fopen(file, "rb");
+    free(file);
+    if (!entry) return NULL;
+
+    size_t length = 0;
+    size_t capacity = 4096;
+    char* text = (char*)safe_malloc(capacity);
+    size_t read_size;
+    while ((read_size = fread(text + length, 1, capacity - length - 1, entry)) > 0) {
+        length += read_size;
+        if (capacity - length < 2) {
+            capacity *= 2;
+            text = (char*)safe_realloc(text, capacity);
+        }
+    }
+    int failed = ferror(entry);
+    fclose(entry);
+    text[length] = '\0';
+
+    HeaderSummary* summary = summary_create(path);
+    int complete = 0;
+    int line_number = 0;
+    char* line = failed ? NULL : text;
+
+    while (line && *line) {
+        char* newline = strchr(line, '\n');
+        if (!newline) break;
+        *newline = '\0';
+
+        char* cursor = line;
+        char* record = next_field(&cursor);
+        if (line_number == 0) {
+            if (!string_equals(record, HEADER_MAGIC)) break;
+        } else if (string_equals(record, "path")) {
+            char* stored = next_field(&cursor);
+            if (!stored || !string_equals(stored, path)) break;
+        } else if (string_equals(record, "stamp")) {
+            char* mtime = next_field(&cursor);
+            char* size = next_field(&cursor);
+            char* hash = next_field(&cursor);
+            char* verified = next_field(&cursor);
+            if (!verified) break;
+            summary->mtime = (int64_t)strtoll(mtime, NULL, 10);
+            summary->size = (uint64_t)strtoull(size, NULL, 10);
+            summary->hash = (uint64_t)strtoull(hash, NULL, 16);
+            summary->verified = (int64_t)strtoll(verified, NULL, 10);
+        } else if (string_equals(record, "include")) {
+            char* system = next_field(&cursor);
+            char* name = next_field(&cursor);
+            if (!name) break;
+            add_include(summary, arena_strdup(summary->arena, name), string_equals(system, "1"));
+        } else if (string_equals(record, "entry")) {
+            char* kind = next_field(&cursor);
+            char* name = next_field(&cursor);
+            char* type = next_field(&cursor);
+            char* detail = next_field(&cursor);
+            int value = detail ? atoi(kind) : -1;
+            if (value < HEADER_FUNCTION || value > HEADER_ENUM) break;
+            add_entry(summary, (HeaderEntryKind)value, arena_strdup(summary->arena, name),
+                      arena_strdup(summary->arena, type), arena_strdup(summary->arena, detail));
+        } else if (string_equals(record, "end")) {
+            complete = 1;
+            break;
+        } else {
+            break;
+        }
+
+        line = newline + 1;
+        line_number++;
+    }
+
+    free(text);
+    if (!complete || summary->verified == 0) {
+        summary_destroy(summary);
+        return NULL;
+    }
+    return summary;
+}
+
+/* Write a summary with the given stamp under a temporary name, then rename it into place */
+static void store_summary(HeaderCache* cache, const HeaderSummary* summary, int64_t mtime, uint64_t size,
+                          int64_t verified) {
+    mutex_lock(&cache->lock);
+    unsigned int sequence = cache->temp_sequence++;
+    mutex_unlock(&cache->lock);
+
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".tmp.%ld.%u", current_process_id(), sequence);
+    char* temp_path = entry_path(cache, summary->path, suffix);
+    char* path = entry_path(cache, summary->path, HEADER_EXTENSION);
+
+    /* A path that does not fit on one line cannot be stored */
+    FILE* entry = strpbrk(summary->path, "\t\n") ? NULL : fopen(temp_path, "wb");
+    if (!entry) {
+        free(temp_path);
+        free(path);
+        return;
+    }
+
+    fprintf(entry, "%s\npath\t%s\n", HEADER_MAGIC, summary->path);
+    fprintf(entry, "stamp\t%lld\t%llu\t%016llx\t%lld\n", (long long)mtime, (unsigned long long)size,
+            (unsigned long long)summary->hash, (long long)verified);
+    for (int i = 0; i < summary->include_count; i++) {
+        const HeaderInclude* include = &summary->includes[i];
+        fprintf(entry, "include\t%d\t%s\n", include->system, include->name);
+    }
+    for (int i = 0; i < summary->entry_count; i++) {
+        const HeaderEntry* item = &summary->entries[i];
+        fprintf(entry, "entry\t%d\t%s\t%s\t%s\n", item->kind, item->name, item->type, item->detail);
+    }
+    fprintf(entry, "end\n");
+
+    int ok = !ferror(entry);
+    ok = fclose(entry) == 0 && ok;
+    if (ok) {
+#ifdef _WIN32
+        remove(path);
+#endif
+        ok = rename(temp_path, path) == 0;
+    }
+    if (!ok) {
+        remove(temp_path);
+    }
+
+    free(temp_path);
+    free(path);
+}
+
+/* Cache creation and destruction */
+
+HeaderCache* header_cache_create(char* const* search_paths, int search_path_count, const char* directory) {
+    if (directory && !make_directory(directory)) {
+        log_message(LOG_ERROR, "Cannot create header cache directory: %s", directory);
+        return NULL;
+    }
+
+    HeaderCache* cache = (HeaderCache*)safe_malloc(sizeof(HeaderCache));
+    cache->search_paths = (char**)safe_malloc(sizeof(char*) * (search_path_count + 1));
+    for (int i = 0; i < search_path_count; i++) {
+        cache->search_paths[i] = string_duplicate(search_paths[i]);
+    }
+    cache->search_path_count = search_path_count;
+    cache->directory = directory ? string_duplicate(directory) : NULL;
+    cache->capacity = HEADER_INITIAL_CAPACITY;
+    cache->count = 0;
+    cache->slots = (HeaderSummary**)calloc((size_t)cache->capacity, sizeof(HeaderSummary*));
+    if (!cache->slots) {
+        log_message(LOG_ERROR, "Memory allocation failed");
+        memory_failure();
+    }
+    cache->retired = NULL;
+    cache->temp_sequence = 0;
+    mutex_init(&cache->lock);
+    return cache;
+}
+
+static void destroy_chain(HeaderSummary* summary) {
+    while (summary) {
+        HeaderSummary* next = summary->next;
+        summary_destroy(summary);
+        summary = next;
+    }
+}
+
+void header_cache_destroy(HeaderCache* cache) {
+    if (!cache) return;
+
+    for (int i = 0; i < cache->capacity; i++) {
+        destroy_chain(cache->slots[i]);
+    }
+    destroy_chain(cache->retired);
+    for (int i = 0; i < cache->search_path_count; i++) {
+        free(cache->search_paths[i]);
+    }
+    mutex_destroy(&cache->lock);
+    free(cache->search_paths);
+    free(cache->directory);
+    free(cache->slots);
+    free(cache);
+}
+
+/* The in-memory table; the caller holds the lock */
+
+static unsigned int path_slot(const HeaderCache* cache, const char* path) {
+    return string_hash(path, strlen(path)) & (unsigned int)(cache->capacity - 1);
+}
+
+static HeaderSummary** find_link(HeaderCache* cache, const char* path) {
+    HeaderSummary** link = &cache->slots[path_slot(cache, path)];
+    while (*link && !string_equals((*link)->path, path)) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+static void grow_table(HeaderCache* cache) {
+    HeaderSummary** old_slots = cache->slots;
+    int old_capacity = cache->capacity;
+
+    cache->capacity *= 2;
+    cache->slots = (HeaderSummary**)calloc((size_t)cache->capacity, sizeof(HeaderSummary*));
+    if (!cache->slots) {
+        log_message(LOG_ERROR, "Memory allocation failed");
+        memory_failure();
+    }
+
+    for (int i = 0; i < old_capacity; i++) {
+        HeaderSummary* summary = old_slots[i];
+        while (summary) {
+            HeaderSummary* next = summary->next;
+            unsigned int slot = path_slot(cache, summary->path);
+            summary->next = cache->slots[slot];
+            cache->slots[slot] = summary;
+            summary = next;
+        }
+    }
+    free(old_slots);
+}
+
+/* Whether a summary still describes a file with this stamp without reading it */
+static int summary_fresh(const HeaderSummary* summary, int64_t mtime, uint64_t size) {
+    /* A write in the second the hash was checked would not move mtime */
+    return summary->mtime == mtime && summary->size == size && summary->verified > mtime;
+}
+
+/* Make summary the current one for its path; returns the one in use, which may be an equal one already there */
+static const HeaderSummary* publish(HeaderCache* cache, HeaderSummary* summary) {
+    mutex_lock(&cache->lock);
+    HeaderSummary** link = find_link(cache, summary->path);
+    HeaderSummary* existing = *link;
+
+    if (existing && existing->hash == summary->hash && existing->mtime == summary->mtime &&
+        existing->size == summary->size) {
+        mutex_unlock(&cache->lock);
+        summary_destroy(summary);
+        return existing;
+    }
+
+    if (existing) {
+        /* Translations may still hold the old one */
+        summary->next = existing->next;
+        existing->next = cache->retired;
+        cache->retired = existing;
+        *link = summary;
+    } else {
+        summary->next = NULL;
+        *link = summary;
+        cache->count++;
+        if (cache->count > cache->capacity) {
+            grow_table(cache);
+        }
+    }
+    mutex_unlock(&cache->lock);
+    return summary;
+}
+
+/* The current summary of the header at path, whose stat is info; NULL if it cannot be read */
+static const HeaderSummary* header_cache_get(HeaderCache* cache, const char* path, const struct stat* info) {
+    int64_t mtime = (int64_t)info->st_mtime;
+    uint64_t size = (uint64_t)info->st_size;
+
+    mutex_lock(&cache->lock);
+    HeaderSummary* known = *find_link(cache, path);
+    if (known && summary_fresh(known, mtime, size)) {
+        mutex_unlock(&cache->lock);
+        return known;
+    }
+    mutex_unlock(&cache->lock);
+
+    /* Not summarised this run, or perhaps changed: try the stored summary, then the file */
+    HeaderSummary* summary = NULL;
+    if (!known && cache->directory) {
+        summary = load_summary(cache, path);
+        if (summary && summary_fresh(summary, mtime, size)) {
+            return publish(cache, summary);
+        }
+    }
+
+    SourceFile* source = source_file_read(path);
+    if (!source) {
+        summary_destroy(summary);
+        return NULL;
+    }
+    uint64_t hash = fnv1a_64(FNV1A_64_BASIS, source->data, source->length);
+    int64_t now = (int64_t)time(NULL);
+
+    /* Touched but unchanged: only the stamp moves */
+    if (known && known->hash == hash) {
+        source_file_close(source);
+        mutex_lock(&cache->lock);
+        known->mtime = mtime;
+        known->size = size;
+        known->verified = now;
+        mutex_unlock(&cache->lock);
+
+        /* Within the second of the change the stamp cannot be trusted yet, so it is not worth storing */
+        if (cache->directory && now > mtime) store_summary(cache, known, mtime, size, now);
+        return known;
+    }
+
+    if (!summary || summary->hash != hash) {
+        summary_destroy(summary);
+        summary = summarise(path, source->data, source->length);
+        summary->hash = hash;
+    }
+    source_file_close(source);
+
+    summary->mtime = mtime;
+    summary->size = size;
+    summary->verified = now;
+    if (cache->directory) store_summary(cache, summary, mtime, size, now);
+    return publish(cache, summary);
+}
+
+/* Include resolution */
+
+static int is_regular_file(const char* path, struct stat* info) {
+    if (stat(path, info) != 0) return 0;
+#ifdef _WIN32
+    return (info->st_mode & _S_IFMT) == _S_IFREG;
+#else
+    return S_ISREG(info->st_mode);
+#endif
+}
+
+static int is_separator(char c) {
+#ifdef _WIN32
+    return c == '/' || c == '\\';
+#else
+    return c == '/';
+#endif
+}
+
+static int is_absolute(const char* path) {
+#ifdef _WIN32
+    if (path[0] != '\0' && path[1] == ':') return 1;
+#endif
+    return is_separator(path[0]);
+}
+
+/* directory (its first length bytes) joined with name */
+static char* join_path(const char* directory, size_t length, const char* name) {
+    char* path = (char*)safe_malloc(length + strlen(name) + 2);
+    memcpy(path, directory, length);
+    if (length > 0 && !is_separator(directory[length - 1])) {
+        path[length++] = '/';
+    }
+    strcpy(path + length, name);
+    return path;
+}
+
+/* Path of the header include names, found from includer_path; NULL if it is nowhere */
+static char* find_header(const HeaderCache* cache, const char* includer_path, const HeaderInclude* include,
+                         struct stat* info) {
+    char* path;
+    if (is_absolute(include->name)) {
+        path = string_duplicate(include->name);
+        if (is_regular_file(path, info)) return path;
+        free(path);
+        return NULL;
+    }
+
+    if (!include->system) {
+        size_t length = strlen(includer_path);
+        while (length > 0 && !is_separator(includer_path[length - 1])) length--;
+        path = join_path(includer_path, length, include->name);
+        if (is_regular_file(path, info)) return path;
+        free(path);
+    }
+
+    for (int i = 0; i < cache->search_path_count; i++) {
+        const char* directory = cache->search_paths[i];
+        path = join_path(directory, strlen(directory), include->name);
+        if (is_regular_file(path, info)) return path;
+        free(path);
+    }
+    return NULL;
+}
+
+void include_set_init(IncludeSet* set) {
+    set->headers = NULL;
+    set->count = 0;
+    set->capacity = 0;
+    set->names = NULL;
+    set->digest = FNV1A_64_BASIS;
+}
+
+static void include_set_clear(IncludeSet* set) {
+    for (int i = 0; i < set->count; i++) {
+        free(set->names[i]);
+    }
+    set->count = 0;
+    set->digest = FNV1A_64_BASIS;
+}
+
+void include_set_destroy(IncludeSet* set) {
+    include_set_clear(set);
+    free(set->headers);
+    free(set->names);
+    set->headers = NULL;
+    set->names = NULL;
+    set->capacity = 0;
+}
+
+static int include_set_contains(const IncludeSet* set, const char* path) {
+    for (int i = 0; i < set->count; i++) {
+        if (string_equals(set->headers[i].summary->path, path)) return 1;
+    }
+    return 0;
+}
+
+static void include_set_add(IncludeSet* set, const HeaderSummary* summary, const char* name) {
+    if (set->count >= set->capacity) {
+        set->capacity = set->capacity ? set->capacity * 2 : 8;
+        set->headers = (IncludedHeader*)safe_realloc(set->headers, sizeof(IncludedHeader) * set->capacity);
+        set->names = (char**)safe_realloc(set->names, sizeof(char*) * set->capacity);
+    }
+
+    /* Descriptions depend on the spelling and the contents, so both go into the digest */
+    set->names[set->count] = string_duplicate(name);
+    set->headers[set->count].summary = summary;
+    set->headers[set->count].name = set->names[set->count];
+    set->count++;
+    set->digest = fnv1a_64(set->digest, name, strlen(name) + 1);
+    set->digest = fnv1a_64(set->digest, &summary->hash, sizeof(summary->hash));
+}
+
+/* Add the headers includer names, each followed by those it includes in turn */
+static void resolve_includes(HeaderCache* cache, const HeaderSummary* includer, const char* includer_path,
+                             IncludeSet* set) {
+    for (int i = 0; i < includer->include_count; i++) {
+        const HeaderInclude* include = &includer->includes[i];
+        struct stat info;
+        char* path = find_header(cache, includer_path, include, &info);
+
+        if (!path) {
+            if (!include->system) {
+                log_message(LOG_WARNING, "%s: cannot find header '%s'", includer_path, include->name);
+            }
+            continue;
+        }
+        if (include_set_contains(set, path)) {
+            free(path);
+            continue;
+        }
+
+        const HeaderSummary* summary = header_cache_get(cache, path, &info);
+        free(path);
+        if (!summary) continue;
+
+        include_set_add(set, summary, include->name);
+        resolve_includes(cache, summary, summary->path, set);
+    }
+}
+
+void header_cache_resolve(HeaderCache* cache, const char* source, size_t length, const char* source_path,
+                          IncludeSet* set) {
+    include_set_clear(set);
+
+    /* Standard input has no directory of its own to search */
+    HeaderSummary* top = summary_create(string_equals(source_path, "-") ? "" : source_path);
+    read_directives(top, source, length, NULL);
+    resolve_includes(cache, top, top->path, set);
+    summary_destroy(top);
+}
+
+SymbolTable* include_set_symbols(const IncludeSet* set, Interner* interner, Arena* arena) {
+    SymbolTable* table = symbol_table_create("headers");
+
+    for (int i = 0; i < set->count; i++) {
+        const IncludedHeader* header = &set->headers[i];
+        for (int j = 0; j < header->summary->entry_count; j++) {
+            const HeaderEntry* entry = &header->summary->entries[j];
+
+            /* Tags have a namespace of their own */
+            if (entry->kind == HEADER_STRUCT || entry->kind == HEADER_UNION || entry->kind == HEADER_ENUM) {
+                continue;
+            }
+
+            /* The first declaration seen wins */
+            const char* name = intern_cstr(interner, entry->name);
+            if (symbol_table_lookup(table, name)) continue;
+
+            int callable = entry->kind == HEADER_FUNCTION || entry->kind == HEADER_MACRO;
+            Symbol* symbol = symbol_create(arena, name, callable ? entry->detail : entry->type,
+                                           header->name, 0);
+            symbol->is_function = callable;
+            symbol->is_macro = entry->kind == HEADER_MACRO;
+            symbol_table_insert(table, symbol);
+        }
+    }
+    return table;
+}
@@ -0,0 +1,119 @@
+#ifndef HEADER_H
+#define HEADER_H
+
+#include <stdint.h>
+
+#include "utils.h"
+#include "arena.h"
+#include "intern.h"
+#include "symbol_table.h"
+#include "thread.h"
+
+/* What a header declares */
+typedef enum {
+    HEADER_FUNCTION,    /* Prototype or definition; type is the return type, detail the declaration */
+    HEADER_MACRO,       /* Function-like macro; detail is the name and parameter list */
+    HEADER_CONSTANT,    /* Object-like macro or enumeration constant; detail is the value, if given */
+    HEADER_VARIABLE,    /* Global variable */
+    HEADER_TYPEDEF,     /* type is the aliased type; detail lists the members of a structure defined in place */
+    HEADER_STRUCT,      /* detail lists the members */
+    HEADER_UNION,
+    HEADER_ENUM         /* detail lists the constants */
+} HeaderEntryKind;
+
+typedef struct {
+    int kind;           /* HeaderEntryKind */
+    const char* name;
+    const char* type;   /* "" when it has none */
+    const char* detail; /* "" when it has none */
+} HeaderEntry;
+
+/* One #include line */
+typedef struct {
+    const char* name;   /* As written between the quotes or angle brackets */
+    int system;         /* <name> rather than "name" */
+} HeaderInclude;
+
+/*
+ * What one header offers a translation unit, gathered without preprocessing:
+ * conditionals are not evaluated and macros are not expanded, so every
+ * branch is summarised. A summary stays valid while the file's size and
+ * modification time are unchanged or, when they are not, while the hash of
+ * its contents is.
+ */
+typedef struct HeaderSummary {
+    char* path;
+    int64_t mtime;
+    uint64_t size;
+    uint64_t hash;
+    int64_t verified;       /* When hash was last checked against the file */
+    HeaderEntry* entries;
+    int entry_count;
+    int entry_capacity;
+    HeaderInclude* includes;
+    int include_count;
+    int include_capacity;
+    Arena* arena;           /* Owns the names and text */
+    struct HeaderSummary* next;     /* Next in the same hash chain */
+} HeaderSummary;
+
+/*
+ * Header summary cache, shared by every file of a run. Summaries are kept in
+ * memory by path and, given a directory, persisted there one file per
+ * header so a later run can skip lexing unchanged headers. A summary is
+ * never freed while the cache lives, even when a newer one replaces it, so
+ * a translation holding one is never left dangling.
+ */
+typedef struct {
+    char** search_paths;    /* -I directories, searched in order */
+    int search_path_count;
+    char* directory;        /* Persisted summaries, or NULL */
+    HeaderSummary** slots;
+    int capacity;           /* Power of two */
+    int count;
+    HeaderSummary* retired; /* Replaced summaries, freed with the cache */
+    unsigned int temp_sequence;     /* Names temporary files during stores */
+    Mutex lock;
+} HeaderCache;
+
+/* Cache creation and destruction; directory (optional) is created if missing */
+HeaderCache* header_cache_create(char* const* search_paths, int search_path_count, const char* directory);
+void header_cache_destroy(HeaderCache* cache);
+
+/* A header one translation unit includes */
+typedef struct {
+    const HeaderSummary* summary;
+    const char* name;       /* As its includer spelt it, for descriptions */
+} IncludedHeader;
+
+/* Every header a translation unit includes, directly or through other headers, in include order */
+typedef struct {
+    IncludedHeader* headers;
+    int count;
+    int capacity;
+    char** names;           /* Owned copies of the spellings in headers */
+    uint64_t digest;        /* Hash of every header's spelling and contents, for translation cache keys */
+} IncludeSet;
+
+void include_set_init(IncludeSet* set);
+void include_set_destroy(IncludeSet* set);
+
+/*
+ * Resolve source's #include lines, then theirs, through cache into set
+ * (cleared first). "name" is looked for beside its includer and then in the
+ * search paths, <name> only in the search paths; a quoted header that
+ * cannot be found is warned about, a system one is skipped silently.
+ */
+void header_cache_resolve(HeaderCache* cache, const char* source, size_t length, const char* source_path,
+                          IncludeSet* set);
+
+/*
+ * Symbols for the functions, macros, constants, variables and type names
+ * set declares, interned with interner so they can be looked up by a tree's
+ * names. A function's type is its whole declaration and every symbol's
+ * scope is the name of the header it came from. The symbols live in arena;
+ * the table is the caller's to destroy.
+ */
+SymbolTable* include_set_symbols(const IncludeSet* set, Interner* interner, Arena* arena);
+
+#endif /* HEADER_H */
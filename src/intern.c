@@ -0,0 +1,99 @@
+#include "intern.h"
+
+#define INTERNER_INITIAL_CAPACITY 256
+
+static InternEntry* entries_create(int capacity) {
+    InternEntry* entries = (InternEntry*)calloc((size_t)capacity, sizeof(InternEntry));
+    if (!entries) {
+        log_message(LOG_ERROR, "Memory allocation failed");
+        memory_failure();
+    }
+    return entries;
+}
+
+/* Interner creation and destruction */
+
+Interner* interner_create(Arena* arena) {
+    Interner* interner = (Interner*)safe_malloc(sizeof(Interner));
+    interner->capacity = INTERNER_INITIAL_CAPACITY;
+    interner->count = 0;
+    interner->entries = entries_create(interner->capacity);
+    interner->arena = arena;
+    return interner;
+}
+
+void interner_destroy(Interner* interner) {
+    if (!interner) return;
+
+    /* The text itself lives in the arena */
+    free(interner->entries);
+    free(interner);
+}
+
+/* Forget every string; the caller resets the arena that held them */
+void interner_clear(Interner* interner) {
+    memset(interner->entries, 0, sizeof(InternEntry) * (size_t)interner->capacity);
+    interner->count = 0;
+}
+
+/* Double the table, reinserting by stored hash */
+static void interner_grow(Interner* interner) {
+    InternEntry* old_entries = interner->entries;
+    int old_capacity = interner->capacity;
+
+    interner->capacity = old_capacity * 2;
+    interner->entries = entries_create(interner->capacity);
+
+    unsigned int mask = (unsigned int)interner->capacity - 1;
+    for (int i = 0; i < old_capacity; i++) {
+        if (!old_entries[i].text) continue;
+
+        unsigned int index = old_entries[i].hash & mask;
+        while (interner->entries[index].text) {
+            index = (index + 1) & mask;
+        }
+        interner->entries[index] = old_entries[i];
+    }
+
+    free(old_entries);
+}
+
+/* Interning */
+
+const char* intern(Interner* interner, const char* str, size_t length) {
+    /* Keep the load factor under three quarters */
+    if ((interner->count + 1) * 4 > interner->capacity * 3) {
+        interner_grow(interner);
+    }
+
+    unsigned int hash = string_hash(str, length);
+    unsigned int mask = (unsigned int)interner->capacity - 1;
+    unsigned int index = hash & mask;
+
+    while (interner->entries[index].text) {
+        InternEntry* entry = &interner->entries[index];
+        if (entry->hash == hash && entry->length == length &&
+            memcmp(entry->text, str, length) == 0) {
+            return entry->text;
+        }
+        index = (index + 1) & mask;
+    }
+
+    InternEntry* entry = &interner->entries[index];
+    entry->text = arena_strndup(interner->arena, str, length);
+    entry->length = length;
+    entry->hash = hash;
+    interner->count++;
+    return entry->text;
+}
+
+const char* intern_cstr(Interner* interner, const char* str) {
+    if (!str) return NULL;
+    return intern(interner, str, strlen(str));
+}
+
+unsigned int intern_pointer_hash(const char* handle) {
+    /* Arena text is 8-byte aligned, so the low bits carry no information */
+    size_t bits = (size_t)handle >> 3;
+    return (unsigned int)(bits ^ (bits >> 15)) * 2654435761u;
+}
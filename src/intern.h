@@ -0,0 +1,38 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include "utils.h"
+#include "arena.h"
+
+/* One interned string; the hash is kept so growing never rehashes text */
+typedef struct {
+    const char* text;
+    size_t length;
+    unsigned int hash;
+} InternEntry;
+
+/*
+ * String interner: every distinct string is stored once, so two interned
+ * strings are equal exactly when their pointers are. Identifier names, type
+ * names and literals in the AST are all interned handles.
+ */
+typedef struct {
+    InternEntry* entries;
+    int capacity;
+    int count;
+    Arena* arena;       /* Owns the interned text */
+} Interner;
+
+/* Interner creation and destruction */
+Interner* interner_create(Arena* arena);
+void interner_destroy(Interner* interner);
+void interner_clear(Interner* interner);
+
+/* Interning */
+const char* intern(Interner* interner, const char* str, size_t length);
+const char* intern_cstr(Interner* interner, const char* str);
+
+/* Hash of an interned handle, for tables keyed by pointer */
+unsigned int intern_pointer_hash(const char* handle);
+
+#endif /* INTERN_H */
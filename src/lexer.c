@@ -1,72 +1,108 @@
 #include "lexer.h"
+#include "scan.h"
+#include "thread.h"
 
 /* Keyword mapping */
 typedef struct {
     const char* keyword;
+    int length;
     TokenType type;
 } KeywordMap;
 
-static KeywordMap keywords[] = {
-    {"int", TOKEN_INT},
-    {"char", TOKEN_CHAR},
-    {"float", TOKEN_FLOAT},
-    {"double", TOKEN_DOUBLE},
-    {"void", TOKEN_VOID},
-    {"if", TOKEN_IF},
-    {"else", TOKEN_ELSE},
-    {"while", TOKEN_WHILE},
-    {"for", TOKEN_FOR},
-    {"do", TOKEN_DO},
-    {"return", TOKEN_RETURN},
-    {"break", TOKEN_BREAK},
-    {"continue", TOKEN_CONTINUE},
-    {"struct", TOKEN_STRUCT},
-    {"union", TOKEN_UNION},
-    {"typedef", TOKEN_TYPEDEF},
-    {"sizeof", TOKEN_SIZEOF},
-    {"const", TOKEN_CONST},
-    {"static", TOKEN_STATIC},
-    {"extern", TOKEN_EXTERN},
-    {"switch", TOKEN_SWITCH},
-    {"case", TOKEN_CASE},
-    {"default", TOKEN_DEFAULT},
-    {"enum", TOKEN_ENUM},
-    {"goto", TOKEN_GOTO},
-    {"signed", TOKEN_SIGNED},
-    {"unsigned", TOKEN_UNSIGNED},
-    {"long", TOKEN_LONG},
-    {"short", TOKEN_SHORT},
-    {NULL, TOKEN_EOF}
+#define KEYWORD(text, type) {text, (int)sizeof(text) - 1, type}
+
+/* The single source of truth for keywords; the lookup index is built from it */
+static const KeywordMap keywords[] = {
+    KEYWORD("int", TOKEN_INT),
+    KEYWORD("char", TOKEN_CHAR),
+    KEYWORD("float", TOKEN_FLOAT),
+    KEYWORD("double", TOKEN_DOUBLE),
+    KEYWORD("void", TOKEN_VOID),
+    KEYWORD("if", TOKEN_IF),
+    KEYWORD("else", TOKEN_ELSE),
+    KEYWORD("while", TOKEN_WHILE),
+    KEYWORD("for", TOKEN_FOR),
+    KEYWORD("do", TOKEN_DO),
+    KEYWORD("return", TOKEN_RETURN),
+    KEYWORD("break", TOKEN_BREAK),
+    KEYWORD("continue", TOKEN_CONTINUE),
+    KEYWORD("struct", TOKEN_STRUCT),
+    KEYWORD("union", TOKEN_UNION),
+    KEYWORD("typedef", TOKEN_TYPEDEF),
+    KEYWORD("sizeof", TOKEN_SIZEOF),
+    KEYWORD("const", TOKEN_CONST),
+    KEYWORD("static", TOKEN_STATIC),
+    KEYWORD("extern", TOKEN_EXTERN),
+    KEYWORD("switch", TOKEN_SWITCH),
+    KEYWORD("case", TOKEN_CASE),
+    KEYWORD("default", TOKEN_DEFAULT),
+    KEYWORD("enum", TOKEN_ENUM),
+    KEYWORD("goto", TOKEN_GOTO),
+    KEYWORD("signed", TOKEN_SIGNED),
+    KEYWORD("unsigned", TOKEN_UNSIGNED),
+    KEYWORD("long", TOKEN_LONG),
+    KEYWORD("short", TOKEN_SHORT),
+    {NULL, 0, TOKEN_EOF}
 };
 
-/* Token creation and destruction */
+/*
+ * Keyword lookup index. Slots hold 1 + the keyword's position in keywords[]
+ * (0 marks an empty slot). The hash mixes length, first and last character
+ * and is collision-free for the current table, so every identifier costs one
+ * probe; linear probing keeps lookups correct if new keywords do collide.
+ */
+#define KEYWORD_TABLE_SIZE 128
+
+static unsigned char keyword_index[KEYWORD_TABLE_SIZE];
+static int keyword_max_length = 0;
+static ThreadOnce keyword_index_once = THREAD_ONCE_INIT;
+
+static unsigned int keyword_hash(const char* start, int length) {
+    unsigned int first = (unsigned char)start[0];
+    unsigned int last = (unsigned char)start[length - 1];
+    return ((unsigned int)length + first * 54u + last) & (KEYWORD_TABLE_SIZE - 1);
+}
+
+static void build_keyword_index(void) {
+    for (int i = 0; keywords[i].keyword != NULL; i++) {
+        unsigned int slot = keyword_hash(keywords[i].keyword, keywords[i].length);
+        while (keyword_index[slot] != 0) {
+            slot = (slot + 1) & (KEYWORD_TABLE_SIZE - 1);
+        }
+        keyword_index[slot] = (unsigned char)(i + 1);
+        if (keywords[i].length > keyword_max_length) {
+            keyword_max_length = keywords[i].length;
+        }
+    }
+}
+
+/* Token creation */
 
-Token* token_create(TokenType type, const char* lexeme, int line, int column) {
-    Token* token = (Token*)safe_malloc(sizeof(Token));
-    token->type = type;
-    token->lexeme = string_duplicate(lexeme);
-    token->line = line;
-    token->column = column;
+Token token_create(TokenType type, const char* start, int length, int offset) {
+    Token token;
+    token.type = type;
+    token.offset = offset;
+    token.start = start;
+    token.length = length;
     return token;
 }
 
-void token_destroy(Token* token) {
-    if (token) {
-        free(token->lexeme);
-        free(token);
-    }
+char* token_lexeme(const Token* token, Arena* arena) {
+    return arena_strndup(arena, token->start, (size_t)token->length);
 }
 
 /* Lexer creation and destruction */
 
-Lexer* lexer_create(const char* source, const char* filename) {
+Lexer* lexer_create(const char* source, size_t length, const char* filename, Arena* arena) {
+    thread_once(&keyword_index_once, build_keyword_index);
+
     Lexer* lexer = (Lexer*)safe_malloc(sizeof(Lexer));
     lexer->source = source;
     lexer->filename = filename;
+    lexer->arena = arena;
     lexer->current = 0;
-    lexer->line = 1;
-    lexer->column = 1;
-    lexer->length = strlen(source);
+    lexer->length = (int)length;
+    line_index_init(&lexer->lines, source, length, arena);
     return lexer;
 }
 
@@ -91,14 +127,7 @@ static char peek_next(Lexer* lexer) {
 }
 
 static char advance(Lexer* lexer) {
-    char c = lexer->source[lexer->current++];
-    if (c == '\n') {
-        lexer->line++;
-        lexer->column = 1;
-    } else {
-        lexer->column++;
-    }
-    return c;
+    return lexer->source[lexer->current++];
 }
 
 static int match(Lexer* lexer, char expected) {
@@ -109,301 +138,302 @@ static int match(Lexer* lexer, char expected) {
 }
 
 static void skip_whitespace(Lexer* lexer) {
+    const char* source = lexer->source;
+    size_t end = (size_t)lexer->length;
+
     while (!is_at_end(lexer)) {
         char c = peek(lexer);
         if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
-            advance(lexer);
-        } else if (c == '#') {
-            /* Preprocessor directive - skip entire line */
-            while (peek(lexer) != '\n' && !is_at_end(lexer)) {
-                advance(lexer);
-            }
-        } else if (c == '/') {
-            if (peek_next(lexer) == '/') {
-                /* Single-line comment */
-                while (peek(lexer) != '\n' && !is_at_end(lexer)) {
-                    advance(lexer);
-                }
-            } else if (peek_next(lexer) == '*') {
-                /* Multi-line comment */
-                advance(lexer); /* / */
-                advance(lexer); /* * */
-                while (!is_at_end(lexer)) {
-                    if (peek(lexer) == '*' && peek_next(lexer) == '/') {
-                        advance(lexer); /* * */
-                        advance(lexer); /* / */
-                        break;
-                    }
-                    advance(lexer);
-                }
-            } else {
-                break;
-            }
+            lexer->current = (int)scan_skip_blanks(source, (size_t)lexer->current, end);
+        } else if (c == '#' || (c == '/' && peek_next(lexer) == '/')) {
+            /* Preprocessor directive or single-line comment - skip the rest of the line */
+            lexer->current = (int)scan_find_byte(source, (size_t)lexer->current, end, '\n');
+        } else if (c == '/' && peek_next(lexer) == '*') {
+            /* Multi-line comment; an unterminated one runs to the end of input */
+            size_t close = scan_find_comment_end(source, (size_t)lexer->current + 2, end);
+            lexer->current = (int)(close < end ? close + 2 : end);
         } else {
             break;
         }
     }
 }
 
-static TokenType check_keyword(const char* lexeme) {
-    for (int i = 0; keywords[i].keyword != NULL; i++) {
-        if (string_equals(lexeme, keywords[i].keyword)) {
-            return keywords[i].type;
+/* Build a token viewing the source text from start to the current position */
+static Token make_token(Lexer* lexer, TokenType type, int start) {
+    return token_create(type, &lexer->source[start], lexer->current - start, start);
+}
+
+/* Build an error token whose text is the message rather than source */
+static Token error_token(const char* message, int start) {
+    return token_create(TOKEN_ERROR, message, (int)strlen(message), start);
+}
+
+static TokenType check_keyword(const char* start, int length) {
+    if (length > keyword_max_length) return TOKEN_IDENTIFIER;
+
+    unsigned int slot = keyword_hash(start, length);
+    while (keyword_index[slot] != 0) {
+        const KeywordMap* entry = &keywords[keyword_index[slot] - 1];
+        if (entry->length == length && memcmp(entry->keyword, start, (size_t)length) == 0) {
+            return entry->type;
         }
+        slot = (slot + 1) & (KEYWORD_TABLE_SIZE - 1);
     }
+
     return TOKEN_IDENTIFIER;
 }
 
-static Token* scan_identifier(Lexer* lexer) {
-    int start = lexer->current;
-    int start_column = lexer->column;
+TokenType lexer_keyword_type(const char* start, int length) {
+    thread_once(&keyword_index_once, build_keyword_index);
+    return length > 0 ? check_keyword(start, length) : TOKEN_IDENTIFIER;
+}
 
-    while (is_identifier_char(peek(lexer))) {
-        advance(lexer);
-    }
+static Token scan_identifier(Lexer* lexer) {
+    int start = lexer->current;
 
-    int length = lexer->current - start;
-    char* lexeme = (char*)safe_malloc(length + 1);
-    strncpy(lexeme, &lexer->source[start], length);
-    lexeme[length] = '\0';
+    lexer->current = (int)scan_identifier_end(lexer->source, (size_t)start, (size_t)lexer->length);
 
-    TokenType type = check_keyword(lexeme);
-    Token* token = token_create(type, lexeme, lexer->line, start_column);
-    free(lexeme);
-    return token;
+    TokenType type = check_keyword(&lexer->source[start], lexer->current - start);
+    return make_token(lexer, type, start);
 }
 
-static Token* scan_number(Lexer* lexer) {
+static Token scan_number(Lexer* lexer) {
     int start = lexer->current;
-    int start_column = lexer->column;
 
-    while (is_digit(peek(lexer))) {
-        advance(lexer);
-    }
+    size_t end = (size_t)lexer->length;
+    lexer->current = (int)scan_digits_end(lexer->source, (size_t)start, end);
 
     /* Handle decimal point */
     if (peek(lexer) == '.' && is_digit(peek_next(lexer))) {
         advance(lexer); /* . */
-        while (is_digit(peek(lexer))) {
-            advance(lexer);
-        }
+        lexer->current = (int)scan_digits_end(lexer->source, (size_t)lexer->current, end);
     }
 
-    int length = lexer->current - start;
-    char* lexeme = (char*)safe_malloc(length + 1);
-    strncpy(lexeme, &lexer->source[start], length);
-    lexeme[length] = '\0';
+    return make_token(lexer, TOKEN_NUMBER, start);
+}
+
+/* Advance to the closing quote of a literal (or the end), stepping over escapes */
+static void skip_literal_body(Lexer* lexer, char quote) {
+    const char* source = lexer->source;
+    size_t end = (size_t)lexer->length;
+    size_t position = (size_t)lexer->current;
 
-    Token* token = token_create(TOKEN_NUMBER, lexeme, lexer->line, start_column);
-    free(lexeme);
-    return token;
+    for (;;) {
+        position = scan_find_quote(source, position, end, quote);
+        if (position >= end || source[position] == quote) break;
+
+        /* Backslash: the escaped byte, even a quote or newline, is part of the literal */
+        position += 2;
+        if (position > end) position = end;
+    }
+    lexer->current = (int)position;
 }
 
-static Token* scan_string(Lexer* lexer) {
+static Token scan_string(Lexer* lexer) {
     int start = lexer->current;
-    int start_column = lexer->column;
 
     advance(lexer); /* Opening " */
-
-    while (peek(lexer) != '"' && !is_at_end(lexer)) {
-        if (peek(lexer) == '\\') {
-            advance(lexer); /* Escape character */
-            if (!is_at_end(lexer)) advance(lexer);
-        } else {
-            advance(lexer);
-        }
-    }
+    skip_literal_body(lexer, '"');
 
     if (is_at_end(lexer)) {
-        return token_create(TOKEN_ERROR, "Unterminated string", lexer->line, start_column);
+        return error_token("Unterminated string", start);
     }
 
     advance(lexer); /* Closing " */
 
-    int length = lexer->current - start;
-    char* lexeme = (char*)safe_malloc(length + 1);
-    strncpy(lexeme, &lexer->source[start], length);
-    lexeme[length] = '\0';
-
-    Token* token = token_create(TOKEN_STRING, lexeme, lexer->line, start_column);
-    free(lexeme);
-    return token;
+    return make_token(lexer, TOKEN_STRING, start);
 }
 
-static Token* scan_char(Lexer* lexer) {
+static Token scan_char(Lexer* lexer) {
     int start = lexer->current;
-    int start_column = lexer->column;
 
     advance(lexer); /* Opening ' */
-
-    while (peek(lexer) != '\'' && !is_at_end(lexer)) {
-        if (peek(lexer) == '\\') {
-            advance(lexer);
-            if (!is_at_end(lexer)) advance(lexer);
-        } else {
-            advance(lexer);
-        }
-    }
+    skip_literal_body(lexer, '\'');
 
     if (is_at_end(lexer)) {
-        return token_create(TOKEN_ERROR, "Unterminated character literal", lexer->line, start_column);
+        return error_token("Unterminated character literal", start);
     }
 
     advance(lexer); /* Closing ' */
 
-    int length = lexer->current - start;
-    char* lexeme = (char*)safe_malloc(length + 1);
-    strncpy(lexeme, &lexer->source[start], length);
-    lexeme[length] = '\0';
-
-    Token* token = token_create(TOKEN_CHAR_LITERAL, lexeme, lexer->line, start_column);
-    free(lexeme);
-    return token;
+    return make_token(lexer, TOKEN_CHAR_LITERAL, start);
 }
 
 /* Main tokenization function */
 
-Token* lexer_next_token(Lexer* lexer) {
+Token lexer_next_token(Lexer* lexer) {
     skip_whitespace(lexer);
 
     if (is_at_end(lexer)) {
-        return token_create(TOKEN_EOF, "", lexer->line, lexer->column);
+        return make_token(lexer, TOKEN_EOF, lexer->current);
     }
 
-    int start_column = lexer->column;
+    int start = lexer->current;
     char c = advance(lexer);
 
     /* Identifiers and keywords */
     if (is_identifier_start(c)) {
         lexer->current--;
-        lexer->column--;
         return scan_identifier(lexer);
     }
 
     /* Numbers */
     if (is_digit(c)) {
         lexer->current--;
-        lexer->column--;
         return scan_number(lexer);
     }
 
     /* Strings */
     if (c == '"') {
         lexer->current--;
-        lexer->column--;
         return scan_string(lexer);
     }
 
     /* Character literals */
     if (c == '\'') {
         lexer->current--;
-        lexer->column--;
         return scan_char(lexer);
     }
 
     /* Two-character and three-character operators */
     switch (c) {
         case '+':
-            if (match(lexer, '+')) return token_create(TOKEN_INCREMENT, "++", lexer->line, start_column);
-            if (match(lexer, '=')) return token_create(TOKEN_PLUS_ASSIGN, "+=", lexer->line, start_column);
-            return token_create(TOKEN_PLUS, "+", lexer->line, start_column);
+            if (match(lexer, '+')) return make_token(lexer, TOKEN_INCREMENT, start);
+            if (match(lexer, '=')) return make_token(lexer, TOKEN_PLUS_ASSIGN, start);
+            return make_token(lexer, TOKEN_PLUS, start);
         case '-':
-            if (match(lexer, '-')) return token_create(TOKEN_DECREMENT, "--", lexer->line, start_column);
-            if (match(lexer, '>')) return token_create(TOKEN_ARROW, "->", lexer->line, start_column);
-            if (match(lexer, '=')) return token_create(TOKEN_MINUS_ASSIGN, "-=", lexer->line, start_column);
-            return token_create(TOKEN_MINUS, "-", lexer->line, start_column);
+            if (match(lexer, '-')) return make_token(lexer, TOKEN_DECREMENT, start);
+            if (match(lexer, '>')) return make_token(lexer, TOKEN_ARROW, start);
+            if (match(lexer, '=')) return make_token(lexer, TOKEN_MINUS_ASSIGN, start);
+            return make_token(lexer, TOKEN_MINUS, start);
         case '*':
-            if (match(lexer, '=')) return token_create(TOKEN_STAR_ASSIGN, "*=", lexer->line, start_column);
-            return token_create(TOKEN_STAR, "*", lexer->line, start_column);
+            if (match(lexer, '=')) return make_token(lexer, TOKEN_STAR_ASSIGN, start);
+            return make_token(lexer, TOKEN_STAR, start);
         case '/':
-            if (match(lexer, '=')) return token_create(TOKEN_SLASH_ASSIGN, "/=", lexer->line, start_column);
-            return token_create(TOKEN_SLASH, "/", lexer->line, start_column);
+            if (match(lexer, '=')) return make_token(lexer, TOKEN_SLASH_ASSIGN, start);
+            return make_token(lexer, TOKEN_SLASH, start);
         case '%':
-            if (match(lexer, '=')) return token_create(TOKEN_PERCENT_ASSIGN, "%=", lexer->line, start_column);
-            return token_create(TOKEN_PERCENT, "%", lexer->line, start_column);
+            if (match(lexer, '=')) return make_token(lexer, TOKEN_PERCENT_ASSIGN, start);
+            return make_token(lexer, TOKEN_PERCENT, start);
         case '=':
-            if (match(lexer, '=')) return token_create(TOKEN_EQ, "==", lexer->line, start_column);
-            return token_create(TOKEN_ASSIGN, "=", lexer->line, start_column);
+            if (match(lexer, '=')) return make_token(lexer, TOKEN_EQ, start);
+            return make_token(lexer, TOKEN_ASSIGN, start);
         case '!':
-            if (match(lexer, '=')) return token_create(TOKEN_NE, "!=", lexer->line, start_column);
-            return token_create(TOKEN_NOT, "!", lexer->line, start_column);
+            if (match(lexer, '=')) return make_token(lexer, TOKEN_NE, start);
+            return make_token(lexer, TOKEN_NOT, start);
         case '<':
             if (match(lexer, '<')) {
-                if (match(lexer, '=')) return token_create(TOKEN_SHL_ASSIGN, "<<=", lexer->line, start_column);
-                return token_create(TOKEN_SHL, "<<", lexer->line, start_column);
+                if (match(lexer, '=')) return make_token(lexer, TOKEN_SHL_ASSIGN, start);
+                return make_token(lexer, TOKEN_SHL, start);
             }
-            if (match(lexer, '=')) return token_create(TOKEN_LE, "<=", lexer->line, start_column);
-            return token_create(TOKEN_LT, "<", lexer->line, start_column);
+            if (match(lexer, '=')) return make_token(lexer, TOKEN_LE, start);
+            return make_token(lexer, TOKEN_LT, start);
         case '>':
             if (match(lexer, '>')) {
-                if (match(lexer, '=')) return token_create(TOKEN_SHR_ASSIGN, ">>=", lexer->line, start_column);
-                return token_create(TOKEN_SHR, ">>", lexer->line, start_column);
+                if (match(lexer, '=')) return make_token(lexer, TOKEN_SHR_ASSIGN, start);
+                return make_token(lexer, TOKEN_SHR, start);
             }
-            if (match(lexer, '=')) return token_create(TOKEN_GE, ">=", lexer->line, start_column);
-            return token_create(TOKEN_GT, ">", lexer->line, start_column);
+            if (match(lexer, '=')) return make_token(lexer, TOKEN_GE, start);
+            return make_token(lexer, TOKEN_GT, start);
         case '&':
-            if (match(lexer, '&')) return token_create(TOKEN_AND, "&&", lexer->line, start_column);
-            if (match(lexer, '=')) return token_create(TOKEN_AND_ASSIGN, "&=", lexer->line, start_column);
-            return token_create(TOKEN_AMPERSAND, "&", lexer->line, start_column);
+            if (match(lexer, '&')) return make_token(lexer, TOKEN_AND, start);
+            if (match(lexer, '=')) return make_token(lexer, TOKEN_AND_ASSIGN, start);
+            return make_token(lexer, TOKEN_AMPERSAND, start);
         case '|':
-            if (match(lexer, '|')) return token_create(TOKEN_OR, "||", lexer->line, start_column);
-            if (match(lexer, '=')) return token_create(TOKEN_OR_ASSIGN, "|=", lexer->line, start_column);
-            return token_create(TOKEN_PIPE, "|", lexer->line, start_column);
+            if (match(lexer, '|')) return make_token(lexer, TOKEN_OR, start);
+            if (match(lexer, '=')) return make_token(lexer, TOKEN_OR_ASSIGN, start);
+            return make_token(lexer, TOKEN_PIPE, start);
         case '^':
-            if (match(lexer, '=')) return token_create(TOKEN_XOR_ASSIGN, "^=", lexer->line, start_column);
-            return token_create(TOKEN_CARET, "^", lexer->line, start_column);
+            if (match(lexer, '=')) return make_token(lexer, TOKEN_XOR_ASSIGN, start);
+            return make_token(lexer, TOKEN_CARET, start);
         case '~':
-            return token_create(TOKEN_TILDE, "~", lexer->line, start_column);
+            return make_token(lexer, TOKEN_TILDE, start);
         case '?':
-            return token_create(TOKEN_QUESTION, "?", lexer->line, start_column);
+            return make_token(lexer, TOKEN_QUESTION, start);
         case ':':
-            return token_create(TOKEN_COLON, ":", lexer->line, start_column);
+            return make_token(lexer, TOKEN_COLON, start);
         case '.':
-            return token_create(TOKEN_DOT, ".", lexer->line, start_column);
+            return make_token(lexer, TOKEN_DOT, start);
         case '(':
-            return token_create(TOKEN_LPAREN, "(", lexer->line, start_column);
+            return make_token(lexer, TOKEN_LPAREN, start);
         case ')':
-            return token_create(TOKEN_RPAREN, ")", lexer->line, start_column);
+            return make_token(lexer, TOKEN_RPAREN, start);
         case '{':
-            return token_create(TOKEN_LBRACE, "{", lexer->line, start_column);
+            return make_token(lexer, TOKEN_LBRACE, start);
         case '}':
-            return token_create(TOKEN_RBRACE, "}", lexer->line, start_column);
+            return make_token(lexer, TOKEN_RBRACE, start);
         case '[':
-            return token_create(TOKEN_LBRACKET, "[", lexer->line, start_column);
+            return make_token(lexer, TOKEN_LBRACKET, start);
         case ']':
-            return token_create(TOKEN_RBRACKET, "]", lexer->line, start_column);
+            return make_token(lexer, TOKEN_RBRACKET, start);
         case ';':
-            return token_create(TOKEN_SEMICOLON, ";", lexer->line, start_column);
+            return make_token(lexer, TOKEN_SEMICOLON, start);
         case ',':
-            return token_create(TOKEN_COMMA, ",", lexer->line, start_column);
+            return make_token(lexer, TOKEN_COMMA, start);
     }
 
     char error_msg[100];
     snprintf(error_msg, sizeof(error_msg), "Unexpected character: '%c'", c);
-    return token_create(TOKEN_ERROR, error_msg, lexer->line, start_column);
+    return error_token(arena_strdup(lexer->arena, error_msg), start);
+}
+
+/* Token stream */
+
+void token_stream_init(TokenStream* stream, Lexer* lexer) {
+    stream->lexer = lexer;
+    stream->produced = 0;
+    stream->finished = 0;
+    stream->had_error = 0;
+}
+
+/*
+ * Token at an absolute position. Positions must be no more than
+ * TOKEN_STREAM_WINDOW - 1 behind the furthest one requested; positions past
+ * the end of input return the final EOF token.
+ */
+const Token* token_stream_at(TokenStream* stream, int position) {
+    while (stream->produced <= position && !stream->finished) {
+        Token token = lexer_next_token(stream->lexer);
+
+        if (token.type == TOKEN_ERROR) {
+            stream->had_error = 1;
+            token.type = TOKEN_EOF;
+        }
+        if (token.type == TOKEN_EOF) {
+            stream->finished = 1;
+        }
+
+        stream->window[stream->produced & (TOKEN_STREAM_WINDOW - 1)] = token;
+        stream->produced++;
+    }
+
+    if (position >= stream->produced) {
+        position = stream->produced - 1;
+    }
+    return &stream->window[position & (TOKEN_STREAM_WINDOW - 1)];
 }
 
 /* Tokenize entire source */
 
-TokenList* tokenize(const char* source, const char* filename) {
+TokenList* tokenize(const char* source, size_t length, const char* filename, Arena* arena) {
     TokenList* list = (TokenList*)safe_malloc(sizeof(TokenList));
     list->capacity = 128;
     list->count = 0;
-    list->tokens = (Token**)safe_malloc(sizeof(Token*) * list->capacity);
+    list->tokens = (Token*)safe_malloc(sizeof(Token) * list->capacity);
 
-    Lexer* lexer = lexer_create(source, filename);
+    Lexer* lexer = lexer_create(source, length, filename, arena);
 
     while (1) {
-        Token* token = lexer_next_token(lexer);
+        Token token = lexer_next_token(lexer);
 
         if (list->count >= list->capacity) {
             list->capacity *= 2;
-            list->tokens = (Token**)safe_realloc(list->tokens, sizeof(Token*) * list->capacity);
+            list->tokens = (Token*)safe_realloc(list->tokens, sizeof(Token) * list->capacity);
         }
 
         list->tokens[list->count++] = token;
 
-        if (token->type == TOKEN_EOF || token->type == TOKEN_ERROR) {
+        if (token.type == TOKEN_EOF || token.type == TOKEN_ERROR) {
             break;
         }
     }
@@ -414,9 +444,6 @@ TokenList* tokenize(const char* source, const char* filename) {
 
 void token_list_destroy(TokenList* list) {
     if (list) {
-        for (int i = 0; i < list->count; i++) {
-            token_destroy(list->tokens[i]);
-        }
         free(list->tokens);
         free(list);
     }
@@ -2,6 +2,8 @@
 #define LEXER_H
 
 #include "utils.h"
+#include "arena.h"
+#include "line_index.h"
 
 /* Token types */
 typedef enum {
@@ -81,40 +83,65 @@ typedef enum {
     TOKEN_ERROR
 } TokenType;
 
-/* Token structure */
+/*
+ * Token structure - the lexeme is a view into the source buffer. Only the
+ * byte offset is kept; a LineIndex turns it into a line and column.
+ */
 typedef struct {
     TokenType type;
-    char* lexeme;
-    int line;
-    int column;
+    int offset;         /* Of the first byte in the source */
+    const char* start;  /* Not NUL-terminated; see token_lexeme() */
+    int length;
 } Token;
 
 /* Lexer structure */
 typedef struct {
     const char* source;
     const char* filename;
+    Arena* arena;       /* Owns formatted error messages */
     int current;
-    int line;
-    int column;
     int length;
+    LineIndex lines;    /* Positions for diagnostics, built on first use */
 } Lexer;
 
 /* Lexer functions */
-Lexer* lexer_create(const char* source, const char* filename);
+/* The source need not be NUL-terminated; the lexer never reads past length */
+Lexer* lexer_create(const char* source, size_t length, const char* filename, Arena* arena);
 void lexer_destroy(Lexer* lexer);
-Token* lexer_next_token(Lexer* lexer);
-Token* token_create(TokenType type, const char* lexeme, int line, int column);
-void token_destroy(Token* token);
+Token lexer_next_token(Lexer* lexer);
+/* The keyword token for length bytes of identifier text, or TOKEN_IDENTIFIER */
+TokenType lexer_keyword_type(const char* start, int length);
+Token token_create(TokenType type, const char* start, int length, int offset);
+char* token_lexeme(const Token* token, Arena* arena);
 const char* token_type_to_string(TokenType type);
 
-/* Token list for parser */
+/*
+ * Streaming token source for the parser. Tokens are pulled from the lexer on
+ * demand and only the most recent TOKEN_STREAM_WINDOW are kept, so the whole
+ * token list never exists at once. A lexer error ends the stream: it reads
+ * as TOKEN_EOF from then on and had_error is set.
+ */
+#define TOKEN_STREAM_WINDOW 8   /* Must be a power of two */
+
+typedef struct {
+    Lexer* lexer;
+    Token window[TOKEN_STREAM_WINDOW];
+    int produced;       /* Tokens pulled from the lexer so far */
+    int finished;       /* The final token (EOF or error) has been pulled */
+    int had_error;
+} TokenStream;
+
+void token_stream_init(TokenStream* stream, Lexer* lexer);
+const Token* token_stream_at(TokenStream* stream, int position);
+
+/* Token list, for callers that want every token (e.g. --show-tokens) */
 typedef struct {
-    Token** tokens;
+    Token* tokens;
     int count;
     int capacity;
 } TokenList;
 
-TokenList* tokenize(const char* source, const char* filename);
+TokenList* tokenize(const char* source, size_t length, const char* filename, Arena* arena);
 void token_list_destroy(TokenList* list);
 
 #endif /* LEXER_H */
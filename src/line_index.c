@@ -0,0 +1,57 @@
+#include "line_index.h"
+#include "scan.h"
+
+void line_index_init(LineIndex* index, const char* source, size_t length, Arena* arena) {
+    index->source = source;
+    index->length = length;
+    index->arena = arena;
+    index->line_starts = NULL;
+    index->line_count = 0;
+}
+
+/* Count the newlines, then record where each line starts */
+static void line_index_build(LineIndex* index) {
+    size_t last = 0;
+    size_t newlines = scan_count_newlines(index->source, 0, index->length, &last);
+
+    index->line_starts = (int*)arena_alloc(index->arena, sizeof(int) * (newlines + 1));
+    index->line_starts[0] = 0;
+    int count = 1;
+
+    size_t position = 0;
+    while ((position = scan_find_byte(index->source, position, index->length, '\n')) < index->length) {
+        position++;
+        index->line_starts[count++] = (int)position;
+    }
+    index->line_count = count;
+}
+
+void line_index_position(LineIndex* index, int offset, int* line, int* column) {
+    if (index->line_count == 0) {
+        line_index_build(index);
+    }
+
+    /* Last line starting at or before offset */
+    int low = 0;
+    int high = index->line_count - 1;
+    while (low < high) {
+        int middle = low + (high - low + 1) / 2;
+        if (index->line_starts[middle] <= offset) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+
+    *line = low + 1;
+    *column = offset - index->line_starts[low] + 1;
+}
+
+int line_index_line(LineIndex* index, int offset) {
+    if (offset < 0) return 0;
+
+    int line;
+    int column;
+    line_index_position(index, offset, &line, &column);
+    return line;
+}
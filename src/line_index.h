@@ -0,0 +1,30 @@
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include "utils.h"
+#include "arena.h"
+
+/*
+ * Line and column lookup for byte offsets. Tokens and AST nodes store only
+ * offsets; positions are worked out here when a diagnostic or dump needs
+ * them. The table of line starts is built on the first lookup, so a clean
+ * compilation never scans for newlines at all.
+ */
+typedef struct {
+    const char* source;
+    size_t length;
+    Arena* arena;       /* Owns the line table */
+    int* line_starts;   /* Offset of the first byte of each line */
+    int line_count;     /* 0 until the table is built */
+} LineIndex;
+
+/* Set up an index over source; nothing is scanned yet */
+void line_index_init(LineIndex* index, const char* source, size_t length, Arena* arena);
+
+/* 1-based line and column (in bytes) of offset, which may be length itself */
+void line_index_position(LineIndex* index, int offset, int* line, int* column);
+
+/* 1-based line of offset, or 0 for a negative (unknown) offset */
+int line_index_line(LineIndex* index, int offset);
+
+#endif /* LINE_INDEX_H */
@@ -2,16 +2,42 @@
 #include <stdlib.h>
 #include <string.h>
 #include "utils.h"
-#include "lexer.h"
-#include "parser.h"
-#include "semantic.h"
-#include "translator.h"
-#include "formatter.h"
+#include "compiler.h"
+#include "batch.h"
+#include "server.h"
 
 /* Command line options */
 typedef struct {
     char* input_file;
     char* output_file;
+    InputList* inputs;
+    int jobs;           /* Worker threads for batch mode (0 = one per CPU) */
+    int read_ahead;     /* Batch pipeline queue bounds (0 = no pipeline) */
+    int write_behind;
+    char* archive_file; /* Batch outputs go into this one archive */
+    int function_jobs;  /* Threads per file for function translation */
+    int memoise;
+    int stream;
+    char* cache_dir;
+    long cache_size_mb;
+    TranslationCache* cache;
+    int includes;       /* Resolve #include lines */
+    char** include_paths;
+    int include_path_count;
+    char* header_cache_dir;
+    HeaderCache* headers;
+    char* spelling_file;        /* Extra American-to-British spellings */
+    SpellingDictionary* spelling;
+    int wrap_width;
+    int formats;        /* Output formats, a mask of RENDER_FORMAT_BIT()s (0 = text) */
+    int stats;
+    char* trace_file;
+    TraceLog* trace;
+    int serve;
+    char* socket_path;
+    int incremental;    /* Server: retranslate only the functions a request changes */
+    int batch;
+    int input_error;
     int show_tokens;
     int show_ast;
     int verbose;
@@ -22,9 +48,47 @@ typedef struct {
 /* Print usage information */
 static void print_usage(const char* program_name) {
     printf("C to British English Compiler (c2en) - Version %s\n\n", C2EN_VERSION_STRING);
-    printf("Usage: %s <input.c> [options]\n\n", program_name);
+    printf("Usage: %s <input.c | -> [options]\n", program_name);
+    printf("       %s <input.c | directory | @response-file>... [options]\n\n", program_name);
     printf("Options:\n");
-    printf("  -o <file>       Specify output file (default: input filename with .txt extension)\n");
+    printf("  -o <file>       Specify output file, or - for standard output\n");
+    printf("                  (default: input filename with the format's extension)\n");
+    printf("  -f <formats>    Write a comma-separated list of formats from one translation:\n");
+    printf("                  text, md, html or json (default: text); with more than one,\n");
+    printf("                  each output takes its format's extension\n");
+    printf("  -j <n>          Translate inputs on n worker threads (default: one per CPU)\n");
+    printf("  --read-ahead <n>\n");
+    printf("                  In batch mode, read up to n sources ahead of translation\n");
+    printf("                  on a reader thread and write results behind it\n");
+    printf("  --write-behind <n>\n");
+    printf("                  Results waiting to be written (default: the read-ahead)\n");
+    printf("  --archive <file>\n");
+    printf("                  In batch mode, put every output in one indexed archive file,\n");
+    printf("                  reusing the entries of unchanged inputs it already holds\n");
+    printf("  --function-jobs <n>\n");
+    printf("                  Translate each file's functions on n threads (default: 1)\n");
+    printf("  --memoise       Describe functions that differ only in name once\n");
+    printf("  --stream        Write each function as soon as it is parsed, in memory\n");
+    printf("                  bounded by the largest function\n");
+    printf("  --cache-dir <dir>\n");
+    printf("                  Reuse translations of unchanged inputs stored in dir\n");
+    printf("  --cache-size <mb>\n");
+    printf("                  Size cap for the cache directory (default: %d)\n", CACHE_DEFAULT_SIZE_MB);
+    printf("  --includes      Read the headers each input includes and describe calls\n");
+    printf("                  into them with their declarations\n");
+    printf("  -I <dir>        Search dir for included headers (implies --includes)\n");
+    printf("  --header-cache <dir>\n");
+    printf("                  Keep header summaries in dir between runs (implies --includes)\n");
+    printf("  --spelling <file>\n");
+    printf("                  Add the American-to-British spellings in file, one pair a line\n");
+    printf("  --wrap <n>      Wrap output lines at n columns\n");
+    printf("  --serve         Translate length-prefixed requests from standard input\n");
+    printf("  --socket <path> With --serve, listen on a Unix socket instead\n");
+    printf("  --incremental   With --serve, take each request as a revision of the last and\n");
+    printf("                  redo only the functions it changes\n");
+    printf("  --stats         Report time per phase, sizes and memory for each file\n");
+    printf("  --trace-json <file>\n");
+    printf("                  Write phase timings as Chrome trace events\n");
     printf("  -v              Verbose mode (show compilation stages)\n");
     printf("  --show-tokens   Display tokenization result\n");
     printf("  --show-ast      Display abstract syntax tree\n");
@@ -33,7 +97,10 @@ static void print_usage(const char* program_name) {
     printf("Examples:\n");
     printf("  %s hello.c                    # Compile hello.c to hello.txt\n", program_name);
     printf("  %s factorial.c -o output.txt  # Compile to specific output file\n", program_name);
-    printf("  %s test.c -v                  # Compile with verbose output\n\n", program_name);
+    printf("  %s hello.c -f text,md,json    # Write hello.txt, hello.md and hello.json\n", program_name);
+    printf("  %s test.c -v                  # Compile with verbose output\n", program_name);
+    printf("  %s - < test.c > test.txt      # Read standard input, write standard output\n", program_name);
+    printf("  %s src/ -j 8                  # Compile every .c file under src/\n\n", program_name);
 }
 
 /* Print version information */
@@ -58,6 +125,9 @@ static void print_version(void) {
 /* Parse command line arguments */
 static Options parse_arguments(int argc, char** argv) {
     Options opts = {0};
+    opts.inputs = input_list_create();
+    opts.function_jobs = 1;
+    opts.cache_size_mb = CACHE_DEFAULT_SIZE_MB;
 
     if (argc < 2) {
         opts.show_help = 1;
@@ -82,172 +152,357 @@ static Options parse_arguments(int argc, char** argv) {
                 log_message(LOG_ERROR, "Option -o requires an argument");
                 opts.show_help = 1;
             }
-        } else if (argv[i][0] == '-') {
-            log_message(LOG_ERROR, "Unknown option: %s", argv[i]);
-            opts.show_help = 1;
-        } else {
-            if (!opts.input_file) {
-                opts.input_file = argv[i];
+        } else if (string_equals(argv[i], "-f") || string_equals(argv[i], "--format")) {
+            if (i + 1 < argc) {
+                opts.formats = render_parse_formats(argv[++i]);
+                if (!opts.formats) {
+                    opts.show_help = 1;
+                }
+            } else {
+                log_message(LOG_ERROR, "Option %s requires a list of formats", argv[i]);
+                opts.show_help = 1;
+            }
+        } else if (string_equals(argv[i], "-j")) {
+            char* end = NULL;
+            long jobs = i + 1 < argc ? strtol(argv[i + 1], &end, 10) : 0;
+            if (jobs > 0 && end && *end == '\0') {
+                opts.jobs = (int)jobs;
+                opts.batch = 1;
+                i++;
+            } else {
+                log_message(LOG_ERROR, "Option -j requires a positive number");
+                opts.show_help = 1;
+            }
+        } else if (string_equals(argv[i], "--read-ahead") || string_equals(argv[i], "--write-behind")) {
+            char* end = NULL;
+            long depth = i + 1 < argc ? strtol(argv[i + 1], &end, 10) : 0;
+            if (depth > 0 && depth <= 65536 && end && *end == '\0') {
+                if (string_equals(argv[i], "--read-ahead")) {
+                    opts.read_ahead = (int)depth;
+                } else {
+                    opts.write_behind = (int)depth;
+                }
+                opts.batch = 1;
+                i++;
+            } else {
+                log_message(LOG_ERROR, "Option %s requires a positive number", argv[i]);
+                opts.show_help = 1;
+            }
+        } else if (string_equals(argv[i], "--function-jobs")) {
+            char* end = NULL;
+            long jobs = i + 1 < argc ? strtol(argv[i + 1], &end, 10) : 0;
+            if (jobs > 0 && end && *end == '\0') {
+                opts.function_jobs = (int)jobs;
+                i++;
+            } else {
+                log_message(LOG_ERROR, "Option --function-jobs requires a positive number");
+                opts.show_help = 1;
+            }
+        } else if (string_equals(argv[i], "--archive")) {
+            if (i + 1 < argc) {
+                opts.archive_file = argv[++i];
+                opts.batch = 1;
+            } else {
+                log_message(LOG_ERROR, "Option --archive requires a file name");
+                opts.show_help = 1;
+            }
+        } else if (string_equals(argv[i], "--memoise")) {
+            opts.memoise = 1;
+        } else if (string_equals(argv[i], "--stream")) {
+            opts.stream = 1;
+        } else if (string_equals(argv[i], "--serve")) {
+            opts.serve = 1;
+        } else if (string_equals(argv[i], "--incremental")) {
+            opts.incremental = 1;
+        } else if (string_equals(argv[i], "--socket")) {
+            if (i + 1 < argc) {
+                opts.socket_path = argv[++i];
+            } else {
+                log_message(LOG_ERROR, "Option --socket requires a path");
+                opts.show_help = 1;
+            }
+        } else if (string_equals(argv[i], "--stats")) {
+            opts.stats = 1;
+        } else if (string_equals(argv[i], "--trace-json")) {
+            if (i + 1 < argc) {
+                opts.trace_file = argv[++i];
+            } else {
+                log_message(LOG_ERROR, "Option --trace-json requires a file name");
+                opts.show_help = 1;
+            }
+        } else if (string_equals(argv[i], "--cache-dir")) {
+            if (i + 1 < argc) {
+                opts.cache_dir = argv[++i];
+            } else {
+                log_message(LOG_ERROR, "Option --cache-dir requires a directory");
+                opts.show_help = 1;
+            }
+        } else if (string_equals(argv[i], "--includes")) {
+            opts.includes = 1;
+        } else if (string_equals(argv[i], "-I")) {
+            if (i + 1 < argc) {
+                opts.include_paths = (char**)safe_realloc(opts.include_paths,
+                                                          sizeof(char*) * (opts.include_path_count + 1));
+                opts.include_paths[opts.include_path_count++] = argv[++i];
+                opts.includes = 1;
+            } else {
+                log_message(LOG_ERROR, "Option -I requires a directory");
+                opts.show_help = 1;
+            }
+        } else if (string_equals(argv[i], "--header-cache")) {
+            if (i + 1 < argc) {
+                opts.header_cache_dir = argv[++i];
+                opts.includes = 1;
+            } else {
+                log_message(LOG_ERROR, "Option --header-cache requires a directory");
+                opts.show_help = 1;
+            }
+        } else if (string_equals(argv[i], "--spelling")) {
+            if (i + 1 < argc) {
+                opts.spelling_file = argv[++i];
+            } else {
+                log_message(LOG_ERROR, "Option --spelling requires a file name");
+                opts.show_help = 1;
+            }
+        } else if (string_equals(argv[i], "--wrap")) {
+            char* end = NULL;
+            long width = i + 1 < argc ? strtol(argv[i + 1], &end, 10) : 0;
+            if (width > 0 && width <= 65536 && end && *end == '\0') {
+                opts.wrap_width = (int)width;
+                i++;
+            } else {
+                log_message(LOG_ERROR, "Option --wrap requires a positive number");
+                opts.show_help = 1;
+            }
+        } else if (string_equals(argv[i], "--cache-size")) {
+            char* end = NULL;
+            long size = i + 1 < argc ? strtol(argv[i + 1], &end, 10) : 0;
+            if (size > 0 && end && *end == '\0') {
+                opts.cache_size_mb = size;
+                i++;
             } else {
-                log_message(LOG_ERROR, "Multiple input files specified");
+                log_message(LOG_ERROR, "Option --cache-size requires a positive number");
                 opts.show_help = 1;
             }
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            log_message(LOG_ERROR, "Unknown option: %s", argv[i]);
+            opts.show_help = 1;
+        } else if (!input_list_add(opts.inputs, argv[i])) {
+            opts.input_error = 1;
         }
     }
 
-    /* Generate default output filename if not specified */
-    if (opts.input_file && !opts.output_file && !opts.show_help && !opts.show_version) {
-        size_t len = strlen(opts.input_file);
-        char* output = (char*)safe_malloc(len + 5);
-        strcpy(output, opts.input_file);
-
-        /* Replace .c extension with .txt */
-        if (len > 2 && output[len-2] == '.' && output[len-1] == 'c') {
-            output[len-2] = '\0';
-        } else if (len > 2 && output[len-1] == 'c') {
-            output[len-1] = '\0';
+    /* A server takes its sources from requests */
+    if (opts.serve || opts.socket_path || opts.incremental) {
+        if (!opts.serve) {
+            log_message(LOG_ERROR, opts.socket_path ? "Option --socket needs --serve"
+                                                    : "Option --incremental needs --serve");
+            opts.show_help = 1;
+        }
+        if (opts.inputs->count > 0 || opts.output_file || opts.batch) {
+            log_message(LOG_ERROR, "Option --serve cannot be used with input files, -o, -j or --archive");
+            opts.show_help = 1;
+        }
+        if (opts.includes) {
+            log_message(LOG_ERROR, "Option --serve cannot be used with --includes, -I or --header-cache");
+            opts.show_help = 1;
+        }
+        if (opts.spelling_file || opts.wrap_width) {
+            log_message(LOG_ERROR, "Option --serve cannot be used with --spelling or --wrap");
+            opts.show_help = 1;
+        }
+        if (opts.formats & ~RENDER_FORMAT_BIT(RENDER_TEXT)) {
+            log_message(LOG_ERROR, "Option --serve only writes text");
+            opts.show_help = 1;
         }
-        strcat(output, ".txt");
-        opts.output_file = output;
+        return opts;
     }
 
-    return opts;
-}
-
-/* Main compilation function */
-static int compile(Options* opts) {
-    if (opts->verbose) {
-        log_message(LOG_INFO, "Starting compilation of %s", opts->input_file);
+    /* Several inputs, a directory or a response file mean batch mode */
+    if (opts.inputs->count > 1 || opts.inputs->expanded) {
+        opts.batch = 1;
     }
 
-    /* Read source file */
-    if (opts->verbose) {
-        log_message(LOG_INFO, "Reading source file...");
-    }
-    char* source = read_file(opts->input_file);
-    if (!source) {
-        log_message(LOG_ERROR, "Failed to read input file: %s", opts->input_file);
-        return 1;
+    if (opts.batch) {
+        if (opts.output_file) {
+            log_message(LOG_ERROR, opts.archive_file ? "Option -o cannot be used with --archive"
+                                                     : "Option -o cannot be used with multiple input files");
+            opts.show_help = 1;
+        }
+        if (opts.archive_file && opts.stream) {
+            log_message(LOG_ERROR, "Option --archive cannot be used with --stream");
+            opts.show_help = 1;
+        }
+        if (opts.show_tokens || opts.show_ast) {
+            log_message(LOG_ERROR, "Options --show-tokens and --show-ast need a single input file");
+            opts.show_help = 1;
+        }
+        for (int i = 0; i < opts.inputs->count; i++) {
+            if (string_equals(opts.inputs->paths[i], "-")) {
+                log_message(LOG_ERROR, opts.archive_file ? "Standard input cannot be used with --archive"
+                                                         : "Standard input cannot be used with multiple input files");
+                opts.show_help = 1;
+                break;
+            }
+        }
+        return opts;
     }
 
-    /* Lexical analysis */
-    if (opts->verbose) {
-        log_message(LOG_INFO, "Performing lexical analysis...");
+    if (opts.inputs->count == 1) {
+        opts.input_file = opts.inputs->paths[0];
     }
-    TokenList* tokens = tokenize(source, opts->input_file);
 
-    if (opts->show_tokens) {
-        printf("\n=== TOKENS ===\n");
-        for (int i = 0; i < tokens->count; i++) {
-            Token* token = tokens->tokens[i];
-            printf("%d:%d  %-15s  '%s'\n",
-                   token->line, token->column,
-                   token_type_to_string(token->type),
-                   token->lexeme);
+    /* Generate default output filename if not specified; stdin goes to stdout */
+    if (opts.input_file && !opts.output_file && !opts.show_help && !opts.show_version) {
+        if (string_equals(opts.input_file, "-")) {
+            opts.output_file = "-";
+        } else {
+            opts.output_file = default_output_filename(opts.input_file, render_first_format(opts.formats));
         }
-        printf("\n");
-    }
-
-    /* Check for lexer errors */
-    if (tokens->count > 0 && tokens->tokens[tokens->count - 1]->type == TOKEN_ERROR) {
-        log_message(LOG_ERROR, "Lexical analysis failed");
-        token_list_destroy(tokens);
-        free(source);
-        return 1;
     }
 
-    /* Syntax analysis */
-    if (opts->verbose) {
-        log_message(LOG_INFO, "Performing syntax analysis...");
+    /* Each format needs a file of its own */
+    if (opts.output_file && string_equals(opts.output_file, "-") && (opts.formats & (opts.formats - 1))) {
+        log_message(LOG_ERROR, "Standard output can only take one format");
+        opts.show_help = 1;
     }
-    ASTNode* ast = parse(tokens, opts->input_file);
 
-    if (!ast) {
-        log_message(LOG_ERROR, "Syntax analysis failed");
-        token_list_destroy(tokens);
-        free(source);
-        return 1;
-    }
+    return opts;
+}
 
-    if (opts->show_ast) {
-        printf("\n=== ABSTRACT SYNTAX TREE ===\n");
-        ast_print(ast, 0);
-        printf("\n");
-    }
+/* Main compilation function */
+static int compile(Options* opts) {
+    CompileOptions options = { opts->show_tokens, opts->show_ast, opts->verbose, opts->function_jobs,
+                               opts->memoise, opts->cache, opts->stats, opts->trace, opts->stream,
+                               opts->headers, opts->spelling, opts->wrap_width, opts->formats };
+    Compiler* compiler = compiler_create();
+    int result = compile_file(compiler, opts->input_file, opts->output_file, &options);
+    compiler_destroy(compiler);
 
-    /* Semantic analysis */
-    if (opts->verbose) {
-        log_message(LOG_INFO, "Performing semantic analysis...");
-    }
-    if (!analyze_semantics(ast, opts->input_file)) {
-        log_message(LOG_ERROR, "Semantic analysis failed");
-        ast_destroy(ast);
-        token_list_destroy(tokens);
-        free(source);
-        return 1;
+    /* Keep standard output clean when it carries the translation */
+    if (result == 0 && !opts->verbose && !string_equals(opts->output_file, "-")) {
+        int formats = compile_formats(&options);
+        for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+            if (!(formats & RENDER_FORMAT_BIT(i))) continue;
+            char* output_file = compile_output_filename(opts->output_file, (RenderFormat)i, &options);
+            printf("Successfully compiled %s to %s\n", opts->input_file, output_file);
+            free(output_file);
+        }
     }
+    return result;
+}
 
-    /* Translation to English */
-    if (opts->verbose) {
-        log_message(LOG_INFO, "Translating to British English...");
+/* Translate every input on a pool of worker threads */
+static int compile_batch(Options* opts) {
+    CompileOptions options = { 0, 0, opts->verbose, opts->function_jobs, opts->memoise, opts->cache,
+                               opts->stats, opts->trace, opts->stream, opts->headers, opts->spelling,
+                               opts->wrap_width, opts->formats };
+    ArchiveWriter* archive = NULL;
+    if (opts->archive_file) {
+        archive = archive_writer_create(opts->archive_file);
+        if (!archive) {
+            return 1;
+        }
     }
-    char* english = translate_to_english(ast);
 
-    /* Format output */
-    if (opts->verbose) {
-        log_message(LOG_INFO, "Formatting output...");
-    }
-    char* formatted = format_english_output(english);
+    BatchOptions batch = { opts->jobs, opts->read_ahead, opts->write_behind, archive };
+    int failures = run_batch(opts->inputs, &batch, &options);
+    int total = opts->inputs->count;
 
-    /* Write output file */
-    if (opts->verbose) {
-        log_message(LOG_INFO, "Writing output to %s", opts->output_file);
-    }
-    if (!write_file(opts->output_file, formatted)) {
-        log_message(LOG_ERROR, "Failed to write output file");
-        free(formatted);
-        free(english);
-        ast_destroy(ast);
-        token_list_destroy(tokens);
-        free(source);
+    if (archive && !archive_writer_finish(archive)) {
         return 1;
     }
 
-    if (opts->verbose) {
-        log_message(LOG_INFO, "Compilation completed successfully!");
+    if (opts->archive_file) {
+        printf("Successfully compiled %d of %d files into %s\n", total - failures, total, opts->archive_file);
     } else {
-        printf("Successfully compiled %s to %s\n", opts->input_file, opts->output_file);
+        printf("Successfully compiled %d of %d files\n", total - failures, total);
     }
+    return failures > 0 ? 1 : 0;
+}
 
-    /* Cleanup */
-    free(formatted);
-    free(english);
-    ast_destroy(ast);
-    token_list_destroy(tokens);
-    free(source);
-
-    return 0;
+/* Run as a resident server with one warm library context */
+static int serve(Options* opts) {
+    ServeOptions options;
+    c2en_options_init(&options.library);
+    options.socket_path = opts->socket_path;
+    options.verbose = opts->verbose;
+    options.library.memoise = opts->memoise;
+    options.library.incremental = opts->incremental;
+    options.library.cache_dir = opts->cache_dir;
+    options.library.cache_max_bytes = (size_t)opts->cache_size_mb * 1024 * 1024;
+    return run_server(&options);
 }
 
 /* Main entry point */
 int main(int argc, char** argv) {
     Options opts = parse_arguments(argc, argv);
+    int result = 0;
 
-    if (opts.show_help) {
-        print_usage(argv[0]);
-        return 0;
+    /* The server's library context opens its own cache */
+    if (opts.cache_dir && !opts.serve && !opts.show_help && !opts.show_version && !opts.input_error) {
+        size_t max_bytes = (size_t)opts.cache_size_mb * 1024 * 1024;
+        opts.cache = translation_cache_create(opts.cache_dir, max_bytes);
+        if (!opts.cache) {
+            opts.input_error = 1;
+        }
     }
 
-    if (opts.show_version) {
-        print_version();
-        return 0;
+    if (opts.includes && !opts.serve && !opts.show_help && !opts.show_version && !opts.input_error) {
+        opts.headers = header_cache_create(opts.include_paths, opts.include_path_count, opts.header_cache_dir);
+        if (!opts.headers) {
+            opts.input_error = 1;
+        }
     }
 
-    if (!opts.input_file) {
+    if (opts.spelling_file && !opts.serve && !opts.show_help && !opts.show_version && !opts.input_error) {
+        opts.spelling = spelling_dictionary_create();
+        if (!spelling_dictionary_load(opts.spelling, opts.spelling_file)) {
+            opts.input_error = 1;
+        }
+    }
+
+    if (opts.trace_file) {
+        opts.trace = trace_log_create();
+    }
+
+    if (opts.show_help) {
+        print_usage(argv[0]);
+    } else if (opts.show_version) {
+        print_version();
+    } else if (opts.input_error) {
+        result = 1;
+    } else if (opts.serve) {
+        result = serve(&opts);
+    } else if (opts.batch) {
+        if (opts.inputs->count == 0) {
+            log_message(LOG_ERROR, "No input files found");
+            result = 1;
+        } else {
+            result = compile_batch(&opts);
+        }
+    } else if (!opts.input_file) {
         log_message(LOG_ERROR, "No input file specified");
         print_usage(argv[0]);
-        return 1;
+        result = 1;
+    } else {
+        result = compile(&opts);
     }
 
-    return compile(&opts);
+    if (opts.trace) {
+        if (!trace_log_write(opts.trace, opts.trace_file)) {
+            log_message(LOG_ERROR, "Failed to write trace file");
+            result = 1;
+        }
+        trace_log_destroy(opts.trace);
+    }
+    if (opts.cache) {
+        translation_cache_trim(opts.cache);
+        translation_cache_destroy(opts.cache);
+    }
+    header_cache_destroy(opts.headers);
+    spelling_dictionary_destroy(opts.spelling);
+    free(opts.include_paths);
+    input_list_destroy(opts.inputs);
+    return result;
 }
@@ -0,0 +1,294 @@
+#include "output.h"
+
+/* Chunk sizing: start small, double up to a ceiling */
+#define OUTPUT_CHUNK_MIN 4096
+#define OUTPUT_CHUNK_MAX (1024 * 1024)
+
+/* Chunk size while streaming to a sink */
+#define OUTPUT_STREAM_CHUNK (64 * 1024)
+
+/* Chunk management */
+
+static OutputChunk* output_chunk_create(size_t capacity) {
+    OutputChunk* chunk = (OutputChunk*)safe_malloc(sizeof(OutputChunk) + capacity);
+    chunk->next = NULL;
+    chunk->length = 0;
+    chunk->capacity = capacity;
+    return chunk;
+}
+
+/* Write every held chunk to the sink, keeping only the (emptied) tail */
+static void output_drain(OutputBuilder* builder) {
+    OutputChunk* current = builder->head;
+    while (current) {
+        OutputChunk* next = current->next;
+        if (current->length > 0 &&
+            !builder->writer(builder->writer_context, current->data, current->length)) {
+            builder->sink_error = 1;
+        }
+        builder->written += current->length;
+        if (current != builder->tail) {
+            free(current);
+        }
+        current = next;
+    }
+
+    if (builder->tail) {
+        builder->tail->length = 0;
+    }
+    builder->head = builder->tail;
+    builder->length = 0;
+}
+
+/* Ensure the tail chunk has room for at least 'needed' more bytes */
+static OutputChunk* output_reserve(OutputBuilder* builder, size_t needed) {
+    OutputChunk* tail = builder->tail;
+    if (tail && tail->capacity - tail->length >= needed) {
+        return tail;
+    }
+
+    if (builder->writer) {
+        output_drain(builder);
+        if (tail && tail->capacity >= needed) {
+            return tail;
+        }
+
+        /* Replace the chunk with one big enough for this append */
+        free(tail);
+        size_t capacity = needed > OUTPUT_STREAM_CHUNK ? needed : OUTPUT_STREAM_CHUNK;
+        OutputChunk* chunk = output_chunk_create(capacity);
+        builder->head = chunk;
+        builder->tail = chunk;
+        return chunk;
+    }
+
+    size_t capacity = tail ? tail->capacity * 2 : OUTPUT_CHUNK_MIN;
+    if (capacity > OUTPUT_CHUNK_MAX) capacity = OUTPUT_CHUNK_MAX;
+    if (capacity < needed) capacity = needed;
+
+    OutputChunk* chunk = output_chunk_create(capacity);
+    if (tail) {
+        tail->next = chunk;
+    } else {
+        builder->head = chunk;
+    }
+    builder->tail = chunk;
+    return chunk;
+}
+
+/* Builder creation and destruction */
+
+OutputBuilder* output_builder_create(void) {
+    OutputBuilder* builder = (OutputBuilder*)safe_malloc(sizeof(OutputBuilder));
+    builder->head = NULL;
+    builder->tail = NULL;
+    builder->length = 0;
+    builder->writer = NULL;
+    builder->writer_context = NULL;
+    builder->sink = NULL;
+    builder->written = 0;
+    builder->sink_error = 0;
+    return builder;
+}
+
+void output_builder_clear(OutputBuilder* builder) {
+    if (!builder) return;
+
+    OutputChunk* current = builder->head;
+    while (current) {
+        OutputChunk* next = current->next;
+        free(current);
+        current = next;
+    }
+
+    builder->head = NULL;
+    builder->tail = NULL;
+    builder->length = 0;
+}
+
+void output_builder_destroy(OutputBuilder* builder) {
+    if (!builder) return;
+    output_builder_clear(builder);
+    free(builder);
+}
+
+/* Appending text */
+
+void output_append_length(OutputBuilder* builder, const char* text, size_t length) {
+    if (!text || length == 0) return;
+
+    OutputChunk* tail = builder->tail;
+    size_t room = tail ? tail->capacity - tail->length : 0;
+
+    /* Fill the current tail first, then spill the rest into a new chunk */
+    if (room > 0) {
+        size_t part = length < room ? length : room;
+        memcpy(tail->data + tail->length, text, part);
+        tail->length += part;
+        builder->length += part;
+        text += part;
+        length -= part;
+    }
+
+    if (length > 0) {
+        OutputChunk* chunk = output_reserve(builder, length);
+        memcpy(chunk->data + chunk->length, text, length);
+        chunk->length += length;
+        builder->length += length;
+    }
+}
+
+void output_append(OutputBuilder* builder, const char* text) {
+    if (!text) return;
+    output_append_length(builder, text, strlen(text));
+}
+
+void output_append_char(OutputBuilder* builder, char c) {
+    OutputChunk* chunk = output_reserve(builder, 1);
+    chunk->data[chunk->length++] = c;
+    builder->length++;
+}
+
+void output_appendf(OutputBuilder* builder, const char* format, ...) {
+    va_list args;
+    va_list retry;
+
+    va_start(args, format);
+    va_copy(retry, args);
+
+    /* Try formatting straight into the tail; vsnprintf needs room for its NUL */
+    OutputChunk* tail = output_reserve(builder, 1);
+    size_t room = tail->capacity - tail->length;
+    int written = vsnprintf(tail->data + tail->length, room, format, args);
+
+    if (written >= 0 && (size_t)written < room) {
+        tail->length += (size_t)written;
+        builder->length += (size_t)written;
+    } else if (written > 0) {
+        /* Did not fit - start a chunk large enough for the whole result */
+        OutputChunk* chunk = output_reserve(builder, (size_t)written + 1);
+        vsnprintf(chunk->data + chunk->length, (size_t)written + 1, format, retry);
+        chunk->length += (size_t)written;
+        builder->length += (size_t)written;
+    }
+
+    va_end(retry);
+    va_end(args);
+}
+
+/* Append a copy of src's text, leaving src unchanged */
+void output_builder_append_copy(OutputBuilder* builder, const OutputBuilder* src) {
+    for (OutputChunk* chunk = src->head; chunk; chunk = chunk->next) {
+        output_append_length(builder, chunk->data, chunk->length);
+    }
+}
+
+/* Move every chunk of src onto the end of builder without copying text */
+void output_builder_splice(OutputBuilder* builder, OutputBuilder* src) {
+    if (!src->head) return;
+
+    if (builder->tail) {
+        builder->tail->next = src->head;
+    } else {
+        builder->head = src->head;
+    }
+    builder->tail = src->tail;
+    builder->length += src->length;
+
+    src->head = NULL;
+    src->tail = NULL;
+    src->length = 0;
+}
+
+/* Patching */
+
+OutputMark output_builder_mark(const OutputBuilder* builder) {
+    OutputMark mark;
+    mark.chunk = builder->tail;
+    mark.offset = builder->tail ? builder->tail->length : 0;
+    return mark;
+}
+
+/* The first byte appended after mark, or NULL if nothing has been appended */
+char* output_builder_mark_text(OutputBuilder* builder, OutputMark mark) {
+    OutputChunk* chunk = mark.chunk ? mark.chunk : builder->head;
+    size_t offset = mark.chunk ? mark.offset : 0;
+
+    /* Appends that did not fit went to the following chunk */
+    while (chunk && offset >= chunk->length) {
+        chunk = chunk->next;
+        offset = 0;
+    }
+    return chunk ? chunk->data + offset : NULL;
+}
+
+/* Streaming */
+
+int output_file_writer(void* file, const char* data, size_t length) {
+    return fwrite(data, 1, length, (FILE*)file) == length;
+}
+
+void output_builder_set_sink(OutputBuilder* builder, FILE* sink) {
+    output_builder_set_writer(builder, sink ? output_file_writer : NULL, sink);
+    builder->sink = sink;
+}
+
+void output_builder_set_writer(OutputBuilder* builder, OutputWriter writer, void* context) {
+    builder->writer = writer;
+    builder->writer_context = writer ? context : NULL;
+    builder->sink = NULL;
+    builder->written = 0;
+    builder->sink_error = 0;
+}
+
+/* Write out everything held; returns 0 if any write to the sink failed */
+int output_builder_flush(OutputBuilder* builder) {
+    if (!builder->writer) return 1;
+
+    output_drain(builder);
+    if (builder->sink && fflush(builder->sink) != 0) {
+        builder->sink_error = 1;
+    }
+    return !builder->sink_error;
+}
+
+/* Extracting text */
+
+char* output_builder_to_string(const OutputBuilder* builder) {
+    char* result = (char*)safe_malloc(builder->length + 1);
+    size_t offset = 0;
+
+    for (OutputChunk* chunk = builder->head; chunk; chunk = chunk->next) {
+        memcpy(result + offset, chunk->data, chunk->length);
+        offset += chunk->length;
+    }
+
+    result[offset] = '\0';
+    return result;
+}
+
+int output_builder_write(const OutputBuilder* builder, FILE* file) {
+    return output_builder_emit(builder, output_file_writer, file);
+}
+
+/* Pass every held chunk to writer; returns 0 as soon as a write fails */
+int output_builder_emit(const OutputBuilder* builder, OutputWriter writer, void* context) {
+    for (OutputChunk* chunk = builder->head; chunk; chunk = chunk->next) {
+        if (chunk->length > 0 && !writer(context, chunk->data, chunk->length)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int output_builder_write_file(const OutputBuilder* builder, const char* filename) {
+    FILE* file = fopen(filename, "w");
+    if (!file) {
+        log_message(LOG_ERROR, "Cannot write to file: %s", filename);
+        return 0;
+    }
+
+    int ok = output_builder_write(builder, file);
+    if (fclose(file) != 0) ok = 0;
+    return ok;
+}
@@ -0,0 +1,70 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "utils.h"
+
+/* One segment of built output text (not NUL-terminated) */
+typedef struct OutputChunk {
+    struct OutputChunk* next;
+    size_t length;
+    size_t capacity;
+    char data[];
+} OutputChunk;
+
+/* Destination for streamed text; returns 0 if the bytes were not taken */
+typedef int (*OutputWriter)(void* context, const char* data, size_t length);
+
+/* Writer for a FILE* context */
+int output_file_writer(void* file, const char* data, size_t length);
+
+/*
+ * Segmented output builder - appends never move existing text. With a sink
+ * set, the builder streams: whenever it needs a new chunk it writes what it
+ * holds to the sink and reuses the chunk, so only one chunk is ever held.
+ */
+typedef struct {
+    OutputChunk* head;
+    OutputChunk* tail;
+    size_t length;      /* Bytes currently held */
+    OutputWriter writer;        /* Sink, or NULL to keep the text */
+    void* writer_context;
+    FILE* sink;                 /* Flushed after writing, when the sink is a file */
+    size_t written;     /* Bytes already written to the sink */
+    int sink_error;     /* A write to the sink failed */
+} OutputBuilder;
+
+/* A position in a builder, for patching text after it has been appended */
+typedef struct {
+    OutputChunk* chunk;
+    size_t offset;
+} OutputMark;
+
+/* Builder creation and destruction */
+OutputBuilder* output_builder_create(void);
+void output_builder_destroy(OutputBuilder* builder);
+void output_builder_clear(OutputBuilder* builder);
+
+/* Appending text */
+void output_append(OutputBuilder* builder, const char* text);
+void output_append_length(OutputBuilder* builder, const char* text, size_t length);
+void output_append_char(OutputBuilder* builder, char c);
+void output_appendf(OutputBuilder* builder, const char* format, ...);
+void output_builder_splice(OutputBuilder* builder, OutputBuilder* src);
+void output_builder_append_copy(OutputBuilder* builder, const OutputBuilder* src);
+
+/* Patching; marks are not valid across a sink flush */
+OutputMark output_builder_mark(const OutputBuilder* builder);
+char* output_builder_mark_text(OutputBuilder* builder, OutputMark mark);
+
+/* Streaming */
+void output_builder_set_sink(OutputBuilder* builder, FILE* sink);
+void output_builder_set_writer(OutputBuilder* builder, OutputWriter writer, void* context);
+int output_builder_flush(OutputBuilder* builder);
+
+/* Extracting text */
+char* output_builder_to_string(const OutputBuilder* builder);
+int output_builder_write(const OutputBuilder* builder, FILE* file);
+int output_builder_emit(const OutputBuilder* builder, OutputWriter writer, void* context);
+int output_builder_write_file(const OutputBuilder* builder, const char* filename);
+
+#endif /* OUTPUT_H */
@@ -1,58 +1,96 @@
 #include "parser.h"
 
 /* Forward declarations for recursive descent */
-static ASTNode* parse_function(Parser* parser);
-static ASTNode* parse_statement(Parser* parser);
-static ASTNode* parse_expression(Parser* parser);
-static ASTNode* parse_assignment(Parser* parser);
-static ASTNode* parse_ternary(Parser* parser);
-static ASTNode* parse_logical_or(Parser* parser);
-static ASTNode* parse_logical_and(Parser* parser);
-static ASTNode* parse_bitwise_or(Parser* parser);
-static ASTNode* parse_bitwise_xor(Parser* parser);
-static ASTNode* parse_bitwise_and(Parser* parser);
-static ASTNode* parse_equality(Parser* parser);
-static ASTNode* parse_comparison(Parser* parser);
-static ASTNode* parse_shift(Parser* parser);
-static ASTNode* parse_term(Parser* parser);
-static ASTNode* parse_factor(Parser* parser);
-static ASTNode* parse_unary(Parser* parser);
-static ASTNode* parse_postfix(Parser* parser);
-static ASTNode* parse_primary(Parser* parser);
+static ASTRef parse_function(Parser* parser);
+static ASTRef parse_statement(Parser* parser);
+static ASTRef parse_expression(Parser* parser);
 
 /* Parser creation */
-Parser* parser_create(TokenList* tokens, const char* filename) {
+Parser* parser_create(TokenStream* tokens, const char* filename, Arena* arena, Interner* interner, AST* ast) {
     Parser* parser = (Parser*)safe_malloc(sizeof(Parser));
-    parser->tokens = tokens->tokens;
+    parser->tokens = tokens;
     parser->current = 0;
-    parser->count = tokens->count;
     parser->filename = filename;
+    parser->arena = arena;
+    parser->interner = interner;
+    parser->ast = ast;
+    parser->errors = NULL;
+    parser->error_count = 0;
+    parser->error_capacity = 0;
     parser->had_error = 0;
+    parser->scratch = NULL;
+    parser->scratch_count = 0;
+    parser->scratch_capacity = 0;
+    parser->frames = NULL;
+    parser->frame_count = 0;
+    parser->frame_capacity = 0;
+    parser->operands = NULL;
+    parser->operand_count = 0;
+    parser->operand_capacity = 0;
     return parser;
 }
 
 void parser_destroy(Parser* parser) {
+    if (!parser) return;
+    free(parser->scratch);
+    free(parser->frames);
+    free(parser->operands);
     free(parser);
 }
 
+/*
+ * Child lists. Each list being parsed notes the scratch stack height when it
+ * opens and pushes its children as they are parsed; nested lists push above
+ * it and are committed first. Closing a list appends its children to the
+ * tree's list table in one piece, so no list is ever grown in place.
+ */
+
+static int scratch_mark(const Parser* parser) {
+    return parser->scratch_count;
+}
+
+static void scratch_push(Parser* parser, uint32_t item) {
+    if (parser->scratch_count >= parser->scratch_capacity) {
+        parser->scratch_capacity = parser->scratch_capacity ? parser->scratch_capacity * 2 : 64;
+        parser->scratch = (uint32_t*)safe_realloc(parser->scratch,
+                                                  sizeof(uint32_t) * parser->scratch_capacity);
+    }
+    parser->scratch[parser->scratch_count++] = item;
+}
+
+/* Pop everything pushed since mark into the tree; AST_NONE for an empty list */
+static ASTList scratch_commit(Parser* parser, int mark) {
+    ASTList list = ast_add_list(parser->ast, parser->scratch + mark, parser->scratch_count - mark);
+    parser->scratch_count = mark;
+    return list;
+}
+
 /* Helper functions */
 
-static Token* peek(Parser* parser) {
-    if (parser->current >= parser->count) {
-        return parser->tokens[parser->count - 1];
+/* The window lookups inline the common case of an already-lexed token */
+static const Token* peek(Parser* parser) {
+    TokenStream* tokens = parser->tokens;
+    if (parser->current < tokens->produced) {
+        return &tokens->window[parser->current & (TOKEN_STREAM_WINDOW - 1)];
     }
-    return parser->tokens[parser->current];
+    return token_stream_at(tokens, parser->current);
 }
 
-static Token* previous(Parser* parser) {
-    return parser->tokens[parser->current - 1];
+static const Token* previous(Parser* parser) {
+    TokenStream* tokens = parser->tokens;
+    return &tokens->window[(parser->current - 1) & (TOKEN_STREAM_WINDOW - 1)];
+}
+
+/* Intern a token's lexeme so the AST can keep it as a shared handle */
+static const char* token_text(Parser* parser, const Token* token) {
+    return intern(parser->interner, token->start, (size_t)token->length);
 }
 
 static int is_at_end(Parser* parser) {
     return peek(parser)->type == TOKEN_EOF;
 }
 
-static Token* advance(Parser* parser) {
+static const Token* advance(Parser* parser) {
     if (!is_at_end(parser)) {
         parser->current++;
     }
@@ -72,29 +110,27 @@ static int match(Parser* parser, TokenType type) {
     return 0;
 }
 
-static int match_multiple(Parser* parser, int count, ...) {
-    va_list args;
-    va_start(args, count);
+/*
+ * Syntax errors are held until parsing ends: if the lexer fails later in the
+ * stream, only the lexical failure is reported, as when lexing came first.
+ */
+static void error_at(Parser* parser, const Token* token, const char* message) {
+    parser->had_error = 1;
 
-    for (int i = 0; i < count; i++) {
-        TokenType type = va_arg(args, TokenType);
-        if (check(parser, type)) {
-            advance(parser);
-            va_end(args);
-            return 1;
-        }
+    if (parser->error_count >= parser->error_capacity) {
+        int capacity = parser->error_capacity ? parser->error_capacity * 2 : 8;
+        parser->errors = (ParseError*)arena_realloc(parser->arena, parser->errors,
+                                                    sizeof(ParseError) * parser->error_capacity,
+                                                    sizeof(ParseError) * capacity);
+        parser->error_capacity = capacity;
     }
 
-    va_end(args);
-    return 0;
-}
-
-static void error_at(Parser* parser, Token* token, const char* message) {
-    parser->had_error = 1;
-    report_error(parser->filename, token->line, token->column, message);
+    ParseError* error = &parser->errors[parser->error_count++];
+    error->offset = token->offset;
+    error->message = message;
 }
 
-static Token* consume(Parser* parser, TokenType type, const char* message) {
+static const Token* consume(Parser* parser, TokenType type, const char* message) {
     if (check(parser, type)) {
         return advance(parser);
     }
@@ -113,33 +149,174 @@ static int is_type(TokenType type) {
            type == TOKEN_CONST;
 }
 
-/* Check if compound assignment operator */
-static int is_compound_assign(TokenType type) {
-    return type == TOKEN_PLUS_ASSIGN || type == TOKEN_MINUS_ASSIGN ||
-           type == TOKEN_STAR_ASSIGN || type == TOKEN_SLASH_ASSIGN ||
-           type == TOKEN_PERCENT_ASSIGN || type == TOKEN_AND_ASSIGN ||
-           type == TOKEN_OR_ASSIGN || type == TOKEN_XOR_ASSIGN ||
-           type == TOKEN_SHL_ASSIGN || type == TOKEN_SHR_ASSIGN;
+/*
+ * Expressions. One precedence-climbing loop replaces a function per level:
+ * operands wait on parser->operands, and parser->frames holds the operators
+ * still missing a right-hand side and the groups (parentheses, arguments,
+ * subscripts, sizeof, the middle of a ternary) still missing their closing
+ * token. Nesting is paid for on the heap rather than the C stack.
+ */
+
+/* Binding powers, loosest first; a prefix operator binds tighter than any infix one */
+enum {
+    POWER_NONE,
+    POWER_ASSIGN,
+    POWER_TERNARY,
+    POWER_LOGICAL_OR,
+    POWER_LOGICAL_AND,
+    POWER_BIT_OR,
+    POWER_BIT_XOR,
+    POWER_BIT_AND,
+    POWER_EQUALITY,
+    POWER_COMPARISON,
+    POWER_SHIFT,
+    POWER_ADDITIVE,
+    POWER_MULTIPLICATIVE,
+    POWER_PREFIX
+};
+
+/* How a token acts as an operator; power 0 means it is not one */
+typedef struct {
+    uint8_t kind;       /* ExprFrameKind pushed for it */
+    uint8_t power;
+    uint8_t op;         /* OperatorKind */
+} OperatorInfo;
+
+#define TOKEN_TYPE_COUNT (TOKEN_ERROR + 1)
+
+/* Operators after an operand; binary ones group left, the rest right */
+static const OperatorInfo infix_operators[TOKEN_TYPE_COUNT] = {
+    [TOKEN_ASSIGN]         = { FRAME_ASSIGN, POWER_ASSIGN, 0 },
+    [TOKEN_PLUS_ASSIGN]    = { FRAME_COMPOUND_ASSIGN, POWER_ASSIGN, OP_ADD_ASSIGN },
+    [TOKEN_MINUS_ASSIGN]   = { FRAME_COMPOUND_ASSIGN, POWER_ASSIGN, OP_SUBTRACT_ASSIGN },
+    [TOKEN_STAR_ASSIGN]    = { FRAME_COMPOUND_ASSIGN, POWER_ASSIGN, OP_MULTIPLY_ASSIGN },
+    [TOKEN_SLASH_ASSIGN]   = { FRAME_COMPOUND_ASSIGN, POWER_ASSIGN, OP_DIVIDE_ASSIGN },
+    [TOKEN_PERCENT_ASSIGN] = { FRAME_COMPOUND_ASSIGN, POWER_ASSIGN, OP_MODULO_ASSIGN },
+    [TOKEN_AND_ASSIGN]     = { FRAME_COMPOUND_ASSIGN, POWER_ASSIGN, OP_AND_ASSIGN },
+    [TOKEN_OR_ASSIGN]      = { FRAME_COMPOUND_ASSIGN, POWER_ASSIGN, OP_OR_ASSIGN },
+    [TOKEN_XOR_ASSIGN]     = { FRAME_COMPOUND_ASSIGN, POWER_ASSIGN, OP_XOR_ASSIGN },
+    [TOKEN_SHL_ASSIGN]     = { FRAME_COMPOUND_ASSIGN, POWER_ASSIGN, OP_SHIFT_LEFT_ASSIGN },
+    [TOKEN_SHR_ASSIGN]     = { FRAME_COMPOUND_ASSIGN, POWER_ASSIGN, OP_SHIFT_RIGHT_ASSIGN },
+    [TOKEN_QUESTION]       = { FRAME_TERNARY_THEN, POWER_TERNARY, 0 },
+    [TOKEN_OR]             = { FRAME_BINARY, POWER_LOGICAL_OR, OP_LOGICAL_OR },
+    [TOKEN_AND]            = { FRAME_BINARY, POWER_LOGICAL_AND, OP_LOGICAL_AND },
+    [TOKEN_PIPE]           = { FRAME_BINARY, POWER_BIT_OR, OP_BIT_OR },
+    [TOKEN_CARET]          = { FRAME_BINARY, POWER_BIT_XOR, OP_BIT_XOR },
+    [TOKEN_AMPERSAND]      = { FRAME_BINARY, POWER_BIT_AND, OP_BIT_AND },
+    [TOKEN_EQ]             = { FRAME_BINARY, POWER_EQUALITY, OP_EQUAL },
+    [TOKEN_NE]             = { FRAME_BINARY, POWER_EQUALITY, OP_NOT_EQUAL },
+    [TOKEN_GT]             = { FRAME_BINARY, POWER_COMPARISON, OP_GREATER },
+    [TOKEN_GE]             = { FRAME_BINARY, POWER_COMPARISON, OP_GREATER_EQUAL },
+    [TOKEN_LT]             = { FRAME_BINARY, POWER_COMPARISON, OP_LESS },
+    [TOKEN_LE]             = { FRAME_BINARY, POWER_COMPARISON, OP_LESS_EQUAL },
+    [TOKEN_SHL]            = { FRAME_BINARY, POWER_SHIFT, OP_SHIFT_LEFT },
+    [TOKEN_SHR]            = { FRAME_BINARY, POWER_SHIFT, OP_SHIFT_RIGHT },
+    [TOKEN_PLUS]           = { FRAME_BINARY, POWER_ADDITIVE, OP_ADD },
+    [TOKEN_MINUS]          = { FRAME_BINARY, POWER_ADDITIVE, OP_SUBTRACT },
+    [TOKEN_STAR]           = { FRAME_BINARY, POWER_MULTIPLICATIVE, OP_MULTIPLY },
+    [TOKEN_SLASH]          = { FRAME_BINARY, POWER_MULTIPLICATIVE, OP_DIVIDE },
+    [TOKEN_PERCENT]        = { FRAME_BINARY, POWER_MULTIPLICATIVE, OP_MODULO }
+};
+
+/* Operators before an operand */
+static const OperatorInfo prefix_operators[TOKEN_TYPE_COUNT] = {
+    [TOKEN_NOT]       = { FRAME_PREFIX, POWER_PREFIX, OP_NOT },
+    [TOKEN_MINUS]     = { FRAME_PREFIX, POWER_PREFIX, OP_NEGATE },
+    [TOKEN_PLUS]      = { FRAME_PREFIX, POWER_PREFIX, OP_UNARY_PLUS },
+    [TOKEN_INCREMENT] = { FRAME_PREFIX, POWER_PREFIX, OP_PRE_INCREMENT },
+    [TOKEN_DECREMENT] = { FRAME_PREFIX, POWER_PREFIX, OP_PRE_DECREMENT },
+    [TOKEN_AMPERSAND] = { FRAME_PREFIX, POWER_PREFIX, OP_ADDRESS_OF },
+    [TOKEN_TILDE]     = { FRAME_PREFIX, POWER_PREFIX, OP_BIT_NOT },
+    [TOKEN_STAR]      = { FRAME_PREFIX, POWER_PREFIX, OP_DEREFERENCE }
+};
+
+static ExprFrame* push_frame(Parser* parser, ExprFrameKind kind, int power, int op) {
+    if (parser->frame_count >= parser->frame_capacity) {
+        parser->frame_capacity = parser->frame_capacity ? parser->frame_capacity * 2 : 32;
+        parser->frames = (ExprFrame*)safe_realloc(parser->frames,
+                                                  sizeof(ExprFrame) * parser->frame_capacity);
+    }
+    ExprFrame* frame = &parser->frames[parser->frame_count++];
+    frame->kind = (uint8_t)kind;
+    frame->power = (uint8_t)power;
+    frame->op = (uint8_t)op;
+    frame->mark = 0;
+    frame->name = NULL;
+    return frame;
+}
+
+static void push_operand(Parser* parser, ASTRef operand) {
+    if (parser->operand_count >= parser->operand_capacity) {
+        parser->operand_capacity = parser->operand_capacity ? parser->operand_capacity * 2 : 32;
+        parser->operands = (ASTRef*)safe_realloc(parser->operands,
+                                                 sizeof(ASTRef) * parser->operand_capacity);
+    }
+    parser->operands[parser->operand_count++] = operand;
+}
+
+static ASTRef pop_operand(Parser* parser) {
+    return parser->operands[--parser->operand_count];
+}
+
+/*
+ * Apply every pending operator of at least the given power, innermost
+ * first. Groups have power 0, so this never reaches past the innermost one.
+ */
+static void reduce(Parser* parser, int power) {
+    AST* ast = parser->ast;
+
+    while (parser->frames[parser->frame_count - 1].power >= power) {
+        const ExprFrame* frame = &parser->frames[--parser->frame_count];
+        ASTRef right = pop_operand(parser);
+        ASTRef left;
+        ASTRef condition;
+
+        switch (frame->kind) {
+            case FRAME_PREFIX:
+                push_operand(parser, ast_create_unary_op(ast, (OperatorKind)frame->op, right));
+                break;
+            case FRAME_BINARY:
+                left = pop_operand(parser);
+                push_operand(parser, ast_create_binary_op(ast, (OperatorKind)frame->op, left, right));
+                break;
+            case FRAME_ASSIGN:
+                left = pop_operand(parser);
+                push_operand(parser, ast_create_assignment(ast, left, right));
+                break;
+            case FRAME_COMPOUND_ASSIGN:
+                left = pop_operand(parser);
+                push_operand(parser, ast_create_compound_assign(ast, (OperatorKind)frame->op, left, right));
+                break;
+            default:
+                /* FRAME_TERNARY_ELSE: right is the else branch */
+                left = pop_operand(parser);
+                condition = pop_operand(parser);
+                push_operand(parser, ast_create_ternary(ast, condition, left, right));
+                break;
+        }
+    }
 }
 
-/* Parse primary expressions */
-static ASTNode* parse_primary(Parser* parser) {
+/* Push a primary operand and return 1, or open the group it starts and return 0 */
+static int parse_primary(Parser* parser) {
+    AST* ast = parser->ast;
+
     /* Number literal */
     if (match(parser, TOKEN_NUMBER)) {
-        Token* token = previous(parser);
-        return ast_create_literal(token->lexeme, "number");
+        push_operand(parser, ast_create_literal(ast, token_text(parser, previous(parser)), "number"));
+        return 1;
     }
 
     /* String literal */
     if (match(parser, TOKEN_STRING)) {
-        Token* token = previous(parser);
-        return ast_create_literal(token->lexeme, "string");
+        push_operand(parser, ast_create_literal(ast, token_text(parser, previous(parser)), "string"));
+        return 1;
     }
 
     /* Character literal */
     if (match(parser, TOKEN_CHAR_LITERAL)) {
-        Token* token = previous(parser);
-        return ast_create_literal(token->lexeme, "char");
+        push_operand(parser, ast_create_literal(ast, token_text(parser, previous(parser)), "char"));
+        return 1;
     }
 
     /* sizeof expression */
@@ -148,9 +325,9 @@ static ASTNode* parse_primary(Parser* parser) {
 
         /* Check if it's a type or expression */
         if (is_type(peek(parser)->type)) {
-            Token* type_token = advance(parser);
+            const Token* type_token = advance(parser);
             char type_str[128];
-            strcpy(type_str, type_token->lexeme);
+            snprintf(type_str, sizeof(type_str), "%.*s", type_token->length, type_token->start);
 
             /* Handle pointer types */
             while (match(parser, TOKEN_STAR)) {
@@ -158,350 +335,268 @@ static ASTNode* parse_primary(Parser* parser) {
             }
 
             consume(parser, TOKEN_RPAREN, "Expected ')' after type");
-            return ast_create_sizeof_type(type_str);
-        } else {
-            ASTNode* expr = parse_expression(parser);
-            consume(parser, TOKEN_RPAREN, "Expected ')' after expression");
-            return ast_create_sizeof_expr(expr);
+            push_operand(parser, ast_create_sizeof_type(ast, intern_cstr(parser->interner, type_str)));
+            return 1;
         }
+
+        push_frame(parser, FRAME_SIZEOF, POWER_NONE, 0);
+        return 0;
     }
 
-    /* Identifier or function call */
+    /* Identifier, function call or array access */
     if (match(parser, TOKEN_IDENTIFIER)) {
-        Token* name_token = previous(parser);
-        char* name = string_duplicate(name_token->lexeme);
+        const char* name = token_text(parser, previous(parser));
 
-        /* Function call */
         if (match(parser, TOKEN_LPAREN)) {
-            ASTNode** args = NULL;
-            int arg_count = 0;
-
+            int mark = scratch_mark(parser);
             if (!check(parser, TOKEN_RPAREN)) {
-                int capacity = 4;
-                args = (ASTNode**)safe_malloc(sizeof(ASTNode*) * capacity);
-
-                do {
-                    if (arg_count >= capacity) {
-                        capacity *= 2;
-                        args = (ASTNode**)safe_realloc(args, sizeof(ASTNode*) * capacity);
-                    }
-                    args[arg_count++] = parse_expression(parser);
-                } while (match(parser, TOKEN_COMMA));
+                ExprFrame* call = push_frame(parser, FRAME_CALL, POWER_NONE, 0);
+                call->mark = mark;
+                call->name = name;
+                return 0;
             }
 
             consume(parser, TOKEN_RPAREN, "Expected ')' after arguments");
-            return ast_create_function_call(name, args, arg_count);
+            push_operand(parser, ast_create_function_call(ast, name, AST_NONE));
+            return 1;
         }
 
-        /* Array access */
         if (match(parser, TOKEN_LBRACKET)) {
-            ASTNode* index = parse_expression(parser);
-            consume(parser, TOKEN_RBRACKET, "Expected ']' after array index");
-            return ast_create_array_access(name, index);
+            push_frame(parser, FRAME_NAME_INDEX, POWER_NONE, 0)->name = name;
+            return 0;
         }
 
-        /* Simple identifier */
-        return ast_create_identifier(name);
+        push_operand(parser, ast_create_identifier(ast, name));
+        return 1;
     }
 
     /* Parenthesized expression */
     if (match(parser, TOKEN_LPAREN)) {
-        ASTNode* expr = parse_expression(parser);
-        consume(parser, TOKEN_RPAREN, "Expected ')' after expression");
-        return expr;
+        push_frame(parser, FRAME_PAREN, POWER_NONE, 0);
+        return 0;
     }
 
     error_at(parser, peek(parser), "Expected expression");
-    return NULL;
+    push_operand(parser, AST_NONE);
+    return 1;
 }
 
-/* Parse postfix expressions (member access, array access, function calls) */
-static ASTNode* parse_postfix(Parser* parser) {
-    ASTNode* expr = parse_primary(parser);
+/* Apply postfix operators to the top operand; 0 if a subscript opened a group */
+static int parse_postfix(Parser* parser) {
+    AST* ast = parser->ast;
+    ASTRef* expr = &parser->operands[parser->operand_count - 1];
 
     while (1) {
         if (match(parser, TOKEN_DOT)) {
-            Token* member = consume(parser, TOKEN_IDENTIFIER, "Expected member name after '.'");
+            const Token* member = consume(parser, TOKEN_IDENTIFIER, "Expected member name after '.'");
             if (member) {
-                expr = ast_create_member_access(expr, member->lexeme, 0);
+                *expr = ast_create_member_access(ast, *expr, token_text(parser, member), 0);
             }
         } else if (match(parser, TOKEN_ARROW)) {
-            Token* member = consume(parser, TOKEN_IDENTIFIER, "Expected member name after '->'");
+            const Token* member = consume(parser, TOKEN_IDENTIFIER, "Expected member name after '->'");
             if (member) {
-                expr = ast_create_member_access(expr, member->lexeme, 1);
+                *expr = ast_create_member_access(ast, *expr, token_text(parser, member), 1);
             }
         } else if (match(parser, TOKEN_LBRACKET)) {
-            ASTNode* index = parse_expression(parser);
-            consume(parser, TOKEN_RBRACKET, "Expected ']' after index");
-            /* Convert to array access - need identifier name */
-            if (expr->type == NODE_IDENTIFIER) {
-                char* name = string_duplicate(expr->data.identifier.name);
-                ast_destroy(expr);
-                expr = ast_create_array_access(name, index);
-            } else {
-                /* For complex expressions like a[i][j] */
-                expr = ast_create_binary_op("[]", expr, index);
-            }
+            push_frame(parser, FRAME_INDEX, POWER_NONE, 0);
+            return 0;
         } else if (match(parser, TOKEN_INCREMENT)) {
-            expr = ast_create_unary_op("++post", expr);
+            *expr = ast_create_unary_op(ast, OP_POST_INCREMENT, *expr);
         } else if (match(parser, TOKEN_DECREMENT)) {
-            expr = ast_create_unary_op("--post", expr);
+            *expr = ast_create_unary_op(ast, OP_POST_DECREMENT, *expr);
         } else {
-            break;
+            return 1;
         }
     }
-
-    return expr;
 }
 
-/* Parse unary expressions */
-static ASTNode* parse_unary(Parser* parser) {
-    if (match_multiple(parser, 7, TOKEN_NOT, TOKEN_MINUS, TOKEN_PLUS,
-                      TOKEN_INCREMENT, TOKEN_DECREMENT, TOKEN_AMPERSAND, TOKEN_TILDE)) {
-        Token* op = previous(parser);
-        ASTNode* operand = parse_unary(parser);
-        return ast_create_unary_op(op->lexeme, operand);
-    }
-
-    /* Dereference operator */
-    if (match(parser, TOKEN_STAR)) {
-        ASTNode* operand = parse_unary(parser);
-        return ast_create_unary_op("*", operand);
-    }
-
-    return parse_postfix(parser);
-}
-
-/* Parse multiplicative expressions */
-static ASTNode* parse_factor(Parser* parser) {
-    ASTNode* left = parse_unary(parser);
-
-    while (match_multiple(parser, 3, TOKEN_STAR, TOKEN_SLASH, TOKEN_PERCENT)) {
-        Token* op = previous(parser);
-        ASTNode* right = parse_unary(parser);
-        left = ast_create_binary_op(op->lexeme, left, right);
-    }
-
-    return left;
-}
-
-/* Parse additive expressions */
-static ASTNode* parse_term(Parser* parser) {
-    ASTNode* left = parse_factor(parser);
-
-    while (match_multiple(parser, 2, TOKEN_PLUS, TOKEN_MINUS)) {
-        Token* op = previous(parser);
-        ASTNode* right = parse_factor(parser);
-        left = ast_create_binary_op(op->lexeme, left, right);
-    }
-
-    return left;
-}
-
-/* Parse shift expressions */
-static ASTNode* parse_shift(Parser* parser) {
-    ASTNode* left = parse_term(parser);
-
-    while (match_multiple(parser, 2, TOKEN_SHL, TOKEN_SHR)) {
-        Token* op = previous(parser);
-        ASTNode* right = parse_term(parser);
-        left = ast_create_binary_op(op->lexeme, left, right);
-    }
-
-    return left;
-}
-
-/* Parse comparison expressions */
-static ASTNode* parse_comparison(Parser* parser) {
-    ASTNode* left = parse_shift(parser);
-
-    while (match_multiple(parser, 4, TOKEN_GT, TOKEN_GE, TOKEN_LT, TOKEN_LE)) {
-        Token* op = previous(parser);
-        ASTNode* right = parse_shift(parser);
-        left = ast_create_binary_op(op->lexeme, left, right);
-    }
-
-    return left;
-}
-
-/* Parse equality expressions */
-static ASTNode* parse_equality(Parser* parser) {
-    ASTNode* left = parse_comparison(parser);
-
-    while (match_multiple(parser, 2, TOKEN_EQ, TOKEN_NE)) {
-        Token* op = previous(parser);
-        ASTNode* right = parse_comparison(parser);
-        left = ast_create_binary_op(op->lexeme, left, right);
-    }
-
-    return left;
-}
-
-/* Parse bitwise AND expressions */
-static ASTNode* parse_bitwise_and(Parser* parser) {
-    ASTNode* left = parse_equality(parser);
-
-    while (match(parser, TOKEN_AMPERSAND)) {
-        Token* op = previous(parser);
-        ASTNode* right = parse_equality(parser);
-        left = ast_create_binary_op(op->lexeme, left, right);
-    }
-
-    return left;
-}
+/*
+ * The innermost group's expression is complete and on top of the operands.
+ * Close the group; returns 1 if another operand is expected next (a further
+ * argument or a ternary's else branch) and 0 if the group left an operand.
+ */
+static int close_group(Parser* parser) {
+    AST* ast = parser->ast;
+    ExprFrame* group = &parser->frames[parser->frame_count - 1];
+    ASTRef inner = pop_operand(parser);
 
-/* Parse bitwise XOR expressions */
-static ASTNode* parse_bitwise_xor(Parser* parser) {
-    ASTNode* left = parse_bitwise_and(parser);
-
-    while (match(parser, TOKEN_CARET)) {
-        Token* op = previous(parser);
-        ASTNode* right = parse_bitwise_and(parser);
-        left = ast_create_binary_op(op->lexeme, left, right);
-    }
-
-    return left;
-}
+    switch (group->kind) {
+        case FRAME_PAREN:
+            consume(parser, TOKEN_RPAREN, "Expected ')' after expression");
+            push_operand(parser, inner);
+            break;
 
-/* Parse bitwise OR expressions */
-static ASTNode* parse_bitwise_or(Parser* parser) {
-    ASTNode* left = parse_bitwise_xor(parser);
+        case FRAME_CALL:
+            scratch_push(parser, inner);
+            if (match(parser, TOKEN_COMMA)) return 1;
+            {
+                ASTList args = scratch_commit(parser, group->mark);
+                consume(parser, TOKEN_RPAREN, "Expected ')' after arguments");
+                push_operand(parser, ast_create_function_call(ast, group->name, args));
+            }
+            break;
 
-    while (match(parser, TOKEN_PIPE)) {
-        Token* op = previous(parser);
-        ASTNode* right = parse_bitwise_xor(parser);
-        left = ast_create_binary_op(op->lexeme, left, right);
-    }
+        case FRAME_NAME_INDEX:
+            consume(parser, TOKEN_RBRACKET, "Expected ']' after array index");
+            push_operand(parser, ast_create_array_access(ast, group->name, inner));
+            break;
 
-    return left;
-}
+        case FRAME_INDEX: {
+            ASTRef base = pop_operand(parser);
+            const ASTNode* base_node = AST_NODE(ast, base);
+            consume(parser, TOKEN_RBRACKET, "Expected ']' after index");
+            /* Convert to array access - need identifier name */
+            if (base_node->type == NODE_IDENTIFIER) {
+                push_operand(parser, ast_create_array_access(ast, AST_TEXT(ast, base_node->data.identifier.name), inner));
+            } else {
+                /* For complex expressions like a[i][j] */
+                push_operand(parser, ast_create_binary_op(ast, OP_INDEX, base, inner));
+            }
+            break;
+        }
 
-/* Parse logical AND expressions */
-static ASTNode* parse_logical_and(Parser* parser) {
-    ASTNode* left = parse_bitwise_or(parser);
+        case FRAME_SIZEOF:
+            consume(parser, TOKEN_RPAREN, "Expected ')' after expression");
+            push_operand(parser, ast_create_sizeof_expr(ast, inner));
+            break;
 
-    while (match(parser, TOKEN_AND)) {
-        Token* op = previous(parser);
-        ASTNode* right = parse_bitwise_or(parser);
-        left = ast_create_binary_op(op->lexeme, left, right);
+        default:
+            /* FRAME_TERNARY_THEN: the condition stays below, the else branch follows */
+            consume(parser, TOKEN_COLON, "Expected ':' in ternary expression");
+            push_operand(parser, inner);
+            group->kind = FRAME_TERNARY_ELSE;
+            group->power = POWER_TERNARY;
+            return 1;
     }
 
-    return left;
+    parser->frame_count--;
+    return 0;
 }
 
-/* Parse logical OR expressions */
-static ASTNode* parse_logical_or(Parser* parser) {
-    ASTNode* left = parse_logical_and(parser);
+/* Parse expressions */
+static ASTRef parse_expression(Parser* parser) {
+    push_frame(parser, FRAME_ROOT, POWER_NONE, 0);
+    int want_operand = 1;
 
-    while (match(parser, TOKEN_OR)) {
-        Token* op = previous(parser);
-        ASTNode* right = parse_logical_and(parser);
-        left = ast_create_binary_op(op->lexeme, left, right);
-    }
+    while (1) {
+        if (want_operand) {
+            const OperatorInfo* prefix;
+            while ((prefix = &prefix_operators[peek(parser)->type])->power != POWER_NONE) {
+                advance(parser);
+                push_frame(parser, FRAME_PREFIX, POWER_PREFIX, prefix->op);
+            }
+            if (!parse_primary(parser)) continue;
+            want_operand = 0;
+        }
 
-    return left;
-}
+        if (!parse_postfix(parser)) {
+            want_operand = 1;
+            continue;
+        }
 
-/* Parse ternary conditional expressions */
-static ASTNode* parse_ternary(Parser* parser) {
-    ASTNode* condition = parse_logical_or(parser);
+        const OperatorInfo* infix = &infix_operators[peek(parser)->type];
+        if (infix->power != POWER_NONE) {
+            advance(parser);
+            /* Binary operators group left; assignments and ternaries nest to the right */
+            reduce(parser, infix->kind == FRAME_BINARY ? infix->power : infix->power + 1);
+            if (infix->kind == FRAME_TERNARY_THEN) {
+                push_frame(parser, FRAME_TERNARY_THEN, POWER_NONE, 0);
+            } else {
+                push_frame(parser, (ExprFrameKind)infix->kind, infix->power, infix->op);
+            }
+            want_operand = 1;
+            continue;
+        }
 
-    if (match(parser, TOKEN_QUESTION)) {
-        ASTNode* then_expr = parse_expression(parser);
-        consume(parser, TOKEN_COLON, "Expected ':' in ternary expression");
-        ASTNode* else_expr = parse_ternary(parser);
-        return ast_create_ternary(condition, then_expr, else_expr);
+        /* Nothing continues the operand, so the innermost group is complete */
+        reduce(parser, POWER_ASSIGN);
+        if (parser->frames[parser->frame_count - 1].kind == FRAME_ROOT) {
+            parser->frame_count--;
+            return pop_operand(parser);
+        }
+        want_operand = close_group(parser);
     }
-
-    return condition;
 }
 
-/* Parse assignment expressions */
-static ASTNode* parse_assignment(Parser* parser) {
-    ASTNode* expr = parse_ternary(parser);
-
-    if (match(parser, TOKEN_ASSIGN)) {
-        ASTNode* value = parse_assignment(parser);
-        return ast_create_assignment(expr, value);
-    }
-
-    /* Check for compound assignment */
-    if (is_compound_assign(peek(parser)->type)) {
-        Token* op = advance(parser);
-        ASTNode* value = parse_assignment(parser);
-        return ast_create_compound_assign(op->lexeme, expr, value);
+/*
+ * Parse one statement of a list. A statement that took no tokens has
+ * recorded its error, so the token it stopped at is stepped over and the
+ * list keeps moving.
+ */
+static ASTRef parse_list_statement(Parser* parser) {
+    int start = parser->current;
+    ASTRef stmt = parse_statement(parser);
+    if (parser->current == start) {
+        advance(parser);
     }
-
-    return expr;
-}
-
-/* Parse expressions */
-static ASTNode* parse_expression(Parser* parser) {
-    return parse_assignment(parser);
+    return stmt;
 }
 
 /* Parse block statements */
-static ASTNode* parse_block(Parser* parser) {
-    ASTNode* block = ast_create_block();
+static ASTRef parse_block(Parser* parser) {
+    ASTRef block = ast_create_block(parser->ast);
+    int mark = scratch_mark(parser);
 
     while (!check(parser, TOKEN_RBRACE) && !is_at_end(parser)) {
-        ASTNode* stmt = parse_statement(parser);
+        ASTRef stmt = parse_list_statement(parser);
         if (stmt) {
-            ast_add_statement(block, stmt);
+            scratch_push(parser, stmt);
         }
     }
 
+    ASTList statements = scratch_commit(parser, mark);
+    AST_NODE(parser->ast, block)->data.block.statements = statements;
     consume(parser, TOKEN_RBRACE, "Expected '}' after block");
     return block;
 }
 
 /* Parse statements */
-static ASTNode* parse_statement(Parser* parser) {
+static ASTRef parse_statement(Parser* parser) {
     /* Variable declaration */
     if (is_type(peek(parser)->type)) {
-        Token* type_token = advance(parser);
-        Token* name_token = consume(parser, TOKEN_IDENTIFIER, "Expected variable name");
+        const Token* type_token = advance(parser);
+        const Token* name_token = consume(parser, TOKEN_IDENTIFIER, "Expected variable name");
 
-        if (!name_token) return NULL;
+        if (!name_token) return AST_NONE;
 
-        char* type = string_duplicate(type_token->lexeme);
-        char* name = string_duplicate(name_token->lexeme);
+        const char* type = token_text(parser, type_token);
+        const char* name = token_text(parser, name_token);
 
         /* Array declaration */
         if (match(parser, TOKEN_LBRACKET)) {
-            ASTNode* size = NULL;
+            ASTRef size = AST_NONE;
             if (!check(parser, TOKEN_RBRACKET)) {
                 size = parse_expression(parser);
             }
             consume(parser, TOKEN_RBRACKET, "Expected ']' after array size");
             consume(parser, TOKEN_SEMICOLON, "Expected ';' after declaration");
-            return ast_create_array_declaration(type, name, size);
+            return ast_create_array_declaration(parser->ast, type, name, size);
         }
 
         /* Variable with initializer */
-        ASTNode* initializer = NULL;
+        ASTRef initializer = AST_NONE;
         if (match(parser, TOKEN_ASSIGN)) {
             initializer = parse_expression(parser);
         }
 
         consume(parser, TOKEN_SEMICOLON, "Expected ';' after declaration");
-        return ast_create_declaration(type, name, initializer);
+        return ast_create_declaration(parser->ast, type, name, initializer);
     }
 
     /* If statement */
     if (match(parser, TOKEN_IF)) {
         consume(parser, TOKEN_LPAREN, "Expected '(' after 'if'");
-        ASTNode* condition = parse_expression(parser);
+        ASTRef condition = parse_expression(parser);
         consume(parser, TOKEN_RPAREN, "Expected ')' after condition");
 
-        ASTNode* then_branch;
+        ASTRef then_branch;
         if (match(parser, TOKEN_LBRACE)) {
             then_branch = parse_block(parser);
         } else {
             then_branch = parse_statement(parser);
         }
 
-        ASTNode* else_branch = NULL;
+        ASTRef else_branch = AST_NONE;
         if (match(parser, TOKEN_ELSE)) {
             if (match(parser, TOKEN_LBRACE)) {
                 else_branch = parse_block(parser);
@@ -510,30 +605,30 @@ static ASTNode* parse_statement(Parser* parser) {
             }
         }
 
-        return ast_create_if(condition, then_branch, else_branch);
+        return ast_create_if(parser->ast, condition, then_branch, else_branch);
     }
 
     /* While statement */
     if (match(parser, TOKEN_WHILE)) {
         consume(parser, TOKEN_LPAREN, "Expected '(' after 'while'");
-        ASTNode* condition = parse_expression(parser);
+        ASTRef condition = parse_expression(parser);
         consume(parser, TOKEN_RPAREN, "Expected ')' after condition");
 
-        ASTNode* body;
+        ASTRef body;
         if (match(parser, TOKEN_LBRACE)) {
             body = parse_block(parser);
         } else {
             body = parse_statement(parser);
         }
 
-        return ast_create_while(condition, body);
+        return ast_create_while(parser->ast, condition, body);
     }
 
     /* For statement */
     if (match(parser, TOKEN_FOR)) {
         consume(parser, TOKEN_LPAREN, "Expected '(' after 'for'");
 
-        ASTNode* init = NULL;
+        ASTRef init = AST_NONE;
         if (!check(parser, TOKEN_SEMICOLON)) {
             if (is_type(peek(parser)->type)) {
                 init = parse_statement(parser);
@@ -545,53 +640,53 @@ static ASTNode* parse_statement(Parser* parser) {
             advance(parser);
         }
 
-        ASTNode* condition = NULL;
+        ASTRef condition = AST_NONE;
         if (!check(parser, TOKEN_SEMICOLON)) {
             condition = parse_expression(parser);
         }
         consume(parser, TOKEN_SEMICOLON, "Expected ';' after loop condition");
 
-        ASTNode* increment = NULL;
+        ASTRef increment = AST_NONE;
         if (!check(parser, TOKEN_RPAREN)) {
             increment = parse_expression(parser);
         }
         consume(parser, TOKEN_RPAREN, "Expected ')' after for clauses");
 
-        ASTNode* body;
+        ASTRef body;
         if (match(parser, TOKEN_LBRACE)) {
             body = parse_block(parser);
         } else {
             body = parse_statement(parser);
         }
 
-        return ast_create_for(init, condition, increment, body);
+        return ast_create_for(parser->ast, init, condition, increment, body);
     }
 
     /* Return statement */
     if (match(parser, TOKEN_RETURN)) {
-        ASTNode* value = NULL;
+        ASTRef value = AST_NONE;
         if (!check(parser, TOKEN_SEMICOLON)) {
             value = parse_expression(parser);
         }
         consume(parser, TOKEN_SEMICOLON, "Expected ';' after return");
-        return ast_create_return(value);
+        return ast_create_return(parser->ast, value);
     }
 
     /* Break statement */
     if (match(parser, TOKEN_BREAK)) {
         consume(parser, TOKEN_SEMICOLON, "Expected ';' after break");
-        return ast_create_break();
+        return ast_create_break(parser->ast);
     }
 
     /* Continue statement */
     if (match(parser, TOKEN_CONTINUE)) {
         consume(parser, TOKEN_SEMICOLON, "Expected ';' after continue");
-        return ast_create_continue();
+        return ast_create_continue(parser->ast);
     }
 
     /* Do-while statement */
     if (match(parser, TOKEN_DO)) {
-        ASTNode* body;
+        ASTRef body;
         if (match(parser, TOKEN_LBRACE)) {
             body = parse_block(parser);
         } else {
@@ -600,43 +695,62 @@ static ASTNode* parse_statement(Parser* parser) {
 
         consume(parser, TOKEN_WHILE, "Expected 'while' after do block");
         consume(parser, TOKEN_LPAREN, "Expected '(' after 'while'");
-        ASTNode* condition = parse_expression(parser);
+        ASTRef condition = parse_expression(parser);
         consume(parser, TOKEN_RPAREN, "Expected ')' after condition");
         consume(parser, TOKEN_SEMICOLON, "Expected ';' after do-while");
 
-        return ast_create_do_while(body, condition);
+        return ast_create_do_while(parser->ast, body, condition);
     }
 
     /* Switch statement */
     if (match(parser, TOKEN_SWITCH)) {
         consume(parser, TOKEN_LPAREN, "Expected '(' after 'switch'");
-        ASTNode* expression = parse_expression(parser);
+        ASTRef expression = parse_expression(parser);
         consume(parser, TOKEN_RPAREN, "Expected ')' after switch expression");
         consume(parser, TOKEN_LBRACE, "Expected '{' before switch body");
 
-        ASTNode* switch_stmt = ast_create_switch(expression);
-        ASTNode* current_case = NULL;
+        ASTRef switch_stmt = ast_create_switch(parser->ast, expression);
+        ASTRef current_case = AST_NONE;
+        int case_mark = scratch_mark(parser);
+        int statement_mark = case_mark;
 
         while (!check(parser, TOKEN_RBRACE) && !is_at_end(parser)) {
+            int is_case = check(parser, TOKEN_CASE) || check(parser, TOKEN_DEFAULT);
+            if (is_case && current_case) {
+                /* The previous case's statements sit above it on the stack */
+                ASTList statements = scratch_commit(parser, statement_mark);
+                AST_NODE(parser->ast, current_case)->data.case_stmt.statements = statements;
+            }
+
             if (match(parser, TOKEN_CASE)) {
-                ASTNode* value = parse_expression(parser);
+                ASTRef value = parse_expression(parser);
                 consume(parser, TOKEN_COLON, "Expected ':' after case value");
-                current_case = ast_create_case(value);
-                ast_add_case(switch_stmt, current_case);
+                current_case = ast_create_case(parser->ast, value);
             } else if (match(parser, TOKEN_DEFAULT)) {
                 consume(parser, TOKEN_COLON, "Expected ':' after 'default'");
-                current_case = ast_create_default();
-                ast_add_case(switch_stmt, current_case);
+                current_case = ast_create_default(parser->ast);
             } else if (current_case) {
-                ASTNode* stmt = parse_statement(parser);
+                ASTRef stmt = parse_list_statement(parser);
                 if (stmt) {
-                    ast_add_case_statement(current_case, stmt);
+                    scratch_push(parser, stmt);
                 }
+                continue;
             } else {
                 error_at(parser, peek(parser), "Statement outside of case in switch");
                 advance(parser);
+                continue;
             }
+
+            scratch_push(parser, current_case);
+            statement_mark = scratch_mark(parser);
+        }
+
+        if (current_case) {
+            ASTList statements = scratch_commit(parser, statement_mark);
+            AST_NODE(parser->ast, current_case)->data.case_stmt.statements = statements;
         }
+        ASTList cases = scratch_commit(parser, case_mark);
+        AST_NODE(parser->ast, switch_stmt)->data.switch_stmt.cases = cases;
 
         consume(parser, TOKEN_RBRACE, "Expected '}' after switch body");
         return switch_stmt;
@@ -644,12 +758,12 @@ static ASTNode* parse_statement(Parser* parser) {
 
     /* Goto statement */
     if (match(parser, TOKEN_GOTO)) {
-        Token* label = consume(parser, TOKEN_IDENTIFIER, "Expected label name after 'goto'");
+        const Token* label = consume(parser, TOKEN_IDENTIFIER, "Expected label name after 'goto'");
         consume(parser, TOKEN_SEMICOLON, "Expected ';' after goto");
         if (label) {
-            return ast_create_goto(label->lexeme);
+            return ast_create_goto(parser->ast, token_text(parser, label));
         }
-        return NULL;
+        return AST_NONE;
     }
 
     /* Label statement - identifier followed by colon */
@@ -659,10 +773,10 @@ static ASTNode* parse_statement(Parser* parser) {
         advance(parser);
         if (check(parser, TOKEN_COLON)) {
             parser->current = saved;
-            Token* label = advance(parser);
+            const char* label = token_text(parser, advance(parser));
             advance(parser); /* consume colon */
-            ASTNode* stmt = parse_statement(parser);
-            return ast_create_label(label->lexeme, stmt);
+            ASTRef stmt = parse_statement(parser);
+            return ast_create_label(parser->ast, label, stmt);
         }
         parser->current = saved;
     }
@@ -673,46 +787,43 @@ static ASTNode* parse_statement(Parser* parser) {
     }
 
     /* Expression statement */
-    ASTNode* expr = parse_expression(parser);
+    ASTRef expr = parse_expression(parser);
     consume(parser, TOKEN_SEMICOLON, "Expected ';' after expression");
     return expr;
 }
 
 /* Parse function */
-static ASTNode* parse_function(Parser* parser) {
+static ASTRef parse_function(Parser* parser) {
     /* Return type */
     if (!is_type(peek(parser)->type)) {
         error_at(parser, peek(parser), "Expected return type");
-        return NULL;
+        return AST_NONE;
     }
-    Token* return_type_token = advance(parser);
-    char* return_type = string_duplicate(return_type_token->lexeme);
+    const Token* return_type_token = advance(parser);
+    const char* return_type = token_text(parser, return_type_token);
 
     /* Function name */
-    Token* name_token = consume(parser, TOKEN_IDENTIFIER, "Expected function name");
-    if (!name_token) return NULL;
-    char* name = string_duplicate(name_token->lexeme);
+    const Token* name_token = consume(parser, TOKEN_IDENTIFIER, "Expected function name");
+    if (!name_token) return AST_NONE;
+    const char* name = token_text(parser, name_token);
 
     /* Parameters */
     consume(parser, TOKEN_LPAREN, "Expected '(' after function name");
 
-    Parameter** params = NULL;
-    int param_count = 0;
-    int param_capacity = 4;
+    int mark = scratch_mark(parser);
 
     if (!check(parser, TOKEN_RPAREN)) {
-        params = (Parameter**)safe_malloc(sizeof(Parameter*) * param_capacity);
-
         do {
             if (!is_type(peek(parser)->type)) {
                 error_at(parser, peek(parser), "Expected parameter type");
                 break;
             }
 
-            Token* param_type_token = advance(parser);
-            Token* param_name_token = consume(parser, TOKEN_IDENTIFIER, "Expected parameter name");
+            const char* param_type = token_text(parser, advance(parser));
+            const Token* param_name_token = consume(parser, TOKEN_IDENTIFIER, "Expected parameter name");
 
             if (!param_name_token) break;
+            const char* param_name = token_text(parser, param_name_token);
 
             int is_array = 0;
             if (match(parser, TOKEN_LBRACKET)) {
@@ -720,53 +831,114 @@ static ASTNode* parse_function(Parser* parser) {
                 consume(parser, TOKEN_RBRACKET, "Expected ']' after '['");
             }
 
-            if (param_count >= param_capacity) {
-                param_capacity *= 2;
-                params = (Parameter**)safe_realloc(params, sizeof(Parameter*) * param_capacity);
-            }
-
-            params[param_count++] = parameter_create(
-                param_type_token->lexeme,
-                param_name_token->lexeme,
-                is_array
-            );
+            scratch_push(parser, ast_add_parameter(parser->ast, param_type, param_name, is_array));
 
         } while (match(parser, TOKEN_COMMA));
     }
 
+    ASTList params = scratch_commit(parser, mark);
     consume(parser, TOKEN_RPAREN, "Expected ')' after parameters");
 
     /* Function body */
     consume(parser, TOKEN_LBRACE, "Expected '{' before function body");
-    ASTNode* body = parse_block(parser);
+    ASTRef body = parse_block(parser);
 
-    return ast_create_function(return_type, name, params, param_count, body);
+    return ast_create_function(parser->ast, return_type, name, params, body);
 }
 
 /* Main parse function */
-ASTNode* parse(TokenList* tokens, const char* filename) {
-    Parser* parser = parser_create(tokens, filename);
-    ASTNode* program = ast_create_program();
+/* Report the deferred syntax errors, unless the lexer failed first, and free the parser */
+static int finish_parse(Parser* parser) {
+    TokenStream* tokens = parser->tokens;
+    int had_error = parser->had_error || tokens->had_error;
+
+    if (!tokens->had_error) {
+        for (int i = 0; i < parser->error_count; i++) {
+            ParseError* error = &parser->errors[i];
+            int line;
+            int column;
+            line_index_position(&tokens->lexer->lines, error->offset, &line, &column);
+            report_error(parser->filename, line, column, error->message);
+        }
+    }
+    parser_destroy(parser);
+    return had_error;
+}
+
+/* Skip to the next function after a syntax error */
+static void skip_to_function(Parser* parser) {
+    while (!is_at_end(parser) && !is_type(peek(parser)->type)) {
+        advance(parser);
+    }
+}
+
+ASTRef parse(TokenStream* tokens, const char* filename, Arena* arena, Interner* interner, AST* ast) {
+    Parser* parser = parser_create(tokens, filename, arena, interner, ast);
+    ASTRef program = ast_create_program(parser->ast);
+    int mark = scratch_mark(parser);
 
     while (!is_at_end(parser)) {
-        ASTNode* function = parse_function(parser);
+        ASTRef function = parse_function(parser);
         if (function) {
-            ast_add_function(program, function);
+            scratch_push(parser, function);
         } else {
-            /* Skip to next function on error */
-            while (!is_at_end(parser) && !is_type(peek(parser)->type)) {
-                advance(parser);
-            }
+            skip_to_function(parser);
         }
     }
 
-    int had_error = parser->had_error;
-    parser_destroy(parser);
+    ASTList functions = scratch_commit(parser, mark);
+    AST_NODE(ast, program)->data.program.functions = functions;
 
-    if (had_error) {
-        ast_destroy(program);
-        return NULL;
+    /* On error the partial tree is simply left in place until the next clear */
+    if (finish_parse(parser)) {
+        return AST_NONE;
     }
 
     return program;
 }
+
+int parse_stream(TokenStream* tokens, const char* filename, Arena* arena, Interner* interner, AST* ast,
+                 FunctionHandler handler, void* context) {
+    Parser* parser = parser_create(tokens, filename, arena, interner, ast);
+    ASTMark empty = ast_mark(ast);
+    int function_count = 0;
+
+    while (!is_at_end(parser)) {
+        ASTRef function = parse_function(parser);
+        if (!function) {
+            skip_to_function(parser);
+        } else if (!parser->had_error && !tokens->had_error) {
+            handler(context, ast, function);
+            function_count++;
+        }
+        ast_rewind(ast, empty);
+    }
+
+    return finish_parse(parser) ? -1 : function_count;
+}
+
+int parse_range(TokenStream* tokens, const char* filename, Arena* arena, Interner* interner, AST* ast,
+                int end, ParsedFunction** functions, int* capacity) {
+    Parser* parser = parser_create(tokens, filename, arena, interner, ast);
+    int function_count = 0;
+
+    while (!parser->had_error && !is_at_end(parser) && peek(parser)->offset < end) {
+        int start = peek(parser)->offset;
+        ASTRef function = parse_function(parser);
+        if (!function || parser->had_error) break;
+
+        if (function_count >= *capacity) {
+            *capacity = *capacity ? *capacity * 2 : 16;
+            *functions = (ParsedFunction*)safe_realloc(*functions, sizeof(ParsedFunction) * *capacity);
+        }
+        ParsedFunction* parsed = &(*functions)[function_count++];
+        parsed->function = function;
+        parsed->start = start;
+        parsed->end = previous(parser)->offset + previous(parser)->length;
+    }
+
+    /* The end of input is a token at its length, so the stretch may run to it */
+    int failed = parser->had_error || tokens->had_error || peek(parser)->offset != end;
+    parser_destroy(parser);
+    return failed ? -1 : function_count;
+}
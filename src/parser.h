@@ -3,19 +3,97 @@
 
 #include "ast.h"
 #include "lexer.h"
+#include "intern.h"
+
+/* A syntax error waiting to be reported */
+typedef struct {
+    int offset;         /* Resolved to a line and column only when reported */
+    const char* message;
+} ParseError;
+
+/* Pending work in an expression: operators short of an operand, groups short of a closing token */
+typedef enum {
+    FRAME_ROOT,             /* The whole expression */
+    FRAME_PAREN,            /* ( expression ) */
+    FRAME_CALL,             /* name ( arguments ) */
+    FRAME_NAME_INDEX,       /* name [ index ] */
+    FRAME_INDEX,            /* operand [ index ] */
+    FRAME_SIZEOF,           /* sizeof ( expression ) */
+    FRAME_TERNARY_THEN,     /* condition ? then : */
+    FRAME_TERNARY_ELSE,     /* condition ? then : else */
+    FRAME_PREFIX,
+    FRAME_BINARY,
+    FRAME_ASSIGN,
+    FRAME_COMPOUND_ASSIGN
+} ExprFrameKind;
+
+typedef struct {
+    uint8_t kind;           /* ExprFrameKind */
+    uint8_t power;          /* Binding power of an operator; 0 for a group */
+    uint8_t op;             /* OperatorKind of prefix, binary and compound-assignment frames */
+    int mark;               /* FRAME_CALL: scratch height before the arguments */
+    const char* name;       /* FRAME_CALL and FRAME_NAME_INDEX */
+} ExprFrame;
 
 /* Parser structure */
 typedef struct {
-    Token** tokens;
-    int current;
-    int count;
+    TokenStream* tokens;
+    int current;        /* Absolute position in the token stream */
     const char* filename;
+    Arena* arena;       /* Holds the pending errors */
+    Interner* interner; /* Names, types and literals in the tree */
+    AST* ast;           /* Receives every node built */
+    ParseError* errors;
+    int error_count;
+    int error_capacity;
     int had_error;
+    uint32_t* scratch;  /* Children of the lists being parsed, innermost on top */
+    int scratch_count;
+    int scratch_capacity;
+    ExprFrame* frames;  /* Open operators and groups of the expression being parsed */
+    int frame_count;
+    int frame_capacity;
+    ASTRef* operands;   /* Operands waiting for their operators */
+    int operand_count;
+    int operand_capacity;
 } Parser;
 
 /* Parser functions */
-Parser* parser_create(TokenList* tokens, const char* filename);
+Parser* parser_create(TokenStream* tokens, const char* filename, Arena* arena, Interner* interner, AST* ast);
 void parser_destroy(Parser* parser);
-ASTNode* parse(TokenList* tokens, const char* filename);
+/* Parse a whole programme into ast; AST_NONE on a syntax error or if the stream hit a lexer error */
+ASTRef parse(TokenStream* tokens, const char* filename, Arena* arena, Interner* interner, AST* ast);
+
+/* Receives one complete function; its nodes are only valid during the call */
+typedef void (*FunctionHandler)(void* context, const AST* ast, ASTRef function);
+
+/*
+ * Parse a programme one function at a time, handing each to handler as soon
+ * as it is complete and then discarding its nodes, so ast never holds more
+ * than one function. After a syntax error the rest is still parsed, for its
+ * diagnostics, but nothing more is handed on. Returns the number of
+ * functions handed on, or -1 on a syntax error or if the stream hit a lexer
+ * error.
+ */
+int parse_stream(TokenStream* tokens, const char* filename, Arena* arena, Interner* interner, AST* ast,
+                 FunctionHandler handler, void* context);
+
+/* A function parsed by parse_range and the bytes it came from: its first token to the end of its last */
+typedef struct {
+    ASTRef function;
+    int start;
+    int end;
+} ParsedFunction;
+
+/*
+ * Parse a stretch of a programme, for re-parsing only what changed since an
+ * earlier revision. The stream's lexer starts where the stretch does, at a
+ * token boundary; every function starting before end is parsed into ast
+ * and appended to *functions (grown as needed, *capacity entries). Nothing
+ * is reported. Returns the number of functions, or -1 on an error or if the
+ * next token does not start exactly at end, leaving a full parse to report.
+ */
+int parse_range(TokenStream* tokens, const char* filename, Arena* arena, Interner* interner, AST* ast,
+                int end, ParsedFunction** functions, int* capacity);
 
 #endif /* PARSER_H */
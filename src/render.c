@@ -0,0 +1,692 @@
+#include "render.h"
+
+#define RENDER_INITIAL_DEPTH 16
+#define RENDER_BUFFER_INITIAL_CAPACITY 256
+
+/* Formats */
+
+static const char* const format_names[RENDER_FORMAT_COUNT] = { "text", "md", "html", "json" };
+static const char* const format_extensions[RENDER_FORMAT_COUNT] = { ".txt", ".md", ".html", ".json" };
+
+const char* render_format_name(RenderFormat format) {
+    return format_names[format];
+}
+
+const char* render_format_extension(RenderFormat format) {
+    return format_extensions[format];
+}
+
+int render_parse_formats(const char* list) {
+    int formats = 0;
+    const char* name = list;
+    for (;;) {
+        const char* comma = strchr(name, ',');
+        size_t length = comma ? (size_t)(comma - name) : strlen(name);
+
+        int found = -1;
+        for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+            if (strlen(format_names[i]) == length && strncmp(format_names[i], name, length) == 0) {
+                found = i;
+            }
+        }
+        if (found < 0) {
+            log_message(LOG_ERROR, "Unknown output format: %.*s (expected text, md, html or json)",
+                        (int)length, name);
+            return 0;
+        }
+        formats |= RENDER_FORMAT_BIT(found);
+
+        if (!comma) return formats;
+        name = comma + 1;
+    }
+}
+
+RenderFormat render_first_format(int formats) {
+    for (int i = 0; i < RENDER_FORMAT_COUNT; i++) {
+        if (formats & RENDER_FORMAT_BIT(i)) return (RenderFormat)i;
+    }
+    return RENDER_TEXT;
+}
+
+/* Buffers */
+
+static void buffer_append(RenderBuffer* buffer, const char* text, size_t length) {
+    if (length == 0) return;
+
+    if (buffer->length + length > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : RENDER_BUFFER_INITIAL_CAPACITY;
+        while (buffer->length + length > capacity) {
+            capacity *= 2;
+        }
+        buffer->data = (char*)safe_realloc(buffer->data, capacity);
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->length, text, length);
+    buffer->length += length;
+}
+
+static void buffer_append_string(RenderBuffer* buffer, const char* text) {
+    buffer_append(buffer, text, strlen(text));
+}
+
+/* Escaping: runs of ordinary bytes are copied whole, special ones replaced */
+
+static const char* html_escape(char c) {
+    switch (c) {
+        case '&': return "&amp;";
+        case '<': return "&lt;";
+        case '>': return "&gt;";
+        case '"': return "&quot;";
+        default: return NULL;
+    }
+}
+
+static void append_html(RenderBuffer* buffer, const char* text, size_t length) {
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++) {
+        const char* escape = html_escape(text[i]);
+        if (!escape) continue;
+        buffer_append(buffer, text + start, i - start);
+        buffer_append_string(buffer, escape);
+        start = i + 1;
+    }
+    buffer_append(buffer, text + start, length - start);
+}
+
+static void append_json(RenderBuffer* buffer, const char* text, size_t length) {
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        buffer_append(buffer, text + start, i - start);
+        char escape[8];
+        if (c == '"' || c == '\\') {
+            escape[0] = '\\';
+            escape[1] = (char)c;
+            escape[2] = '\0';
+        } else if (c == '\n') {
+            strcpy(escape, "\\n");
+        } else if (c == '\t') {
+            strcpy(escape, "\\t");
+        } else {
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+        }
+        buffer_append_string(buffer, escape);
+        start = i + 1;
+    }
+    buffer_append(buffer, text + start, length - start);
+}
+
+/* Prose in Markdown: the characters that would start emphasis, code, links or HTML are escaped */
+static void append_markdown(RenderBuffer* buffer, const char* text, size_t length) {
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (!strchr("\\`*_[]<>", text[i]) || text[i] == '\0') continue;
+        buffer_append(buffer, text + start, i - start);
+        buffer_append(buffer, "\\", 1);
+        start = i;
+    }
+    buffer_append(buffer, text + start, length - start);
+}
+
+/* A Markdown code span, with a longer fence when the code holds a backtick */
+static void append_markdown_code(RenderBuffer* buffer, const char* text, size_t length) {
+    if (memchr(text, '`', length)) {
+        buffer_append(buffer, "`` ", 3);
+        buffer_append(buffer, text, length);
+        buffer_append(buffer, " ``", 3);
+    } else {
+        buffer_append(buffer, "`", 1);
+        buffer_append(buffer, text, length);
+        buffer_append(buffer, "`", 1);
+    }
+}
+
+/* Output helpers */
+
+static void write_spaces(OutputBuilder* out, int count) {
+    static const char spaces[] = "                                ";
+    while (count > 0) {
+        int n = count < (int)sizeof(spaces) - 1 ? count : (int)sizeof(spaces) - 1;
+        output_append_length(out, spaces, (size_t)n);
+        count -= n;
+    }
+}
+
+static void write_repeated(OutputBuilder* out, char c, int count) {
+    for (int i = 0; i < count; i++) {
+        output_append_char(out, c);
+    }
+}
+
+static void write_buffer(OutputBuilder* out, const RenderBuffer* buffer) {
+    output_append_length(out, buffer->data, buffer->length);
+}
+
+static int is_quoted(const DescriptionRecord* record) {
+    return record->kind == DESC_NAME || (record->kind == DESC_CODE && (record->flags & DESC_QUOTED));
+}
+
+static int format_number(char* digits, size_t size, int value) {
+    return snprintf(digits, size, "%d", value);
+}
+
+/* Frames */
+
+static RenderFrame* parent_frame(Renderer* renderer, const RenderFrame* frame) {
+    return frame->depth > 0 ? &renderer->frames[frame->depth - 1] : NULL;
+}
+
+/* Blocks written as list items, in formats with lists */
+static int is_list_item(const RenderFrame* parent) {
+    if (!parent) return 0;
+    switch (parent->kind) {
+        case DESC_PARAMETERS:
+        case DESC_STEPS:
+        case DESC_STEP:
+        case DESC_CASE:
+        case DESC_OTHERWISE:
+        case DESC_LABEL:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/*
+ * Text. Each sentence is one line, written as its fragments arrive, each
+ * block followed by the blank lines and underlines the translator's text
+ * has always had.
+ */
+
+static int text_level(const RenderFrame* parent, DescriptionKind kind) {
+    if (!parent) return 0;
+
+    switch (parent->kind) {
+        case DESC_STEPS:
+        case DESC_CASE:
+            return parent->level + 1;
+        case DESC_STEP:
+            return kind == DESC_CLOSING ? parent->level : parent->level + 1;
+        default:
+            return parent->level;
+    }
+}
+
+static void text_write(Renderer* renderer, OutputBuilder* out, const char* text, size_t length) {
+    if (length == 0) return;
+
+    renderer->sentence_length += (int)length;
+    if (renderer->capitalise) {
+        renderer->capitalise = 0;
+        if (*text >= 'a' && *text <= 'z') {
+            output_append_char(out, (char)(*text - 'a' + 'A'));
+            text++;
+            length--;
+        }
+    }
+    output_append_length(out, text, length);
+}
+
+/* Code, between the markers the formatter takes it by */
+static void text_code(Renderer* renderer, OutputBuilder* out, const char* text, size_t length) {
+    if (length == 0) return;
+
+    output_append_char(out, RENDER_CODE_OPEN);
+    text_write(renderer, out, text, length);
+    output_append_char(out, RENDER_CODE_CLOSE);
+}
+
+static void text_open(const RenderFrame* frame, OutputBuilder* out) {
+    write_spaces(out, frame->level * 2);
+    if (frame->kind == DESC_STEP && frame->value > 0) {
+        output_appendf(out, "%d. ", frame->value);
+    } else if (frame->kind == DESC_PARAMETER) {
+        output_append(out, "  • ");
+    }
+}
+
+static void text_fragment(Renderer* renderer, const DescriptionRecord* record, OutputBuilder* out) {
+    if (record->kind == DESC_NUMBER) {
+        char digits[16];
+        text_write(renderer, out, digits, (size_t)format_number(digits, sizeof(digits), record->value));
+    } else if (record->kind == DESC_TEXT) {
+        text_write(renderer, out, record->text, (size_t)record->value);
+    } else {
+        int quoted = is_quoted(record);
+        if (quoted) text_write(renderer, out, "'", 1);
+        text_code(renderer, out, record->text, (size_t)record->value);
+        if (quoted) text_write(renderer, out, "'", 1);
+    }
+}
+
+static void text_finish(Renderer* renderer, const RenderFrame* frame, OutputBuilder* out) {
+    output_append_char(out, '\n');
+    switch (frame->kind) {
+        case DESC_PROGRAMME:
+            write_repeated(out, '=', renderer->sentence_length);
+            output_append(out, "\n\n");
+            break;
+        case DESC_FUNCTION:
+            write_repeated(out, '-', renderer->sentence_length);
+            output_append_char(out, '\n');
+            break;
+        case DESC_PARAGRAPH:
+        case DESC_STEPS:
+            output_append_char(out, '\n');
+            break;
+        default:
+            break;
+    }
+}
+
+static void text_close(const RenderFrame* frame, OutputBuilder* out) {
+    switch (frame->kind) {
+        case DESC_STEP:
+            write_spaces(out, frame->level * 2);
+            output_append_char(out, '\n');
+            break;
+        case DESC_PARAMETERS:
+        case DESC_FUNCTION:
+            output_append_char(out, '\n');
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * The other formats gather each sentence twice: in their own markup, and
+ * as the text format would write it, escaped, for where markup cannot go.
+ */
+
+static void gather_piece(Renderer* renderer, DescriptionKind kind, int quoted, const char* text, size_t length) {
+    RenderBuffer* sentence = &renderer->sentence;
+    RenderBuffer* plain = &renderer->plain;
+
+    switch (renderer->format) {
+        case RENDER_MARKDOWN:
+            if (kind == DESC_NAME || kind == DESC_CODE) {
+                append_markdown_code(sentence, text, length);
+            } else if (kind == DESC_TEXT) {
+                append_markdown(sentence, text, length);
+            } else {
+                buffer_append(sentence, text, length);
+            }
+            return;
+
+        case RENDER_HTML:
+            if (kind == DESC_NAME || kind == DESC_CODE) {
+                buffer_append_string(sentence, "<code>");
+                append_html(sentence, text, length);
+                buffer_append_string(sentence, "</code>");
+            } else {
+                append_html(sentence, text, length);
+            }
+            if (quoted) buffer_append(plain, "'", 1);
+            append_html(plain, text, length);
+            if (quoted) buffer_append(plain, "'", 1);
+            return;
+
+        case RENDER_JSON:
+            /* Neighbouring prose is one fragment */
+            if (kind == DESC_TEXT && renderer->text_open) {
+                append_json(sentence, text, length);
+            } else {
+                if (renderer->text_open) buffer_append(sentence, "\"}", 2);
+                if (sentence->length > 0) buffer_append(sentence, ", ", 2);
+                renderer->text_open = kind == DESC_TEXT;
+                if (kind == DESC_NUMBER) {
+                    buffer_append_string(sentence, "{\"number\": ");
+                    buffer_append(sentence, text, length);
+                    buffer_append(sentence, "}", 1);
+                } else {
+                    buffer_append_string(sentence, kind == DESC_TEXT ? "{\"text\": \"" :
+                                                   kind == DESC_NAME ? "{\"name\": \"" : "{\"code\": \"");
+                    append_json(sentence, text, length);
+                    if (kind != DESC_TEXT) buffer_append(sentence, "\"}", 2);
+                }
+            }
+            if (quoted) buffer_append(plain, "'", 1);
+            append_json(plain, text, length);
+            if (quoted) buffer_append(plain, "'", 1);
+            return;
+
+        default:
+            return;
+    }
+}
+
+static void gather_fragment(Renderer* renderer, const DescriptionRecord* record) {
+    DescriptionKind kind = (DescriptionKind)record->kind;
+    int quoted = is_quoted(record);
+    const char* text = record->text;
+    size_t length = (size_t)record->value;
+    char digits[16];
+    if (kind == DESC_NUMBER) {
+        length = (size_t)format_number(digits, sizeof(digits), record->value);
+        text = digits;
+    }
+
+    /* Only prose is capitalised: the text of a name or code is left as it is */
+    if (renderer->capitalise) {
+        renderer->capitalise = 0;
+        if (kind == DESC_TEXT && length > 0 && *text >= 'a' && *text <= 'z') {
+            char capital = (char)(*text - 'a' + 'A');
+            gather_piece(renderer, kind, quoted, &capital, 1);
+            text++;
+            length--;
+        }
+    }
+    gather_piece(renderer, kind, quoted, text, length);
+}
+
+/* Markdown: headings, paragraphs and nested lists, each level under the text of the item holding it */
+
+static int markdown_marker(const RenderFrame* frame, char* marker, size_t size) {
+    if (frame->kind == DESC_STEP && frame->value > 0) {
+        return snprintf(marker, size, "%d. ", frame->value);
+    }
+    return snprintf(marker, size, "- ");
+}
+
+static int markdown_level(Renderer* renderer, const RenderFrame* parent) {
+    if (!parent || !is_list_item(parent_frame(renderer, parent))) return 0;
+
+    char marker[24];
+    return parent->level + markdown_marker(parent, marker, sizeof(marker));
+}
+
+static void markdown_finish(Renderer* renderer, const RenderFrame* frame, OutputBuilder* out) {
+    if (is_list_item(parent_frame(renderer, frame))) {
+        char marker[24];
+        write_spaces(out, frame->level);
+        output_append_length(out, marker, (size_t)markdown_marker(frame, marker, sizeof(marker)));
+        write_buffer(out, &renderer->sentence);
+        output_append_char(out, '\n');
+        return;
+    }
+
+    if (frame->kind == DESC_PROGRAMME) {
+        output_append(out, "# ");
+    } else if (frame->kind == DESC_FUNCTION) {
+        output_append(out, "## ");
+    }
+    write_buffer(out, &renderer->sentence);
+    output_append(out, "\n\n");
+}
+
+static void markdown_close(const RenderFrame* frame, OutputBuilder* out) {
+    if ((frame->kind == DESC_PARAMETERS || frame->kind == DESC_STEPS) && frame->children > 0) {
+        output_append_char(out, '\n');
+    }
+}
+
+/* HTML: a whole document, the steps an ordered list holding unordered ones */
+
+static void html_open(const RenderFrame* frame, OutputBuilder* out) {
+    if (frame->kind == DESC_FUNCTION) {
+        output_append(out, "<section>\n");
+    }
+}
+
+static void html_finish(Renderer* renderer, const RenderFrame* frame, OutputBuilder* out) {
+    const RenderFrame* parent = parent_frame(renderer, frame);
+
+    switch (frame->kind) {
+        case DESC_PROGRAMME:
+            output_append(out, "<!DOCTYPE html>\n<html lang=\"en-GB\">\n<head>\n<meta charset=\"utf-8\">\n<title>");
+            write_buffer(out, &renderer->plain);
+            output_append(out, "</title>\n<style>li.unnumbered { list-style: none; }</style>\n</head>\n<body>\n<h1>");
+            write_buffer(out, &renderer->sentence);
+            output_append(out, "</h1>\n");
+            return;
+        case DESC_FUNCTION:
+            output_append(out, "<h2>");
+            write_buffer(out, &renderer->sentence);
+            output_append(out, "</h2>\n");
+            return;
+        case DESC_PARAMETER:
+            output_append(out, "<li>");
+            write_buffer(out, &renderer->sentence);
+            output_append(out, "</li>\n");
+            return;
+        default:
+            break;
+    }
+
+    if (!is_list_item(parent)) {
+        output_append(out, "<p>");
+        write_buffer(out, &renderer->sentence);
+        output_append(out, "</p>\n");
+        if (frame->kind == DESC_PARAMETERS) {
+            output_append(out, "<ul>\n");
+        } else if (frame->kind == DESC_STEPS) {
+            output_append(out, "<ol>\n");
+        }
+        return;
+    }
+
+    /* A step stays open for the list of its sub-steps */
+    if (frame->kind == DESC_STEP && frame->value > 0) {
+        output_appendf(out, "<li value=\"%d\">", frame->value);
+    } else if (parent->kind == DESC_STEPS) {
+        output_append(out, "<li class=\"unnumbered\">");
+    } else {
+        output_append(out, "<li>");
+    }
+    write_buffer(out, &renderer->sentence);
+}
+
+static void html_child(Renderer* renderer, const RenderFrame* parent, OutputBuilder* out) {
+    if (parent->children == 0 && parent->kind != DESC_PARAMETER &&
+        is_list_item(parent_frame(renderer, parent))) {
+        output_append(out, "\n<ul>\n");
+    }
+}
+
+static void html_close(Renderer* renderer, const RenderFrame* frame, OutputBuilder* out) {
+    switch (frame->kind) {
+        case DESC_PROGRAMME:
+            output_append(out, "</body>\n</html>\n");
+            return;
+        case DESC_FUNCTION:
+            output_append(out, "</section>\n");
+            return;
+        case DESC_PARAMETERS:
+            output_append(out, "</ul>\n");
+            return;
+        case DESC_STEPS:
+            output_append(out, "</ol>\n");
+            return;
+        case DESC_PARAMETER:
+            return;
+        default:
+            break;
+    }
+
+    if (is_list_item(parent_frame(renderer, frame))) {
+        output_append(out, frame->children > 0 ? "</ul>\n</li>\n" : "</li>\n");
+    }
+}
+
+/* JSON: one object per block, its sentence as plain text and as fragments, its blocks as children */
+
+static const char* const json_kinds[DESC_END] = {
+    "programme", "function", "paragraph", "sentence", "parameters", "parameter",
+    "steps", "step", "case", "otherwise", "label", "closing"
+};
+
+static void json_open(const RenderFrame* frame, OutputBuilder* out) {
+    int indent = frame->depth * 4;
+    write_spaces(out, indent);
+    output_append(out, "{\n");
+    write_spaces(out, indent + 2);
+    output_appendf(out, "\"kind\": \"%s\"", json_kinds[frame->kind]);
+    if (frame->kind == DESC_STEP && frame->value > 0) {
+        output_append(out, ",\n");
+        write_spaces(out, indent + 2);
+        output_appendf(out, "\"number\": %d", frame->value);
+    }
+}
+
+static void json_finish(Renderer* renderer, const RenderFrame* frame, OutputBuilder* out) {
+    int indent = frame->depth * 4 + 2;
+    if (renderer->text_open) {
+        buffer_append(&renderer->sentence, "\"}", 2);
+        renderer->text_open = 0;
+    }
+    output_append(out, ",\n");
+    write_spaces(out, indent);
+    output_append(out, "\"text\": \"");
+    write_buffer(out, &renderer->plain);
+    output_append(out, "\",\n");
+    write_spaces(out, indent);
+    output_append(out, "\"fragments\": [");
+    write_buffer(out, &renderer->sentence);
+    output_append_char(out, ']');
+}
+
+static void json_child(const RenderFrame* parent, OutputBuilder* out) {
+    if (parent->children == 0) {
+        output_append(out, ",\n");
+        write_spaces(out, parent->depth * 4 + 2);
+        output_append(out, "\"children\": [\n");
+    } else {
+        output_append(out, ",\n");
+    }
+}
+
+static void json_close(const RenderFrame* frame, OutputBuilder* out) {
+    int indent = frame->depth * 4;
+    if (frame->children > 0) {
+        output_append_char(out, '\n');
+        write_spaces(out, indent + 2);
+        output_append_char(out, ']');
+    }
+    output_append_char(out, '\n');
+    write_spaces(out, indent);
+    output_append_char(out, '}');
+    if (frame->depth == 0) {
+        output_append_char(out, '\n');
+    }
+}
+
+/* Walking the records */
+
+static void finish_sentence(Renderer* renderer, RenderFrame* frame, OutputBuilder* out) {
+    frame->open = 0;
+    switch (renderer->format) {
+        case RENDER_TEXT: text_finish(renderer, frame, out); break;
+        case RENDER_MARKDOWN: markdown_finish(renderer, frame, out); break;
+        case RENDER_HTML: html_finish(renderer, frame, out); break;
+        case RENDER_JSON: json_finish(renderer, frame, out); break;
+        default: break;
+    }
+}
+
+static void begin_block(Renderer* renderer, const DescriptionRecord* record, OutputBuilder* out) {
+    if (renderer->depth == renderer->frame_capacity) {
+        renderer->frame_capacity = renderer->frame_capacity ? renderer->frame_capacity * 2 : RENDER_INITIAL_DEPTH;
+        renderer->frames = (RenderFrame*)safe_realloc(renderer->frames,
+                                                      sizeof(RenderFrame) * renderer->frame_capacity);
+    }
+
+    RenderFrame* parent = renderer->depth > 0 ? &renderer->frames[renderer->depth - 1] : NULL;
+    if (parent) {
+        if (parent->open) finish_sentence(renderer, parent, out);
+        if (renderer->format == RENDER_HTML) html_child(renderer, parent, out);
+        if (renderer->format == RENDER_JSON) json_child(parent, out);
+        parent->children++;
+    }
+
+    RenderFrame* frame = &renderer->frames[renderer->depth];
+    frame->kind = record->kind;
+    frame->flags = record->flags;
+    frame->value = record->value;
+    frame->depth = renderer->depth;
+    frame->open = 1;
+    frame->children = 0;
+    renderer->depth++;
+
+    renderer->capitalise = (record->flags & DESC_CAPITALISE) != 0;
+    renderer->sentence_length = 0;
+    renderer->text_open = 0;
+    renderer->sentence.length = 0;
+    renderer->plain.length = 0;
+
+    switch (renderer->format) {
+        case RENDER_TEXT:
+            frame->level = text_level(parent, (DescriptionKind)frame->kind);
+            text_open(frame, out);
+            break;
+        case RENDER_MARKDOWN:
+            frame->level = markdown_level(renderer, parent);
+            break;
+        case RENDER_HTML:
+            frame->level = 0;
+            html_open(frame, out);
+            break;
+        case RENDER_JSON:
+            frame->level = 0;
+            json_open(frame, out);
+            break;
+        default:
+            break;
+    }
+}
+
+static void end_block(Renderer* renderer, OutputBuilder* out) {
+    if (renderer->depth == 0) return;
+
+    RenderFrame* frame = &renderer->frames[renderer->depth - 1];
+    if (frame->open) finish_sentence(renderer, frame, out);
+    switch (renderer->format) {
+        case RENDER_TEXT: text_close(frame, out); break;
+        case RENDER_MARKDOWN: markdown_close(frame, out); break;
+        case RENDER_HTML: html_close(renderer, frame, out); break;
+        case RENDER_JSON: json_close(frame, out); break;
+        default: break;
+    }
+    renderer->depth--;
+}
+
+void renderer_begin(Renderer* renderer, RenderFormat format) {
+    memset(renderer, 0, sizeof(Renderer));
+    renderer->format = format;
+}
+
+void renderer_feed(Renderer* renderer, const Description* description, OutputBuilder* out) {
+    for (int i = 0; i < description->count; i++) {
+        const DescriptionRecord* record = &description->records[i];
+        if (record->kind == DESC_END) {
+            end_block(renderer, out);
+        } else if (record->kind < DESC_END) {
+            begin_block(renderer, record, out);
+        } else if (renderer->depth > 0 && renderer->frames[renderer->depth - 1].open) {
+            if (renderer->format == RENDER_TEXT) {
+                text_fragment(renderer, record, out);
+            } else {
+                gather_fragment(renderer, record);
+            }
+        }
+    }
+}
+
+void renderer_end(Renderer* renderer, OutputBuilder* out) {
+    while (renderer->depth > 0) {
+        end_block(renderer, out);
+    }
+    free(renderer->frames);
+    free(renderer->sentence.data);
+    free(renderer->plain.data);
+    memset(renderer, 0, sizeof(Renderer));
+}
+
+void render_description(const Description* description, RenderFormat format, OutputBuilder* out) {
+    Renderer renderer;
+    renderer_begin(&renderer, format);
+    renderer_feed(&renderer, description, out);
+    renderer_end(&renderer, out);
+}
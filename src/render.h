@@ -0,0 +1,87 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "description.h"
+#include "output.h"
+#include "utils.h"
+
+/* Output formats a description can be rendered in */
+typedef enum {
+    RENDER_TEXT,        /* Plain text, as the translator has always written it */
+    RENDER_MARKDOWN,
+    RENDER_HTML,
+    RENDER_JSON,
+    RENDER_FORMAT_COUNT
+} RenderFormat;
+
+/*
+ * Text output is raw, for the formatter: each name and piece of code in it
+ * is bracketed by these bytes, which C source text does not hold, so the
+ * formatter can leave code as it is and remove them. They are the marks
+ * scan_word_starts reports.
+ */
+#define RENDER_CODE_OPEN '\x0E'
+#define RENDER_CODE_CLOSE '\x0F'
+
+/* Sets of formats are masks of these bits */
+#define RENDER_FORMAT_BIT(format) (1 << (format))
+
+/* Format names ("text", "md", ...) and the extensions of files in them (".txt", ...) */
+const char* render_format_name(RenderFormat format);
+const char* render_format_extension(RenderFormat format);
+
+/*
+ * The formats in a comma-separated list of names, as a mask; returns 0,
+ * having reported the problem, if a name is not a format.
+ */
+int render_parse_formats(const char* list);
+
+/* The first format in a mask, in the order of RenderFormat */
+RenderFormat render_first_format(int formats);
+
+/* A block being rendered */
+typedef struct {
+    unsigned char kind;     /* DescriptionKind */
+    unsigned char flags;
+    int value;
+    int level;          /* Text: indent level. Markdown: column of the block's text */
+    int depth;          /* Blocks enclosing this one */
+    int open;           /* The sentence is still taking fragments */
+    int children;       /* Blocks nested in this one so far */
+} RenderFrame;
+
+/* A sentence gathered until its block shows how it is written */
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} RenderBuffer;
+
+/*
+ * Renderer state for a description that arrives in pieces, so a streamed
+ * description can be rendered function by function. Records are read once,
+ * front to back. The text renderer writes each fragment as it arrives; the
+ * others gather a sentence, in their own markup and as escaped plain text,
+ * until the next block or the end shows where it goes.
+ */
+typedef struct {
+    RenderFormat format;
+    RenderFrame* frames;
+    int depth;
+    int frame_capacity;
+    int capitalise;         /* The next byte of the sentence starts it and is to be a capital */
+    int sentence_length;    /* Bytes of the text sentence so far, for underlining headings */
+    int text_open;          /* JSON: the last fragment is prose whose string is still open */
+    RenderBuffer sentence;
+    RenderBuffer plain;
+} Renderer;
+
+/* Rendering a description a piece at a time; renderer_end closes what is open and frees the state */
+void renderer_begin(Renderer* renderer, RenderFormat format);
+void renderer_feed(Renderer* renderer, const Description* description, OutputBuilder* out);
+void renderer_end(Renderer* renderer, OutputBuilder* out);
+
+/* Render the whole of description in format, appending to out */
+void render_description(const Description* description, RenderFormat format, OutputBuilder* out);
+
+#endif /* RENDER_H */
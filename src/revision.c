@@ -0,0 +1,259 @@
+#include "revision.h"
+#include "lexer.h"
+#include "semantic.h"
+#include "translator.h"
+#include "formatter.h"
+
+/* Revision creation and destruction */
+
+Revision* revision_create(void) {
+    Revision* revision = (Revision*)safe_malloc(sizeof(Revision));
+    revision->valid = 0;
+    revision->source = NULL;
+    revision->length = 0;
+    revision->functions = NULL;
+    revision->function_count = 0;
+    revision->function_capacity = 0;
+    revision->next = NULL;
+    revision->next_capacity = 0;
+    revision->parsed = NULL;
+    revision->parsed_capacity = 0;
+    revision->piece = output_builder_create();
+    return revision;
+}
+
+static void free_function(RevisionFunction* function) {
+    free(function->name);
+    free(function->return_type);
+    free(function->text);
+}
+
+void revision_destroy(Revision* revision) {
+    if (!revision) return;
+
+    /* next only ever holds copies of these, or text lost with a failed translation */
+    for (int i = 0; i < revision->function_count; i++) {
+        free_function(&revision->functions[i]);
+    }
+    free(revision->functions);
+    free(revision->next);
+    free(revision->parsed);
+    free(revision->source);
+    output_builder_destroy(revision->piece);
+    free(revision);
+}
+
+/* Text */
+
+/* Render and format the compiler's description as text, appending it to out */
+static void format_description(Compiler* compiler, OutputBuilder* out, const CompileOptions* options) {
+    FormatOptions format = { options->spelling, options->wrap_width };
+    output_builder_clear(compiler->english);
+    render_description(compiler->description, RENDER_TEXT, compiler->english);
+    format_english_output(compiler->english, out, &format);
+}
+
+/*
+ * How many of the last revision's functions lie wholly in the bytes data
+ * shares with it at the start (keep_before) and at the end (keep_after)
+ */
+static void unchanged_functions(const Revision* revision, const char* data, size_t length,
+                                int* keep_before, int* keep_after) {
+    const char* old = revision->source;
+    size_t old_length = revision->length;
+    size_t limit = old_length < length ? old_length : length;
+
+    size_t prefix = 0;
+    while (prefix < limit && old[prefix] == data[prefix]) {
+        prefix++;
+    }
+    size_t suffix = 0;
+    while (suffix < limit - prefix && old[old_length - 1 - suffix] == data[length - 1 - suffix]) {
+        suffix++;
+    }
+
+    const RevisionFunction* functions = revision->functions;
+    int count = revision->function_count;
+    int before = 0;
+    while (before < count && (size_t)functions[before].end <= prefix) {
+        before++;
+    }
+    int after = 0;
+    while (after < count - before && (size_t)functions[count - 1 - after].start >= old_length - suffix) {
+        after++;
+    }
+    *keep_before = before;
+    *keep_after = after;
+}
+
+/*
+ * Translate data keeping the first keep_before and last keep_after functions
+ * of the last revision and parsing the bytes between them again. Lexing
+ * restarts just after the last kept function's closing brace, so it sees
+ * exactly what a full pass would; the stretch only stands if its last
+ * token ends where the first kept function after it starts. Kept bodies
+ * were checked against the last revision's functions, so they stand as
+ * long as every name they could have called is still defined.
+ */
+static int translate_changes(Revision* revision, Compiler* compiler, const char* data, size_t length,
+                             const char* name, int keep_before, int keep_after,
+                             const CompileOptions* options, CompileStats* stats) {
+    const RevisionFunction* old = revision->functions;
+    int old_count = revision->function_count;
+    int changed_end = old_count - keep_after;
+    long delta = (long)length - (long)revision->length;
+    int start = keep_before > 0 ? old[keep_before - 1].end : 0;
+    int end = keep_after > 0 ? old[changed_end].start + (int)delta : (int)length;
+
+    Arena* arena = compiler->arena;
+    AST* ast = compiler->ast;
+    arena_reset(arena);
+    interner_clear(compiler->interner);
+    ast_clear(ast);
+    description_clear(compiler->description);
+    output_builder_clear(compiler->formatted[RENDER_TEXT]);
+
+    /* Syntax analysis of the changed stretch */
+    compile_stats_phase_begin(stats, PHASE_PARSE);
+    Lexer* lexer = lexer_create(data, length, name, arena);
+    lexer->current = start;
+    TokenStream stream;
+    token_stream_init(&stream, lexer);
+    int count = parse_range(&stream, name, arena, compiler->interner, ast, end,
+                            &revision->parsed, &revision->parsed_capacity);
+    lexer_destroy(lexer);
+    compile_stats_phase_end(stats, PHASE_PARSE);
+    stats->tokens = (size_t)stream.produced;
+    if (count < 0) return 0;
+
+    const ParsedFunction* parsed = revision->parsed;
+
+    /* Semantic analysis: every signature, in source order, then the new bodies */
+    compile_stats_phase_begin(stats, PHASE_SEMANTIC);
+    SemanticAnalyzer* analyzer = semantic_analyzer_create(ast, name, arena, NULL);
+    for (int i = 0; i < old_count; i++) {
+        if (i == keep_before) {
+            for (int j = 0; j < count; j++) {
+                semantic_declare_function(analyzer, parsed[j].function);
+            }
+        }
+        if (i < keep_before || i >= changed_end) {
+            semantic_declare_signature(analyzer, intern_cstr(compiler->interner, old[i].name),
+                                       intern_cstr(compiler->interner, old[i].return_type));
+        }
+    }
+    if (keep_before == old_count) {
+        for (int j = 0; j < count; j++) {
+            semantic_declare_function(analyzer, parsed[j].function);
+        }
+    }
+
+    int checked = !analyzer->had_error;
+    if (checked && keep_before + keep_after > 0) {
+        for (int i = keep_before; i < changed_end; i++) {
+            if (!symbol_table_lookup(analyzer->globals, intern_cstr(compiler->interner, old[i].name))) {
+                checked = 0;
+            }
+        }
+    }
+    for (int j = 0; checked && j < count; j++) {
+        semantic_check_function(analyzer, parsed[j].function);
+        checked = !analyzer->had_error;
+    }
+    stats->symbols = (size_t)semantic_analyzer_symbol_count(analyzer);
+    semantic_analyzer_destroy(analyzer);
+    compile_stats_phase_end(stats, PHASE_SEMANTIC);
+    if (!checked) return 0;
+
+    /* The new revision's table: kept functions move over, changed ones are translated afresh */
+    int total = keep_before + count + keep_after;
+    if (total > revision->next_capacity) {
+        revision->next_capacity = total * 2;
+        revision->next = (RevisionFunction*)safe_realloc(revision->next,
+                                                         sizeof(RevisionFunction) * revision->next_capacity);
+    }
+    RevisionFunction* next = revision->next;
+    for (int i = 0; i < keep_before; i++) {
+        next[i] = old[i];
+    }
+
+    TranslateOptions translate_options = { 1, 0, NULL };
+    for (int j = 0; j < count; j++) {
+        const ASTNode* node = AST_NODE(ast, parsed[j].function);
+        RevisionFunction* function = &next[keep_before + j];
+        function->start = parsed[j].start;
+        function->end = parsed[j].end;
+        function->name = string_duplicate(AST_TEXT(ast, node->data.function.name));
+        function->return_type = string_duplicate(AST_TEXT(ast, node->data.function.return_type));
+
+        compile_stats_phase_begin(stats, PHASE_TRANSLATE);
+        description_clear(compiler->description);
+        translate_stream_function(ast, parsed[j].function, compiler->description, &translate_options);
+        compile_stats_phase_end(stats, PHASE_TRANSLATE);
+
+        compile_stats_phase_begin(stats, PHASE_FORMAT);
+        output_builder_clear(revision->piece);
+        format_description(compiler, revision->piece, options);
+        function->text = output_builder_to_string(revision->piece);
+        function->text_length = revision->piece->length;
+        compile_stats_phase_end(stats, PHASE_FORMAT);
+    }
+
+    for (int i = 0; i < keep_after; i++) {
+        RevisionFunction* function = &next[keep_before + count + i];
+        *function = old[changed_end + i];
+        function->start += (int)delta;
+        function->end += (int)delta;
+    }
+
+    /* Each function's text ends a line, so formatting the pieces apart gives the whole text's formatting */
+    compile_stats_phase_begin(stats, PHASE_FORMAT);
+    OutputBuilder* formatted = compiler->formatted[RENDER_TEXT];
+    description_clear(compiler->description);
+    translate_programme_head(compiler->description, total);
+    format_description(compiler, formatted, options);
+    for (int i = 0; i < total; i++) {
+        output_append_length(formatted, next[i].text, next[i].text_length);
+    }
+    compile_stats_phase_end(stats, PHASE_FORMAT);
+
+    char* source = (char*)safe_malloc(length + 1);
+    memcpy(source, data, length);
+    source[length] = '\0';
+
+    /* Nothing below allocates, so running out of memory never leaves the revision half replaced */
+    for (int i = keep_before; i < changed_end; i++) {
+        free_function(&revision->functions[i]);
+    }
+    RevisionFunction* spent = revision->functions;
+    int spent_capacity = revision->function_capacity;
+    revision->functions = next;
+    revision->function_count = total;
+    revision->function_capacity = revision->next_capacity;
+    revision->next = spent;
+    revision->next_capacity = spent_capacity;
+    free(revision->source);
+    revision->source = source;
+    revision->length = length;
+    revision->valid = 1;
+    stats->arena_bytes = arena->bytes_used;
+    return 1;
+}
+
+int revision_translate(Revision* revision, Compiler* compiler, const char* data, size_t length,
+                       const char* name, const CompileOptions* options, CompileStats* stats) {
+    if (options->headers) return 0;
+
+    if (revision->valid) {
+        int keep_before;
+        int keep_after;
+        unchanged_functions(revision, data, length, &keep_before, &keep_after);
+        if (translate_changes(revision, compiler, data, length, name, keep_before, keep_after, options, stats)) {
+            return 1;
+        }
+        if (keep_before + keep_after == 0) return 0;
+    }
+
+    /* Everything as changed: either there is no revision yet or the change reached past the kept functions */
+    return translate_changes(revision, compiler, data, length, name, 0, 0, options, stats);
+}
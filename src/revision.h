@@ -0,0 +1,57 @@
+#ifndef REVISION_H
+#define REVISION_H
+
+#include "compiler.h"
+#include "parser.h"
+
+/* One function of the last revision translated */
+typedef struct {
+    int start;              /* Its bytes in the revision's source */
+    int end;
+    char* name;             /* Its signature, to check changed functions against */
+    char* return_type;
+    char* text;             /* Its final text */
+    size_t text_length;
+} RevisionFunction;
+
+/*
+ * The last revision of a source that was translated, function by function,
+ * so the next revision of the same source - an editor buffer sent again
+ * after a change - can be translated by re-parsing, re-checking and
+ * re-translating only the functions whose bytes changed, reusing the text
+ * of all the others.
+ */
+typedef struct {
+    int valid;              /* source and functions describe a translation */
+    char* source;
+    size_t length;
+    RevisionFunction* functions;
+    int function_count;
+    int function_capacity;
+    RevisionFunction* next;         /* The table being built for the new revision */
+    int next_capacity;
+    ParsedFunction* parsed;         /* Functions re-parsed from the changed bytes */
+    int parsed_capacity;
+    OutputBuilder* piece;           /* One function's text, while it is formatted */
+} Revision;
+
+/* Revision creation and destruction */
+Revision* revision_create(void);
+void revision_destroy(Revision* revision);
+
+/*
+ * Translate data, the next revision of the source, leaving the formatted
+ * text in compiler->formatted[RENDER_TEXT] just as compiler_translate and
+ * compiler_emit would, and keep it as the revision for the next call. Only
+ * the bytes that differ from the last revision are parsed again, from the
+ * end of the last function before the change to the start of the first one
+ * after it; if that cannot be done safely, the whole source is taken as
+ * changed. Nothing is reported: returns 0, leaving the last revision in
+ * place, when the source has an error or options ask for what this does
+ * not do (include resolution), and the caller then translates it the usual
+ * way, which reports the errors.
+ */
+int revision_translate(Revision* revision, Compiler* compiler, const char* data, size_t length,
+                       const char* name, const CompileOptions* options, CompileStats* stats);
+
+#endif /* REVISION_H */
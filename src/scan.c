@@ -0,0 +1,317 @@
+#include <stdint.h>
+
+#include "scan.h"
+
+/*
+ * Vector back-ends. Each provides a 16-byte ScanVector, byte-wise compares
+ * that set matching bytes to all ones, and vector_mask(), which packs a
+ * compare result into an integer with (1 << SCAN_MASK_SHIFT) bits per byte,
+ * lowest address in the lowest bits.
+ */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCAN_VECTOR 1
+#define SCAN_MASK_SHIFT 0
+#define SCAN_FULL_MASK 0xFFFFu
+
+typedef __m128i ScanVector;
+
+static ScanVector vector_load(const char* text) {
+    return _mm_loadu_si128((const __m128i*)(const void*)text);
+}
+
+static ScanVector vector_equal(ScanVector v, char c) {
+    return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+}
+
+/* Unsigned lo <= v <= hi: move lo to -128 so one signed compare does it */
+static ScanVector vector_in_range(ScanVector v, unsigned char lo, unsigned char hi) {
+    ScanVector shifted = _mm_add_epi8(v, _mm_set1_epi8((char)(0x80 - lo)));
+    return _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(0x80 + (hi - lo) + 1)));
+}
+
+static ScanVector vector_or(ScanVector a, ScanVector b) {
+    return _mm_or_si128(a, b);
+}
+
+static ScanVector vector_and(ScanVector a, ScanVector b) {
+    return _mm_and_si128(a, b);
+}
+
+static ScanVector vector_or_byte(ScanVector v, char c) {
+    return _mm_or_si128(v, _mm_set1_epi8(c));
+}
+
+static uint64_t vector_mask(ScanVector v) {
+    return (uint64_t)(unsigned int)_mm_movemask_epi8(v);
+}
+
+/* One bit per byte, which vector_mask already is */
+static uint64_t vector_bits(ScanVector v) {
+    return vector_mask(v);
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define SCAN_VECTOR 1
+#define SCAN_MASK_SHIFT 2
+#define SCAN_FULL_MASK UINT64_MAX
+
+typedef uint8x16_t ScanVector;
+
+static ScanVector vector_load(const char* text) {
+    return vld1q_u8((const uint8_t*)text);
+}
+
+static ScanVector vector_equal(ScanVector v, char c) {
+    return vceqq_u8(v, vdupq_n_u8((uint8_t)c));
+}
+
+static ScanVector vector_in_range(ScanVector v, unsigned char lo, unsigned char hi) {
+    return vandq_u8(vcgeq_u8(v, vdupq_n_u8(lo)), vcleq_u8(v, vdupq_n_u8(hi)));
+}
+
+static ScanVector vector_or(ScanVector a, ScanVector b) {
+    return vorrq_u8(a, b);
+}
+
+static ScanVector vector_and(ScanVector a, ScanVector b) {
+    return vandq_u8(a, b);
+}
+
+static ScanVector vector_or_byte(ScanVector v, char c) {
+    return vorrq_u8(v, vdupq_n_u8((uint8_t)c));
+}
+
+/* NEON has no movemask; narrowing keeps four bits of every byte */
+static uint64_t vector_mask(ScanVector v) {
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(v), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+}
+
+/* One bit per byte: weight each half's bytes by their bit and add them up */
+static uint64_t vector_bits(ScanVector v) {
+    static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint64x2_t sums = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(vandq_u8(v, vld1q_u8(weights)))));
+    return vgetq_lane_u64(sums, 0) | (vgetq_lane_u64(sums, 1) << 8);
+}
+#endif
+
+#define SCAN_WIDTH 16
+
+
+/* Bit helpers; masks passed to lowest_bit and highest_bit are nonzero */
+#ifdef SCAN_VECTOR
+#if defined(__GNUC__) || defined(__clang__)
+static int lowest_bit(uint64_t mask) {
+    return __builtin_ctzll(mask);
+}
+
+static int highest_bit(uint64_t mask) {
+    return 63 - __builtin_clzll(mask);
+}
+
+static int bit_count(uint64_t mask) {
+    return __builtin_popcountll(mask);
+}
+#else
+static int lowest_bit(uint64_t mask) {
+    int bit = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        bit++;
+    }
+    return bit;
+}
+
+static int highest_bit(uint64_t mask) {
+    int bit = 0;
+    while (mask >>= 1) {
+        bit++;
+    }
+    return bit;
+}
+
+static int bit_count(uint64_t mask) {
+    mask = mask - ((mask >> 1) & 0x5555555555555555ULL);
+    mask = (mask & 0x3333333333333333ULL) + ((mask >> 2) & 0x3333333333333333ULL);
+    mask = (mask + (mask >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((mask * 0x0101010101010101ULL) >> 56);
+}
+#endif
+
+/* Offset of the first matching byte */
+static size_t first_byte(uint64_t mask) {
+    return (size_t)(lowest_bit(mask) >> SCAN_MASK_SHIFT);
+}
+#endif
+
+/* Scalar classification, used for tails and without a vector unit */
+
+static int is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static int is_letter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static int is_identifier_byte(char c) {
+    return is_letter(c) || (c >= '0' && c <= '9') || c == '_';
+}
+
+/* Bytes of English words: identifier bytes and those of UTF-8 sequences */
+static int is_word_byte(char c) {
+    return is_identifier_byte(c) || (unsigned char)c >= 0x80;
+}
+
+static int is_mark(char c) {
+    return (unsigned char)c >= SCAN_MARK_FIRST && (unsigned char)c <= SCAN_MARK_LAST;
+}
+
+/* Scanning */
+
+size_t scan_skip_blanks(const char* text, size_t from, size_t end) {
+    size_t i = from;
+#ifdef SCAN_VECTOR
+    for (; i + SCAN_WIDTH <= end; i += SCAN_WIDTH) {
+        ScanVector v = vector_load(text + i);
+        ScanVector blank = vector_or(vector_or(vector_equal(v, ' '), vector_equal(v, '\t')),
+                                     vector_or(vector_equal(v, '\r'), vector_equal(v, '\n')));
+        uint64_t mask = vector_mask(blank) ^ SCAN_FULL_MASK;
+        if (mask) return i + first_byte(mask);
+    }
+#endif
+    while (i < end && is_blank(text[i])) i++;
+    return i;
+}
+
+size_t scan_identifier_end(const char* text, size_t from, size_t end) {
+    size_t i = from;
+#ifdef SCAN_VECTOR
+    for (; i + SCAN_WIDTH <= end; i += SCAN_WIDTH) {
+        ScanVector v = vector_load(text + i);
+        ScanVector letter = vector_in_range(vector_or_byte(v, 0x20), 'a', 'z');
+        ScanVector digit = vector_in_range(v, '0', '9');
+        ScanVector word = vector_or(vector_or(letter, digit), vector_equal(v, '_'));
+        uint64_t mask = vector_mask(word) ^ SCAN_FULL_MASK;
+        if (mask) return i + first_byte(mask);
+    }
+#endif
+    while (i < end && is_identifier_byte(text[i])) i++;
+    return i;
+}
+
+size_t scan_digits_end(const char* text, size_t from, size_t end) {
+    size_t i = from;
+#ifdef SCAN_VECTOR
+    for (; i + SCAN_WIDTH <= end; i += SCAN_WIDTH) {
+        uint64_t mask = vector_mask(vector_in_range(vector_load(text + i), '0', '9')) ^ SCAN_FULL_MASK;
+        if (mask) return i + first_byte(mask);
+    }
+#endif
+    while (i < end && text[i] >= '0' && text[i] <= '9') i++;
+    return i;
+}
+
+size_t scan_find_byte(const char* text, size_t from, size_t end, char c) {
+    size_t i = from;
+#ifdef SCAN_VECTOR
+    for (; i + SCAN_WIDTH <= end; i += SCAN_WIDTH) {
+        uint64_t mask = vector_mask(vector_equal(vector_load(text + i), c));
+        if (mask) return i + first_byte(mask);
+    }
+#endif
+    while (i < end && text[i] != c) i++;
+    return i;
+}
+
+size_t scan_find_quote(const char* text, size_t from, size_t end, char quote) {
+    size_t i = from;
+#ifdef SCAN_VECTOR
+    for (; i + SCAN_WIDTH <= end; i += SCAN_WIDTH) {
+        ScanVector v = vector_load(text + i);
+        uint64_t mask = vector_mask(vector_or(vector_equal(v, quote), vector_equal(v, '\\')));
+        if (mask) return i + first_byte(mask);
+    }
+#endif
+    while (i < end && text[i] != quote && text[i] != '\\') i++;
+    return i;
+}
+
+uint64_t scan_word_starts(const char* text, size_t from, size_t end) {
+    uint64_t starts = 0;
+    uint64_t after = from > 0 && is_word_byte(text[from - 1]);
+    size_t count = end - from < SCAN_WORD_SPAN ? end - from : SCAN_WORD_SPAN;
+    size_t k = 0;
+#ifdef SCAN_VECTOR
+    for (; k + SCAN_WIDTH <= count; k += SCAN_WIDTH) {
+        ScanVector v = vector_load(text + from + k);
+        ScanVector letter = vector_in_range(vector_or_byte(v, 0x20), 'a', 'z');
+        ScanVector word = vector_or(vector_or(letter, vector_in_range(v, '0', '9')),
+                                    vector_or(vector_equal(v, '_'), vector_in_range(v, 0x80, 0xFF)));
+        uint64_t word_bits = vector_bits(word);
+        uint64_t after_bits = ((word_bits << 1) | after) & 0xFFFFu;
+        uint64_t opening = vector_bits(letter) & ~after_bits;
+        starts |= (opening | vector_bits(vector_in_range(v, SCAN_MARK_FIRST, SCAN_MARK_LAST))) << k;
+        after = word_bits >> (SCAN_WIDTH - 1);
+    }
+#endif
+    for (; k < count; k++) {
+        char c = text[from + k];
+        if (is_mark(c) || (!after && is_letter(c))) starts |= (uint64_t)1 << k;
+        after = is_word_byte(c);
+    }
+    return starts;
+}
+
+int scan_lowest_bit(uint64_t mask) {
+#ifdef SCAN_VECTOR
+    return lowest_bit(mask);
+#else
+    int bit = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+size_t scan_find_comment_end(const char* text, size_t from, size_t end) {
+    size_t i = from;
+#ifdef SCAN_VECTOR
+    /* Compare each byte and its successor, so stop one short of a full block */
+    for (; i + SCAN_WIDTH < end; i += SCAN_WIDTH) {
+        ScanVector star = vector_equal(vector_load(text + i), '*');
+        ScanVector slash = vector_equal(vector_load(text + i + 1), '/');
+        uint64_t mask = vector_mask(vector_and(star, slash));
+        if (mask) return i + first_byte(mask);
+    }
+#endif
+    for (; i + 1 < end; i++) {
+        if (text[i] == '*' && text[i + 1] == '/') return i;
+    }
+    return end;
+}
+
+size_t scan_count_newlines(const char* text, size_t from, size_t to, size_t* last) {
+    size_t count = 0;
+    size_t i = from;
+#ifdef SCAN_VECTOR
+    for (; i + SCAN_WIDTH <= to; i += SCAN_WIDTH) {
+        uint64_t mask = vector_mask(vector_equal(vector_load(text + i), '\n'));
+        if (mask) {
+            count += (size_t)(bit_count(mask) >> SCAN_MASK_SHIFT);
+            *last = i + (size_t)(highest_bit(mask) >> SCAN_MASK_SHIFT);
+        }
+    }
+#endif
+    for (; i < to; i++) {
+        if (text[i] == '\n') {
+            count++;
+            *last = i;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,59 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdint.h>
+
+#include "utils.h"
+
+/*
+ * Byte scanning for the lexer and the formatter. Each function looks at text[from, end) and
+ * returns the position of the first byte it is searching for, or end when
+ * there is none; nothing at or past end is read. SSE2 and NEON builds test
+ * 16 bytes per step and others fall back to a byte loop. Identifier bytes
+ * are ASCII letters, digits and '_', as in the C locale.
+ */
+
+/* First byte that is not ' ', '\t', '\r' or '\n' */
+size_t scan_skip_blanks(const char* text, size_t from, size_t end);
+
+/* First byte that cannot continue an identifier */
+size_t scan_identifier_end(const char* text, size_t from, size_t end);
+
+/* First byte that is not a decimal digit */
+size_t scan_digits_end(const char* text, size_t from, size_t end);
+
+/* First occurrence of c */
+size_t scan_find_byte(const char* text, size_t from, size_t end, char c);
+
+/* First quote or backslash, for scanning string and character literals */
+size_t scan_find_quote(const char* text, size_t from, size_t end, char quote);
+
+/* Bytes scan_word_starts covers per call */
+#define SCAN_WORD_SPAN 64
+
+/* The control bytes scan_word_starts also reports, which mark code in the formatter's input */
+#define SCAN_MARK_FIRST 0x0E
+#define SCAN_MARK_LAST 0x0F
+
+/*
+ * Where words start in English text, and its marks, as bits: bit k is set
+ * when text[from + k] is an ASCII letter not straight after a word byte (a
+ * letter, digit, '_' or byte past ASCII), or a mark. Covers SCAN_WORD_SPAN
+ * bytes, or up to end; the byte before from, when there is one, is read to
+ * tell whether text[from] follows a word.
+ */
+uint64_t scan_word_starts(const char* text, size_t from, size_t end);
+
+/* Position of the lowest set bit of a nonzero mask */
+int scan_lowest_bit(uint64_t mask);
+
+/* Start of the first "*" "/" pair, closing a block comment */
+size_t scan_find_comment_end(const char* text, size_t from, size_t end);
+
+/*
+ * Newlines in text[from, to); *last is set to the position of the last one
+ * when there are any and left alone otherwise.
+ */
+size_t scan_count_newlines(const char* text, size_t from, size_t to, size_t* last);
+
+#endif /* SCAN_H */
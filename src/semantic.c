@@ -1,68 +1,157 @@
 #include "semantic.h"
+#include "thread.h"
+
+/* Consecutive functions per thread, times this, make the chunks of a parallel check */
+#define SEMANTIC_CHUNKS_PER_THREAD 4
 
 /* Forward declarations */
-static void analyze_node(SemanticAnalyzer* analyzer, ASTNode* node);
-static void analyze_function(SemanticAnalyzer* analyzer, ASTNode* node);
-static void analyze_statement(SemanticAnalyzer* analyzer, ASTNode* node);
-static void analyze_expression(SemanticAnalyzer* analyzer, ASTNode* node);
+static void analyze_statement(SemanticAnalyzer* analyzer, ASTRef ref);
+static void analyze_expression(SemanticAnalyzer* analyzer, ASTRef ref);
 
 /* Semantic analyzer creation and destruction */
 
-SemanticAnalyzer* semantic_analyzer_create(const char* filename) {
+/* An analyzer over globals, or over a new globals table of its own when that is NULL */
+static SemanticAnalyzer* analyzer_create(const AST* ast, SymbolTable* globals, const char* filename,
+                                         Arena* arena, LineIndex* lines) {
     SemanticAnalyzer* analyzer = (SemanticAnalyzer*)safe_malloc(sizeof(SemanticAnalyzer));
-    analyzer->global_scope = symbol_table_create("global", NULL);
-    analyzer->current_scope = analyzer->global_scope;
+    analyzer->ast = ast;
+    analyzer->owns_globals = globals == NULL;
+    analyzer->globals = globals ? globals : symbol_table_create("global");
+    analyzer->locals = symbol_table_create("global");
+    analyzer->headers = NULL;
     analyzer->filename = filename;
+    analyzer->lines = lines;
+    analyzer->arena = arena;
+    analyzer->local_arena = arena;
+    analyzer->errors = NULL;
+    analyzer->error_count = 0;
+    analyzer->error_capacity = 0;
+    analyzer->current_function = 0;
     analyzer->had_error = 0;
+    analyzer->defer_calls = 0;
+    analyzer->deferred = NULL;
+    analyzer->deferred_count = 0;
+    analyzer->deferred_capacity = 0;
     return analyzer;
 }
 
+SemanticAnalyzer* semantic_analyzer_create(const AST* ast, const char* filename, Arena* arena,
+                                           LineIndex* lines) {
+    return analyzer_create(ast, NULL, filename, arena, lines);
+}
+
 void semantic_analyzer_destroy(SemanticAnalyzer* analyzer) {
-    if (!analyzer) return;
-
-    /* Destroy all symbol tables */
-    SymbolTable* current = analyzer->global_scope;
-    while (current) {
-        SymbolTable* parent = current->parent;
-        symbol_table_destroy(current);
-        current = parent;
+    /* Symbols and messages live in the arenas; only the tables are freed here */
+    if (analyzer->owns_globals) {
+        symbol_table_destroy(analyzer->globals);
     }
-
+    symbol_table_destroy(analyzer->locals);
+    free(analyzer->errors);
+    free(analyzer->deferred);
     free(analyzer);
 }
 
+int semantic_analyzer_symbol_count(const SemanticAnalyzer* analyzer) {
+    return analyzer->globals->symbol_count + analyzer->locals->symbol_count;
+}
+
 /* Error reporting */
 
-static void semantic_error(SemanticAnalyzer* analyzer, int line, const char* message) {
+/* Source line of a node, or 0 when it has no position */
+static int node_line(SemanticAnalyzer* analyzer, const ASTNode* node) {
+    if (!analyzer->lines) return 0;
+    return line_index_line(analyzer->lines, node->offset);
+}
+
+/* Errors are held until the whole check is done, so parallel checks can report in order */
+static void semantic_error_at(SemanticAnalyzer* analyzer, int offset, const char* message) {
     analyzer->had_error = 1;
-    fprintf(stderr, "[SEMANTIC ERROR] %s:%d: %s\n", analyzer->filename, line, message);
+
+    if (analyzer->error_count >= analyzer->error_capacity) {
+        analyzer->error_capacity = analyzer->error_capacity ? analyzer->error_capacity * 2 : 8;
+        analyzer->errors = (SemanticError*)safe_realloc(analyzer->errors,
+                                                        sizeof(SemanticError) * analyzer->error_capacity);
+    }
+    SemanticError* error = &analyzer->errors[analyzer->error_count++];
+    error->function = analyzer->current_function;
+    error->offset = offset;
+    error->message = arena_strdup(analyzer->arena, message);
+    error->callee = NULL;
+}
+
+/* Keep a call to a function that may be declared further down, with its error should it not be */
+static void defer_call(SemanticAnalyzer* analyzer, const ASTNode* node, const char* callee, const char* message) {
+    if (analyzer->deferred_count >= analyzer->deferred_capacity) {
+        analyzer->deferred_capacity = analyzer->deferred_capacity ? analyzer->deferred_capacity * 2 : 8;
+        analyzer->deferred = (SemanticError*)safe_realloc(analyzer->deferred,
+                                                          sizeof(SemanticError) * analyzer->deferred_capacity);
+    }
+    SemanticError* error = &analyzer->deferred[analyzer->deferred_count++];
+    error->function = analyzer->current_function;
+    error->offset = node->offset;
+    error->message = arena_strdup(analyzer->arena, message);
+    error->callee = callee;     /* Interned, as the globals table compares names by pointer */
+}
+
+static void semantic_error(SemanticAnalyzer* analyzer, const ASTNode* node, const char* message) {
+    semantic_error_at(analyzer, node->offset, message);
+}
+
+static void report_semantic_error(SemanticAnalyzer* analyzer, const SemanticError* error) {
+    int line = analyzer->lines ? line_index_line(analyzer->lines, error->offset) : 0;
+    diagnostic_printf("[SEMANTIC ERROR] %s:%d: %s\n", analyzer->filename, line, error->message);
+}
+
+/*
+ * Report the signature pass's errors and the body errors, each list already
+ * in source order, merged by function. A function with a signature error
+ * has no body errors, so the two never interleave within one function.
+ */
+static void report_merged(SemanticAnalyzer* analyzer, const SemanticError* signatures, int signature_count,
+                          const SemanticError* bodies, int body_count) {
+    int i = 0;
+    int j = 0;
+    while (i < signature_count || j < body_count) {
+        if (j == body_count || (i < signature_count && signatures[i].function <= bodies[j].function)) {
+            report_semantic_error(analyzer, &signatures[i++]);
+        } else {
+            report_semantic_error(analyzer, &bodies[j++]);
+        }
+    }
 }
 
 /* Scope management */
 
 static void enter_scope(SemanticAnalyzer* analyzer, const char* scope_name) {
-    SymbolTable* new_scope = symbol_table_create(scope_name, analyzer->current_scope);
-    analyzer->current_scope = new_scope;
+    symbol_table_enter_scope(analyzer->locals, scope_name);
 }
 
 static void exit_scope(SemanticAnalyzer* analyzer) {
-    if (analyzer->current_scope && analyzer->current_scope->parent) {
-        analyzer->current_scope = analyzer->current_scope->parent;
-    }
+    symbol_table_exit_scope(analyzer->locals);
+}
+
+/* The innermost visible symbol: a parameter or local, else a global */
+static Symbol* lookup_symbol(SemanticAnalyzer* analyzer, const char* name) {
+    Symbol* symbol = symbol_table_lookup(analyzer->locals, name);
+    if (!symbol) symbol = symbol_table_lookup(analyzer->globals, name);
+    return symbol ? symbol : symbol_table_lookup(analyzer->headers, name);
 }
 
 /* Analysis functions */
 
-static void analyze_expression(SemanticAnalyzer* analyzer, ASTNode* node) {
-    if (!node) return;
+static void analyze_expression(SemanticAnalyzer* analyzer, ASTRef ref) {
+    if (ref == AST_NONE) return;
+
+    const AST* ast = analyzer->ast;
+    const ASTNode* node = AST_NODE(ast, ref);
 
     switch (node->type) {
         case NODE_IDENTIFIER: {
-            Symbol* symbol = symbol_table_lookup(analyzer->current_scope, node->data.identifier.name);
+            Symbol* symbol = lookup_symbol(analyzer, AST_TEXT(ast, node->data.identifier.name));
             if (!symbol) {
                 char error_msg[256];
-                snprintf(error_msg, sizeof(error_msg), "Undeclared variable '%s'", node->data.identifier.name);
-                semantic_error(analyzer, node->line, error_msg);
+                snprintf(error_msg, sizeof(error_msg), "Undeclared variable '%s'", AST_TEXT(ast, node->data.identifier.name));
+                semantic_error(analyzer, node, error_msg);
             }
             break;
         }
@@ -77,13 +166,17 @@ static void analyze_expression(SemanticAnalyzer* analyzer, ASTNode* node) {
             break;
 
         case NODE_FUNCTION_CALL: {
-            Symbol* symbol = symbol_table_lookup(analyzer->global_scope, node->data.function_call.name);
+            const char* name = AST_TEXT(ast, node->data.function_call.name);
+            Symbol* symbol = symbol_table_lookup(analyzer->globals, name);
+            if (!symbol) {
+                symbol = symbol_table_lookup(analyzer->headers, name);
+            }
             if (!symbol) {
                 /* Check if it's a standard library function */
                 const char* std_funcs[] = {"printf", "scanf", "strlen", "strcpy", "malloc", "free", NULL};
                 int is_std = 0;
                 for (int i = 0; std_funcs[i] != NULL; i++) {
-                    if (string_equals(node->data.function_call.name, std_funcs[i])) {
+                    if (string_equals(AST_TEXT(ast, node->data.function_call.name), std_funcs[i])) {
                         is_std = 1;
                         break;
                     }
@@ -91,28 +184,33 @@ static void analyze_expression(SemanticAnalyzer* analyzer, ASTNode* node) {
 
                 if (!is_std) {
                     char error_msg[256];
-                    snprintf(error_msg, sizeof(error_msg), "Undefined function '%s'", node->data.function_call.name);
-                    semantic_error(analyzer, node->line, error_msg);
+                    snprintf(error_msg, sizeof(error_msg), "Undefined function '%s'", AST_TEXT(ast, node->data.function_call.name));
+                    if (analyzer->defer_calls) {
+                        defer_call(analyzer, node, AST_TEXT(ast, node->data.function_call.name), error_msg);
+                    } else {
+                        semantic_error(analyzer, node, error_msg);
+                    }
                 }
             }
 
             /* Analyze arguments */
-            for (int i = 0; i < node->data.function_call.arg_count; i++) {
-                analyze_expression(analyzer, node->data.function_call.arguments[i]);
+            const uint32_t* arguments = AST_LIST_ITEMS(ast, node->data.function_call.arguments);
+            for (int i = 0; i < AST_LIST_COUNT(ast, node->data.function_call.arguments); i++) {
+                analyze_expression(analyzer, arguments[i]);
             }
             break;
         }
 
         case NODE_ARRAY_ACCESS: {
-            Symbol* symbol = symbol_table_lookup(analyzer->current_scope, node->data.array_access.name);
+            Symbol* symbol = lookup_symbol(analyzer, AST_TEXT(ast, node->data.array_access.name));
             if (!symbol) {
                 char error_msg[256];
-                snprintf(error_msg, sizeof(error_msg), "Undeclared array '%s'", node->data.array_access.name);
-                semantic_error(analyzer, node->line, error_msg);
+                snprintf(error_msg, sizeof(error_msg), "Undeclared array '%s'", AST_TEXT(ast, node->data.array_access.name));
+                semantic_error(analyzer, node, error_msg);
             } else if (!symbol->is_array) {
                 char error_msg[256];
-                snprintf(error_msg, sizeof(error_msg), "'%s' is not an array", node->data.array_access.name);
-                semantic_error(analyzer, node->line, error_msg);
+                snprintf(error_msg, sizeof(error_msg), "'%s' is not an array", AST_TEXT(ast, node->data.array_access.name));
+                semantic_error(analyzer, node, error_msg);
             }
             analyze_expression(analyzer, node->data.array_access.index);
             break;
@@ -132,27 +230,31 @@ static void analyze_expression(SemanticAnalyzer* analyzer, ASTNode* node) {
     }
 }
 
-static void analyze_statement(SemanticAnalyzer* analyzer, ASTNode* node) {
-    if (!node) return;
+static void analyze_statement(SemanticAnalyzer* analyzer, ASTRef ref) {
+    if (ref == AST_NONE) return;
+
+    const AST* ast = analyzer->ast;
+    const ASTNode* node = AST_NODE(ast, ref);
 
     switch (node->type) {
         case NODE_DECLARATION: {
             /* Check if variable already declared in current scope */
-            Symbol* existing = symbol_table_lookup_local(analyzer->current_scope, node->data.declaration.name);
+            Symbol* existing = symbol_table_lookup_local(analyzer->locals, AST_TEXT(ast, node->data.declaration.name));
             if (existing) {
                 char error_msg[256];
                 snprintf(error_msg, sizeof(error_msg), "Variable '%s' already declared in this scope",
-                        node->data.declaration.name);
-                semantic_error(analyzer, node->line, error_msg);
+                        AST_TEXT(ast, node->data.declaration.name));
+                semantic_error(analyzer, node, error_msg);
             } else {
                 Symbol* symbol = symbol_create(
-                    node->data.declaration.name,
-                    node->data.declaration.data_type,
-                    analyzer->current_scope->scope_name,
-                    node->line
+                    analyzer->local_arena,
+                    AST_TEXT(ast, node->data.declaration.name),
+                    AST_TEXT(ast, node->data.declaration.data_type),
+                    symbol_table_scope_name(analyzer->locals),
+                    node_line(analyzer, node)
                 );
-                symbol->is_array = node->data.declaration.is_array;
-                symbol_table_insert(analyzer->current_scope, symbol);
+                symbol->is_array = node->flag;
+                symbol_table_insert(analyzer->locals, symbol);
             }
 
             /* Analyze initializer */
@@ -197,11 +299,13 @@ static void analyze_statement(SemanticAnalyzer* analyzer, ASTNode* node) {
             }
             break;
 
-        case NODE_BLOCK:
-            for (int i = 0; i < node->data.block.statement_count; i++) {
-                analyze_statement(analyzer, node->data.block.statements[i]);
+        case NODE_BLOCK: {
+            const uint32_t* statements = AST_LIST_ITEMS(ast, node->data.block.statements);
+            for (int i = 0; i < AST_LIST_COUNT(ast, node->data.block.statements); i++) {
+                analyze_statement(analyzer, statements[i]);
             }
             break;
+        }
 
         case NODE_BREAK:
         case NODE_CONTINUE:
@@ -210,42 +314,56 @@ static void analyze_statement(SemanticAnalyzer* analyzer, ASTNode* node) {
 
         default:
             /* Expression statements */
-            analyze_expression(analyzer, node);
+            analyze_expression(analyzer, ref);
             break;
     }
 }
 
-static void analyze_function(SemanticAnalyzer* analyzer, ASTNode* node) {
-    if (node->type != NODE_FUNCTION) return;
-
+/* Add a function to the globals, unless the name is taken; offset places the error */
+static int declare_signature(SemanticAnalyzer* analyzer, const char* name, const char* return_type,
+                             int offset, int line) {
     /* Check if function already declared */
-    Symbol* existing = symbol_table_lookup_local(analyzer->global_scope, node->data.function.name);
+    Symbol* existing = symbol_table_lookup(analyzer->globals, name);
     if (existing) {
         char error_msg[256];
-        snprintf(error_msg, sizeof(error_msg), "Function '%s' already declared", node->data.function.name);
-        semantic_error(analyzer, node->line, error_msg);
-        return;
+        snprintf(error_msg, sizeof(error_msg), "Function '%s' already declared", name);
+        semantic_error_at(analyzer, offset, error_msg);
+        return 0;
     }
 
     /* Add function to global scope */
-    Symbol* func_symbol = symbol_create(
-        node->data.function.name,
-        node->data.function.return_type,
-        "global",
-        node->line
-    );
+    Symbol* func_symbol = symbol_create(analyzer->arena, name, return_type, "global", line);
     func_symbol->is_function = 1;
-    symbol_table_insert(analyzer->global_scope, func_symbol);
+    symbol_table_insert(analyzer->globals, func_symbol);
+    return 1;
+}
+
+/* First pass: add a function to the globals; returns 0 if its body is not to be checked */
+static int declare_function(SemanticAnalyzer* analyzer, ASTRef ref) {
+    const AST* ast = analyzer->ast;
+    const ASTNode* node = AST_NODE(ast, ref);
+    if (node->type != NODE_FUNCTION) return 0;
+
+    return declare_signature(analyzer, AST_TEXT(ast, node->data.function.name),
+                             AST_TEXT(ast, node->data.function.return_type), node->offset,
+                             node_line(analyzer, node));
+}
+
+/* Second pass: check a declared function's body; globals are only read */
+static void check_function_body(SemanticAnalyzer* analyzer, ASTRef ref) {
+    const AST* ast = analyzer->ast;
+    const ASTNode* node = AST_NODE(ast, ref);
 
     /* Enter function scope */
-    enter_scope(analyzer, node->data.function.name);
+    enter_scope(analyzer, AST_TEXT(ast, node->data.function.name));
 
     /* Add parameters to function scope */
-    for (int i = 0; i < node->data.function.param_count; i++) {
-        Parameter* param = node->data.function.parameters[i];
-        Symbol* param_symbol = symbol_create(param->name, param->type, node->data.function.name, node->line);
+    const uint32_t* params = AST_LIST_ITEMS(ast, node->data.function.parameters);
+    for (int i = 0; i < AST_LIST_COUNT(ast, node->data.function.parameters); i++) {
+        const Parameter* param = AST_PARAMETER(ast, params[i]);
+        Symbol* param_symbol = symbol_create(analyzer->local_arena, param->name, param->type, AST_TEXT(ast, node->data.function.name), node_line(analyzer, node));
         param_symbol->is_array = param->is_array;
-        symbol_table_insert(analyzer->current_scope, param_symbol);
+        symbol_table_insert(analyzer->locals, param_symbol);
     }
 
     /* Analyze function body */
@@ -255,30 +373,165 @@ static void analyze_function(SemanticAnalyzer* analyzer, ASTNode* node) {
     exit_scope(analyzer);
 }
 
-static void analyze_node(SemanticAnalyzer* analyzer, ASTNode* node) {
-    if (!node) return;
+/* Parallel body checks: each chunk is a run of consecutive functions with its own analyzer */
 
-    switch (node->type) {
-        case NODE_PROGRAM:
-            for (int i = 0; i < node->data.program.function_count; i++) {
-                analyze_function(analyzer, node->data.program.functions[i]);
-            }
-            break;
+typedef struct {
+    const uint32_t* functions;
+    const unsigned char* declared;
+    int function_count;
+    int chunk_count;
+    SemanticAnalyzer** workers;
+} BodyChecks;
 
-        default:
-            break;
+static int chunk_start(const BodyChecks* work, int chunk) {
+    return (int)((long long)work->function_count * chunk / work->chunk_count);
+}
+
+static void check_chunk(void* context, int chunk) {
+    BodyChecks* work = (BodyChecks*)context;
+    SemanticAnalyzer* worker = work->workers[chunk];
+    int end = chunk_start(work, chunk + 1);
+
+    for (int i = chunk_start(work, chunk); i < end; i++) {
+        if (!work->declared[i]) continue;
+        worker->current_function = i;
+        check_function_body(worker, work->functions[i]);
+    }
+}
+
+/* Check the bodies on threads threads and report every error in source order */
+static void check_bodies_parallel(SemanticAnalyzer* analyzer, const uint32_t* functions,
+                                  const unsigned char* declared, int count, int threads) {
+    BodyChecks work;
+    work.functions = functions;
+    work.declared = declared;
+    work.function_count = count;
+    work.chunk_count = threads * SEMANTIC_CHUNKS_PER_THREAD;
+    if (work.chunk_count > count) work.chunk_count = count;
+    work.workers = (SemanticAnalyzer**)safe_malloc(sizeof(SemanticAnalyzer*) * work.chunk_count);
+    for (int i = 0; i < work.chunk_count; i++) {
+        work.workers[i] = analyzer_create(analyzer->ast, analyzer->globals, analyzer->filename,
+                                          arena_create(0), analyzer->lines);
+        work.workers[i]->headers = analyzer->headers;
+    }
+
+    /* The line table is built on first use; build it now, before the threads share it */
+    if (analyzer->lines) {
+        line_index_line(analyzer->lines, 0);
+    }
+
+    parallel_for(work.chunk_count, threads, check_chunk, &work);
+
+    /* Chunks cover ascending runs of functions, so their errors concatenate in order */
+    int body_count = 0;
+    for (int i = 0; i < work.chunk_count; i++) {
+        body_count += work.workers[i]->error_count;
+    }
+    SemanticError* bodies = (SemanticError*)safe_malloc(sizeof(SemanticError) * (body_count + 1));
+    body_count = 0;
+    for (int i = 0; i < work.chunk_count; i++) {
+        SemanticAnalyzer* worker = work.workers[i];
+        if (worker->error_count > 0) {
+            memcpy(&bodies[body_count], worker->errors, sizeof(SemanticError) * worker->error_count);
+            body_count += worker->error_count;
+        }
+        analyzer->had_error |= worker->had_error;
+    }
+    report_merged(analyzer, analyzer->errors, analyzer->error_count, bodies, body_count);
+    free(bodies);
+
+    /* The locals tables' counts are folded into the caller's before they go */
+    for (int i = 0; i < work.chunk_count; i++) {
+        SemanticAnalyzer* worker = work.workers[i];
+        analyzer->locals->symbol_count += worker->locals->symbol_count;
+        Arena* arena = worker->arena;
+        semantic_analyzer_destroy(worker);
+        arena_destroy(arena);
     }
+    free(work.workers);
 }
 
-/* Main analysis function */
+/* Main analysis functions */
 
-int analyze_semantics(ASTNode* program, const char* filename) {
-    if (!program) return 0;
+int semantic_analyze_function(SemanticAnalyzer* analyzer, ASTRef function) {
+    if (declare_function(analyzer, function)) {
+        check_function_body(analyzer, function);
+    }
+
+    int success = analyzer->error_count == 0;
+    for (int i = 0; i < analyzer->error_count; i++) {
+        report_semantic_error(analyzer, &analyzer->errors[i]);
+    }
+    analyzer->error_count = 0;
+    return success;
+}
 
-    SemanticAnalyzer* analyzer = semantic_analyzer_create(filename);
-    analyze_node(analyzer, program);
+int semantic_report_deferred(SemanticAnalyzer* analyzer) {
+    int success = 1;
+    for (int i = 0; i < analyzer->deferred_count; i++) {
+        const SemanticError* error = &analyzer->deferred[i];
+        if (symbol_table_lookup(analyzer->globals, error->callee)) continue;
+
+        report_semantic_error(analyzer, error);
+        analyzer->had_error = 1;
+        success = 0;
+    }
+    analyzer->deferred_count = 0;
+    return success;
+}
+
+int semantic_declare_signature(SemanticAnalyzer* analyzer, const char* name, const char* return_type) {
+    return declare_signature(analyzer, name, return_type, -1, 0);
+}
+
+int semantic_declare_function(SemanticAnalyzer* analyzer, ASTRef function) {
+    return declare_function(analyzer, function);
+}
+
+void semantic_check_function(SemanticAnalyzer* analyzer, ASTRef function) {
+    check_function_body(analyzer, function);
+}
+
+int analyze_semantics(const AST* ast, ASTRef program, const char* filename, Arena* arena,
+                      LineIndex* lines, SymbolTable* headers, int jobs, int* symbol_count) {
+    if (program == AST_NONE) return 0;
+
+    const ASTNode* node = AST_NODE(ast, program);
+    if (node->type != NODE_PROGRAM) return 0;
+
+    SemanticAnalyzer* analyzer = semantic_analyzer_create(ast, filename, arena, lines);
+    analyzer->headers = headers;
+    const uint32_t* functions = AST_LIST_ITEMS(ast, node->data.program.functions);
+    int count = AST_LIST_COUNT(ast, node->data.program.functions);
+
+    /* Signatures first, in order, so the globals are complete before any body is checked */
+    unsigned char* declared = (unsigned char*)safe_malloc((size_t)count + 1);
+    for (int i = 0; i < count; i++) {
+        analyzer->current_function = i;
+        declared[i] = (unsigned char)declare_function(analyzer, functions[i]);
+    }
+
+    int threads = jobs > 0 ? jobs : thread_cpu_count();
+    if (threads > count) threads = count;
+
+    if (threads > 1) {
+        check_bodies_parallel(analyzer, functions, declared, count, threads);
+    } else {
+        int signature_count = analyzer->error_count;
+        for (int i = 0; i < count; i++) {
+            if (!declared[i]) continue;
+            analyzer->current_function = i;
+            check_function_body(analyzer, functions[i]);
+        }
+        report_merged(analyzer, analyzer->errors, signature_count,
+                      analyzer->errors + signature_count, analyzer->error_count - signature_count);
+    }
+    free(declared);
 
     int success = !analyzer->had_error;
+    if (symbol_count) {
+        *symbol_count = semantic_analyzer_symbol_count(analyzer);
+    }
     semantic_analyzer_destroy(analyzer);
 
     return success;
@@ -3,19 +3,88 @@
 
 #include "ast.h"
 #include "symbol_table.h"
+#include "line_index.h"
 
-/* Semantic analyzer structure */
+/* A semantic error waiting to be reported */
 typedef struct {
-    SymbolTable* current_scope;
-    SymbolTable* global_scope;
+    int function;       /* Index of the function it was found in, for source order */
+    int offset;         /* Resolved to a line only when reported */
+    const char* message;
+    const char* callee;     /* A deferred call's function (interned), declared or not by the end; else NULL */
+} SemanticError;
+
+/*
+ * Semantic analyzer. Function signatures go into globals in a first pass;
+ * bodies are then checked against them with a private table for parameters
+ * and locals, so several analyzers can check bodies at once over one shared,
+ * read-only globals table.
+ */
+typedef struct {
+    const AST* ast;
+    SymbolTable* globals;   /* Functions; only read while bodies are checked */
+    SymbolTable* locals;    /* Parameters and locals of the function being checked */
+    SymbolTable* headers;   /* Declarations from included headers, or NULL; only read */
+    int owns_globals;
     const char* filename;
+    LineIndex* lines;   /* Resolves node offsets in messages; may be NULL */
+    Arena* arena;       /* Owns the global symbols and pending messages */
+    Arena* local_arena; /* Owns parameters and locals; arena unless the caller sets another */
+    SemanticError* errors;
+    int error_count;
+    int error_capacity;
+    int current_function;   /* Index recorded with each error */
     int had_error;
+    int defer_calls;            /* Keep calls to undeclared functions until semantic_report_deferred */
+    SemanticError* deferred;
+    int deferred_count;
+    int deferred_capacity;
 } SemanticAnalyzer;
 
 /* Semantic analyzer functions */
-SemanticAnalyzer* semantic_analyzer_create(const char* filename);
+SemanticAnalyzer* semantic_analyzer_create(const AST* ast, const char* filename, Arena* arena,
+                                           LineIndex* lines);
 void semantic_analyzer_destroy(SemanticAnalyzer* analyzer);
 
-int analyze_semantics(ASTNode* program, const char* filename);
+/* Symbols declared so far, globals and locals alike */
+int semantic_analyzer_symbol_count(const SemanticAnalyzer* analyzer);
+
+/*
+ * Check a programme: every function is declared before any body is checked,
+ * so a call may name a function defined further down. Bodies are checked on
+ * up to jobs threads (0 = one per CPU, 1 = serially) and errors are reported
+ * in source order either way. lines (optional) gives line numbers for
+ * diagnostics, headers (optional) the names the programme's headers declare,
+ * and symbol_count (optional) receives the symbols declared.
+ */
+int analyze_semantics(const AST* ast, ASTRef program, const char* filename, Arena* arena,
+                      LineIndex* lines, SymbolTable* headers, int jobs, int* symbol_count);
+
+/*
+ * Check one function against the functions checked before it with the same
+ * analyzer, reporting its errors before returning; for callers that see a
+ * function at a time. With defer_calls set, a call to a function not yet
+ * declared is not an error here: it is kept, and semantic_report_deferred
+ * reports it after the last function if the callee never appeared, so the
+ * same programmes are accepted as by analyze_semantics. Nothing in
+ * local_arena is referenced once this returns. Returns 0 if this function
+ * had an error.
+ */
+int semantic_analyze_function(SemanticAnalyzer* analyzer, ASTRef function);
+
+/* Report the deferred calls whose functions were never declared, in source order; returns 0 if any */
+int semantic_report_deferred(SemanticAnalyzer* analyzer);
+
+/*
+ * The two passes of analyze_semantics a function at a time, for callers
+ * holding the trees of only some functions, such as the ones that changed
+ * since the last revision: declare every function, by its tree or by its
+ * name and return type alone (interned with the tree's text), then check
+ * the bodies wanted. Errors are
+ * kept in analyzer->errors, not reported. The declarations return 0 if the
+ * name was already declared.
+ */
+int semantic_declare_signature(SemanticAnalyzer* analyzer, const char* name, const char* return_type);
+int semantic_declare_function(SemanticAnalyzer* analyzer, ASTRef function);
+void semantic_check_function(SemanticAnalyzer* analyzer, ASTRef function);
 
 #endif /* SEMANTIC_H */
@@ -0,0 +1,287 @@
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#define _POSIX_C_SOURCE 200809L
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include <errno.h>
+#include <signal.h>
+
+#include "server.h"
+#include "output.h"
+#include "stats.h"
+
+/* Both ends of a connection, as file descriptors */
+typedef struct {
+    int input;
+    int output;
+} Channel;
+
+/* Reused across requests */
+typedef struct {
+    c2en_context* context;
+    char* request;
+    size_t request_capacity;
+    OutputBuilder* response;
+    unsigned long served;
+    int verbose;
+} ServerState;
+
+/* Set by SIGINT or SIGTERM on a socket server; a read or write they interrupt then gives up */
+static volatile sig_atomic_t stop_requested = 0;
+
+/* Channel I/O */
+
+static long read_some(int fd, void* buffer, size_t length) {
+#ifdef _WIN32
+    return (long)_read(fd, buffer, (unsigned int)(length > 0x40000000 ? 0x40000000 : length));
+#else
+    return (long)read(fd, buffer, length);
+#endif
+}
+
+static long write_some(int fd, const void* buffer, size_t length) {
+#ifdef _WIN32
+    return (long)_write(fd, buffer, (unsigned int)(length > 0x40000000 ? 0x40000000 : length));
+#else
+    return (long)write(fd, buffer, length);
+#endif
+}
+
+/* Read exactly length bytes: 1 when done, 0 if the input ended first, -1 on error */
+static int read_exact(const Channel* channel, void* buffer, size_t length) {
+    char* cursor = (char*)buffer;
+    while (length > 0) {
+        long got = read_some(channel->input, cursor, length);
+        if (got < 0 && errno == EINTR && !stop_requested) continue;
+        if (got < 0) return -1;
+        if (got == 0) return 0;
+        cursor += got;
+        length -= (size_t)got;
+    }
+    return 1;
+}
+
+static int write_all(void* context, const char* data, size_t length) {
+    const Channel* channel = (const Channel*)context;
+    while (length > 0) {
+        long put = write_some(channel->output, data, length);
+        if (put < 0 && errno == EINTR && !stop_requested) continue;
+        if (put <= 0) return 0;
+        data += put;
+        length -= (size_t)put;
+    }
+    return 1;
+}
+
+/* Requests */
+
+static int collect_output(void* context, const char* text, size_t length) {
+    output_append_length((OutputBuilder*)context, text, length);
+    return 1;
+}
+
+static int write_response(const Channel* channel, c2en_status status, const OutputBuilder* text,
+                          const char* diagnostics) {
+    unsigned char header[5];
+    header[0] = (unsigned char)status;
+    put_be32(header + 1, (uint32_t)text->length);
+
+    /* Lengths are 32-bit: serve_channel turns away a longer translation, and longer diagnostics are cut */
+    size_t diagnostic_length = strlen(diagnostics);
+    if (diagnostic_length > SERVE_MAX_RESPONSE) diagnostic_length = SERVE_MAX_RESPONSE;
+    unsigned char trailer[4];
+    put_be32(trailer, (uint32_t)diagnostic_length);
+
+    return write_all((void*)channel, (const char*)header, sizeof(header)) &&
+           output_builder_emit(text, write_all, (void*)channel) &&
+           write_all((void*)channel, (const char*)trailer, sizeof(trailer)) &&
+           write_all((void*)channel, diagnostics, diagnostic_length);
+}
+
+/* Answer requests until the client closes or a stop is requested; returns 0 if the connection broke */
+static int serve_channel(ServerState* state, const Channel* channel) {
+    for (;;) {
+        unsigned char header[4];
+        int got = read_exact(channel, header, sizeof(header));
+        if (got == 0 || stop_requested) return 1;
+        if (got < 0) {
+            log_message(LOG_ERROR, "Cannot read request");
+            return 0;
+        }
+
+        size_t length = get_be32(header);
+        if (length > SERVE_MAX_REQUEST) {
+            log_message(LOG_ERROR, "Request of %zu bytes exceeds the %u byte limit",
+                        length, SERVE_MAX_REQUEST);
+            return 0;
+        }
+        if (length > state->request_capacity) {
+            state->request = (char*)safe_realloc(state->request, length);
+            state->request_capacity = length;
+        }
+        if (length > 0 && read_exact(channel, state->request, length) != 1) {
+            if (stop_requested) return 1;
+            log_message(LOG_ERROR, "Connection closed before the end of a request");
+            return 0;
+        }
+
+        uint64_t start = stats_now();
+        output_builder_clear(state->response);
+        c2en_writer writer = { collect_output, state->response };
+        c2en_status status = c2en_translate_buffer(state->context, state->request, length, &writer);
+        const char* diagnostics = c2en_context_diagnostics(state->context);
+        char limit_message[128];
+        if (status == C2EN_OK && state->response->length > SERVE_MAX_RESPONSE) {
+            snprintf(limit_message, sizeof(limit_message),
+                     "[ERROR] Translation of %zu bytes exceeds the %lu byte response limit\n",
+                     state->response->length, (unsigned long)SERVE_MAX_RESPONSE);
+            diagnostics = limit_message;
+            status = C2EN_ERROR_WRITE;
+        }
+        if (status != C2EN_OK) {
+            output_builder_clear(state->response);
+        }
+
+        if (!write_response(channel, status, state->response, diagnostics)) {
+            if (stop_requested) return 1;
+            log_message(LOG_ERROR, "Cannot write response");
+            return 0;
+        }
+
+        state->served++;
+        if (state->verbose) {
+            log_message(LOG_INFO, "Request %lu: %zu bytes in, %zu bytes out, %s, %.3f ms",
+                        state->served, length, state->response->length,
+                        c2en_status_string(status), (double)(stats_now() - start) / 1e6);
+        }
+    }
+}
+
+/* Standard input and output */
+
+static int serve_stdio(ServerState* state) {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+    Channel channel = { _fileno(stdin), _fileno(stdout) };
+#else
+    Channel channel = { fileno(stdin), fileno(stdout) };
+#endif
+    return serve_channel(state, &channel) ? 0 : 1;
+}
+
+/* Unix socket */
+
+#ifdef _WIN32
+
+static int serve_socket(ServerState* state, const char* path) {
+    (void)state;
+    (void)path;
+    log_message(LOG_ERROR, "Option --socket is not supported on this platform");
+    return 1;
+}
+
+#else
+
+static void request_stop(int signal_number) {
+    (void)signal_number;
+    stop_requested = 1;
+}
+
+/* SIGINT and SIGTERM interrupt accept() and any read or write, so the socket file can be removed */
+static void install_signal_handlers(void) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_handler = request_stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    /* A client that goes away mid-response must not end the server */
+    action.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &action, NULL);
+}
+
+static int serve_socket(ServerState* state, const char* path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        log_message(LOG_ERROR, "Socket path is too long: %s", path);
+        return 1;
+    }
+    strcpy(address.sun_path, path);
+
+    /* Replace a socket left behind by an earlier server, but nothing else */
+    struct stat info;
+    if (stat(path, &info) == 0 && S_ISSOCK(info.st_mode)) {
+        unlink(path);
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 ||
+        bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(listener, 16) != 0) {
+        log_message(LOG_ERROR, "Cannot listen on socket %s: %s", path, strerror(errno));
+        if (listener >= 0) close(listener);
+        return 1;
+    }
+
+    install_signal_handlers();
+    if (state->verbose) {
+        log_message(LOG_INFO, "Listening on %s", path);
+    }
+
+    int result = 0;
+    while (!stop_requested) {
+        int connection = accept(listener, NULL, NULL);
+        if (connection < 0) {
+            if (errno == EINTR) continue;
+            log_message(LOG_ERROR, "Cannot accept connection: %s", strerror(errno));
+            result = 1;
+            break;
+        }
+
+        Channel channel = { connection, connection };
+        serve_channel(state, &channel);
+        close(connection);
+    }
+
+    close(listener);
+    unlink(path);
+    return result;
+}
+
+#endif
+
+/* Entry point */
+
+int run_server(const ServeOptions* options) {
+    ServerState state;
+    state.context = c2en_context_create(&options->library);
+    if (!state.context) {
+        log_message(LOG_ERROR, "Cannot create translation context");
+        return 1;
+    }
+    state.request = NULL;
+    state.request_capacity = 0;
+    state.response = output_builder_create();
+    state.served = 0;
+    state.verbose = options->verbose;
+
+    int result = options->socket_path ? serve_socket(&state, options->socket_path)
+                                      : serve_stdio(&state);
+
+    if (state.verbose) {
+        log_message(LOG_INFO, "Served %lu requests", state.served);
+    }
+    output_builder_destroy(state.response);
+    free(state.request);
+    c2en_context_destroy(state.context);
+    return result;
+}
@@ -0,0 +1,36 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "utils.h"
+#include "c2en.h"
+
+/*
+ * Resident translation server (--serve). One library context lives for the
+ * whole run, so its arena, interner and cache stay warm between requests.
+ *
+ * Framing, in both directions, uses 32-bit big-endian lengths:
+ *
+ *   request:  u32 length, source bytes
+ *   response: u8 status (c2en_status), u32 length, translation,
+ *             u32 length, diagnostics
+ *
+ * A connection carries any number of requests and ends when the client
+ * closes it. On a socket, connections are served one at a time.
+ */
+
+/* Largest request accepted; a bigger one closes the connection */
+#define SERVE_MAX_REQUEST (256u * 1024 * 1024)
+
+/* Largest translation a u32 length can frame; a longer one is answered with C2EN_ERROR_WRITE */
+#define SERVE_MAX_RESPONSE 0xFFFFFFFFu
+
+typedef struct {
+    const char* socket_path;    /* Listen on this Unix socket, or NULL for stdin/stdout */
+    int verbose;                /* Log each request to stderr */
+    c2en_options library;
+} ServeOptions;
+
+/* Serve until the input ends (stdin) or forever (socket); returns 0 on a clean exit */
+int run_server(const ServeOptions* options);
+
+#endif /* SERVER_H */
@@ -0,0 +1,135 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "source.h"
+
+#define SOURCE_READ_CHUNK (64 * 1024)
+
+/* Read a stream to the end into a heap buffer */
+static char* read_stream(FILE* file, size_t* length) {
+    size_t capacity = SOURCE_READ_CHUNK;
+    size_t used = 0;
+    char* data = (char*)safe_malloc(capacity);
+
+    for (;;) {
+        if (capacity - used < SOURCE_READ_CHUNK) {
+            capacity *= 2;
+            data = (char*)safe_realloc(data, capacity);
+        }
+
+        size_t read_size = fread(data + used, 1, capacity - used, file);
+        used += read_size;
+        if (read_size == 0) break;
+    }
+
+    if (ferror(file)) {
+        free(data);
+        return NULL;
+    }
+
+    *length = used;
+    return data;
+}
+
+#ifndef _WIN32
+
+/* Map a regular, non-empty file; returns NULL when mapping does not apply */
+static const char* map_file(const char* filename, size_t* length) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    /* The lexer makes one forward pass */
+    posix_madvise(data, (size_t)info.st_size, POSIX_MADV_SEQUENTIAL);
+
+    *length = (size_t)info.st_size;
+    return (const char*)data;
+}
+
+#endif
+
+/* Load filename, mapping it when map is set and the platform allows; text stops at a NUL */
+static SourceFile* load_source(const char* filename, int map, int text) {
+    SourceFile* source = (SourceFile*)safe_malloc(sizeof(SourceFile));
+    source->data = NULL;
+    source->length = 0;
+    source->mapped_length = 0;
+
+    int from_stdin = string_equals(filename, "-");
+
+#ifndef _WIN32
+    if (map && !from_stdin) {
+        source->data = map_file(filename, &source->mapped_length);
+        source->length = source->mapped_length;
+    }
+#else
+    (void)map;
+#endif
+
+    if (!source->data) {
+        FILE* file = from_stdin ? stdin : fopen(filename, text ? "r" : "rb");
+        if (!file) {
+            log_message(LOG_ERROR, "Cannot open file: %s", filename);
+            free(source);
+            return NULL;
+        }
+
+        source->data = read_stream(file, &source->length);
+        if (!from_stdin) fclose(file);
+
+        if (!source->data) {
+            log_message(LOG_ERROR, "Cannot read file: %s", filename);
+            free(source);
+            return NULL;
+        }
+    }
+
+    /* Text ends at the first NUL byte, as it always has */
+    const char* nul = text ? (const char*)memchr(source->data, '\0', source->length) : NULL;
+    if (nul) {
+        source->length = (size_t)(nul - source->data);
+    }
+
+    return source;
+}
+
+SourceFile* source_file_open(const char* filename) {
+    return load_source(filename, 1, 1);
+}
+
+SourceFile* source_file_read(const char* filename) {
+    return load_source(filename, 0, 1);
+}
+
+SourceFile* source_file_open_binary(const char* filename) {
+    return load_source(filename, 1, 0);
+}
+
+void source_file_close(SourceFile* source) {
+    if (!source) return;
+
+#ifndef _WIN32
+    if (source->mapped_length > 0) {
+        munmap((void*)source->data, source->mapped_length);
+        free(source);
+        return;
+    }
+#endif
+
+    free((void*)source->data);
+    free(source);
+}
@@ -0,0 +1,25 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include "utils.h"
+
+/*
+ * Source text for one compilation. Regular files are memory-mapped where the
+ * platform allows; pipes, stdin and everything on Windows are read into a
+ * heap buffer instead. The text is not NUL-terminated: use length.
+ */
+typedef struct {
+    const char* data;
+    size_t length;
+    size_t mapped_length;   /* Size of the mapping, 0 when data is heap memory */
+} SourceFile;
+
+/* Open filename, or standard input for "-"; NULL (with an error logged) on failure */
+SourceFile* source_file_open(const char* filename);
+/* As source_file_open, but always read into memory now rather than faulted in on first use */
+SourceFile* source_file_read(const char* filename);
+/* As source_file_open, for data rather than text: every byte is kept, NULs included */
+SourceFile* source_file_open_binary(const char* filename);
+void source_file_close(SourceFile* source);
+
+#endif /* SOURCE_H */
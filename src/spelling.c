@@ -0,0 +1,338 @@
+#include "spelling.h"
+#include "thread.h"
+
+#define SPELLING_INITIAL_STATES 256
+#define SPELLING_INITIAL_TEXT 1024
+
+/*
+ * Built-in spellings, as families sharing a stem: each ending in the
+ * '|'-separated list is added to both stems, an empty ending standing for
+ * the stem alone.
+ */
+typedef struct {
+    const char* american;
+    const char* british;
+    const char* endings;
+} SpellingFamily;
+
+#define IZE_ENDINGS "e|es|ed|ing|ation|ations|er|ers"
+#define YZE_ENDINGS "e|es|ed|ing|er|ers"
+#define DOUBLED_L_ENDINGS "ed|ing|er|ers"
+
+static const SpellingFamily spelling_families[] = {
+    /* -or and -our */
+    {"color", "colour", "|s|ed|ing|ful|less"},
+    {"favor", "favour", "|s|ed|ing|able|ite|ites"},
+    {"behavior", "behaviour", "|s|al"},
+    {"honor", "honour", "|s|ed|ing|able"},
+    {"labor", "labour", "|s|ed|ing|er|ers"},
+    {"neighbor", "neighbour", "|s|ing|hood|hoods"},
+    {"flavor", "flavour", "|s|ed|ing"},
+    {"humor", "humour", "|s|ed"},
+    {"rumor", "rumour", "|s|ed"},
+    {"vapor", "vapour", "|s"},
+    {"armor", "armour", "|s|ed"},
+    {"endeavor", "endeavour", "|s|ed|ing"},
+    {"harbor", "harbour", "|s|ed|ing"},
+
+    /* -ize and -ise */
+    {"initializ", "initialis", IZE_ENDINGS},
+    {"organiz", "organis", IZE_ENDINGS},
+    {"recogniz", "recognis", IZE_ENDINGS},
+    {"realiz", "realis", IZE_ENDINGS},
+    {"optimiz", "optimis", IZE_ENDINGS},
+    {"minimiz", "minimis", IZE_ENDINGS},
+    {"maximiz", "maximis", IZE_ENDINGS},
+    {"normaliz", "normalis", IZE_ENDINGS},
+    {"serializ", "serialis", IZE_ENDINGS},
+    {"synchroniz", "synchronis", IZE_ENDINGS},
+    {"finaliz", "finalis", IZE_ENDINGS},
+    {"customiz", "customis", IZE_ENDINGS},
+    {"prioritiz", "prioritis", IZE_ENDINGS},
+    {"summariz", "summaris", IZE_ENDINGS},
+    {"utiliz", "utilis", IZE_ENDINGS},
+    {"visualiz", "visualis", IZE_ENDINGS},
+    {"categoriz", "categoris", IZE_ENDINGS},
+    {"authoriz", "authoris", IZE_ENDINGS},
+    {"specializ", "specialis", IZE_ENDINGS},
+    {"standardiz", "standardis", IZE_ENDINGS},
+    {"memoriz", "memoris", IZE_ENDINGS},
+    {"memoiz", "memois", IZE_ENDINGS},
+    {"emphasiz", "emphasis", IZE_ENDINGS},
+    {"characteriz", "characteris", IZE_ENDINGS},
+    {"parameteriz", "parameteris", IZE_ENDINGS},
+    {"tokeniz", "tokenis", IZE_ENDINGS},
+    {"localiz", "localis", IZE_ENDINGS},
+    {"capitaliz", "capitalis", IZE_ENDINGS},
+    {"sanitiz", "sanitis", IZE_ENDINGS},
+    {"randomiz", "randomis", IZE_ENDINGS},
+    {"generaliz", "generalis", IZE_ENDINGS},
+    {"stabiliz", "stabilis", IZE_ENDINGS},
+    {"vectoriz", "vectoris", IZE_ENDINGS},
+    {"apologiz", "apologis", IZE_ENDINGS},
+    {"criticiz", "criticis", IZE_ENDINGS},
+
+    /* -yze and -yse */
+    {"analyz", "analys", YZE_ENDINGS},
+    {"paralyz", "paralys", YZE_ENDINGS},
+    {"catalyz", "catalys", YZE_ENDINGS},
+
+    /* -er and -re */
+    {"center", "centre", "|s"},
+    {"centered", "centred", ""},
+    {"centering", "centring", ""},
+    {"liter", "litre", "|s"},
+    {"fiber", "fibre", "|s"},
+    {"theater", "theatre", "|s"},
+    {"caliber", "calibre", "|s"},
+
+    /* -ense and -ence */
+    {"defense", "defence", "|s|less"},
+    {"offense", "offence", "|s"},
+    {"pretense", "pretence", "|s"},
+
+    /* -og and -ogue */
+    {"catalog", "catalogue", "|s"},
+    {"dialog", "dialogue", "|s"},
+
+    /* Doubled l before an ending */
+    {"model", "modell", DOUBLED_L_ENDINGS},
+    {"travel", "travell", DOUBLED_L_ENDINGS},
+    {"cancel", "cancell", DOUBLED_L_ENDINGS},
+    {"label", "labell", DOUBLED_L_ENDINGS},
+    {"signal", "signall", DOUBLED_L_ENDINGS},
+    {"fuel", "fuell", DOUBLED_L_ENDINGS},
+    {"total", "totall", DOUBLED_L_ENDINGS},
+    {"level", "levell", DOUBLED_L_ENDINGS},
+    {"channel", "channell", DOUBLED_L_ENDINGS},
+    {"counsel", "counsell", DOUBLED_L_ENDINGS},
+    {"tunnel", "tunnell", DOUBLED_L_ENDINGS},
+    {"marshal", "marshall", DOUBLED_L_ENDINGS},
+
+    /* Single words */
+    {"gray", "grey", "|s|ed|ing"},
+    {"program", "programme", "|s"},
+    {"artifact", "artefact", "|s"},
+    {"judgment", "judgement", "|s"},
+    {"acknowledgment", "acknowledgement", "|s"},
+    {"enroll", "enrol", "|s"},
+    {"enrollment", "enrolment", "|s"},
+    {"fulfill", "fulfil", "|s"},
+    {"fulfillment", "fulfilment", ""},
+    {"skeptical", "sceptical", ""},
+    {"aging", "ageing", ""},
+    {"maneuver", "manoeuvre", "|s"},
+    {"aluminum", "aluminium", ""},
+    {"math", "maths", ""},
+    {"jewelry", "jewellery", ""},
+    {"plow", "plough", "|s|ed|ing"},
+    {"cozy", "cosy", ""},
+    {NULL, NULL, NULL}
+};
+
+/* Building */
+
+/* A state no word ends in yet, leading nowhere but the dead state */
+static int add_state(SpellingDictionary* dictionary) {
+    if (dictionary->state_count == dictionary->state_capacity) {
+        dictionary->state_capacity *= 2;
+        dictionary->states = (SpellingState*)safe_realloc(dictionary->states,
+                                                          sizeof(SpellingState) * dictionary->state_capacity);
+        dictionary->next = (int*)safe_realloc(dictionary->next,
+                                              sizeof(int) * SPELLING_COLUMNS * dictionary->state_capacity);
+    }
+    int state = dictionary->state_count++;
+    dictionary->states[state].replacement = -1;
+    dictionary->states[state].replacement_length = 0;
+
+    int* row = dictionary->next + (size_t)state * SPELLING_COLUMNS;
+    for (int column = 0; column < SPELLING_COLUMNS; column++) {
+        row[column] = SPELLING_DEAD;
+    }
+    return state;
+}
+
+/* The state after letter (0 to 25) from parent, added if missing */
+static int child_state(SpellingDictionary* dictionary, int parent, int letter) {
+    int row = dictionary->next[(size_t)parent * SPELLING_COLUMNS + letter];
+    if (row != SPELLING_DEAD) return row / SPELLING_COLUMNS;
+
+    int child = add_state(dictionary);
+    dictionary->next[(size_t)parent * SPELLING_COLUMNS + letter] = child * SPELLING_COLUMNS;
+    return child;
+}
+
+static int add_text(SpellingDictionary* dictionary, const char* text, size_t length) {
+    if (dictionary->text_length + length > dictionary->text_capacity) {
+        while (dictionary->text_length + length > dictionary->text_capacity) {
+            dictionary->text_capacity *= 2;
+        }
+        dictionary->text = (char*)safe_realloc(dictionary->text, dictionary->text_capacity);
+    }
+    memcpy(dictionary->text + dictionary->text_length, text, length);
+    int offset = (int)dictionary->text_length;
+    dictionary->text_length += length;
+    return offset;
+}
+
+int spelling_dictionary_add(SpellingDictionary* dictionary, const char* american, size_t american_length,
+                            const char* british, size_t british_length) {
+    if (american_length == 0) return 0;
+    for (size_t i = 0; i < american_length; i++) {
+        char c = american[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))) return 0;
+    }
+
+    int letters[3] = { SPELLING_DIGIT, SPELLING_DIGIT, SPELLING_DIGIT };
+    int state = 0;
+    for (size_t i = 0; i < american_length; i++) {
+        char c = american[i];
+        int letter = c >= 'a' ? c - 'a' : c - 'A';
+        if (i < 3) letters[i] = letter;
+        state = child_state(dictionary, state, letter);
+    }
+    int prefix = SPELLING_PREFIX(letters[0], letters[1], letters[2]);
+    dictionary->prefixes[prefix / 8] |= (unsigned char)(1u << (prefix % 8));
+    if (dictionary->states[state].replacement < 0) {
+        dictionary->entry_count++;
+    }
+    dictionary->states[state].replacement = add_text(dictionary, british, british_length);
+    dictionary->states[state].replacement_length = (int)british_length;
+
+    dictionary->digest = fnv1a_64(dictionary->digest, american, american_length);
+    dictionary->digest = fnv1a_64(dictionary->digest, "", 1);
+    dictionary->digest = fnv1a_64(dictionary->digest, british, british_length);
+    dictionary->digest = fnv1a_64(dictionary->digest, "", 1);
+    return 1;
+}
+
+/* Add a family's stems with each of its endings */
+static void add_family(SpellingDictionary* dictionary, const SpellingFamily* family) {
+    char american[64];
+    char british[64];
+    size_t american_stem = strlen(family->american);
+    size_t british_stem = strlen(family->british);
+    memcpy(american, family->american, american_stem);
+    memcpy(british, family->british, british_stem);
+
+    const char* ending = family->endings;
+    for (;;) {
+        const char* bar = strchr(ending, '|');
+        size_t length = bar ? (size_t)(bar - ending) : strlen(ending);
+        memcpy(american + american_stem, ending, length);
+        memcpy(british + british_stem, ending, length);
+        spelling_dictionary_add(dictionary, american, american_stem + length, british, british_stem + length);
+        if (!bar) break;
+        ending = bar + 1;
+    }
+}
+
+SpellingDictionary* spelling_dictionary_create(void) {
+    SpellingDictionary* dictionary = (SpellingDictionary*)safe_malloc(sizeof(SpellingDictionary));
+    dictionary->state_capacity = SPELLING_INITIAL_STATES;
+    dictionary->states = (SpellingState*)safe_malloc(sizeof(SpellingState) * dictionary->state_capacity);
+    dictionary->next = (int*)safe_malloc(sizeof(int) * SPELLING_COLUMNS * dictionary->state_capacity);
+    dictionary->state_count = 0;
+    dictionary->text_capacity = SPELLING_INITIAL_TEXT;
+    dictionary->text = (char*)safe_malloc(dictionary->text_capacity);
+    dictionary->text_length = 0;
+    dictionary->entry_count = 0;
+    dictionary->digest = FNV1A_64_BASIS;
+    memset(dictionary->prefixes, 0, sizeof(dictionary->prefixes));
+    add_state(dictionary);
+    add_state(dictionary);
+
+    for (int i = 0; spelling_families[i].american != NULL; i++) {
+        add_family(dictionary, &spelling_families[i]);
+    }
+    return dictionary;
+}
+
+void spelling_dictionary_destroy(SpellingDictionary* dictionary) {
+    if (!dictionary) return;
+    free(dictionary->next);
+    free(dictionary->states);
+    free(dictionary->text);
+    free(dictionary);
+}
+
+/* Dictionary files */
+
+static int is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+int spelling_dictionary_load(SpellingDictionary* dictionary, const char* filename) {
+    char* content = read_file(filename);
+    if (!content) return 0;
+
+    int ok = 1;
+    int line = 1;
+    const char* cursor = content;
+    while (*cursor) {
+        const char* end = strchr(cursor, '\n');
+        if (!end) end = cursor + strlen(cursor);
+        const char* stop = memchr(cursor, '#', (size_t)(end - cursor));
+        if (!stop) stop = end;
+
+        /* Up to two words, then nothing */
+        const char* words[2];
+        size_t lengths[2];
+        int count = 0;
+        const char* p = cursor;
+        for (;;) {
+            while (p < stop && is_blank(*p)) p++;
+            if (p == stop) break;
+            const char* word = p;
+            while (p < stop && !is_blank(*p)) p++;
+            if (count == 2) {
+                count = 3;
+                break;
+            }
+            words[count] = word;
+            lengths[count] = (size_t)(p - word);
+            count++;
+        }
+
+        if (count == 1 || count == 3) {
+            log_message(LOG_ERROR, "%s:%d: expected an American and a British spelling", filename, line);
+            ok = 0;
+            break;
+        }
+        if (count == 2 && !spelling_dictionary_add(dictionary, words[0], lengths[0], words[1], lengths[1])) {
+            log_message(LOG_ERROR, "%s:%d: '%.*s' is not a word", filename, line, (int)lengths[0], words[0]);
+            ok = 0;
+            break;
+        }
+
+        if (!*end) break;
+        cursor = end + 1;
+        line++;
+    }
+
+    free(content);
+    return ok;
+}
+
+/* The built-in dictionary */
+
+static SpellingDictionary* default_dictionary = NULL;
+static ThreadOnce default_dictionary_once = THREAD_ONCE_INIT;
+
+static void build_default_dictionary(void) {
+    default_dictionary = spelling_dictionary_create();
+}
+
+const SpellingDictionary* spelling_dictionary_default(void) {
+    thread_once(&default_dictionary_once, build_default_dictionary);
+    return default_dictionary;
+}
+
+/* Matching */
+
+const char* spelling_replacement(const SpellingDictionary* dictionary, int row, size_t* length) {
+    const SpellingState* entry = &dictionary->states[row / SPELLING_COLUMNS];
+    if (entry->replacement < 0) return NULL;
+    *length = (size_t)entry->replacement_length;
+    return dictionary->text + entry->replacement;
+}
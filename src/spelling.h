@@ -0,0 +1,82 @@
+#ifndef SPELLING_H
+#define SPELLING_H
+
+#include <stdint.h>
+
+#include "utils.h"
+
+/* Letters the automaton moves on: a to z, whatever their case */
+#define SPELLING_ALPHABET 26
+
+/* Columns of the transition table: a letter's place in the alphabet, or this for other word bytes */
+#define SPELLING_DIGIT SPELLING_ALPHABET
+#define SPELLING_COLUMNS (SPELLING_ALPHABET + 1)
+
+/* Rows of the root, where words start, and of a word that cannot match */
+#define SPELLING_ROOT 0
+#define SPELLING_DEAD SPELLING_COLUMNS
+
+/*
+ * Words' first three letters (SPELLING_DIGIT past a word's end) as one
+ * number, the index of a bit in the prefix filter; a word whose bit is
+ * clear cannot match.
+ */
+#define SPELLING_PREFIX(a, b, c) (((a) * SPELLING_COLUMNS + (b)) * SPELLING_COLUMNS + (c))
+#define SPELLING_PREFIX_BYTES ((SPELLING_COLUMNS * SPELLING_COLUMNS * SPELLING_COLUMNS + 7) / 8)
+
+/* A state of the automaton */
+typedef struct {
+    int replacement;    /* Offset of the British spelling in text, or -1 unless a word ends here */
+    int replacement_length;
+} SpellingState;
+
+/*
+ * American-to-British spelling dictionary, compiled into an automaton that
+ * reads a word a byte at a time. Words only ever match whole, so a match
+ * can only start at a word's first letter and the automaton needs no
+ * failure transitions: a byte that no word continues with leads to the dead
+ * state for the rest of the word. Each byte costs one lookup in the table
+ * of transitions, and most words are never walked at all because the
+ * prefix filter rules them out from their first three letters, so matching
+ * costs the same however many words it holds. Read-only once built, and so
+ * shared by every thread.
+ */
+typedef struct {
+    int* next;          /* SPELLING_COLUMNS transitions per state, each the row (state times */
+                        /* SPELLING_COLUMNS) of the state moved to */
+    SpellingState* states;
+    int state_count;
+    int state_capacity;
+    unsigned char prefixes[SPELLING_PREFIX_BYTES];  /* Bit SPELLING_PREFIX(...) set for each word's prefix */
+    char* text;         /* British spellings, back to back */
+    size_t text_length;
+    size_t text_capacity;
+    int entry_count;
+    uint64_t digest;    /* Hash of every entry in order, for translation cache keys */
+} SpellingDictionary;
+
+/* Dictionary creation (with the built-in spellings) and destruction */
+SpellingDictionary* spelling_dictionary_create(void);
+void spelling_dictionary_destroy(SpellingDictionary* dictionary);
+
+/*
+ * Map american (letters only, matched in any case) to british, replacing an
+ * earlier mapping of the same word. Returns 0 if american is not a word.
+ */
+int spelling_dictionary_add(SpellingDictionary* dictionary, const char* american, size_t american_length,
+                            const char* british, size_t british_length);
+
+/*
+ * Add the pairs in a dictionary file: one "american british" pair per line,
+ * blank lines and text after '#' ignored. Returns 0, having reported the
+ * problem, if the file cannot be read or a line is not a pair.
+ */
+int spelling_dictionary_load(SpellingDictionary* dictionary, const char* filename);
+
+/* The built-in dictionary, built on first use and never freed */
+const SpellingDictionary* spelling_dictionary_default(void);
+
+/* The British spelling of the word ending in the state at row, or NULL if none does */
+const char* spelling_replacement(const SpellingDictionary* dictionary, int row, size_t* length);
+
+#endif /* SPELLING_H */
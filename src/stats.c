@@ -0,0 +1,196 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+#include "stats.h"
+
+static const char* const phase_names[PHASE_COUNT] = {
+    "read",
+    "parse",
+    "semantic",
+    "translate",
+    "format",
+};
+
+/* Clock and process memory */
+
+uint64_t stats_now(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+           (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ULL / (uint64_t)frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+#endif
+}
+
+size_t stats_peak_rss(void) {
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss;
+#else
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+/* Collecting */
+
+void compile_stats_begin(CompileStats* stats) {
+    memset(stats, 0, sizeof(CompileStats));
+    stats->start = stats_now();
+}
+
+void compile_stats_end(CompileStats* stats) {
+    stats->duration = stats_now() - stats->start;
+}
+
+void compile_stats_phase_begin(CompileStats* stats, CompilePhase phase) {
+    uint64_t now = stats_now();
+    if (!stats->phase_ran[phase]) {
+        stats->phase_start[phase] = now;
+    }
+    stats->phase_resumed[phase] = now;
+    stats->phase_ran[phase] = 1;
+}
+
+void compile_stats_phase_end(CompileStats* stats, CompilePhase phase) {
+    stats->phase_duration[phase] += stats_now() - stats->phase_resumed[phase];
+}
+
+/* Reporting */
+
+static double milliseconds(uint64_t nanoseconds) {
+    return (double)nanoseconds / 1e6;
+}
+
+void compile_stats_report(const CompileStats* stats, const char* input_file) {
+    OutputBuilder* report = output_builder_create();
+
+    output_appendf(report, "[STATS] %s%s\n", input_file, stats->cached ? " (cached)" : "");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        if (!stats->phase_ran[i]) continue;
+        output_appendf(report, "  %-12s %10.3f ms\n", phase_names[i], milliseconds(stats->phase_duration[i]));
+    }
+    output_appendf(report, "  %-12s %10.3f ms\n", "total", milliseconds(stats->duration));
+
+    if (!stats->cached) {
+        output_appendf(report, "  tokens %zu, nodes %zu, symbols %zu\n",
+                       stats->tokens, stats->nodes, stats->symbols);
+    }
+    output_appendf(report, "  input %zu bytes, output %zu bytes, arena peak %zu bytes",
+                   stats->input_bytes, stats->output_bytes, stats->arena_bytes);
+    size_t peak_rss = stats_peak_rss();
+    if (peak_rss > 0) {
+        output_appendf(report, ", process peak RSS %zu bytes", peak_rss);
+    }
+    output_append_char(report, '\n');
+
+    /* One message, so batch workers keep it together */
+    char* text = output_builder_to_string(report);
+    diagnostic_printf("%s", text);
+    free(text);
+    output_builder_destroy(report);
+}
+
+/* Trace log */
+
+static THREAD_LOCAL int trace_thread_id = 0;
+
+TraceLog* trace_log_create(void) {
+    TraceLog* trace = (TraceLog*)safe_malloc(sizeof(TraceLog));
+    trace->origin = stats_now();
+    trace->events = output_builder_create();
+    trace->event_count = 0;
+    trace->thread_count = 0;
+    mutex_init(&trace->lock);
+    return trace;
+}
+
+void trace_log_destroy(TraceLog* trace) {
+    if (!trace) return;
+
+    mutex_destroy(&trace->lock);
+    output_builder_destroy(trace->events);
+    free(trace);
+}
+
+static void append_json_string(OutputBuilder* out, const char* text) {
+    output_append_char(out, '"');
+    for (const unsigned char* c = (const unsigned char*)text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            output_append_char(out, '\\');
+            output_append_char(out, (char)*c);
+        } else if (*c < 0x20) {
+            output_appendf(out, "\\u%04x", *c);
+        } else {
+            output_append_char(out, (char)*c);
+        }
+    }
+    output_append_char(out, '"');
+}
+
+/* Open one complete ("X") event; the caller adds args and closes it */
+static void begin_event(TraceLog* trace, const char* name, uint64_t start, uint64_t duration) {
+    OutputBuilder* out = trace->events;
+    output_append(out, trace->event_count++ ? ",\n" : "\n");
+    output_append(out, "{\"name\":");
+    append_json_string(out, name);
+    output_appendf(out, ",\"cat\":\"c2en\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d",
+                   (double)(start - trace->origin) / 1e3, (double)duration / 1e3, trace_thread_id);
+}
+
+void trace_log_add_compile(TraceLog* trace, const CompileStats* stats, const char* input_file) {
+    mutex_lock(&trace->lock);
+
+    if (trace_thread_id == 0) {
+        trace_thread_id = ++trace->thread_count;
+    }
+
+    OutputBuilder* out = trace->events;
+    begin_event(trace, "compile", stats->start, stats->duration);
+    output_append(out, ",\"args\":{\"file\":");
+    append_json_string(out, input_file);
+    output_appendf(out, ",\"cached\":%s,\"input_bytes\":%zu,\"output_bytes\":%zu",
+                   stats->cached ? "true" : "false", stats->input_bytes, stats->output_bytes);
+    if (!stats->cached) {
+        output_appendf(out, ",\"tokens\":%zu,\"nodes\":%zu,\"symbols\":%zu,\"arena_bytes\":%zu",
+                       stats->tokens, stats->nodes, stats->symbols, stats->arena_bytes);
+    }
+    output_append(out, "}}");
+
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        if (!stats->phase_ran[i]) continue;
+        begin_event(trace, phase_names[i], stats->phase_start[i], stats->phase_duration[i]);
+        output_append(out, "}");
+    }
+
+    mutex_unlock(&trace->lock);
+}
+
+int trace_log_write(TraceLog* trace, const char* filename) {
+    FILE* file = fopen(filename, "w");
+    if (!file) {
+        log_message(LOG_ERROR, "Cannot write to file: %s", filename);
+        return 0;
+    }
+
+    int ok = fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file) >= 0 &&
+             output_builder_write(trace->events, file) &&
+             fputs("\n]}\n", file) >= 0;
+    if (fclose(file) != 0) ok = 0;
+    return ok;
+}
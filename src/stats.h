@@ -0,0 +1,72 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+
+#include "utils.h"
+#include "output.h"
+#include "thread.h"
+
+/*
+ * Phases of one compilation. Tokens are pulled by the parser as it goes and
+ * formatted text is streamed to the output file, so lexing is timed with
+ * parsing and formatting with writing.
+ */
+typedef enum {
+    PHASE_READ,
+    PHASE_PARSE,        /* Tokenizing and parsing */
+    PHASE_SEMANTIC,
+    PHASE_TRANSLATE,
+    PHASE_FORMAT,       /* Formatting and writing the output */
+    PHASE_COUNT
+} CompilePhase;
+
+/* Timings and sizes for one compilation */
+typedef struct {
+    uint64_t start;                     /* Nanoseconds on the monotonic clock */
+    uint64_t duration;
+    uint64_t phase_start[PHASE_COUNT];      /* First entry to the phase */
+    uint64_t phase_duration[PHASE_COUNT];   /* Summed over every entry (streaming interleaves phases) */
+    uint64_t phase_resumed[PHASE_COUNT];    /* Latest entry */
+    int phase_ran[PHASE_COUNT];
+    int cached;                         /* Output came from the translation cache */
+    size_t input_bytes;
+    size_t output_bytes;
+    size_t tokens;
+    size_t nodes;
+    size_t symbols;
+    size_t arena_bytes;                 /* Arena high-water mark */
+} CompileStats;
+
+/* Clock and process memory */
+uint64_t stats_now(void);
+size_t stats_peak_rss(void);            /* Bytes; 0 where unsupported */
+
+/* Collecting */
+void compile_stats_begin(CompileStats* stats);
+void compile_stats_end(CompileStats* stats);
+void compile_stats_phase_begin(CompileStats* stats, CompilePhase phase);
+void compile_stats_phase_end(CompileStats* stats, CompilePhase phase);
+
+/* Write a per-phase report to the diagnostics stream */
+void compile_stats_report(const CompileStats* stats, const char* input_file);
+
+/*
+ * Chrome trace-event log (chrome://tracing, Perfetto). Events from every
+ * thread are collected under a lock and written out at the end of the run;
+ * each thread appears as its own track.
+ */
+typedef struct {
+    uint64_t origin;        /* Timestamps are relative to creation */
+    OutputBuilder* events;
+    int event_count;
+    int thread_count;
+    Mutex lock;
+} TraceLog;
+
+TraceLog* trace_log_create(void);
+void trace_log_destroy(TraceLog* trace);
+void trace_log_add_compile(TraceLog* trace, const CompileStats* stats, const char* input_file);
+int trace_log_write(TraceLog* trace, const char* filename);
+
+#endif /* STATS_H */
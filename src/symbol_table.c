@@ -1,50 +1,136 @@
 #include "symbol_table.h"
 
+#define SYMBOL_TABLE_INITIAL_CAPACITY 64
+#define SYMBOL_TABLE_INITIAL_SCOPES 8
+
+/* Marks a slot whose symbol went out of scope; probing continues past it */
+static Symbol tombstone_symbol;
+#define TOMBSTONE (&tombstone_symbol)
+
 /* Symbol table creation and destruction */
 
-SymbolTable* symbol_table_create(const char* scope_name, SymbolTable* parent) {
+SymbolTable* symbol_table_create(const char* global_scope_name) {
     SymbolTable* table = (SymbolTable*)safe_malloc(sizeof(SymbolTable));
-    table->head = NULL;
-    table->parent = parent;
-    table->scope_name = string_duplicate(scope_name);
+    table->capacity = SYMBOL_TABLE_INITIAL_CAPACITY;
+    table->used = 0;
+    table->slots = (Symbol**)calloc((size_t)table->capacity, sizeof(Symbol*));
+    if (!table->slots) {
+        log_message(LOG_ERROR, "Memory allocation failed");
+        memory_failure();
+    }
+
+    table->scope_capacity = SYMBOL_TABLE_INITIAL_SCOPES;
+    table->scope_count = 0;
+    table->scopes = (Scope*)safe_malloc(sizeof(Scope) * table->scope_capacity);
+    table->symbol_count = 0;
+
+    symbol_table_enter_scope(table, global_scope_name);
     return table;
 }
 
 void symbol_table_destroy(SymbolTable* table) {
     if (!table) return;
 
-    Symbol* current = table->head;
-    while (current) {
-        Symbol* next = current->next;
-        symbol_destroy(current);
-        current = next;
-    }
-
-    free(table->scope_name);
+    /* Symbols themselves live in the caller's arena */
+    free(table->slots);
+    free(table->scopes);
     free(table);
 }
 
-/* Symbol creation and destruction */
+/* Symbol creation */
 
-Symbol* symbol_create(const char* name, const char* type, const char* scope, int line) {
-    Symbol* symbol = (Symbol*)safe_malloc(sizeof(Symbol));
-    symbol->name = string_duplicate(name);
-    symbol->type = string_duplicate(type);
-    symbol->scope = string_duplicate(scope);
+Symbol* symbol_create(Arena* arena, const char* name, const char* type, const char* scope, int line) {
+    Symbol* symbol = (Symbol*)arena_alloc(arena, sizeof(Symbol));
+    symbol->name = name;
+    symbol->type = type;
+    symbol->scope = scope;
     symbol->line_declared = line;
     symbol->is_function = 0;
+    symbol->is_macro = 0;
     symbol->is_array = 0;
+    symbol->depth = 0;
+    symbol->shadowed = NULL;
     symbol->next = NULL;
     return symbol;
 }
 
-void symbol_destroy(Symbol* symbol) {
-    if (!symbol) return;
+/* Hash table internals */
+
+/*
+ * Find the slot for name: either the slot holding its innermost symbol, or
+ * (when absent) the slot an insert should use - the first tombstone passed,
+ * otherwise the empty slot that ended the probe.
+ */
+static int find_slot(const SymbolTable* table, const char* name) {
+    unsigned int mask = (unsigned int)table->capacity - 1;
+    unsigned int index = intern_pointer_hash(name) & mask;
+    int reuse = -1;
+
+    while (table->slots[index]) {
+        Symbol* symbol = table->slots[index];
+        if (symbol == TOMBSTONE) {
+            if (reuse < 0) reuse = (int)index;
+        } else if (symbol->name == name) {
+            return (int)index;
+        }
+        index = (index + 1) & mask;
+    }
+
+    return reuse >= 0 ? reuse : (int)index;
+}
+
+/* Double the slot array, dropping tombstones */
+static void grow_slots(SymbolTable* table) {
+    Symbol** old_slots = table->slots;
+    int old_capacity = table->capacity;
+
+    table->capacity = old_capacity * 2;
+    table->used = 0;
+    table->slots = (Symbol**)calloc((size_t)table->capacity, sizeof(Symbol*));
+    if (!table->slots) {
+        log_message(LOG_ERROR, "Memory allocation failed");
+        memory_failure();
+    }
+
+    for (int i = 0; i < old_capacity; i++) {
+        Symbol* symbol = old_slots[i];
+        if (symbol && symbol != TOMBSTONE) {
+            table->slots[find_slot(table, symbol->name)] = symbol;
+            table->used++;
+        }
+    }
+
+    free(old_slots);
+}
+
+/* Scope management */
+
+void symbol_table_enter_scope(SymbolTable* table, const char* scope_name) {
+    if (table->scope_count >= table->scope_capacity) {
+        table->scope_capacity *= 2;
+        table->scopes = (Scope*)safe_realloc(table->scopes, sizeof(Scope) * table->scope_capacity);
+    }
+
+    Scope* scope = &table->scopes[table->scope_count++];
+    scope->name = scope_name;
+    scope->symbols = NULL;
+}
+
+void symbol_table_exit_scope(SymbolTable* table) {
+    /* The global scope is never popped */
+    if (table->scope_count <= 1) return;
+
+    Scope* scope = &table->scopes[--table->scope_count];
+
+    /* Undo the scope's declarations, newest first */
+    for (Symbol* symbol = scope->symbols; symbol; symbol = symbol->next) {
+        int index = find_slot(table, symbol->name);
+        table->slots[index] = symbol->shadowed ? symbol->shadowed : TOMBSTONE;
+    }
+}
 
-    free(symbol->name);
-    free(symbol->type);
-    free(symbol->scope);
-    free(symbol);
+const char* symbol_table_scope_name(const SymbolTable* table) {
+    return table->scopes[table->scope_count - 1].name;
 }
 
 /* Symbol table operations */
@@ -52,53 +138,67 @@ void symbol_destroy(Symbol* symbol) {
 void symbol_table_insert(SymbolTable* table, Symbol* symbol) {
     if (!table || !symbol) return;
 
-    symbol->next = table->head;
-    table->head = symbol;
-}
+    /* Keep the load factor under three quarters */
+    if ((table->used + 1) * 4 > table->capacity * 3) {
+        grow_slots(table);
+    }
 
-Symbol* symbol_table_lookup_local(SymbolTable* table, const char* name) {
-    if (!table || !name) return NULL;
+    table->symbol_count++;
 
-    Symbol* current = table->head;
-    while (current) {
-        if (string_equals(current->name, name)) {
-            return current;
-        }
-        current = current->next;
-    }
+    Scope* scope = &table->scopes[table->scope_count - 1];
+    symbol->depth = table->scope_count - 1;
+    symbol->next = scope->symbols;
+    scope->symbols = symbol;
 
-    return NULL;
+    int index = find_slot(table, symbol->name);
+    Symbol* existing = table->slots[index];
+    if (!existing) {
+        table->used++;
+        symbol->shadowed = NULL;
+    } else {
+        symbol->shadowed = existing == TOMBSTONE ? NULL : existing;
+    }
+    table->slots[index] = symbol;
 }
 
 Symbol* symbol_table_lookup(SymbolTable* table, const char* name) {
     if (!table || !name) return NULL;
 
-    /* Search current scope */
-    Symbol* symbol = symbol_table_lookup_local(table, name);
-    if (symbol) return symbol;
+    Symbol* symbol = table->slots[find_slot(table, name)];
+    return symbol == TOMBSTONE ? NULL : symbol;
+}
 
-    /* Search parent scopes */
-    if (table->parent) {
-        return symbol_table_lookup(table->parent, name);
+Symbol* symbol_table_lookup_local(SymbolTable* table, const char* name) {
+    Symbol* symbol = symbol_table_lookup(table, name);
+    if (symbol && symbol->depth == table->scope_count - 1) {
+        return symbol;
     }
-
     return NULL;
 }
 
+Symbol* symbol_table_lookup_global(SymbolTable* table, const char* name) {
+    Symbol* symbol = symbol_table_lookup(table, name);
+    while (symbol && symbol->depth != 0) {
+        symbol = symbol->shadowed;
+    }
+    return symbol;
+}
+
 /* Debug printing */
 
 void symbol_table_print(SymbolTable* table) {
     if (!table) return;
 
-    printf("Symbol Table [%s]:\n", table->scope_name);
-    Symbol* current = table->head;
-    while (current) {
-        printf("  %s: %s (line %d)%s%s\n",
-               current->name,
-               current->type,
-               current->line_declared,
-               current->is_function ? " [function]" : "",
-               current->is_array ? " [array]" : "");
-        current = current->next;
+    for (int depth = table->scope_count - 1; depth >= 0; depth--) {
+        Scope* scope = &table->scopes[depth];
+        printf("Symbol Table [%s]:\n", scope->name);
+        for (Symbol* current = scope->symbols; current; current = current->next) {
+            printf("  %s: %s (line %d)%s%s\n",
+                   current->name,
+                   current->type,
+                   current->line_declared,
+                   current->is_function ? " [function]" : "",
+                   current->is_array ? " [array]" : "");
+        }
     }
 }
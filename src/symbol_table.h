@@ -2,35 +2,59 @@
 #define SYMBOL_TABLE_H
 
 #include "utils.h"
+#include "arena.h"
+#include "intern.h"
 
 /* Symbol structure */
 typedef struct Symbol {
-    char* name;
-    char* type;
-    char* scope;
+    const char* name;
+    const char* type;
+    const char* scope;
     int line_declared;
     int is_function;
+    int is_macro;               /* A function-like macro from a header */
     int is_array;
-    struct Symbol* next;
+    int depth;                  /* Scope depth at declaration (0 = global) */
+    struct Symbol* shadowed;    /* Outer symbol hidden by this one, if any */
+    struct Symbol* next;        /* Next symbol declared in the same scope */
 } Symbol;
 
-/* Symbol table structure */
+/* One entry on the scope stack; its symbol list doubles as the undo log */
+typedef struct {
+    const char* name;
+    Symbol* symbols;
+} Scope;
+
+/*
+ * Symbol table: an open-addressing hash table holding the innermost visible
+ * symbol for each name, plus a stack of scopes. Leaving a scope walks that
+ * scope's symbols and restores whatever they shadowed. Names are interned
+ * handles and are hashed and compared by pointer.
+ */
 typedef struct SymbolTable {
-    Symbol* head;
-    struct SymbolTable* parent;  /* For nested scopes */
-    char* scope_name;
+    Symbol** slots;
+    int capacity;
+    int used;                   /* Occupied slots, including tombstones */
+    Scope* scopes;
+    int scope_count;
+    int scope_capacity;
+    int symbol_count;           /* Symbols inserted over the table's life */
 } SymbolTable;
 
 /* Symbol table functions */
-SymbolTable* symbol_table_create(const char* scope_name, SymbolTable* parent);
+SymbolTable* symbol_table_create(const char* global_scope_name);
 void symbol_table_destroy(SymbolTable* table);
 
-Symbol* symbol_create(const char* name, const char* type, const char* scope, int line);
-void symbol_destroy(Symbol* symbol);
+void symbol_table_enter_scope(SymbolTable* table, const char* scope_name);
+void symbol_table_exit_scope(SymbolTable* table);
+const char* symbol_table_scope_name(const SymbolTable* table);
+
+Symbol* symbol_create(Arena* arena, const char* name, const char* type, const char* scope, int line);
 
 void symbol_table_insert(SymbolTable* table, Symbol* symbol);
 Symbol* symbol_table_lookup(SymbolTable* table, const char* name);
 Symbol* symbol_table_lookup_local(SymbolTable* table, const char* name);
+Symbol* symbol_table_lookup_global(SymbolTable* table, const char* name);
 
 void symbol_table_print(SymbolTable* table);
 
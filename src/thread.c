@@ -0,0 +1,241 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#endif
+#include <unistd.h>
+#endif
+
+#include "thread.h"
+
+/* Start routine arguments, freed by the new thread */
+typedef struct {
+    ThreadFunction function;
+    void* arg;
+} ThreadStart;
+
+#ifdef _WIN32
+
+static DWORD WINAPI thread_trampoline(LPVOID param) {
+    ThreadStart start = *(ThreadStart*)param;
+    free(param);
+    start.function(start.arg);
+    return 0;
+}
+
+int thread_create(Thread* thread, ThreadFunction function, void* arg) {
+    ThreadStart* start = (ThreadStart*)safe_malloc(sizeof(ThreadStart));
+    start->function = function;
+    start->arg = arg;
+
+    *thread = CreateThread(NULL, 0, thread_trampoline, start, 0, NULL);
+    if (!*thread) {
+        free(start);
+        return 0;
+    }
+    return 1;
+}
+
+void thread_join(Thread thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+int thread_cpu_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+void mutex_init(Mutex* mutex) {
+    InitializeCriticalSection(mutex);
+}
+
+void mutex_destroy(Mutex* mutex) {
+    DeleteCriticalSection(mutex);
+}
+
+void mutex_lock(Mutex* mutex) {
+    EnterCriticalSection(mutex);
+}
+
+void mutex_unlock(Mutex* mutex) {
+    LeaveCriticalSection(mutex);
+}
+
+void condition_init(Condition* condition) {
+    InitializeConditionVariable(condition);
+}
+
+void condition_destroy(Condition* condition) {
+    (void)condition;
+}
+
+void condition_wait(Condition* condition, Mutex* mutex) {
+    SleepConditionVariableCS(condition, mutex, INFINITE);
+}
+
+void condition_signal(Condition* condition) {
+    WakeConditionVariable(condition);
+}
+
+void condition_broadcast(Condition* condition) {
+    WakeAllConditionVariable(condition);
+}
+
+typedef struct {
+    void (*function)(void);
+} OnceCall;
+
+static BOOL CALLBACK once_trampoline(PINIT_ONCE once, PVOID param, PVOID* context) {
+    (void)once;
+    (void)context;
+    ((OnceCall*)param)->function();
+    return TRUE;
+}
+
+void thread_once(ThreadOnce* once, void (*function)(void)) {
+    OnceCall call = { function };
+    InitOnceExecuteOnce(once, once_trampoline, &call, NULL);
+}
+
+#else
+
+static void* thread_trampoline(void* param) {
+    ThreadStart start = *(ThreadStart*)param;
+    free(param);
+    start.function(start.arg);
+    return NULL;
+}
+
+int thread_create(Thread* thread, ThreadFunction function, void* arg) {
+    ThreadStart* start = (ThreadStart*)safe_malloc(sizeof(ThreadStart));
+    start->function = function;
+    start->arg = arg;
+
+    if (pthread_create(thread, NULL, thread_trampoline, start) != 0) {
+        free(start);
+        return 0;
+    }
+    return 1;
+}
+
+void thread_join(Thread thread) {
+    pthread_join(thread, NULL);
+}
+
+int thread_cpu_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
+
+void mutex_init(Mutex* mutex) {
+    pthread_mutex_init(mutex, NULL);
+}
+
+void mutex_destroy(Mutex* mutex) {
+    pthread_mutex_destroy(mutex);
+}
+
+void mutex_lock(Mutex* mutex) {
+    pthread_mutex_lock(mutex);
+}
+
+void mutex_unlock(Mutex* mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+void condition_init(Condition* condition) {
+    pthread_cond_init(condition, NULL);
+}
+
+void condition_destroy(Condition* condition) {
+    pthread_cond_destroy(condition);
+}
+
+void condition_wait(Condition* condition, Mutex* mutex) {
+    pthread_cond_wait(condition, mutex);
+}
+
+void condition_signal(Condition* condition) {
+    pthread_cond_signal(condition);
+}
+
+void condition_broadcast(Condition* condition) {
+    pthread_cond_broadcast(condition);
+}
+
+void thread_once(ThreadOnce* once, void (*function)(void)) {
+    pthread_once(once, function);
+}
+
+#endif
+
+/* Parallel loops */
+
+typedef struct {
+    ParallelBody body;
+    void* context;
+    int count;
+    int grain;
+    int next;
+    Mutex lock;
+} ParallelLoop;
+
+static void parallel_worker(void* arg) {
+    ParallelLoop* loop = (ParallelLoop*)arg;
+
+    for (;;) {
+        mutex_lock(&loop->lock);
+        int start = loop->next;
+        loop->next += loop->grain;
+        mutex_unlock(&loop->lock);
+
+        if (start >= loop->count) break;
+
+        int end = start + loop->grain < loop->count ? start + loop->grain : loop->count;
+        for (int i = start; i < end; i++) {
+            loop->body(loop->context, i);
+        }
+    }
+}
+
+void parallel_for(int count, int jobs, ParallelBody body, void* context) {
+    if (jobs <= 0) jobs = thread_cpu_count();
+    if (jobs > count) jobs = count;
+
+    if (jobs <= 1) {
+        for (int i = 0; i < count; i++) {
+            body(context, i);
+        }
+        return;
+    }
+
+    ParallelLoop loop;
+    loop.body = body;
+    loop.context = context;
+    loop.count = count;
+    loop.next = 0;
+    /* About eight batches per thread balances uneven work against locking */
+    loop.grain = count / (jobs * 8);
+    if (loop.grain < 1) loop.grain = 1;
+    mutex_init(&loop.lock);
+
+    Thread* threads = (Thread*)safe_malloc(sizeof(Thread) * jobs);
+    int* started = (int*)safe_malloc(sizeof(int) * jobs);
+    for (int i = 1; i < jobs; i++) {
+        started[i] = thread_create(&threads[i], parallel_worker, &loop);
+    }
+
+    parallel_worker(&loop);
+
+    for (int i = 1; i < jobs; i++) {
+        if (started[i]) {
+            thread_join(threads[i]);
+        }
+    }
+
+    free(started);
+    free(threads);
+    mutex_destroy(&loop.lock);
+}
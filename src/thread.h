@@ -0,0 +1,61 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include "utils.h"
+
+/* Minimal threading layer over pthreads or Win32 */
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE Thread;
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE Condition;
+typedef INIT_ONCE ThreadOnce;
+#define THREAD_ONCE_INIT INIT_ONCE_STATIC_INIT
+#else
+#include <pthread.h>
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Condition;
+typedef pthread_once_t ThreadOnce;
+#define THREAD_ONCE_INIT PTHREAD_ONCE_INIT
+#endif
+
+/* Thread-local storage class */
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+typedef void (*ThreadFunction)(void* arg);
+
+/* Threads */
+int thread_create(Thread* thread, ThreadFunction function, void* arg);
+void thread_join(Thread thread);
+int thread_cpu_count(void);
+
+/* Mutexes */
+void mutex_init(Mutex* mutex);
+void mutex_destroy(Mutex* mutex);
+void mutex_lock(Mutex* mutex);
+void mutex_unlock(Mutex* mutex);
+
+/* Condition variables; condition_wait releases mutex while it sleeps */
+void condition_init(Condition* condition);
+void condition_destroy(Condition* condition);
+void condition_wait(Condition* condition, Mutex* mutex);
+void condition_signal(Condition* condition);
+void condition_broadcast(Condition* condition);
+
+/*
+ * Parallel loop: run body(context, i) for every i in [0, count) on up to jobs
+ * threads (0 = one per CPU), the calling thread included. Indices are handed
+ * out in small batches; returns once every index has run.
+ */
+typedef void (*ParallelBody)(void* context, int index);
+void parallel_for(int count, int jobs, ParallelBody body, void* context);
+
+/* One-time initialisation */
+void thread_once(ThreadOnce* once, void (*function)(void));
+
+#endif /* THREAD_H */
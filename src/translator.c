@@ -1,751 +1,989 @@
 #include "translator.h"
-#include "formatter.h"
+#include "thread.h"
 
 /* Forward declarations */
-static void translate_function(TranslationContext* ctx, ASTNode* node);
-static void translate_statement(TranslationContext* ctx, ASTNode* node, int step_number);
-static char* translate_expression(ASTNode* node);
+static void translate_function(TranslationContext* ctx, ASTRef ref);
+static void translate_statement(TranslationContext* ctx, ASTRef ref, int step_number);
+static void write_expression(const AST* ast, SymbolTable* headers, Description* out, ASTRef ref);
 
 /* Helper functions */
 
-static void append_output(TranslationContext* ctx, const char* text) {
-    if (!text) return;
-
-    size_t text_len = strlen(text);
-    size_t required = ctx->output_size + text_len + 1;
-
-    if (required > ctx->output_capacity) {
-        ctx->output_capacity = required * 2;
-        ctx->output = (char*)safe_realloc(ctx->output, ctx->output_capacity);
-    }
+/* Open a step, numbered when step_number is positive */
+static void begin_step(TranslationContext* ctx, int step_number) {
+    description_begin(ctx->output, DESC_STEP, step_number, 0);
+}
 
-    strcat(ctx->output, text);
-    ctx->output_size += text_len;
+/* A step that is one sentence */
+static void add_step(TranslationContext* ctx, const char* text) {
+    begin_step(ctx, 0);
+    description_text(ctx->output, text);
+    description_end(ctx->output);
 }
 
-static void append_line(TranslationContext* ctx, const char* text) {
-    /* Add indentation */
-    for (int i = 0; i < ctx->indent_level; i++) {
-        append_output(ctx, "  ");
-    }
-    append_output(ctx, text);
-    append_output(ctx, "\n");
+/*
+ * Expression translation. Expressions become fragments of the sentence
+ * being built, subexpressions in place, so a whole expression is one pass
+ * with no intermediate strings and no length limit.
+ */
+
+/* Write before, left, middle, right, after */
+static void write_binary_phrase(const AST* ast, SymbolTable* headers, Description* out, const char* before, ASTRef left,
+                                const char* middle, ASTRef right, const char* after) {
+    description_text(out, before);
+    write_expression(ast, headers, out, left);
+    description_text(out, middle);
+    write_expression(ast, headers, out, right);
+    description_text(out, after);
 }
 
-/* Expression translation */
-
-static char* translate_binary_operator(const char* op, ASTNode* left, ASTNode* right) {
-    char* left_str = translate_expression(left);
-    char* right_str = translate_expression(right);
-    char* result = (char*)safe_malloc(1024);
-
-    if (string_equals(op, "+")) {
-        snprintf(result, 1024, "the sum of %s and %s", left_str, right_str);
-    } else if (string_equals(op, "-")) {
-        snprintf(result, 1024, "the difference between %s and %s", left_str, right_str);
-    } else if (string_equals(op, "*")) {
-        snprintf(result, 1024, "the product of %s and %s", left_str, right_str);
-    } else if (string_equals(op, "/")) {
-        snprintf(result, 1024, "%s divided by %s", left_str, right_str);
-    } else if (string_equals(op, "%")) {
-        snprintf(result, 1024, "the remainder when %s is divided by %s", left_str, right_str);
-    } else if (string_equals(op, "==")) {
-        snprintf(result, 1024, "%s is equal to %s", left_str, right_str);
-    } else if (string_equals(op, "!=")) {
-        snprintf(result, 1024, "%s is not equal to %s", left_str, right_str);
-    } else if (string_equals(op, "<")) {
-        snprintf(result, 1024, "%s is less than %s", left_str, right_str);
-    } else if (string_equals(op, "<=")) {
-        snprintf(result, 1024, "%s is less than or equal to %s", left_str, right_str);
-    } else if (string_equals(op, ">")) {
-        snprintf(result, 1024, "%s is greater than %s", left_str, right_str);
-    } else if (string_equals(op, ">=")) {
-        snprintf(result, 1024, "%s is greater than or equal to %s", left_str, right_str);
-    } else if (string_equals(op, "&&")) {
-        snprintf(result, 1024, "both %s and %s", left_str, right_str);
-    } else if (string_equals(op, "||")) {
-        snprintf(result, 1024, "either %s or %s", left_str, right_str);
-    } else if (string_equals(op, "&")) {
-        snprintf(result, 1024, "the bitwise AND of %s and %s", left_str, right_str);
-    } else if (string_equals(op, "|")) {
-        snprintf(result, 1024, "the bitwise OR of %s and %s", left_str, right_str);
-    } else if (string_equals(op, "^")) {
-        snprintf(result, 1024, "the bitwise XOR of %s and %s", left_str, right_str);
-    } else if (string_equals(op, "<<")) {
-        snprintf(result, 1024, "%s left-shifted by %s bits", left_str, right_str);
-    } else if (string_equals(op, ">>")) {
-        snprintf(result, 1024, "%s right-shifted by %s bits", left_str, right_str);
-    } else {
-        snprintf(result, 1024, "%s %s %s", left_str, op, right_str);
+static void write_binary_operator(const AST* ast, SymbolTable* headers, Description* out, OperatorKind op, ASTRef left, ASTRef right) {
+    switch (op) {
+        case OP_ADD:
+            write_binary_phrase(ast, headers, out, "the sum of ", left, " and ", right, "");
+            break;
+        case OP_SUBTRACT:
+            write_binary_phrase(ast, headers, out, "the difference between ", left, " and ", right, "");
+            break;
+        case OP_MULTIPLY:
+            write_binary_phrase(ast, headers, out, "the product of ", left, " and ", right, "");
+            break;
+        case OP_DIVIDE:
+            write_binary_phrase(ast, headers, out, "", left, " divided by ", right, "");
+            break;
+        case OP_MODULO:
+            write_binary_phrase(ast, headers, out, "the remainder when ", left, " is divided by ", right, "");
+            break;
+        case OP_EQUAL:
+            write_binary_phrase(ast, headers, out, "", left, " is equal to ", right, "");
+            break;
+        case OP_NOT_EQUAL:
+            write_binary_phrase(ast, headers, out, "", left, " is not equal to ", right, "");
+            break;
+        case OP_LESS:
+            write_binary_phrase(ast, headers, out, "", left, " is less than ", right, "");
+            break;
+        case OP_LESS_EQUAL:
+            write_binary_phrase(ast, headers, out, "", left, " is less than or equal to ", right, "");
+            break;
+        case OP_GREATER:
+            write_binary_phrase(ast, headers, out, "", left, " is greater than ", right, "");
+            break;
+        case OP_GREATER_EQUAL:
+            write_binary_phrase(ast, headers, out, "", left, " is greater than or equal to ", right, "");
+            break;
+        case OP_LOGICAL_AND:
+            write_binary_phrase(ast, headers, out, "both ", left, " and ", right, "");
+            break;
+        case OP_LOGICAL_OR:
+            write_binary_phrase(ast, headers, out, "either ", left, " or ", right, "");
+            break;
+        case OP_BIT_AND:
+            write_binary_phrase(ast, headers, out, "the bitwise AND of ", left, " and ", right, "");
+            break;
+        case OP_BIT_OR:
+            write_binary_phrase(ast, headers, out, "the bitwise OR of ", left, " and ", right, "");
+            break;
+        case OP_BIT_XOR:
+            write_binary_phrase(ast, headers, out, "the bitwise XOR of ", left, " and ", right, "");
+            break;
+        case OP_SHIFT_LEFT:
+            write_binary_phrase(ast, headers, out, "", left, " left-shifted by ", right, " bits");
+            break;
+        case OP_SHIFT_RIGHT:
+            write_binary_phrase(ast, headers, out, "", left, " right-shifted by ", right, " bits");
+            break;
+        default:
+            write_expression(ast, headers, out, left);
+            description_text(out, " ");
+            description_text(out, operator_symbol(op));
+            description_text(out, " ");
+            write_expression(ast, headers, out, right);
+            break;
     }
+}
 
-    free(left_str);
-    free(right_str);
-    return result;
+/* Write before, operand, after */
+static void write_unary_phrase(const AST* ast, SymbolTable* headers, Description* out, const char* before, ASTRef operand, const char* after) {
+    description_text(out, before);
+    write_expression(ast, headers, out, operand);
+    description_text(out, after);
 }
 
-static char* translate_unary_operator(const char* op, ASTNode* operand) {
-    char* operand_str = translate_expression(operand);
-    char* result = (char*)safe_malloc(512);
-
-    if (string_equals(op, "!")) {
-        snprintf(result, 512, "not %s", operand_str);
-    } else if (string_equals(op, "-")) {
-        snprintf(result, 512, "negative %s", operand_str);
-    } else if (string_equals(op, "+")) {
-        snprintf(result, 512, "%s", operand_str);
-    } else if (string_equals(op, "++")) {
-        snprintf(result, 512, "%s incremented by 1", operand_str);
-    } else if (string_equals(op, "--")) {
-        snprintf(result, 512, "%s decremented by 1", operand_str);
-    } else if (string_equals(op, "++post")) {
-        snprintf(result, 512, "increment %s by 1", operand_str);
-    } else if (string_equals(op, "--post")) {
-        snprintf(result, 512, "decrement %s by 1", operand_str);
-    } else if (string_equals(op, "~")) {
-        snprintf(result, 512, "the bitwise complement of %s", operand_str);
-    } else if (string_equals(op, "&")) {
-        snprintf(result, 512, "the address of %s", operand_str);
-    } else if (string_equals(op, "*")) {
-        snprintf(result, 512, "the value stored at the memory location referenced by %s", operand_str);
-    } else {
-        snprintf(result, 512, "%s %s", op, operand_str);
+static void write_unary_operator(const AST* ast, SymbolTable* headers, Description* out, OperatorKind op, ASTRef operand) {
+    switch (op) {
+        case OP_NOT:
+            write_unary_phrase(ast, headers, out, "not ", operand, "");
+            break;
+        case OP_NEGATE:
+            write_unary_phrase(ast, headers, out, "negative ", operand, "");
+            break;
+        case OP_UNARY_PLUS:
+            write_unary_phrase(ast, headers, out, "", operand, "");
+            break;
+        case OP_PRE_INCREMENT:
+            write_unary_phrase(ast, headers, out, "", operand, " incremented by 1");
+            break;
+        case OP_PRE_DECREMENT:
+            write_unary_phrase(ast, headers, out, "", operand, " decremented by 1");
+            break;
+        case OP_POST_INCREMENT:
+            write_unary_phrase(ast, headers, out, "increment ", operand, " by 1");
+            break;
+        case OP_POST_DECREMENT:
+            write_unary_phrase(ast, headers, out, "decrement ", operand, " by 1");
+            break;
+        case OP_BIT_NOT:
+            write_unary_phrase(ast, headers, out, "the bitwise complement of ", operand, "");
+            break;
+        case OP_ADDRESS_OF:
+            write_unary_phrase(ast, headers, out, "the address of ", operand, "");
+            break;
+        case OP_DEREFERENCE:
+            write_unary_phrase(ast, headers, out, "the value stored at the memory location referenced by ", operand, "");
+            break;
+        default:
+            description_text(out, operator_symbol(op));
+            description_text(out, " ");
+            write_expression(ast, headers, out, operand);
+            break;
     }
-
-    free(operand_str);
-    return result;
 }
 
-static char* translate_function_call(ASTNode* node) {
-    char* result = (char*)safe_malloc(2048);
-    const char* func_name = node->data.function_call.name;
+static void write_function_call(const AST* ast, SymbolTable* headers, Description* out, const ASTNode* node) {
+    const char* func_name = AST_TEXT(ast, node->data.function_call.name);
+    const uint32_t* args = AST_LIST_ITEMS(ast, node->data.function_call.arguments);
+    int arg_count = AST_LIST_COUNT(ast, node->data.function_call.arguments);
 
     /* Handle standard library functions with special descriptions */
     if (string_equals(func_name, "printf")) {
-        if (node->data.function_call.arg_count > 0) {
-            ASTNode* format_arg = node->data.function_call.arguments[0];
+        if (arg_count > 0) {
+            const ASTNode* format_arg = AST_NODE(ast, args[0]);
             if (format_arg->type == NODE_LITERAL) {
-                snprintf(result, 2048, "display the message %s", format_arg->data.literal.value);
+                description_text(out, "display the message ");
+                description_code(out, AST_TEXT(ast, format_arg->data.literal.value));
             } else {
-                snprintf(result, 2048, "display formatted output to the user");
+                description_text(out, "display formatted output to the user");
             }
         } else {
-            snprintf(result, 2048, "display output to the user");
+            description_text(out, "display output to the user");
         }
     } else if (string_equals(func_name, "scanf")) {
-        snprintf(result, 2048, "read input from the user");
+        description_text(out, "read input from the user");
     } else if (string_equals(func_name, "strlen")) {
-        if (node->data.function_call.arg_count > 0) {
-            char* arg_str = translate_expression(node->data.function_call.arguments[0]);
-            snprintf(result, 2048, "determine the length of the text stored in %s", arg_str);
-            free(arg_str);
+        if (arg_count > 0) {
+            description_text(out, "determine the length of the text stored in ");
+            write_expression(ast, headers, out, args[0]);
         } else {
-            snprintf(result, 2048, "determine the length of a text string");
+            description_text(out, "determine the length of a text string");
         }
     } else if (string_equals(func_name, "strcpy")) {
-        snprintf(result, 2048, "copy one text string to another");
+        description_text(out, "copy one text string to another");
     } else if (string_equals(func_name, "malloc")) {
-        snprintf(result, 2048, "allocate memory dynamically");
+        description_text(out, "allocate memory dynamically");
     } else if (string_equals(func_name, "free")) {
-        snprintf(result, 2048, "release previously allocated memory");
+        description_text(out, "release previously allocated memory");
     } else if (string_equals(func_name, "strcmp")) {
-        snprintf(result, 2048, "compare two text strings");
+        description_text(out, "compare two text strings");
     } else if (string_equals(func_name, "strncmp")) {
-        snprintf(result, 2048, "compare a specified number of characters in two text strings");
+        description_text(out, "compare a specified number of characters in two text strings");
     } else if (string_equals(func_name, "strcat")) {
-        snprintf(result, 2048, "concatenate two text strings");
+        description_text(out, "concatenate two text strings");
     } else if (string_equals(func_name, "strncpy")) {
-        snprintf(result, 2048, "copy a specified number of characters from one text string to another");
+        description_text(out, "copy a specified number of characters from one text string to another");
     } else if (string_equals(func_name, "sprintf")) {
-        snprintf(result, 2048, "format text and store it in a string");
+        description_text(out, "format text and store it in a string");
     } else if (string_equals(func_name, "fprintf")) {
-        snprintf(result, 2048, "write formatted output to a file");
+        description_text(out, "write formatted output to a file");
     } else if (string_equals(func_name, "fscanf")) {
-        snprintf(result, 2048, "read formatted input from a file");
+        description_text(out, "read formatted input from a file");
     } else if (string_equals(func_name, "fopen")) {
-        snprintf(result, 2048, "open a file");
+        description_text(out, "open a file");
     } else if (string_equals(func_name, "fclose")) {
-        snprintf(result, 2048, "close an open file");
+        description_text(out, "close an open file");
     } else if (string_equals(func_name, "fread")) {
-        snprintf(result, 2048, "read data from a file");
+        description_text(out, "read data from a file");
     } else if (string_equals(func_name, "fwrite")) {
-        snprintf(result, 2048, "write data to a file");
+        description_text(out, "write data to a file");
     } else if (string_equals(func_name, "fgets")) {
-        snprintf(result, 2048, "read a line of text from a file");
+        description_text(out, "read a line of text from a file");
     } else if (string_equals(func_name, "fputs")) {
-        snprintf(result, 2048, "write a line of text to a file");
+        description_text(out, "write a line of text to a file");
     } else if (string_equals(func_name, "feof")) {
-        snprintf(result, 2048, "check if end of file has been reached");
+        description_text(out, "check if end of file has been reached");
     } else if (string_equals(func_name, "fseek")) {
-        snprintf(result, 2048, "move the file position indicator");
+        description_text(out, "move the file position indicator");
     } else if (string_equals(func_name, "ftell")) {
-        snprintf(result, 2048, "get the current file position");
+        description_text(out, "get the current file position");
     } else if (string_equals(func_name, "rewind")) {
-        snprintf(result, 2048, "reset the file position to the beginning");
+        description_text(out, "reset the file position to the beginning");
     } else if (string_equals(func_name, "calloc")) {
-        snprintf(result, 2048, "allocate and initialise memory to zero");
+        description_text(out, "allocate and initialise memory to zero");
     } else if (string_equals(func_name, "realloc")) {
-        snprintf(result, 2048, "resize previously allocated memory");
+        description_text(out, "resize previously allocated memory");
     } else if (string_equals(func_name, "memcpy")) {
-        snprintf(result, 2048, "copy a block of memory");
+        description_text(out, "copy a block of memory");
     } else if (string_equals(func_name, "memset")) {
-        snprintf(result, 2048, "fill a block of memory with a specified value");
+        description_text(out, "fill a block of memory with a specified value");
     } else if (string_equals(func_name, "memcmp")) {
-        snprintf(result, 2048, "compare two blocks of memory");
+        description_text(out, "compare two blocks of memory");
     } else if (string_equals(func_name, "atoi")) {
-        snprintf(result, 2048, "convert text to an integer");
+        description_text(out, "convert text to an integer");
     } else if (string_equals(func_name, "atof")) {
-        snprintf(result, 2048, "convert text to a floating-point number");
+        description_text(out, "convert text to a floating-point number");
     } else if (string_equals(func_name, "atol")) {
-        snprintf(result, 2048, "convert text to a long integer");
+        description_text(out, "convert text to a long integer");
     } else if (string_equals(func_name, "itoa")) {
-        snprintf(result, 2048, "convert an integer to text");
+        description_text(out, "convert an integer to text");
     } else if (string_equals(func_name, "abs")) {
-        snprintf(result, 2048, "calculate the absolute value");
+        description_text(out, "calculate the absolute value");
     } else if (string_equals(func_name, "sqrt")) {
-        snprintf(result, 2048, "calculate the square root");
+        description_text(out, "calculate the square root");
     } else if (string_equals(func_name, "pow")) {
-        snprintf(result, 2048, "raise a number to a power");
+        description_text(out, "raise a number to a power");
     } else if (string_equals(func_name, "sin")) {
-        snprintf(result, 2048, "calculate the sine");
+        description_text(out, "calculate the sine");
     } else if (string_equals(func_name, "cos")) {
-        snprintf(result, 2048, "calculate the cosine");
+        description_text(out, "calculate the cosine");
     } else if (string_equals(func_name, "tan")) {
-        snprintf(result, 2048, "calculate the tangent");
+        description_text(out, "calculate the tangent");
     } else if (string_equals(func_name, "log")) {
-        snprintf(result, 2048, "calculate the natural logarithm");
+        description_text(out, "calculate the natural logarithm");
     } else if (string_equals(func_name, "exp")) {
-        snprintf(result, 2048, "calculate the exponential");
+        description_text(out, "calculate the exponential");
     } else if (string_equals(func_name, "ceil")) {
-        snprintf(result, 2048, "round up to the nearest integer");
+        description_text(out, "round up to the nearest integer");
     } else if (string_equals(func_name, "floor")) {
-        snprintf(result, 2048, "round down to the nearest integer");
+        description_text(out, "round down to the nearest integer");
     } else if (string_equals(func_name, "rand")) {
-        snprintf(result, 2048, "generate a pseudo-random number");
+        description_text(out, "generate a pseudo-random number");
     } else if (string_equals(func_name, "srand")) {
-        snprintf(result, 2048, "seed the random number generator");
+        description_text(out, "seed the random number generator");
     } else if (string_equals(func_name, "time")) {
-        snprintf(result, 2048, "get the current time");
+        description_text(out, "get the current time");
     } else if (string_equals(func_name, "exit")) {
-        snprintf(result, 2048, "terminate the programme");
+        description_text(out, "terminate the programme");
     } else if (string_equals(func_name, "assert")) {
-        snprintf(result, 2048, "verify a condition and abort if false");
+        description_text(out, "verify a condition and abort if false");
     } else if (string_equals(func_name, "getchar")) {
-        snprintf(result, 2048, "read a character from standard input");
+        description_text(out, "read a character from standard input");
     } else if (string_equals(func_name, "putchar")) {
-        snprintf(result, 2048, "write a character to standard output");
+        description_text(out, "write a character to standard output");
     } else if (string_equals(func_name, "puts")) {
-        snprintf(result, 2048, "write a string to standard output");
+        description_text(out, "write a string to standard output");
     } else if (string_equals(func_name, "gets")) {
-        snprintf(result, 2048, "read a string from standard input");
+        description_text(out, "read a string from standard input");
     } else if (string_equals(func_name, "isalpha")) {
-        snprintf(result, 2048, "check if a character is alphabetic");
+        description_text(out, "check if a character is alphabetic");
     } else if (string_equals(func_name, "isdigit")) {
-        snprintf(result, 2048, "check if a character is a digit");
+        description_text(out, "check if a character is a digit");
     } else if (string_equals(func_name, "isspace")) {
-        snprintf(result, 2048, "check if a character is whitespace");
+        description_text(out, "check if a character is whitespace");
     } else if (string_equals(func_name, "toupper")) {
-        snprintf(result, 2048, "convert a character to uppercase");
+        description_text(out, "convert a character to uppercase");
     } else if (string_equals(func_name, "tolower")) {
-        snprintf(result, 2048, "convert a character to lowercase");
+        description_text(out, "convert a character to lowercase");
     } else if (string_equals(func_name, "qsort")) {
-        snprintf(result, 2048, "sort an array using quicksort");
+        description_text(out, "sort an array using quicksort");
     } else if (string_equals(func_name, "bsearch")) {
-        snprintf(result, 2048, "search a sorted array using binary search");
+        description_text(out, "search a sorted array using binary search");
     } else {
-        /* Generic function call */
-        if (node->data.function_call.arg_count > 0) {
-            char args_str[1024] = "";
-            for (int i = 0; i < node->data.function_call.arg_count; i++) {
-                char* arg = translate_expression(node->data.function_call.arguments[i]);
-                if (i > 0) strcat(args_str, ", ");
-                strcat(args_str, arg);
-                free(arg);
-            }
-            snprintf(result, 2048, "call the '%s' function with arguments %s", func_name, args_str);
+        /* Generic function call, with its declaration when a header gives one */
+        Symbol* declared = symbol_table_lookup(headers, func_name);
+        if (declared && declared->is_macro) {
+            description_text(out, "expand the ");
+            description_name(out, func_name);
+            description_text(out, " macro from ");
+            description_quoted_code(out, declared->scope);
+        } else if (declared && declared->is_function) {
+            description_text(out, "call the ");
+            description_name(out, func_name);
+            description_text(out, " function declared in ");
+            description_quoted_code(out, declared->scope);
+            description_text(out, " as ");
+            description_quoted_code(out, declared->type);
         } else {
-            snprintf(result, 2048, "call the '%s' function", func_name);
+            description_text(out, "call the ");
+            description_name(out, func_name);
+            description_text(out, " function");
+        }
+        if (arg_count > 0) {
+            description_text(out, " with arguments ");
+            for (int i = 0; i < arg_count; i++) {
+                if (i > 0) description_text(out, ", ");
+                write_expression(ast, headers, out, args[i]);
+            }
         }
     }
+}
+
+static void write_compound_assign(const AST* ast, SymbolTable* headers, Description* out, const ASTNode* node) {
+    ASTRef target = node->data.compound_assign.target;
+    ASTRef value = node->data.compound_assign.value;
+    OperatorKind op = (OperatorKind)node->op;
 
-    return result;
+    switch (op) {
+        case OP_ADD_ASSIGN:
+            write_binary_phrase(ast, headers, out, "increase ", target, " by ", value, "");
+            break;
+        case OP_SUBTRACT_ASSIGN:
+            write_binary_phrase(ast, headers, out, "decrease ", target, " by ", value, "");
+            break;
+        case OP_MULTIPLY_ASSIGN:
+            write_binary_phrase(ast, headers, out, "multiply ", target, " by ", value, "");
+            break;
+        case OP_DIVIDE_ASSIGN:
+            write_binary_phrase(ast, headers, out, "divide ", target, " by ", value, "");
+            break;
+        case OP_MODULO_ASSIGN:
+            write_binary_phrase(ast, headers, out, "set ", target, " to the remainder when divided by ", value, "");
+            break;
+        case OP_AND_ASSIGN:
+            write_binary_phrase(ast, headers, out, "bitwise AND ", target, " with ", value, "");
+            break;
+        case OP_OR_ASSIGN:
+            write_binary_phrase(ast, headers, out, "bitwise OR ", target, " with ", value, "");
+            break;
+        case OP_XOR_ASSIGN:
+            write_binary_phrase(ast, headers, out, "bitwise XOR ", target, " with ", value, "");
+            break;
+        case OP_SHIFT_LEFT_ASSIGN:
+            write_binary_phrase(ast, headers, out, "left-shift ", target, " by ", value, " bits");
+            break;
+        case OP_SHIFT_RIGHT_ASSIGN:
+            write_binary_phrase(ast, headers, out, "right-shift ", target, " by ", value, " bits");
+            break;
+        default:
+            description_text(out, "apply ");
+            description_text(out, operator_symbol(op));
+            description_text(out, " to ");
+            write_binary_phrase(ast, headers, out, "", target, " with ", value, "");
+            break;
+    }
 }
 
-static char* translate_expression(ASTNode* node) {
-    if (!node) return string_duplicate("nothing");
+static void write_expression(const AST* ast, SymbolTable* headers, Description* out, ASTRef ref) {
+    if (ref == AST_NONE) {
+        description_text(out, "nothing");
+        return;
+    }
 
-    char* result = (char*)safe_malloc(1024);
+    const ASTNode* node = AST_NODE(ast, ref);
 
     switch (node->type) {
         case NODE_LITERAL:
-            if (string_equals(node->data.literal.data_type, "number")) {
-                snprintf(result, 1024, "the value %s", node->data.literal.value);
-            } else if (string_equals(node->data.literal.data_type, "string")) {
-                snprintf(result, 1024, "%s", node->data.literal.value);
-            } else if (string_equals(node->data.literal.data_type, "char")) {
-                snprintf(result, 1024, "the character %s", node->data.literal.value);
-            } else {
-                snprintf(result, 1024, "%s", node->data.literal.value);
+            if (string_equals(AST_TEXT(ast, node->data.literal.data_type), "number")) {
+                description_text(out, "the value ");
+            } else if (string_equals(AST_TEXT(ast, node->data.literal.data_type), "char")) {
+                description_text(out, "the character ");
             }
+            description_code(out, AST_TEXT(ast, node->data.literal.value));
             break;
 
         case NODE_IDENTIFIER:
-            snprintf(result, 1024, "'%s'", node->data.identifier.name);
+            description_name(out, AST_TEXT(ast, node->data.identifier.name));
             break;
 
         case NODE_BINARY_OP:
-            free(result);
-            return translate_binary_operator(node->data.binary_op.operator,
-                                            node->data.binary_op.left,
-                                            node->data.binary_op.right);
+            write_binary_operator(ast, headers, out, (OperatorKind)node->op,
+                                  node->data.binary_op.left,
+                                  node->data.binary_op.right);
+            break;
 
         case NODE_UNARY_OP:
-            free(result);
-            return translate_unary_operator(node->data.unary_op.operator,
-                                           node->data.unary_op.operand);
+            write_unary_operator(ast, headers, out, (OperatorKind)node->op,
+                                 node->data.unary_op.operand);
+            break;
 
         case NODE_FUNCTION_CALL:
-            free(result);
-            return translate_function_call(node);
+            write_function_call(ast, headers, out, node);
+            break;
 
-        case NODE_ARRAY_ACCESS: {
-            char* index_str = translate_expression(node->data.array_access.index);
-            snprintf(result, 1024, "the element at position %s in the array '%s'",
-                    index_str, node->data.array_access.name);
-            free(index_str);
+        case NODE_ARRAY_ACCESS:
+            description_text(out, "the element at position ");
+            write_expression(ast, headers, out, node->data.array_access.index);
+            description_text(out, " in the array ");
+            description_name(out, AST_TEXT(ast, node->data.array_access.name));
             break;
-        }
 
-        case NODE_ASSIGNMENT: {
-            char* target_str = translate_expression(node->data.assignment.target);
-            char* value_str = translate_expression(node->data.assignment.value);
-            snprintf(result, 1024, "set %s to %s", target_str, value_str);
-            free(target_str);
-            free(value_str);
+        case NODE_ASSIGNMENT:
+            write_binary_phrase(ast, headers, out, "set ", node->data.assignment.target,
+                                " to ", node->data.assignment.value, "");
             break;
-        }
 
-        case NODE_MEMBER_ACCESS: {
-            char* obj_str = translate_expression(node->data.member_access.object);
-            if (node->data.member_access.is_arrow) {
-                snprintf(result, 1024, "the '%s' member of the structure pointed to by %s",
-                        node->data.member_access.member, obj_str);
-            } else {
-                snprintf(result, 1024, "the '%s' member of %s",
-                        node->data.member_access.member, obj_str);
-            }
-            free(obj_str);
+        case NODE_MEMBER_ACCESS:
+            description_text(out, "the ");
+            description_name(out, AST_TEXT(ast, node->data.member_access.member));
+            description_text(out, node->flag ? " member of the structure pointed to by " : " member of ");
+            write_expression(ast, headers, out, node->data.member_access.object);
             break;
-        }
 
-        case NODE_TERNARY: {
-            char* cond_str = translate_expression(node->data.ternary.condition);
-            char* then_str = translate_expression(node->data.ternary.then_expr);
-            char* else_str = translate_expression(node->data.ternary.else_expr);
-            snprintf(result, 1024, "if %s then %s, otherwise %s", cond_str, then_str, else_str);
-            free(cond_str);
-            free(then_str);
-            free(else_str);
+        case NODE_TERNARY:
+            description_text(out, "if ");
+            write_expression(ast, headers, out, node->data.ternary.condition);
+            write_binary_phrase(ast, headers, out, " then ", node->data.ternary.then_expr,
+                                ", otherwise ", node->data.ternary.else_expr, "");
             break;
-        }
 
-        case NODE_SIZEOF: {
+        case NODE_SIZEOF:
             if (node->data.sizeof_expr.type_name) {
-                snprintf(result, 1024, "the size in bytes of type '%s'", node->data.sizeof_expr.type_name);
+                description_text(out, "the size in bytes of type ");
+                description_quoted_code(out, AST_TEXT(ast, node->data.sizeof_expr.type_name));
             } else {
-                char* expr_str = translate_expression(node->data.sizeof_expr.expression);
-                snprintf(result, 1024, "the size in bytes of %s", expr_str);
-                free(expr_str);
+                write_unary_phrase(ast, headers, out, "the size in bytes of ", node->data.sizeof_expr.expression, "");
             }
             break;
-        }
 
-        case NODE_CAST: {
-            char* expr_str = translate_expression(node->data.cast.expression);
-            snprintf(result, 1024, "%s converted to type '%s'", expr_str, node->data.cast.target_type);
-            free(expr_str);
+        case NODE_CAST:
+            write_expression(ast, headers, out, node->data.cast.expression);
+            description_text(out, " converted to type ");
+            description_quoted_code(out, AST_TEXT(ast, node->data.cast.target_type));
             break;
-        }
 
-        case NODE_COMPOUND_ASSIGN: {
-            char* target_str = translate_expression(node->data.compound_assign.target);
-            char* value_str = translate_expression(node->data.compound_assign.value);
-            const char* op = node->data.compound_assign.operator;
-
-            if (string_equals(op, "+=")) {
-                snprintf(result, 1024, "increase %s by %s", target_str, value_str);
-            } else if (string_equals(op, "-=")) {
-                snprintf(result, 1024, "decrease %s by %s", target_str, value_str);
-            } else if (string_equals(op, "*=")) {
-                snprintf(result, 1024, "multiply %s by %s", target_str, value_str);
-            } else if (string_equals(op, "/=")) {
-                snprintf(result, 1024, "divide %s by %s", target_str, value_str);
-            } else if (string_equals(op, "%=")) {
-                snprintf(result, 1024, "set %s to the remainder when divided by %s", target_str, value_str);
-            } else if (string_equals(op, "&=")) {
-                snprintf(result, 1024, "bitwise AND %s with %s", target_str, value_str);
-            } else if (string_equals(op, "|=")) {
-                snprintf(result, 1024, "bitwise OR %s with %s", target_str, value_str);
-            } else if (string_equals(op, "^=")) {
-                snprintf(result, 1024, "bitwise XOR %s with %s", target_str, value_str);
-            } else if (string_equals(op, "<<=")) {
-                snprintf(result, 1024, "left-shift %s by %s bits", target_str, value_str);
-            } else if (string_equals(op, ">>=")) {
-                snprintf(result, 1024, "right-shift %s by %s bits", target_str, value_str);
-            } else {
-                snprintf(result, 1024, "apply %s to %s with %s", op, target_str, value_str);
-            }
-            free(target_str);
-            free(value_str);
+        case NODE_COMPOUND_ASSIGN:
+            write_compound_assign(ast, headers, out, node);
             break;
-        }
 
         default:
-            snprintf(result, 1024, "an expression");
+            description_text(out, "an expression");
             break;
     }
+}
+
+/* Write an optional expression, or the given text when it is absent */
+static void write_optional_expression(const AST* ast, SymbolTable* headers, Description* out, ASTRef ref, const char* absent) {
+    if (ref != AST_NONE) {
+        write_expression(ast, headers, out, ref);
+    } else {
+        description_text(out, absent);
+    }
+}
 
-    return result;
+/* Translate a branch or loop body into the enclosing block */
+static void translate_body(TranslationContext* ctx, ASTRef body) {
+    const AST* ast = ctx->ast;
+    const ASTNode* node = AST_NODE(ast, body);
+    if (node->type == NODE_BLOCK) {
+        const uint32_t* statements = AST_LIST_ITEMS(ast, node->data.block.statements);
+        for (int i = 0; i < AST_LIST_COUNT(ast, node->data.block.statements); i++) {
+            translate_statement(ctx, statements[i], 0);
+        }
+    } else {
+        translate_statement(ctx, body, 0);
+    }
 }
 
 /* Statement translation */
 
-static void translate_statement(TranslationContext* ctx, ASTNode* node, int step_number) {
-    if (!node) return;
+static void translate_statement(TranslationContext* ctx, ASTRef ref, int step_number) {
+    if (ref == AST_NONE) return;
 
-    char step_prefix[32] = "";
-    if (step_number > 0) {
-        snprintf(step_prefix, sizeof(step_prefix), "%d. ", step_number);
-    }
+    const AST* ast = ctx->ast;
+    const ASTNode* node = AST_NODE(ast, ref);
+    SymbolTable* headers = ctx->headers;
+    Description* out = ctx->output;
 
     switch (node->type) {
-        case NODE_DECLARATION: {
-            char line[1024];
-            if (node->data.declaration.is_array) {
-                char* size_str = translate_expression(node->data.declaration.array_size);
-                snprintf(line, sizeof(line), "%sDeclare an array named '%s' of type %s with %s elements.",
-                        step_prefix, node->data.declaration.name,
-                        node->data.declaration.data_type, size_str);
-                free(size_str);
+        case NODE_DECLARATION:
+            begin_step(ctx, step_number);
+            description_text(out, node->flag ? "Declare an array named " : "Declare a variable named ");
+            description_name(out, AST_TEXT(ast, node->data.declaration.name));
+            description_text(out, " of type ");
+            description_code(out, AST_TEXT(ast, node->data.declaration.data_type));
+            if (node->flag) {
+                description_text(out, " with ");
+                write_expression(ast, headers, out, node->data.declaration.array_size);
+                description_text(out, " elements.");
             } else if (node->data.declaration.initializer) {
-                char* init_str = translate_expression(node->data.declaration.initializer);
-                snprintf(line, sizeof(line), "%sDeclare a variable named '%s' of type %s, initialised to %s.",
-                        step_prefix, node->data.declaration.name,
-                        node->data.declaration.data_type, init_str);
-                free(init_str);
+                description_text(out, ", initialised to ");
+                write_expression(ast, headers, out, node->data.declaration.initializer);
+                description_text(out, ".");
             } else {
-                snprintf(line, sizeof(line), "%sDeclare a variable named '%s' of type %s.",
-                        step_prefix, node->data.declaration.name,
-                        node->data.declaration.data_type);
+                description_text(out, ".");
             }
-            append_line(ctx, line);
-            append_line(ctx, "");
+            description_end(out);
             break;
-        }
 
-        case NODE_IF: {
-            char* cond_str = translate_expression(node->data.if_stmt.condition);
-            char line[1024];
-            snprintf(line, sizeof(line), "%sIf the condition \"%s\" is true, then:", step_prefix, cond_str);
-            append_line(ctx, line);
-            free(cond_str);
-
-            ctx->indent_level++;
-            if (node->data.if_stmt.then_branch->type == NODE_BLOCK) {
-                for (int i = 0; i < node->data.if_stmt.then_branch->data.block.statement_count; i++) {
-                    translate_statement(ctx, node->data.if_stmt.then_branch->data.block.statements[i], 0);
-                }
-            } else {
-                translate_statement(ctx, node->data.if_stmt.then_branch, 0);
-            }
-            ctx->indent_level--;
+        case NODE_IF:
+            begin_step(ctx, step_number);
+            description_text(out, "If the condition \"");
+            write_expression(ast, headers, out, node->data.if_stmt.condition);
+            description_text(out, "\" is true, then:");
+
+            translate_body(ctx, node->data.if_stmt.then_branch);
 
             if (node->data.if_stmt.else_branch) {
-                append_line(ctx, "  Otherwise:");
-                ctx->indent_level++;
-                if (node->data.if_stmt.else_branch->type == NODE_BLOCK) {
-                    for (int i = 0; i < node->data.if_stmt.else_branch->data.block.statement_count; i++) {
-                        translate_statement(ctx, node->data.if_stmt.else_branch->data.block.statements[i], 0);
-                    }
-                } else {
-                    translate_statement(ctx, node->data.if_stmt.else_branch, 0);
-                }
-                ctx->indent_level--;
+                description_begin(out, DESC_OTHERWISE, 0, 0);
+                description_text(out, "Otherwise:");
+                translate_body(ctx, node->data.if_stmt.else_branch);
+                description_end(out);
             }
-            append_line(ctx, "");
+            description_end(out);
             break;
-        }
 
-        case NODE_WHILE: {
-            char* cond_str = translate_expression(node->data.while_stmt.condition);
-            char line[1024];
-            snprintf(line, sizeof(line), "%sWhilst the condition \"%s\" remains true, repeatedly perform the following:",
-                    step_prefix, cond_str);
-            append_line(ctx, line);
-            free(cond_str);
-
-            ctx->indent_level++;
-            if (node->data.while_stmt.body->type == NODE_BLOCK) {
-                for (int i = 0; i < node->data.while_stmt.body->data.block.statement_count; i++) {
-                    translate_statement(ctx, node->data.while_stmt.body->data.block.statements[i], 0);
-                }
-            } else {
-                translate_statement(ctx, node->data.while_stmt.body, 0);
-            }
-            ctx->indent_level--;
-            append_line(ctx, "");
+        case NODE_WHILE:
+            begin_step(ctx, step_number);
+            description_text(out, "Whilst the condition \"");
+            write_expression(ast, headers, out, node->data.while_stmt.condition);
+            description_text(out, "\" remains true, repeatedly perform the following:");
+
+            translate_body(ctx, node->data.while_stmt.body);
+            description_end(out);
             break;
-        }
 
-        case NODE_FOR: {
-            char line[2048];
-            char* init_str = node->data.for_stmt.init ? translate_expression(node->data.for_stmt.init) : string_duplicate("nothing");
-            char* cond_str = node->data.for_stmt.condition ? translate_expression(node->data.for_stmt.condition) : string_duplicate("true");
-            char* inc_str = node->data.for_stmt.increment ? translate_expression(node->data.for_stmt.increment) : string_duplicate("nothing");
-
-            snprintf(line, sizeof(line),
-                    "%sBeginning with %s, and continuing whilst the condition \"%s\" holds, "
-                    "repeatedly perform the following operations, and after each iteration %s:",
-                    step_prefix, init_str, cond_str, inc_str);
-            append_line(ctx, line);
-
-            free(init_str);
-            free(cond_str);
-            free(inc_str);
-
-            ctx->indent_level++;
-            if (node->data.for_stmt.body->type == NODE_BLOCK) {
-                for (int i = 0; i < node->data.for_stmt.body->data.block.statement_count; i++) {
-                    translate_statement(ctx, node->data.for_stmt.body->data.block.statements[i], 0);
-                }
-            } else {
-                translate_statement(ctx, node->data.for_stmt.body, 0);
-            }
-            ctx->indent_level--;
-            append_line(ctx, "");
+        case NODE_FOR:
+            begin_step(ctx, step_number);
+            description_text(out, "Beginning with ");
+            write_optional_expression(ast, headers, out, node->data.for_stmt.init, "nothing");
+            description_text(out, ", and continuing whilst the condition \"");
+            write_optional_expression(ast, headers, out, node->data.for_stmt.condition, "true");
+            description_text(out, "\" holds, repeatedly perform the following operations, and after each iteration ");
+            write_optional_expression(ast, headers, out, node->data.for_stmt.increment, "nothing");
+            description_text(out, ":");
+
+            translate_body(ctx, node->data.for_stmt.body);
+            description_end(out);
             break;
-        }
 
-        case NODE_RETURN: {
-            char line[1024];
+        case NODE_RETURN:
+            begin_step(ctx, step_number);
             if (node->data.return_stmt.value) {
-                char* value_str = translate_expression(node->data.return_stmt.value);
-                snprintf(line, sizeof(line), "%sReturn %s.", step_prefix, value_str);
-                free(value_str);
+                description_text(out, "Return ");
+                write_expression(ast, headers, out, node->data.return_stmt.value);
+                description_text(out, ".");
             } else {
-                snprintf(line, sizeof(line), "%sReturn (void).", step_prefix);
+                description_text(out, "Return (void).");
             }
-            append_line(ctx, line);
-            append_line(ctx, "");
+            description_end(out);
             break;
-        }
 
         case NODE_BREAK:
-            append_line(ctx, "Exit the loop immediately.");
-            append_line(ctx, "");
+            add_step(ctx, "Exit the loop immediately.");
             break;
 
         case NODE_CONTINUE:
-            append_line(ctx, "Skip to the next iteration of the loop.");
-            append_line(ctx, "");
+            add_step(ctx, "Skip to the next iteration of the loop.");
             break;
 
-        case NODE_DO_WHILE: {
-            char line[1024];
-            snprintf(line, sizeof(line), "%sRepeatedly perform the following:", step_prefix);
-            append_line(ctx, line);
+        case NODE_DO_WHILE:
+            begin_step(ctx, step_number);
+            description_text(out, "Repeatedly perform the following:");
 
-            ctx->indent_level++;
-            if (node->data.while_stmt.body->type == NODE_BLOCK) {
-                for (int i = 0; i < node->data.while_stmt.body->data.block.statement_count; i++) {
-                    translate_statement(ctx, node->data.while_stmt.body->data.block.statements[i], 0);
-                }
-            } else {
-                translate_statement(ctx, node->data.while_stmt.body, 0);
-            }
-            ctx->indent_level--;
+            translate_body(ctx, node->data.while_stmt.body);
 
-            char* cond_str = translate_expression(node->data.while_stmt.condition);
-            snprintf(line, sizeof(line), "Continue whilst the condition \"%s\" remains true.", cond_str);
-            append_line(ctx, line);
-            free(cond_str);
-            append_line(ctx, "");
+            description_begin(out, DESC_CLOSING, 0, 0);
+            description_text(out, "Continue whilst the condition \"");
+            write_expression(ast, headers, out, node->data.while_stmt.condition);
+            description_text(out, "\" remains true.");
+            description_end(out);
+            description_end(out);
             break;
-        }
 
-        case NODE_SWITCH: {
-            char* expr_str = translate_expression(node->data.switch_stmt.expression);
-            char line[1024];
-            snprintf(line, sizeof(line), "%sDepending on the value of %s:", step_prefix, expr_str);
-            append_line(ctx, line);
-            free(expr_str);
+        case NODE_SWITCH:
+            begin_step(ctx, step_number);
+            description_text(out, "Depending on the value of ");
+            write_expression(ast, headers, out, node->data.switch_stmt.expression);
+            description_text(out, ":");
 
-            ctx->indent_level++;
-            for (int i = 0; i < node->data.switch_stmt.case_count; i++) {
-                ASTNode* case_node = node->data.switch_stmt.cases[i];
+            const uint32_t* cases = AST_LIST_ITEMS(ast, node->data.switch_stmt.cases);
+            for (int i = 0; i < AST_LIST_COUNT(ast, node->data.switch_stmt.cases); i++) {
+                const ASTNode* case_node = AST_NODE(ast, cases[i]);
+                description_begin(out, DESC_CASE, 0, 0);
                 if (case_node->type == NODE_CASE) {
-                    char* value_str = translate_expression(case_node->data.case_stmt.value);
-                    snprintf(line, sizeof(line), "When it equals %s:", value_str);
-                    append_line(ctx, line);
-                    free(value_str);
+                    description_text(out, "When it equals ");
+                    write_expression(ast, headers, out, case_node->data.case_stmt.value);
+                    description_text(out, ":");
                 } else {
-                    append_line(ctx, "Otherwise (default):");
+                    description_text(out, "Otherwise (default):");
                 }
 
-                ctx->indent_level++;
-                for (int j = 0; j < case_node->data.case_stmt.statement_count; j++) {
-                    translate_statement(ctx, case_node->data.case_stmt.statements[j], 0);
+                const uint32_t* statements = AST_LIST_ITEMS(ast, case_node->data.case_stmt.statements);
+                for (int j = 0; j < AST_LIST_COUNT(ast, case_node->data.case_stmt.statements); j++) {
+                    translate_statement(ctx, statements[j], 0);
                 }
-                ctx->indent_level--;
+                description_end(out);
             }
-            ctx->indent_level--;
-            append_line(ctx, "");
+            description_end(out);
             break;
-        }
 
-        case NODE_GOTO: {
-            char line[1024];
-            snprintf(line, sizeof(line), "%sJump to label '%s'.", step_prefix, node->data.goto_stmt.label);
-            append_line(ctx, line);
-            append_line(ctx, "");
+        case NODE_GOTO:
+            begin_step(ctx, step_number);
+            description_text(out, "Jump to label ");
+            description_name(out, AST_TEXT(ast, node->data.goto_stmt.label));
+            description_text(out, ".");
+            description_end(out);
             break;
-        }
 
-        case NODE_LABEL: {
-            char line[1024];
-            snprintf(line, sizeof(line), "Label '%s':", node->data.label_stmt.name);
-            append_line(ctx, line);
+        case NODE_LABEL:
+            description_begin(out, DESC_LABEL, 0, 0);
+            description_text(out, "Label ");
+            description_name(out, AST_TEXT(ast, node->data.label_stmt.name));
+            description_text(out, ":");
             if (node->data.label_stmt.statement) {
                 translate_statement(ctx, node->data.label_stmt.statement, 0);
             }
+            description_end(out);
             break;
-        }
 
-        case NODE_BLOCK:
-            for (int i = 0; i < node->data.block.statement_count; i++) {
-                translate_statement(ctx, node->data.block.statements[i], step_number > 0 ? i + 1 : 0);
+        case NODE_BLOCK: {
+            const uint32_t* statements = AST_LIST_ITEMS(ast, node->data.block.statements);
+            for (int i = 0; i < AST_LIST_COUNT(ast, node->data.block.statements); i++) {
+                translate_statement(ctx, statements[i], step_number > 0 ? i + 1 : 0);
             }
             break;
+        }
 
         default:
-            /* Expression statement */
-            {
-                char* expr_str = translate_expression(node);
-                char line[1024];
-                snprintf(line, sizeof(line), "%s%s.", step_prefix, expr_str);
-                /* Capitalize first letter */
-                if (line[0] >= 'a' && line[0] <= 'z') {
-                    line[0] = line[0] - 'a' + 'A';
-                }
-                append_line(ctx, line);
-                append_line(ctx, "");
-                free(expr_str);
-            }
+            /* Expression statement; unnumbered, it starts the sentence */
+            description_begin(out, DESC_STEP, step_number, step_number > 0 ? 0 : DESC_CAPITALISE);
+            write_expression(ast, headers, out, ref);
+            description_text(out, ".");
+            description_end(out);
             break;
     }
 }
 
 /* Function translation */
 
-static void translate_function(TranslationContext* ctx, ASTNode* node) {
-    if (node->type != NODE_FUNCTION) return;
+/* Open the function with its heading: the only part of a description that uses the name */
+static void translate_function_header(TranslationContext* ctx, const ASTNode* node) {
+    description_begin(ctx->output, DESC_FUNCTION, 0, 0);
+    description_text(ctx->output, "Function: ");
+    description_code(ctx->output, AST_TEXT(ctx->ast, node->data.function.name));
+}
 
-    /* Function header */
-    char header[256];
-    snprintf(header, sizeof(header), "Function: %s", node->data.function.name);
-    append_line(ctx, header);
+/* A parameter's name and type */
+static void write_parameter(Description* out, const Parameter* param) {
+    description_name(out, param->name);
+    description_text(out, " of type ");
+    description_code(out, param->type);
+    if (param->is_array) description_text(out, " (array)");
+}
 
-    /* Underline */
-    for (size_t i = 0; i < strlen(header); i++) {
-        append_output(ctx, "-");
-    }
-    append_output(ctx, "\n");
+/* Everything after the header, closing the function; depends on the name only through "main" */
+static void translate_function_body(TranslationContext* ctx, const ASTNode* node) {
+    const AST* ast = ctx->ast;
+    Description* out = ctx->output;
+    const uint32_t* params = AST_LIST_ITEMS(ast, node->data.function.parameters);
+    int param_count = AST_LIST_COUNT(ast, node->data.function.parameters);
 
     /* Function description */
-    char desc[512];
-    if (node->data.function.param_count == 0) {
-        snprintf(desc, sizeof(desc), "This function accepts no parameters and returns a value of type %s.",
-                node->data.function.return_type);
-    } else if (node->data.function.param_count == 1) {
-        Parameter* param = node->data.function.parameters[0];
-        snprintf(desc, sizeof(desc),
-                "This function accepts one parameter named '%s' of type %s%s, and returns a value of type %s.",
-                param->name, param->type, param->is_array ? " (array)" : "",
-                node->data.function.return_type);
+    description_begin(out, DESC_PARAGRAPH, 0, 0);
+    if (param_count == 0) {
+        description_text(out, "This function accepts no parameters and returns a value of type ");
+    } else if (param_count == 1) {
+        description_text(out, "This function accepts one parameter named ");
+        write_parameter(out, AST_PARAMETER(ast, params[0]));
+        description_text(out, ", and returns a value of type ");
     } else {
-        snprintf(desc, sizeof(desc), "This function accepts %d parameters and returns a value of type %s.",
-                node->data.function.param_count, node->data.function.return_type);
+        description_text(out, "This function accepts ");
+        description_number(out, param_count);
+        description_text(out, " parameters and returns a value of type ");
     }
-    append_line(ctx, desc);
-    append_line(ctx, "");
+    description_code(out, AST_TEXT(ast, node->data.function.return_type));
+    description_text(out, ".");
+    description_end(out);
 
     /* Parameter list if multiple */
-    if (node->data.function.param_count > 1) {
-        append_line(ctx, "Parameters:");
-        for (int i = 0; i < node->data.function.param_count; i++) {
-            Parameter* param = node->data.function.parameters[i];
-            char param_line[256];
-            snprintf(param_line, sizeof(param_line), "  • '%s': %s%s",
-                    param->name, param->type, param->is_array ? " (array)" : "");
-            append_line(ctx, param_line);
+    if (param_count > 1) {
+        description_begin(out, DESC_PARAMETERS, 0, 0);
+        description_text(out, "Parameters:");
+        for (int i = 0; i < param_count; i++) {
+            const Parameter* param = AST_PARAMETER(ast, params[i]);
+            description_begin(out, DESC_PARAMETER, 0, 0);
+            description_name(out, param->name);
+            description_text(out, ": ");
+            description_code(out, param->type);
+            if (param->is_array) description_text(out, " (array)");
+            description_end(out);
         }
-        append_line(ctx, "");
+        description_end(out);
     }
 
     /* Function body */
-    if (string_equals(node->data.function.name, "main")) {
-        append_line(ctx, "This is the main entry point of the programme.");
-        append_line(ctx, "");
+    if (string_equals(AST_TEXT(ast, node->data.function.name), "main")) {
+        description_begin(out, DESC_PARAGRAPH, 0, 0);
+        description_text(out, "This is the main entry point of the programme.");
+        description_end(out);
+    }
+
+    description_begin(out, DESC_STEPS, 0, 0);
+    description_text(out, "The function performs the following steps:");
+    const ASTNode* body = AST_NODE(ast, node->data.function.body);
+    if (node->data.function.body && body->type == NODE_BLOCK) {
+        const uint32_t* statements = AST_LIST_ITEMS(ast, body->data.block.statements);
+        for (int i = 0; i < AST_LIST_COUNT(ast, body->data.block.statements); i++) {
+            translate_statement(ctx, statements[i], i + 1);
+        }
     }
+    description_end(out);
+
+    description_end(out);
+}
+
+static void translate_function(TranslationContext* ctx, ASTRef ref) {
+    const ASTNode* node = AST_NODE(ctx->ast, ref);
+    if (node->type != NODE_FUNCTION) return;
 
-    append_line(ctx, "The function performs the following steps:");
-    append_line(ctx, "");
+    translate_function_header(ctx, node);
+    translate_function_body(ctx, node);
+}
+
+/*
+ * Memoisation. Functions whose return type, parameters and body are
+ * structurally equal get the same description apart from the header, so
+ * each such group is described once. "main" is never grouped, since its
+ * description mentions the entry point.
+ */
+
+typedef struct {
+    int* representative;    /* First function with the same description */
+    int* shared;            /* Nonzero where a later function reuses this one */
+    Description** bodies;   /* Descriptions of shared representatives */
+} FunctionMemo;
+
+static int is_memoisable(const AST* ast, ASTRef ref) {
+    const ASTNode* node = AST_NODE(ast, ref);
+    return node->type == NODE_FUNCTION && !string_equals(AST_TEXT(ast, node->data.function.name), "main");
+}
+
+static unsigned int function_shape_hash(const AST* ast, ASTRef ref) {
+    const ASTNode* node = AST_NODE(ast, ref);
+    const char* return_type = AST_TEXT(ast, node->data.function.return_type);
+    unsigned int hash = string_hash(return_type, strlen(return_type));
+    hash = (hash ^ ast_hash_parameters(ast, node->data.function.parameters)) * 16777619u;
+    return (hash ^ ast_hash(ast, node->data.function.body)) * 16777619u;
+}
+
+static int function_shape_equal(const AST* ast, ASTRef a_ref, ASTRef b_ref) {
+    const ASTNode* a = AST_NODE(ast, a_ref);
+    const ASTNode* b = AST_NODE(ast, b_ref);
+    return string_equals(AST_TEXT(ast, a->data.function.return_type), AST_TEXT(ast, b->data.function.return_type)) &&
+           ast_parameters_equal(ast, a->data.function.parameters, b->data.function.parameters) &&
+           ast_equal(ast, a->data.function.body, b->data.function.body);
+}
+
+/* Group the functions by shape with an open-addressing table of first indices */
+static void function_memo_init(FunctionMemo* memo, const AST* ast, const uint32_t* functions, int count) {
+    memo->representative = (int*)safe_malloc(sizeof(int) * count);
+    memo->shared = (int*)calloc((size_t)count, sizeof(int));
+    memo->bodies = (Description**)calloc((size_t)count, sizeof(Description*));
+    if (!memo->shared || !memo->bodies) {
+        log_message(LOG_ERROR, "Memory allocation failed");
+        memory_failure();
+    }
+
+    int capacity = 16;
+    while (capacity < count * 2) capacity *= 2;
+    unsigned int mask = (unsigned int)capacity - 1;
+    int* slots = (int*)safe_malloc(sizeof(int) * capacity);
+    unsigned int* hashes = (unsigned int*)safe_malloc(sizeof(unsigned int) * count);
+    for (int i = 0; i < capacity; i++) slots[i] = -1;
+
+    for (int i = 0; i < count; i++) {
+        memo->representative[i] = i;
+        if (!is_memoisable(ast, functions[i])) continue;
+
+        hashes[i] = function_shape_hash(ast, functions[i]);
+        unsigned int index = hashes[i] & mask;
+        while (slots[index] >= 0) {
+            int other = slots[index];
+            if (hashes[other] == hashes[i] && function_shape_equal(ast, functions[other], functions[i])) {
+                memo->representative[i] = other;
+                memo->shared[other] = 1;
+                break;
+            }
+            index = (index + 1) & mask;
+        }
+        if (slots[index] < 0) {
+            slots[index] = i;
+        }
+    }
 
-    if (node->data.function.body && node->data.function.body->type == NODE_BLOCK) {
-        ctx->indent_level = 1;
-        for (int i = 0; i < node->data.function.body->data.block.statement_count; i++) {
-            translate_statement(ctx, node->data.function.body->data.block.statements[i], i + 1);
+    for (int i = 0; i < count; i++) {
+        if (memo->shared[i]) {
+            memo->bodies[i] = description_create();
         }
-        ctx->indent_level = 0;
     }
 
-    append_line(ctx, "");
+    free(hashes);
+    free(slots);
 }
 
-/* Main translation function */
+static void function_memo_destroy(FunctionMemo* memo, int count) {
+    for (int i = 0; i < count; i++) {
+        description_destroy(memo->bodies[i]);
+    }
+    free(memo->bodies);
+    free(memo->shared);
+    free(memo->representative);
+}
+
+/*
+ * Describe function index into ctx, except that a shared representative's
+ * body goes to its memo builder and a repeat writes only its header; the
+ * caller copies the memoised body in after either.
+ */
+static void translate_function_memo(TranslationContext* ctx, ASTRef ref,
+                                    const FunctionMemo* memo, int index) {
+    const ASTNode* node = AST_NODE(ctx->ast, ref);
+    if (!memo || node->type != NODE_FUNCTION) {
+        translate_function(ctx, ref);
+        return;
+    }
+
+    translate_function_header(ctx, node);
+    if (memo->representative[index] != index) return;
+
+    if (memo->shared[index]) {
+        TranslationContext body_ctx;
+        body_ctx.ast = ctx->ast;
+        body_ctx.output = memo->bodies[index];
+        body_ctx.headers = ctx->headers;
+        translate_function_body(&body_ctx, node);
+    } else {
+        translate_function_body(ctx, node);
+    }
+}
 
-char* translate_to_english(ASTNode* program) {
-    if (!program || program->type != NODE_PROGRAM) {
-        return string_duplicate("Error: Invalid programme structure.\n");
+/* Copy in the memoised body that translate_function_memo left out, if any */
+static void append_memoised_body(Description* output, const FunctionMemo* memo, int index) {
+    if (!memo) return;
+
+    Description* body = memo->bodies[memo->representative[index]];
+    if (body) {
+        description_append(output, body);
     }
+}
+
+/* Parallel translation: each function is described into its own segment */
+
+typedef struct {
+    const AST* ast;
+    const uint32_t* functions;
+    Description** segments;
+    const FunctionMemo* memo;
+    SymbolTable* headers;
+} FunctionSegments;
+
+static void translate_function_segment(void* context, int index) {
+    FunctionSegments* work = (FunctionSegments*)context;
 
     TranslationContext ctx;
-    ctx.output_capacity = 4096;
-    ctx.output_size = 0;
-    ctx.output = (char*)safe_malloc(ctx.output_capacity);
-    ctx.output[0] = '\0';
-    ctx.indent_level = 0;
+    ctx.ast = work->ast;
+    ctx.output = work->segments[index];
+    ctx.headers = work->headers;
+    translate_function_memo(&ctx, work->functions[index], work->memo, index);
+}
 
-    /* Programme header */
-    append_line(&ctx, "Programme Description");
-    append_line(&ctx, "=====================");
-    append_line(&ctx, "");
+/* Programme header */
 
-    /* Count functions */
-    int func_count = program->data.program.function_count;
+static void translate_programme_title(Description* output) {
+    description_begin(output, DESC_PROGRAMME, 0, 0);
+    description_text(output, "Programme Description");
+}
+
+/* The function count, as a paragraph or, when it ends the description, its closing sentence */
+static void translate_function_count(Description* output, int func_count, DescriptionKind kind) {
+    description_begin(output, kind, 0, 0);
     if (func_count == 1) {
-        append_line(&ctx, "This programme consists of one function.");
+        description_text(output, "This programme consists of one function.");
     } else {
-        char line[256];
-        snprintf(line, sizeof(line), "This programme consists of %d functions.", func_count);
-        append_line(&ctx, line);
+        description_text(output, "This programme consists of ");
+        description_number(output, func_count);
+        description_text(output, " functions.");
+    }
+    description_end(output);
+}
+
+/* Main translation functions */
+
+void translate_to_english(const AST* ast, ASTRef program, Description* output,
+                          const TranslateOptions* options) {
+    if (program == AST_NONE || AST_NODE(ast, program)->type != NODE_PROGRAM) {
+        description_begin(output, DESC_SENTENCE, 0, 0);
+        description_text(output, "Error: Invalid programme structure.");
+        description_end(output);
+        return;
+    }
+
+    TranslationContext ctx;
+    ctx.ast = ast;
+    ctx.output = output;
+    ctx.headers = options->headers;
+
+    /* Programme header */
+    translate_programme_title(output);
+
+    /* Count functions */
+    ASTList function_list = AST_NODE(ast, program)->data.program.functions;
+    int func_count = AST_LIST_COUNT(ast, function_list);
+    translate_function_count(output, func_count, DESC_PARAGRAPH);
+
+    const uint32_t* functions = AST_LIST_ITEMS(ast, function_list);
+    FunctionMemo memo;
+    const FunctionMemo* memo_used = NULL;
+    if (options->memoise && func_count > 1) {
+        function_memo_init(&memo, ast, functions, func_count);
+        memo_used = &memo;
     }
-    append_line(&ctx, "");
 
     /* Translate each function */
+    if (options->jobs == 1 || func_count < 2) {
+        for (int i = 0; i < func_count; i++) {
+            translate_function_memo(&ctx, functions[i], memo_used, i);
+            append_memoised_body(output, memo_used, i);
+        }
+        description_end(output);
+        if (memo_used) function_memo_destroy(&memo, func_count);
+        return;
+    }
+
+    /*
+     * Functions are independent, so describing them separately and joining
+     * the segments in source order gives exactly the serial description.
+     */
+    FunctionSegments work;
+    work.ast = ast;
+    work.functions = functions;
+    work.memo = memo_used;
+    work.headers = options->headers;
+    work.segments = (Description**)safe_malloc(sizeof(Description*) * func_count);
+    for (int i = 0; i < func_count; i++) {
+        work.segments[i] = description_create();
+    }
+
+    parallel_for(func_count, options->jobs, translate_function_segment, &work);
+
     for (int i = 0; i < func_count; i++) {
-        translate_function(&ctx, program->data.program.functions[i]);
+        description_append(output, work.segments[i]);
+        description_destroy(work.segments[i]);
+        append_memoised_body(output, memo_used, i);
     }
+    description_end(output);
+    free(work.segments);
+    if (memo_used) function_memo_destroy(&memo, func_count);
+}
+
+void translate_stream_begin(Description* output) {
+    translate_programme_title(output);
+}
+
+void translate_stream_function(const AST* ast, ASTRef function, Description* output,
+                               const TranslateOptions* options) {
+    TranslationContext ctx;
+    ctx.ast = ast;
+    ctx.output = output;
+    ctx.headers = options->headers;
+    translate_function(&ctx, function);
+}
+
+void translate_stream_end(Description* output, int function_count) {
+    translate_function_count(output, function_count, DESC_SENTENCE);
+    description_end(output);
+}
 
-    return ctx.output;
+void translate_programme_head(Description* output, int function_count) {
+    translate_programme_title(output);
+    translate_function_count(output, function_count, DESC_PARAGRAPH);
+    description_end(output);
 }
@@ -2,17 +2,53 @@
 #define TRANSLATOR_H
 
 #include "ast.h"
+#include "description.h"
 #include "utils.h"
+#include "symbol_table.h"
 
 /* Translation context */
 typedef struct {
-    char* output;
-    size_t output_size;
-    size_t output_capacity;
-    int indent_level;
+    const AST* ast;
+    Description* output;
+    SymbolTable* headers;   /* Declarations from included headers, or NULL */
 } TranslationContext;
 
-/* Translator functions */
-char* translate_to_english(ASTNode* program);
+/*
+ * Translation switches. With jobs other than 1, functions are translated in
+ * parallel on up to jobs threads (0 = one per CPU). With memoise set,
+ * functions that differ only in their name are described once and the
+ * description is copied for the rest. Neither changes the output. headers,
+ * when set, holds what the programme's headers declare, and calls to their
+ * functions and macros are described with the header and declaration.
+ */
+typedef struct {
+    int jobs;
+    int memoise;
+    SymbolTable* headers;
+} TranslateOptions;
+
+/* Describe the programme, appending to output; the renderers turn that into text */
+void translate_to_english(const AST* ast, ASTRef program, Description* output,
+                          const TranslateOptions* options);
+
+/*
+ * Streaming translation, one function at a time: the title, then each
+ * function as it is parsed, then the function count. The count comes last
+ * because it is not known when the title is written; otherwise the
+ * description matches translate_to_english's. Of the options, only headers
+ * applies.
+ */
+void translate_stream_begin(Description* output);
+void translate_stream_function(const AST* ast, ASTRef function, Description* output,
+                               const TranslateOptions* options);
+void translate_stream_end(Description* output, int function_count);
+
+/*
+ * The title and function count that head translate_to_english's
+ * description, on their own, for callers that keep each function's
+ * description apart: rendered as text, this then the functions from
+ * translate_stream_function give translate_to_english's text.
+ */
+void translate_programme_head(Description* output, int function_count);
 
 #endif /* TRANSLATOR_H */
@@ -1,4 +1,15 @@
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#define _POSIX_C_SOURCE 200809L
+#include <unistd.h>
+#endif
+#include <errno.h>
+#include <sys/stat.h>
+
 #include "utils.h"
+#include "thread.h"
 
 /* String manipulation utilities */
 
@@ -34,13 +45,76 @@ int string_starts_with(const char* str, const char* prefix) {
     return strncmp(str, prefix, len) == 0;
 }
 
+/* FNV-1a hash of length bytes */
+unsigned int string_hash(const char* str, size_t length) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint64_t fnv1a_64(uint64_t hash, const void* data, size_t length) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* Byte encoding */
+
+void put_le32(unsigned char* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+uint32_t get_le32(const unsigned char* in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= (uint32_t)in[i] << (8 * i);
+    }
+    return value;
+}
+
+void put_le64(unsigned char* out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+uint64_t get_le64(const unsigned char* in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= (uint64_t)in[i] << (8 * i);
+    }
+    return value;
+}
+
+void put_be32(unsigned char* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (unsigned char)(value >> (8 * (3 - i)));
+    }
+}
+
+uint32_t get_be32(const unsigned char* in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= (uint32_t)in[i] << (8 * (3 - i));
+    }
+    return value;
+}
+
 /* Memory management utilities */
 
 void* safe_malloc(size_t size) {
     void* ptr = malloc(size);
     if (!ptr) {
         log_message(LOG_ERROR, "Memory allocation failed");
-        exit(EXIT_FAILURE);
+        memory_failure();
     }
     return ptr;
 }
@@ -49,11 +123,27 @@ void* safe_realloc(void* ptr, size_t size) {
     void* new_ptr = realloc(ptr, size);
     if (!new_ptr && size > 0) {
         log_message(LOG_ERROR, "Memory reallocation failed");
-        exit(EXIT_FAILURE);
+        memory_failure();
     }
     return new_ptr;
 }
 
+/* Per-thread handler; a failed allocation exits when unset */
+static THREAD_LOCAL MemoryFailureHandler memory_failure_handler = NULL;
+static THREAD_LOCAL void* memory_failure_context = NULL;
+
+void memory_failure_capture(MemoryFailureHandler handler, void* context) {
+    memory_failure_handler = handler;
+    memory_failure_context = context;
+}
+
+void memory_failure(void) {
+    if (memory_failure_handler) {
+        memory_failure_handler(memory_failure_context);
+    }
+    exit(EXIT_FAILURE);
+}
+
 /* File utilities */
 
 char* read_file(const char* filename) {
@@ -87,22 +177,95 @@ int write_file(const char* filename, const char* content) {
     return 1;
 }
 
+int make_directory(const char* path) {
+#ifdef _WIN32
+    return _mkdir(path) == 0 || errno == EEXIST;
+#else
+    return mkdir(path, 0777) == 0 || errno == EEXIST;
+#endif
+}
+
+long current_process_id(void) {
+#ifdef _WIN32
+    return (long)_getpid();
+#else
+    return (long)getpid();
+#endif
+}
+
+/* Diagnostics */
+
+/* Per-thread redirection; diagnostics go to stderr when unset */
+static THREAD_LOCAL DiagnosticWriter diagnostic_writer = NULL;
+static THREAD_LOCAL void* diagnostic_context = NULL;
+
+void diagnostics_capture(DiagnosticWriter writer, void* context) {
+    diagnostic_writer = writer;
+    diagnostic_context = context;
+}
+
+/* Emit one complete diagnostic, so concurrent messages never interleave */
+static void diagnostic_emit(const char* text, size_t length) {
+    if (diagnostic_writer) {
+        diagnostic_writer(diagnostic_context, text, length);
+    } else {
+        fwrite(text, 1, length, stderr);
+    }
+}
+
+/*
+ * Format into buffer when the text fits, otherwise into a heap string the
+ * caller frees. Returns NULL on a formatting error.
+ */
+static char* format_text(char* buffer, size_t size, int* length, const char* format, va_list args) {
+    va_list retry;
+    va_copy(retry, args);
+
+    char* text = buffer;
+    *length = vsnprintf(buffer, size, format, args);
+    if (*length < 0) {
+        text = NULL;
+    } else if ((size_t)*length >= size) {
+        text = (char*)safe_malloc((size_t)*length + 1);
+        vsnprintf(text, (size_t)*length + 1, format, retry);
+    }
+
+    va_end(retry);
+    return text;
+}
+
+void diagnostic_printf(const char* format, ...) {
+    char buffer[512];
+    int length;
+
+    va_list args;
+    va_start(args, format);
+    char* text = format_text(buffer, sizeof(buffer), &length, format, args);
+    va_end(args);
+
+    if (!text) return;
+    diagnostic_emit(text, (size_t)length);
+    if (text != buffer) free(text);
+}
+
 /* Logging and error reporting */
 
 void log_message(LogLevel level, const char* format, ...) {
     const char* level_str[] = {"INFO", "WARNING", "ERROR"};
-    fprintf(stderr, "[%s] ", level_str[level]);
+    char buffer[512];
+    int length;
 
     va_list args;
     va_start(args, format);
-    vfprintf(stderr, format, args);
+    char* message = format_text(buffer, sizeof(buffer), &length, format, args);
     va_end(args);
 
-    fprintf(stderr, "\n");
+    diagnostic_printf("[%s] %s\n", level_str[level], message ? message : "");
+    if (message && message != buffer) free(message);
 }
 
 void report_error(const char* filename, int line, int column, const char* message) {
-    fprintf(stderr, "[ERROR] %s:%d:%d: %s\n", filename, line, column, message);
+    diagnostic_printf("[ERROR] %s:%d:%d: %s\n", filename, line, column, message);
 }
 
 /* Character classification helpers */
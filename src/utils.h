@@ -6,6 +6,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 /* Version information */
 #define C2EN_VERSION_MAJOR 1
@@ -25,14 +26,48 @@ char* string_duplicate(const char* str);
 char* string_concat(const char* str1, const char* str2);
 int string_equals(const char* str1, const char* str2);
 int string_starts_with(const char* str, const char* prefix);
+unsigned int string_hash(const char* str, size_t length);
+
+/* 64-bit FNV-1a of length bytes, continuing from hash; start from FNV1A_64_BASIS */
+#define FNV1A_64_BASIS 14695981039346656037ULL
+uint64_t fnv1a_64(uint64_t hash, const void* data, size_t length);
+
+/* Fixed-width integers in file formats (little-endian) and on the wire (big-endian) */
+void put_le32(unsigned char* out, uint32_t value);
+uint32_t get_le32(const unsigned char* in);
+void put_le64(unsigned char* out, uint64_t value);
+uint64_t get_le64(const unsigned char* in);
+void put_be32(unsigned char* out, uint32_t value);
+uint32_t get_be32(const unsigned char* in);
 
 /* Memory management utilities */
 void* safe_malloc(size_t size);
 void* safe_realloc(void* ptr, size_t size);
 
+/*
+ * Allocation failure. By default the process exits; when the calling thread
+ * has installed a handler, that is called instead. A handler must not return
+ * (the library unwinds to its entry point with longjmp).
+ */
+typedef void (*MemoryFailureHandler)(void* context);
+void memory_failure_capture(MemoryFailureHandler handler, void* context);
+void memory_failure(void);
+
 /* File utilities */
 char* read_file(const char* filename);
 int write_file(const char* filename, const char* content);
+/* Create a directory; succeeds if it already exists */
+int make_directory(const char* path);
+/* The process's id, which keeps temporary file names apart */
+long current_process_id(void);
+
+/*
+ * Diagnostics. Every message is emitted whole, to stderr or - when the
+ * calling thread has installed a writer - to that writer instead.
+ */
+typedef void (*DiagnosticWriter)(void* context, const char* text, size_t length);
+void diagnostics_capture(DiagnosticWriter writer, void* context);
+void diagnostic_printf(const char* format, ...);
 
 /* Logging and error reporting */
 void log_message(LogLevel level, const char* format, ...);
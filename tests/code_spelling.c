@@ -0,0 +1,10 @@
+int check(char c, int color) {
+    if (c == '"' && color > 0) {
+        return color;
+    }
+    return 0;
+}
+
+int main() {
+    return check('"', 2);
+}
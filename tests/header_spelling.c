@@ -0,0 +1,7 @@
+#include "color.h"
+
+int main() {
+    int total = add_numbers(2, 3);
+    int larger = COLOR_MAX(total, 4);
+    return larger;
+}
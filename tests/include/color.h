@@ -0,0 +1,8 @@
+#ifndef COLOR_H
+#define COLOR_H
+
+#define COLOR_MAX(a, b) ((a) > (b) ? (a) : (b))
+
+int add_numbers(int a, int b);
+
+#endif